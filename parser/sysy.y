@@ -27,13 +27,69 @@
 /* ---------- yylex forward declaration ---------- */
 
 %code {
-    yy::Parser::symbol_type yylex(void* yyscanner, yy::location& loc);
+    #include <cstdio>
+    #include <sstream>
+
+    /* Defined in scanner.cpp: the next token from flex or the hand-written
+     * lexer, whichever the Scanner is using. */
+    yy::Parser::symbol_type yylex(Scanner& ctx, yy::location& loc);
+
+    /* Where `l` starts, for the debug location of the node built there. */
+    static SourceLoc At(const yy::location& l) {
+        return {(uint32_t)l.begin.line, (uint32_t)l.begin.column};
+    }
+
+    /* Report `m` at `l` as a warning; parsing carries on. */
+    static void Warn(Scanner& ctx, const yy::location& l, const std::string& m) {
+        std::ostringstream where;
+        where << l;
+        fprintf(ctx.Diagnostics(), "%s: warning: %s\n", where.str().c_str(), m.c_str());
+    }
+
+    /* Fold the text after `#pragma` (`unroll(N)`, `nounroll`,
+     * `vectorize(width)` or `interleave(N)`) into the hints of `loop`.
+     * A pragma this compiler does not know, or a hint on a statement that
+     * is not a loop, is warned about and ignored. Returns the error
+     * message for a malformed count of a known hint, or nullptr. */
+    static const char* ApplyLoopHint(Scanner& ctx, const yy::location& l,
+                                     const std::string& text, StmtAST& loop) {
+        LoopHints hints = loop.hints;
+        char name[16];
+        int value = 0, end = 0;
+        if (sscanf(text.c_str(), " %15[A-Za-z_] %n", name, &end) != 1 || !end) {
+            Warn(ctx, l, "ignoring unknown pragma");
+            return nullptr;
+        }
+        std::string hint = name;
+        const char* rest = text.c_str() + end;
+        if (hint == "nounroll") {
+            if (*rest) return "nounroll takes no count";
+            hints.noUnroll = true;
+        } else if (hint == "unroll" || hint == "vectorize" || hint == "interleave") {
+            end = 0;
+            if (sscanf(rest, "( %d ) %n", &value, &end) != 1 || !end || rest[end])
+                return "loop hint needs a count in parentheses";
+            if (value <= 0) return "loop hint count must be positive";
+            if (hint == "unroll")         hints.unroll = value;
+            else if (hint == "vectorize") hints.vectorize = value;
+            else                          hints.interleave = value;
+        } else {
+            Warn(ctx, l, "ignoring unknown pragma '" + hint + "'");
+            return nullptr;
+        }
+        if (loop.type != StmtAST::TYPE::While && loop.type != StmtAST::TYPE::For) {
+            Warn(ctx, l, "ignoring '" + hint + "': not followed by a loop");
+            return nullptr;
+        }
+        loop.hints = hints;
+        return nullptr;
+    }
 }
 
 /* ---------- scanner / parser parameters ---------- */
 
-%lex-param   {void* scanner} {yy::location& loc}
-%parse-param {void* scanner} {yy::location& loc} {class Scanner& ctx}
+%lex-param   {Scanner& ctx} {yy::location& loc}
+%parse-param {yy::location& loc} {class Scanner& ctx}
 
 /* ===================================================================
  * Token declarations
@@ -42,19 +98,26 @@
 /* keywords */
 %token INT CHAR VOID
 %token CONST RETURN IF ELSE WHILE FOR BREAK CONTINUE
+%token PARALLEL SWITCH CASE DEFAULT
+%token ATTRIBUTE
 
 /* multi-char operators (with precedence, low → high) */
 %left OR
 %left AND
+%left '|'
+%left '^'
+%left '&'
 %left EQ NE
 %left '<' '>' LE GE
+%left SHL SHR
 %left '+' '-'
 %left '*' '/' '%'
 
 /* valued tokens */
-%token <std::string> IDENT
+%token <Ident>       IDENT
 %token <int>         INT_CONST
 %token <std::string> STR_CONST
+%token <std::string> PRAGMA
 
 /* end-of-input */
 %token END 0
@@ -66,13 +129,13 @@
 /* --- top-level & functions --- */
 %type <std::unique_ptr<FuncDefAST>>    FuncDef
 %type <std::unique_ptr<FuncFParamAST>> FuncFParam
-%type <std::vector<std::unique_ptr<FuncFParamAST>>> FuncFParams
-%type <std::vector<std::unique_ptr<ExprAST>>>       FuncRParams
+%type <ASTVector<std::unique_ptr<FuncFParamAST>>> FuncFParams
+%type <ASTVector<std::unique_ptr<ExprAST>>>       FuncRParams
 
 /* --- blocks & statements --- */
 %type <std::unique_ptr<BlockAST>>     Block
 %type <std::unique_ptr<BlockItemAST>> BlockItem
-%type <std::vector<std::unique_ptr<BlockItemAST>>> BlockItems
+%type <ASTVector<std::unique_ptr<BlockItemAST>>> BlockItems
 %type <std::unique_ptr<StmtAST>>      Stmt MatchedStmt UnmatchedStmt
 
 /* --- declarations --- */
@@ -81,35 +144,34 @@
 %type <std::unique_ptr<VarDeclAST>>   VarDecl
 %type <std::unique_ptr<ConstDefAST>>  ConstDef
 %type <std::unique_ptr<VarDefAST>>    VarDef
-%type <std::vector<std::unique_ptr<ConstDefAST>>> ConstDefs
-%type <std::vector<std::unique_ptr<VarDefAST>>>   VarDefs
+%type <ASTVector<std::unique_ptr<ConstDefAST>>> ConstDefs
+%type <ASTVector<std::unique_ptr<VarDefAST>>>   VarDefs
 
 /* --- initializers --- */
 %type <std::unique_ptr<ConstInitValAST>> ConstInitVal
 %type <std::unique_ptr<InitValAST>>      InitVal
-%type <std::vector<std::unique_ptr<ConstInitValAST>>> ConstInitVals
-%type <std::vector<std::unique_ptr<InitValAST>>>      InitVals
+%type <ASTVector<std::unique_ptr<ConstInitValAST>>> ConstInitVals
+%type <ASTVector<std::unique_ptr<InitValAST>>>      InitVals
 
 /* --- expressions --- */
-%type <std::unique_ptr<ExprAST>>        Expr
+%type <std::unique_ptr<ExprAST>>        Expr BinaryExpr UnaryExpr PrimaryExpr
 %type <std::unique_ptr<ConstExprAST>>   ConstExpr
-%type <std::unique_ptr<PrimaryExprAST>> PrimaryExpr
-%type <std::unique_ptr<UnaryExprAST>>   UnaryExpr
-%type <std::unique_ptr<BinaryExprAST>>  BinaryExpr
-%type <std::unique_ptr<LAndExprAST>>    LAndExpr
-%type <std::unique_ptr<LOrExprAST>>     LOrExpr
-%type <std::unique_ptr<NumberAST>>      Number
 %type <std::unique_ptr<LValAST>>        LVal
 %type <std::unique_ptr<BaseType>>       BasicType
 
 /* --- indexing & dimensions --- */
-%type <std::vector<std::unique_ptr<ConstExprAST>>> ArrayDims
-%type <std::vector<std::unique_ptr<ExprAST>>>      Indies
+%type <ASTVector<std::unique_ptr<ConstExprAST>>> ArrayDims
+%type <ASTVector<std::unique_ptr<ExprAST>>>      Indies
 
 /* --- for-statement helpers --- */
 %type <std::unique_ptr<ExprAST>>      OptExpr
 %type <std::unique_ptr<BlockItemAST>> ForInitClause
-%type <std::unique_ptr<StmtAST>>      ForStepClause
+%type <std::unique_ptr<StmtAST>>      ForStepClause ForHead ForControl
+%type <ASTVector<SymbolId>>           ReductionClause Idents
+
+/* --- switch --- */
+%type <std::unique_ptr<CaseAST>>      SwitchCase
+%type <ASTVector<std::unique_ptr<CaseAST>>> SwitchCases
 
 
 /* ===================================================================
@@ -123,6 +185,7 @@ CompUnit
     : %empty
     | CompUnit FuncDef          { ctx.ast.AddFuncDef(std::move($2)); }
     | CompUnit Decl             { ctx.ast.AddDecl(std::move($2)); }
+    | CompUnit PRAGMA           { Warn(ctx, @2, "ignoring pragma outside a function"); }
     ;
 
 /* ---------- function definition ---------- */
@@ -130,9 +193,15 @@ CompUnit
 FuncDef
     : BasicType IDENT '(' FuncFParams ')' Block {
         $$ = std::make_unique<FuncDefAST>(std::move($1), $2, std::move($4), std::move($6));
+        $$->loc = At(@2);
       }
     | BasicType IDENT '(' ')' Block {
         $$ = std::make_unique<FuncDefAST>(std::move($1), $2, std::move($5));
+        $$->loc = At(@2);
+      }
+    | ATTRIBUTE '(' '(' Idents ')' ')' FuncDef {
+        $7->attributes.insert($7->attributes.begin(), $4.begin(), $4.end());
+        $$ = std::move($7);
       }
     ;
 
@@ -144,7 +213,7 @@ BasicType
 
 FuncFParams
     : FuncFParam {
-        $$ = std::vector<std::unique_ptr<FuncFParamAST>>();
+        $$ = ASTVector<std::unique_ptr<FuncFParamAST>>();
         $$.emplace_back(std::move($1));
       }
     | FuncFParams ',' FuncFParam {
@@ -171,11 +240,15 @@ Block
     : '{' BlockItems '}' {
         $$ = std::make_unique<BlockAST>(std::move($2));
       }
+    | '{' BlockItems PRAGMA '}' {
+        Warn(ctx, @3, "ignoring pragma at the end of a block");
+        $$ = std::make_unique<BlockAST>(std::move($2));
+      }
     ;
 
 BlockItems
     : %empty {
-        $$ = std::vector<std::unique_ptr<BlockItemAST>>();
+        $$ = ASTVector<std::unique_ptr<BlockItemAST>>();
       }
     | BlockItems BlockItem {
         $1.emplace_back(std::move($2));
@@ -184,8 +257,12 @@ BlockItems
     ;
 
 BlockItem
-    : Decl { $$ = std::make_unique<BlockItemAST>(std::move($1)); }
+    : Decl { $$ = std::make_unique<BlockItemAST>(std::move($1)); $$->loc = At(@$); }
     | Stmt { $$ = std::make_unique<BlockItemAST>(std::move($1)); }
+    | PRAGMA Decl {
+        Warn(ctx, @1, "ignoring pragma before a declaration");
+        $$ = std::make_unique<BlockItemAST>(std::move($2)); $$->loc = At(@2);
+      }
     ;
 
 /* ---------- statements (dangling-else resolution) ---------- */
@@ -198,69 +275,159 @@ Stmt
 MatchedStmt
     : LVal '=' Expr ';' {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Assign, std::move($1), std::move($3));
+        $$->loc = At(@$);
       }
     | OptExpr ';' {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Expr, std::move($1));
+        $$->loc = At(@$);
       }
     | Block {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Block, std::move($1));
+        $$->loc = At(@$);
       }
     | IF '(' Expr ')' MatchedStmt ELSE MatchedStmt {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::If, std::move($3), std::move($5), std::move($7));
+        $$->loc = At(@$);
       }
     | RETURN ';' {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Ret);
+        $$->loc = At(@$);
       }
     | RETURN Expr ';' {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Ret, std::move($2));
+        $$->loc = At(@$);
       }
     | WHILE '(' Expr ')' MatchedStmt {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::While, std::move($3), std::move($5));
+        $$->loc = At(@$);
       }
-    | FOR '(' ForInitClause OptExpr ';' ForStepClause ')' MatchedStmt {
-        auto s = std::make_unique<StmtAST>(StmtAST::TYPE::For);
-        if ($3) {
-            if ($3->decl)      s->forDecl     = std::move($3->decl);
-            else if ($3->stmt) s->forInitStmt = std::move($3->stmt);
-        }
-        s->cond        = std::move($4);
-        s->forStepStmt = std::move($6);
-        s->thenStmt    = std::move($8);
-        $$ = std::move(s);
+    | ForHead MatchedStmt {
+        $1->thenStmt = std::move($2);
+        $$ = std::move($1);
+      }
+    | SWITCH '(' Expr ')' '{' SwitchCases '}' {
+        $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Switch, std::move($3), std::move($6));
+        $$->loc = At(@$);
       }
     | BREAK ';' {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Break);
+        $$->loc = At(@$);
       }
     | CONTINUE ';' {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Continue);
+        $$->loc = At(@$);
+      }
+    | PRAGMA MatchedStmt {
+        if (auto* why = ApplyLoopHint(ctx, @1, $1, *$2)) {
+            error(@1, why);
+            YYERROR;
+        }
+        $$ = std::move($2);
       }
     ;
 
 UnmatchedStmt
     : IF '(' Expr ')' Stmt {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::If, std::move($3), std::move($5));
+        $$->loc = At(@$);
       }
     | IF '(' Expr ')' MatchedStmt ELSE UnmatchedStmt {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::If, std::move($3), std::move($5), std::move($7));
+        $$->loc = At(@$);
       }
-    | FOR '(' ForInitClause OptExpr ';' ForStepClause ')' UnmatchedStmt {
-        auto s = std::make_unique<StmtAST>(StmtAST::TYPE::For);
-        if ($3) {
-            if ($3->decl)      s->forDecl     = std::move($3->decl);
-            else if ($3->stmt) s->forInitStmt = std::move($3->stmt);
-        }
-        s->cond        = std::move($4);
-        s->forStepStmt = std::move($6);
-        s->thenStmt    = std::move($8);
-        $$ = std::move(s);
+    | ForHead UnmatchedStmt {
+        $1->thenStmt = std::move($2);
+        $$ = std::move($1);
       }
     | WHILE '(' Expr ')' UnmatchedStmt {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::While, std::move($3), std::move($5));
+        $$->loc = At(@$);
+      }
+    | PRAGMA UnmatchedStmt {
+        if (auto* why = ApplyLoopHint(ctx, @1, $1, *$2)) {
+            error(@1, why);
+            YYERROR;
+        }
+        $$ = std::move($2);
+      }
+    ;
+
+/* ---------- switch labels ---------- */
+
+SwitchCases
+    : %empty {
+        $$ = ASTVector<std::unique_ptr<CaseAST>>();
+      }
+    | SwitchCases SwitchCase {
+        $1.emplace_back(std::move($2));
+        $$ = std::move($1);
+      }
+    ;
+
+SwitchCase
+    : CASE ConstExpr ':' BlockItems {
+        $$ = std::make_unique<CaseAST>(std::move($2), std::move($4));
+      }
+    | DEFAULT ':' BlockItems {
+        $$ = std::make_unique<CaseAST>(std::move($3));
       }
     ;
 
 /* ---------- for-statement clauses ---------- */
 
+ForHead
+    : FOR ForControl {
+        $$ = std::move($2);
+        $$->loc = At(@$);
+      }
+    | PARALLEL FOR ForControl {
+        $3->parallel = true;
+        $$ = std::move($3);
+        $$->loc = At(@$);
+      }
+    | PARALLEL ReductionClause FOR ForControl {
+        $4->parallel   = true;
+        $4->reductions = std::move($2);
+        $$ = std::move($4);
+        $$->loc = At(@$);
+      }
+    ;
+
+ForControl
+    : '(' ForInitClause OptExpr ';' ForStepClause ')' {
+        auto s = std::make_unique<StmtAST>(StmtAST::TYPE::For);
+        if ($2) {
+            if ($2->decl)      s->forDecl     = std::move($2->decl);
+            else if ($2->stmt) s->forInitStmt = std::move($2->stmt);
+        }
+        s->cond        = std::move($3);
+        s->forStepStmt = std::move($5);
+        $$ = std::move(s);
+      }
+    ;
+
+/* `reduction` is only a keyword inside this clause */
+ReductionClause
+    : IDENT '(' '+' ':' Idents ')' {
+        if ($1.name != "reduction") {
+            error(@1, "expected 'reduction' after 'parallel'");
+            YYERROR;
+        }
+        $$ = std::move($5);
+      }
+    ;
+
+Idents
+    : IDENT {
+        $$ = ASTVector<SymbolId>();
+        $$.push_back($1.id);
+      }
+    | Idents ',' IDENT {
+        $1.push_back($3.id);
+        $$ = std::move($1);
+      }
+    ;
+
 OptExpr
     : Expr   { $$ = std::move($1); }
     | %empty { $$ = nullptr; }
@@ -277,10 +444,12 @@ ForInitClause
       }
     | LVal '=' Expr ';' {
         auto stmt = std::make_unique<StmtAST>(StmtAST::TYPE::Assign, std::move($1), std::move($3));
+        stmt->loc = At(@$);
         $$ = std::make_unique<BlockItemAST>(std::move(stmt));
       }
     | Expr ';' {
         auto stmt = std::make_unique<StmtAST>(StmtAST::TYPE::Expr, std::move($1));
+        stmt->loc = At(@$);
         $$ = std::make_unique<BlockItemAST>(std::move(stmt));
       }
     ;
@@ -291,122 +460,131 @@ ForStepClause
       }
     | LVal '=' Expr {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Assign, std::move($1), std::move($3));
+        $$->loc = At(@$);
       }
     | Expr {
         $$ = std::make_unique<StmtAST>(StmtAST::TYPE::Expr, std::move($1));
+        $$->loc = At(@$);
       }
     ;
 
 /* ---------- expressions (precedence low → high) ---------- */
 
-Expr
-    : LOrExpr {
-        $$ = std::make_unique<ExprAST>(std::move($1));
-      }
-    ;
+/* Every rule below builds an ExprAST directly; parentheses and unary '+'
+ * pass their operand through. Binary operators, including `&&` and `||`,
+ * are ranked by the precedence declarations above. */
 
-LOrExpr
-    : LAndExpr {
-        $$ = std::make_unique<LOrExprAST>(std::move($1));
-      }
-    | LOrExpr OR LAndExpr {
-        $$ = std::make_unique<LOrExprAST>(std::move($1), std::move($3));
-      }
-    ;
-
-LAndExpr
+Expr
     : BinaryExpr {
-        $$ = std::make_unique<LAndExprAST>(std::move($1));
+        $$ = std::move($1);
       }
-    | LAndExpr AND BinaryExpr {
-        $$ = std::make_unique<LAndExprAST>(std::move($1), std::move($3));
+    | BinaryExpr '?' Expr ':' Expr {
+        $$ = std::make_unique<ExprAST>(std::move($1), std::move($3), std::move($5));
       }
     ;
 
 BinaryExpr
     : UnaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(std::move($1));
+        $$ = std::move($1);
       }
-    | BinaryExpr '+' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::ADD, std::move($1), std::move($3));
+    | BinaryExpr OR BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::LOr, std::move($1), std::move($3));
       }
-    | BinaryExpr '-' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::SUB, std::move($1), std::move($3));
+    | BinaryExpr AND BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::LAnd, std::move($1), std::move($3));
       }
-    | BinaryExpr '*' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::MUL, std::move($1), std::move($3));
+    | BinaryExpr '|' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::BitOr, std::move($1), std::move($3));
       }
-    | BinaryExpr '/' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::DIV, std::move($1), std::move($3));
+    | BinaryExpr '^' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Xor, std::move($1), std::move($3));
       }
-    | BinaryExpr '%' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::MOD, std::move($1), std::move($3));
+    | BinaryExpr '&' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::BitAnd, std::move($1), std::move($3));
+      }
+    | BinaryExpr EQ BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Eq, std::move($1), std::move($3));
+      }
+    | BinaryExpr NE BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Ne, std::move($1), std::move($3));
       }
     | BinaryExpr '<' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::LT, std::move($1), std::move($3));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Lt, std::move($1), std::move($3));
       }
     | BinaryExpr '>' BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::GT, std::move($1), std::move($3));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Gt, std::move($1), std::move($3));
       }
     | BinaryExpr LE BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::LE, std::move($1), std::move($3));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Le, std::move($1), std::move($3));
       }
     | BinaryExpr GE BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::GE, std::move($1), std::move($3));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Ge, std::move($1), std::move($3));
       }
-    | BinaryExpr EQ BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::EQ, std::move($1), std::move($3));
+    | BinaryExpr SHL BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Shl, std::move($1), std::move($3));
       }
-    | BinaryExpr NE BinaryExpr {
-        $$ = std::make_unique<BinaryExprAST>(BinaryExprAST::Op::NE, std::move($1), std::move($3));
+    | BinaryExpr SHR BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Shr, std::move($1), std::move($3));
+      }
+    | BinaryExpr '+' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Add, std::move($1), std::move($3));
+      }
+    | BinaryExpr '-' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Sub, std::move($1), std::move($3));
+      }
+    | BinaryExpr '*' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Mul, std::move($1), std::move($3));
+      }
+    | BinaryExpr '/' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Div, std::move($1), std::move($3));
+      }
+    | BinaryExpr '%' BinaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Mod, std::move($1), std::move($3));
       }
     ;
 
 UnaryExpr
     : PrimaryExpr {
-        $$ = std::make_unique<UnaryExprAST>(UnaryExprAST::TYPE::Primary, std::move($1));
+        $$ = std::move($1);
       }
     | '+' UnaryExpr {
-        $$ = std::make_unique<UnaryExprAST>(UnaryExprAST::TYPE::Unary, UnaryExprAST::OP::PLUS, std::move($2));
+        $$ = std::move($2);
       }
     | '-' UnaryExpr {
-        $$ = std::make_unique<UnaryExprAST>(UnaryExprAST::TYPE::Unary, UnaryExprAST::OP::MINUS, std::move($2));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Neg, std::move($2));
       }
     | '!' UnaryExpr {
-        $$ = std::make_unique<UnaryExprAST>(UnaryExprAST::TYPE::Unary, UnaryExprAST::OP::NOT, std::move($2));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::Not, std::move($2));
+      }
+    | '~' UnaryExpr {
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::BitNot, std::move($2));
       }
     | IDENT '(' ')' {
-        $$ = std::make_unique<UnaryExprAST>(UnaryExprAST::TYPE::Call, $1);
+        $$ = std::make_unique<ExprAST>($1, ASTVector<std::unique_ptr<ExprAST>>());
       }
     | IDENT '(' FuncRParams ')' {
-        $$ = std::make_unique<UnaryExprAST>(UnaryExprAST::TYPE::Call, $1, std::move($3));
+        $$ = std::make_unique<ExprAST>($1, std::move($3));
       }
     ;
 
 PrimaryExpr
     : '(' Expr ')' {
-        $$ = std::make_unique<PrimaryExprAST>(PrimaryExprAST::TYPE::Expr, std::move($2));
+        $$ = std::move($2);
       }
     | LVal {
-        $$ = std::make_unique<PrimaryExprAST>(PrimaryExprAST::TYPE::LVal, std::move($1));
+        $$ = std::make_unique<ExprAST>(std::move($1));
       }
-    | Number {
-        $$ = std::make_unique<PrimaryExprAST>(PrimaryExprAST::TYPE::Number, std::move($1));
+    | INT_CONST {
+        $$ = std::make_unique<ExprAST>($1);
       }
     | STR_CONST {
-        $$ = std::make_unique<PrimaryExprAST>($1);
-      }
-    ;
-
-Number
-    : INT_CONST {
-        $$ = std::make_unique<NumberAST>(std::move($1));
+        $$ = std::make_unique<ExprAST>(ExprAST::Kind::String, ctx.Names().Intern($1));
       }
     ;
 
 FuncRParams
     : Expr {
-        $$ = std::vector<std::unique_ptr<ExprAST>>();
+        $$ = ASTVector<std::unique_ptr<ExprAST>>();
         $$.emplace_back(std::move($1));
       }
     | FuncRParams ',' Expr {
@@ -436,7 +614,7 @@ VarDecl
 
 ConstDefs
     : ConstDef {
-        $$ = std::vector<std::unique_ptr<ConstDefAST>>();
+        $$ = ASTVector<std::unique_ptr<ConstDefAST>>();
         $$.emplace_back(std::move($1));
       }
     | ConstDefs ',' ConstDef {
@@ -447,7 +625,7 @@ ConstDefs
 
 VarDefs
     : VarDef {
-        $$ = std::vector<std::unique_ptr<VarDefAST>>();
+        $$ = ASTVector<std::unique_ptr<VarDefAST>>();
         $$.emplace_back(std::move($1));
       }
     | VarDefs ',' VarDef {
@@ -496,7 +674,7 @@ ConstInitVal
 
 ConstInitVals
     : ConstInitVal {
-        $$ = std::vector<std::unique_ptr<ConstInitValAST>>();
+        $$ = ASTVector<std::unique_ptr<ConstInitValAST>>();
         $$.emplace_back(std::move($1));
       }
     | ConstInitVals ',' ConstInitVal {
@@ -519,7 +697,7 @@ InitVal
 
 InitVals
     : InitVal {
-        $$ = std::vector<std::unique_ptr<InitValAST>>();
+        $$ = ASTVector<std::unique_ptr<InitValAST>>();
         $$.emplace_back(std::move($1));
       }
     | InitVals ',' InitVal {
@@ -541,7 +719,7 @@ LVal
 
 ArrayDims
     : '[' ConstExpr ']' {
-        $$ = std::vector<std::unique_ptr<ConstExprAST>>();
+        $$ = ASTVector<std::unique_ptr<ConstExprAST>>();
         $$.emplace_back(std::move($2));
       }
     | ArrayDims '[' ConstExpr ']' {
@@ -552,7 +730,7 @@ ArrayDims
 
 Indies
     : '[' Expr ']' {
-        $$ = std::vector<std::unique_ptr<ExprAST>>();
+        $$ = ASTVector<std::unique_ptr<ExprAST>>();
         $$.emplace_back(std::move($2));
       }
     | Indies '[' Expr ']' {
@@ -575,5 +753,7 @@ ConstExpr
 
 void yy::Parser::error(const yy::location& l, const std::string& m)
 {
-    std::cerr << l << ": " << m << std::endl;
+    std::ostringstream where;
+    where << l;
+    fprintf(ctx.Diagnostics(), "%s: %s\n", where.str().c_str(), m.c_str());
 }
\ No newline at end of file
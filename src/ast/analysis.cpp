@@ -0,0 +1,213 @@
+#include "ast/analysis.h"
+#include "ast/walk.h"
+#include "util/scc.h"
+
+#include <algorithm>
+
+namespace {
+
+class CallCollector : public ASTWalker {
+public:
+    explicit CallCollector(std::set<SymbolId>& calls) : calls(calls) {}
+    void OnCall(ExprAST* call) override { calls.insert(call->id); }
+
+private:
+    std::set<SymbolId>& calls;
+};
+
+class NameFinder : public ASTWalker {
+public:
+    explicit NameFinder(SymbolId name) : name(name) {}
+    void OnRead(LValAST* lval) override { found = found || lval->id == name; }
+
+    bool found = false;
+
+private:
+    SymbolId name;
+};
+
+// Whether `expr` is `bound` spelled the same way: the same literal, or the
+// same unindexed name, which the caller has checked still binds the same.
+bool SameBound(ExprAST* expr, ExprAST* bound) {
+    if (expr->kind != bound->kind) return false;
+    if (expr->kind == ExprAST::Kind::Number) return expr->value == bound->value;
+    auto* l = AsLVal(expr);
+    auto* r = AsLVal(bound);
+    return l && r && l->id == r->id && l->indies.empty() && r->indies.empty();
+}
+
+// The induction variable of `for (i = 0; i < bound; i = i + 1)`, where the
+// header may also declare `int i = 0`; kNoSymbol for any other loop.
+SymbolId CountingLoop(StmtAST* loop, ExprAST* bound) {
+    using Kind = ExprAST::Kind;
+    if (!loop || loop->type != StmtAST::TYPE::For) return kNoSymbol;
+
+    SymbolId var = kNoSymbol;
+    ExprAST* lo = nullptr;
+    if (loop->forDecl && loop->forDecl->varDecl && loop->forDecl->varDecl->varDefs.size() == 1) {
+        auto* def = loop->forDecl->varDecl->varDefs[0].get();
+        if (def->sizeExprs.empty() && def->initVal && !def->initVal->isArray) {
+            var = def->id;
+            lo = def->initVal->expr.get();
+        }
+    } else if (loop->forInitStmt && loop->forInitStmt->type == StmtAST::TYPE::Assign
+               && loop->forInitStmt->lval->indies.empty()) {
+        var = loop->forInitStmt->lval->id;
+        lo = loop->forInitStmt->expr.get();
+    }
+    if (!lo || lo->kind != Kind::Number || lo->value != 0) return kNoSymbol;
+
+    auto* cmp = loop->cond.get();
+    auto* i = cmp && cmp->kind == Kind::Lt ? AsLVal(cmp->lhs.get()) : nullptr;
+    if (!i || i->id != var || !i->indies.empty() || !SameBound(cmp->rhs.get(), bound)) return kNoSymbol;
+    if (auto* name = AsLVal(bound); name && name->id == var) return kNoSymbol;
+
+    auto* step = loop->forStepStmt.get();
+    auto* add = step && step->type == StmtAST::TYPE::Assign && step->lval->id == var
+                && step->lval->indies.empty() ? step->expr.get() : nullptr;
+    auto* self = add && add->kind == Kind::Add ? AsLVal(add->lhs.get()) : nullptr;
+    if (!self || self->id != var || !self->indies.empty()) return kNoSymbol;
+    if (add->rhs->kind != Kind::Number || add->rhs->value != 1) return kNoSymbol;
+    return var;
+}
+
+// Whether `stmt` is a nest of counting loops, one per dimension of `def`
+// and bounded by it, around a single `def[i][j]... = expr` that indexes with
+// the loop variables in order and does not read `def`.
+bool FillsArray(StmtAST* stmt, VarDefAST* def) {
+    std::vector<SymbolId> vars;
+    for (auto& size : def->sizeExprs) {
+        SymbolId var = CountingLoop(stmt, size->expr.get());
+        if (var == kNoSymbol || var == def->id || std::count(vars.begin(), vars.end(), var)) return false;
+        vars.push_back(var);
+        stmt = stmt->thenStmt.get();
+        if (stmt->type == StmtAST::TYPE::Block) {
+            auto& items = stmt->block->items;
+            if (items.size() != 1 || !items[0]->stmt) return false;
+            stmt = items[0]->stmt.get();
+        }
+    }
+
+    if (stmt->type != StmtAST::TYPE::Assign || stmt->lval->id != def->id) return false;
+    auto& indies = stmt->lval->indies;
+    if (indies.size() != vars.size()) return false;
+    for (size_t k = 0; k < vars.size(); ++k) {
+        auto* index = AsLVal(indies[k].get());
+        if (!index || index->id != vars[k] || !index->indies.empty()) return false;
+    }
+    NameFinder reads(def->id);
+    reads.Walk(stmt->expr.get());
+    return !reads.found;
+}
+
+// Sets `filled` on each uninitialized array declared in `items` whose next
+// item fills it.
+void MarkFilled(ASTVector<unique_ptr<BlockItemAST>>& items) {
+    for (size_t i = 0; i + 1 < items.size(); ++i) {
+        auto* decl = items[i]->decl ? items[i]->decl->varDecl.get() : nullptr;
+        auto* next = items[i + 1]->stmt.get();
+        if (!decl || !next) continue;
+        for (auto& def : decl->varDefs) {
+            if (def->sizeExprs.empty() || def->initVal) continue;
+            // A bound named by the same declaration is not the array's.
+            bool rebound = false;
+            for (auto& size : def->sizeExprs)
+                if (auto* name = AsLVal(size->expr.get()))
+                    for (auto& other : decl->varDefs) rebound |= other->id == name->id;
+            def->filled = !rebound && FillsArray(next, def.get());
+        }
+    }
+}
+
+class FilledArrays : public ASTWalker {
+public:
+    void OnStmt(StmtAST* stmt) override {
+        if (stmt->type == StmtAST::TYPE::Block) MarkFilled(stmt->block->items);
+        for (auto& label : stmt->cases) MarkFilled(label->items);
+    }
+};
+
+class ParallelCalls : public ASTWalker {
+public:
+    explicit ParallelCalls(std::set<SymbolId>& calls) : calls(calls) {}
+    void OnStmt(StmtAST* stmt) override {
+        if (stmt->type == StmtAST::TYPE::For && stmt->parallel)
+            CallCollector(calls).Walk(stmt->thenStmt.get());
+    }
+
+private:
+    std::set<SymbolId>& calls;
+};
+
+} // anonymous namespace
+
+CallGraph::CallGraph(const CompUnitAST& unit) {
+    for (auto& funcDef : unit.funcDefs) callees[funcDef->id];
+    for (auto& funcDef : unit.funcDefs) {
+        std::set<SymbolId> calls;
+        CallCollector(calls).Walk(funcDef.get());
+        auto& edges = callees[funcDef->id];
+        for (auto& callee : calls)
+            if (callees.count(callee)) edges.insert(callee);
+    }
+
+    recursive = CyclicNodes(callees);
+}
+
+const std::set<SymbolId>& CallGraph::Callees(SymbolId func) const {
+    static const std::set<SymbolId> none;
+    auto found = callees.find(func);
+    return found != callees.end() ? found->second : none;
+}
+
+bool CallGraph::IsRecursive(SymbolId func) const { return recursive.count(func) != 0; }
+
+std::set<SymbolId> CallGraph::Reachable(std::set<SymbolId> roots) const {
+    vector<SymbolId> pending(roots.begin(), roots.end());
+    while (!pending.empty()) {
+        auto func = pending.back();
+        pending.pop_back();
+        for (auto& callee : Callees(func))
+            if (roots.insert(callee).second) pending.push_back(callee);
+    }
+    return roots;
+}
+
+void MarkFilledArrays(FuncDefAST* func) {
+    MarkFilled(func->block->items);
+    FilledArrays().Walk(func);
+}
+
+void MarkConcurrent(CompUnitAST& unit, const CallGraph& graph) {
+    std::set<SymbolId> calls;
+    for (auto& funcDef : unit.funcDefs) ParallelCalls(calls).Walk(funcDef.get());
+
+    auto reached = graph.Reachable(std::move(calls));
+    for (auto& funcDef : unit.funcDefs)
+        funcDef->concurrent = reached.count(funcDef->id) != 0;
+}
+
+size_t MarkUnreachable(CompUnitAST& unit, const CallGraph& graph, const Interner& names) {
+    SymbolId main = names.Find("main"), used = names.Find("used");
+    std::set<SymbolId> roots;
+    bool hasMain = false;
+    for (auto& funcDef : unit.funcDefs) {
+        auto& attrs = funcDef->attributes;
+        hasMain |= funcDef->id == main;
+        if (funcDef->id == main || std::find(attrs.begin(), attrs.end(), used) != attrs.end())
+            roots.insert(funcDef->id);
+    }
+    if (!hasMain) return 0;
+
+    auto reached = graph.Reachable(std::move(roots));
+    size_t dropped = 0;
+    for (auto& funcDef : unit.funcDefs) {
+        funcDef->reachable = reached.count(funcDef->id) != 0;
+        dropped += !funcDef->reachable;
+    }
+    return dropped;
+}
+
+LValAST* AsLVal(ExprAST* expr) {
+    return expr->kind == ExprAST::Kind::LVal ? expr->lval.get() : nullptr;
+}
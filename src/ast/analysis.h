@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "ast/ast.h"
+
+// Static call graph over the user functions of a translation unit. Calls to
+// names that are not defined in the unit (builtins) are left out.
+class CallGraph {
+public:
+    explicit CallGraph(const CompUnitAST& unit);
+
+    const std::set<SymbolId>& Callees(SymbolId func) const;
+    // True when `func` can reach itself, directly or through other calls.
+    bool IsRecursive(SymbolId func) const;
+    // `roots` and every function they can reach.
+    std::set<SymbolId> Reachable(std::set<SymbolId> roots) const;
+
+private:
+    std::map<SymbolId, std::set<SymbolId>> callees;
+    std::set<SymbolId> recursive;
+};
+
+// For each local array without an initializer, record whether the statement
+// right after its declaration writes every element (`VarDefAST::filled`):
+// a nest of `for (i = 0; i < N; i = i + 1)` loops over its dimensions around
+// one assignment to `a[i][j]...` that does not read the array. Only such an
+// array can skip being zeroed when it is moved into static storage.
+void MarkFilledArrays(FuncDefAST* func);
+
+// Mark every function that a parallel loop body can reach, directly or
+// through other calls, as `FuncDefAST::concurrent`.
+void MarkConcurrent(CompUnitAST& unit, const CallGraph& graph);
+
+// Clear `FuncDefAST::reachable` on every function that neither `main` nor
+// an `__attribute__((used))` function can reach, and return how many there
+// were. A unit without `main` is a library: all of it stays reachable.
+// `names` is the table the unit's names were interned into.
+size_t MarkUnreachable(CompUnitAST& unit, const CallGraph& graph, const Interner& names);
+
+// The l-value when `expr` is just a (possibly indexed) variable, or nullptr.
+LValAST* AsLVal(ExprAST* expr);
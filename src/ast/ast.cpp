@@ -1,27 +1,39 @@
 #include "ast/ast.h"
+#include "ast/analysis.h"
+#include "ast/eval.h"
+#include "ast/init.h"
+#include "ast/parallel.h"
 #include "ir/codegen.h"
+#include "util/timing.h"
 
 #include <cassert>
+#include <cstdint>
+#include <set>
 
 // ========== Constructors ==========
 
-ConstDefAST::ConstDefAST(string ident, unique_ptr<ConstInitValAST>&& initVal)
-    : ident(std::move(ident)), initVal(std::move(initVal)) {}
+ConstDefAST::ConstDefAST(Ident name, unique_ptr<ConstInitValAST>&& initVal)
+    : id(name.id), initVal(std::move(initVal)) {}
 
-ConstDefAST::ConstDefAST(string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<ConstInitValAST>&& initVal)
-    : ident(std::move(ident)), sizeExprs(std::move(sizeExprs)), initVal(std::move(initVal)) {}
+ConstDefAST::ConstDefAST(Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<ConstInitValAST>&& initVal)
+    : id(name.id), sizeExprs(std::move(sizeExprs)), initVal(std::move(initVal)) {}
 
-VarDefAST::VarDefAST(string ident)
-    : ident(std::move(ident)) {}
+VarDefAST::VarDefAST(Ident name)
+    : id(name.id) {}
 
-VarDefAST::VarDefAST(string ident, unique_ptr<InitValAST>&& initVal)
-    : ident(std::move(ident)), initVal(std::move(initVal)) {}
+VarDefAST::VarDefAST(Ident name, unique_ptr<InitValAST>&& initVal)
+    : id(name.id), initVal(std::move(initVal)) {}
 
-VarDefAST::VarDefAST(string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs)
-    : ident(std::move(ident)), sizeExprs(std::move(sizeExprs)) {}
+VarDefAST::VarDefAST(Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs)
+    : id(name.id), sizeExprs(std::move(sizeExprs)) {}
 
-VarDefAST::VarDefAST(string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<InitValAST>&& initVal)
-    : ident(std::move(ident)), sizeExprs(std::move(sizeExprs)), initVal(std::move(initVal)) {}
+VarDefAST::VarDefAST(Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<InitValAST>&& initVal)
+    : id(name.id), sizeExprs(std::move(sizeExprs)), initVal(std::move(initVal)) {}
+
+CompUnitAST::~CompUnitAST() {
+    for (auto& funcDef : funcDefs) funcDef.release();
+    for (auto& decl : decls) decl.release();
+}
 
 void CompUnitAST::AddFuncDef(unique_ptr<FuncDefAST>&& funcDef) {
     funcDefs.emplace_back(std::move(funcDef));
@@ -31,13 +43,13 @@ void CompUnitAST::AddDecl(unique_ptr<DeclAST>&& decl) {
     decls.emplace_back(std::move(decl));
 }
 
-FuncDefAST::FuncDefAST(unique_ptr<BaseType>&& funcType, string ident, unique_ptr<BlockAST>&& block)
-    : funcType(std::move(funcType)), ident(std::move(ident)), block(std::move(block)) {}
+FuncDefAST::FuncDefAST(unique_ptr<BaseType>&& funcType, Ident name, unique_ptr<BlockAST>&& block)
+    : funcType(std::move(funcType)), id(name.id), block(std::move(block)) {}
 
-FuncDefAST::FuncDefAST(unique_ptr<BaseType>&& funcType, string ident, vector<unique_ptr<FuncFParamAST>>&& params, unique_ptr<BlockAST>&& block)
-    : funcType(std::move(funcType)), ident(std::move(ident)), params(std::move(params)), block(std::move(block)) {}
+FuncDefAST::FuncDefAST(unique_ptr<BaseType>&& funcType, Ident name, ASTVector<unique_ptr<FuncFParamAST>>&& params, unique_ptr<BlockAST>&& block)
+    : funcType(std::move(funcType)), id(name.id), params(std::move(params)), block(std::move(block)) {}
 
-BlockAST::BlockAST(vector<unique_ptr<BlockItemAST>>&& items)
+BlockAST::BlockAST(ASTVector<unique_ptr<BlockItemAST>>&& items)
     : items(std::move(items)) {}
 
 StmtAST::StmtAST(TYPE type) : type(type) {}
@@ -49,68 +61,94 @@ StmtAST::StmtAST(TYPE type, unique_ptr<ExprAST>&& cond, unique_ptr<StmtAST>&& th
     : type(type), cond(std::move(cond)), thenStmt(std::move(thenStmt)) {}
 StmtAST::StmtAST(TYPE type, unique_ptr<ExprAST>&& cond, unique_ptr<StmtAST>&& thenStmt, unique_ptr<StmtAST>&& elseStmt)
     : type(type), cond(std::move(cond)), thenStmt(std::move(thenStmt)), elseStmt(std::move(elseStmt)) {}
-
-ExprAST::ExprAST(unique_ptr<LOrExprAST>&& lorExpr) : lorExpr(std::move(lorExpr)) {}
-
-PrimaryExprAST::PrimaryExprAST(TYPE type, unique_ptr<ExprAST>&& expr) : type(type), expr(std::move(expr)) {}
-PrimaryExprAST::PrimaryExprAST(TYPE type, unique_ptr<LValAST>&& lval) : type(type), lval(std::move(lval)) {}
-PrimaryExprAST::PrimaryExprAST(TYPE type, unique_ptr<NumberAST>&& value) : type(type), value(std::move(value)) {}
-PrimaryExprAST::PrimaryExprAST(string strVal) : type(TYPE::String), strVal(std::move(strVal)) {}
-
-NumberAST::NumberAST(int value) : value(value) {}
-
-UnaryExprAST::UnaryExprAST(TYPE type, unique_ptr<PrimaryExprAST>&& primaryExpr)
-    : type(type), primaryExpr(std::move(primaryExpr)) {}
-UnaryExprAST::UnaryExprAST(TYPE type, OP op, unique_ptr<UnaryExprAST>&& unaryExpr)
-    : type(type), op(op), unaryExpr(std::move(unaryExpr)) {}
-UnaryExprAST::UnaryExprAST(TYPE type, string ident) : type(type), ident(std::move(ident)) {}
-UnaryExprAST::UnaryExprAST(TYPE type, string ident, vector<unique_ptr<ExprAST>>&& callArgs)
-    : type(type), ident(std::move(ident)), callArgs(std::move(callArgs)) {}
-
-BinaryExprAST::BinaryExprAST(unique_ptr<UnaryExprAST>&& operand)
-    : operand(std::move(operand)) {}
-BinaryExprAST::BinaryExprAST(Op op, unique_ptr<BinaryExprAST>&& lhs, unique_ptr<BinaryExprAST>&& rhs)
-    : op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
-
-LAndExprAST::LAndExprAST(unique_ptr<BinaryExprAST>&& operand) : operand(std::move(operand)) {}
-LAndExprAST::LAndExprAST(unique_ptr<LAndExprAST>&& left, unique_ptr<BinaryExprAST>&& right)
-    : left(std::move(left)), right(std::move(right)) {}
-
-LOrExprAST::LOrExprAST(unique_ptr<LAndExprAST>&& operand) : operand(std::move(operand)) {}
-LOrExprAST::LOrExprAST(unique_ptr<LOrExprAST>&& left, unique_ptr<LAndExprAST>&& right)
-    : left(std::move(left)), right(std::move(right)) {}
+StmtAST::StmtAST(TYPE type, unique_ptr<ExprAST>&& expr, ASTVector<unique_ptr<CaseAST>>&& cases)
+    : type(type), expr(std::move(expr)), cases(std::move(cases)) {}
+
+// Free an `else if` ladder arm by arm rather than recursively.
+StmtAST::~StmtAST() {
+    auto next = std::move(elseStmt);
+    while (next) {
+        auto after = std::move(next->elseStmt);
+        next = std::move(after);
+    }
+}
+
+CaseAST::CaseAST(ASTVector<unique_ptr<BlockItemAST>>&& items) : items(std::move(items)) {}
+CaseAST::CaseAST(unique_ptr<ConstExprAST>&& value, ASTVector<unique_ptr<BlockItemAST>>&& items)
+    : value(std::move(value)), items(std::move(items)) {}
+
+// Deep chains are common in generated code, so `speculatable` is worked out
+// here from the operands' flags instead of by walking the tree.
+ExprAST::ExprAST(int value) : kind(Kind::Number), value(value) {}
+ExprAST::ExprAST(unique_ptr<LValAST>&& lval) : kind(Kind::LVal), lval(std::move(lval)) {
+    // An indexed l-value may be out of bounds when its guard is false.
+    speculatable = this->lval->indies.empty();
+}
+ExprAST::ExprAST(Kind kind, SymbolId literal) : kind(kind), id(literal) {}
+ExprAST::ExprAST(Ident callee, ASTVector<unique_ptr<ExprAST>>&& args)
+    : kind(Kind::Call), id(callee.id), speculatable(false), args(std::move(args)) {}
+ExprAST::ExprAST(Kind kind, unique_ptr<ExprAST>&& operand) : kind(kind), lhs(std::move(operand)) {
+    speculatable = lhs->speculatable;
+}
+ExprAST::ExprAST(Kind kind, unique_ptr<ExprAST>&& lhs, unique_ptr<ExprAST>&& rhs)
+    : kind(kind), lhs(std::move(lhs)), rhs(std::move(rhs)) {
+    // `/` and `%` may divide by zero.
+    speculatable = kind != Kind::Div && kind != Kind::Mod && this->lhs->speculatable && this->rhs->speculatable;
+}
+ExprAST::ExprAST(unique_ptr<ExprAST>&& cond, unique_ptr<ExprAST>&& thenExpr, unique_ptr<ExprAST>&& elseExpr)
+    : kind(Kind::Cond), lhs(std::move(thenExpr)), rhs(std::move(elseExpr)), cond(std::move(cond)) {
+    speculatable = this->cond->speculatable && lhs->speculatable && rhs->speculatable;
+}
+
+// Operands are moved onto a worklist and freed one at a time, so dropping
+// a deep chain does not recurse once per level.
+ExprAST::~ExprAST() {
+    vector<unique_ptr<ExprAST>> pending;
+    auto detach = [&pending](ExprAST* expr) {
+        for (auto* operand : {&expr->lhs, &expr->rhs, &expr->cond})
+            if (*operand) pending.push_back(std::move(*operand));
+        for (auto& arg : expr->args) pending.push_back(std::move(arg));
+        expr->args.clear();
+    };
+    detach(this);
+    while (!pending.empty()) {
+        auto expr = std::move(pending.back());
+        pending.pop_back();
+        detach(expr.get());
+    }
+}
 
 DeclAST::DeclAST(unique_ptr<ConstDeclAST>&& constDecl) : constDecl(std::move(constDecl)) {}
 DeclAST::DeclAST(unique_ptr<VarDeclAST>&& varDecl) : varDecl(std::move(varDecl)) {}
 
-ConstDeclAST::ConstDeclAST(unique_ptr<BaseType>&& btype, vector<unique_ptr<ConstDefAST>>&& constDefs)
+ConstDeclAST::ConstDeclAST(unique_ptr<BaseType>&& btype, ASTVector<unique_ptr<ConstDefAST>>&& constDefs)
     : btype(std::move(btype)), constDefs(std::move(constDefs)) {}
 
-VarDeclAST::VarDeclAST(unique_ptr<BaseType>&& btype, vector<unique_ptr<VarDefAST>>&& varDefs)
+VarDeclAST::VarDeclAST(unique_ptr<BaseType>&& btype, ASTVector<unique_ptr<VarDefAST>>&& varDefs)
     : btype(std::move(btype)), varDefs(std::move(varDefs)) {}
 
 ConstInitValAST::ConstInitValAST() : isArray(true) {}
 ConstInitValAST::ConstInitValAST(unique_ptr<ConstExprAST>&& expr) : expr(std::move(expr)), isArray(false) {}
-ConstInitValAST::ConstInitValAST(vector<unique_ptr<ConstInitValAST>>&& subVals) : subVals(std::move(subVals)), isArray(true) {}
+ConstInitValAST::ConstInitValAST(ASTVector<unique_ptr<ConstInitValAST>>&& subVals) : subVals(std::move(subVals)), isArray(true) {}
 
 InitValAST::InitValAST() : isArray(true) {}
 InitValAST::InitValAST(unique_ptr<ExprAST>&& expr) : expr(std::move(expr)), isArray(false) {}
-InitValAST::InitValAST(vector<unique_ptr<InitValAST>>&& subVals) : subVals(std::move(subVals)), isArray(true) {}
+InitValAST::InitValAST(ASTVector<unique_ptr<InitValAST>>&& subVals) : subVals(std::move(subVals)), isArray(true) {}
 
 BlockItemAST::BlockItemAST(unique_ptr<DeclAST>&& decl) : decl(std::move(decl)) {}
 BlockItemAST::BlockItemAST(unique_ptr<StmtAST>&& stmt) : stmt(std::move(stmt)) {}
 
-LValAST::LValAST(string ident) : ident(std::move(ident)) {}
-LValAST::LValAST(string ident, vector<unique_ptr<ExprAST>>&& indies)
-    : ident(std::move(ident)), indies(std::move(indies)) {}
+LValAST::LValAST(Ident name) : id(name.id) {}
+LValAST::LValAST(Ident name, ASTVector<unique_ptr<ExprAST>>&& indies)
+    : id(name.id), indies(std::move(indies)) {}
 
 ConstExprAST::ConstExprAST(unique_ptr<ExprAST>&& expr) : expr(std::move(expr)) {}
 
-FuncFParamAST::FuncFParamAST(unique_ptr<BaseType>&& btype, string ident, bool isArray)
-    : btype(std::move(btype)), ident(std::move(ident)), isArray(isArray) {}
+FuncFParamAST::FuncFParamAST(unique_ptr<BaseType>&& btype, Ident name, bool isArray)
+    : btype(std::move(btype)), id(name.id), isArray(isArray) {}
 
-FuncFParamAST::FuncFParamAST(unique_ptr<BaseType>&& btype, string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs)
-    : btype(std::move(btype)), ident(std::move(ident)), sizeExprs(std::move(sizeExprs)), isArray(true) {}
+FuncFParamAST::FuncFParamAST(unique_ptr<BaseType>&& btype, Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs)
+    : btype(std::move(btype)), id(name.id), sizeExprs(std::move(sizeExprs)), isArray(true) {}
 
 FuncRParamAST::FuncRParamAST(unique_ptr<ExprAST>&& expr) : expr(std::move(expr)) {}
 
@@ -118,33 +156,6 @@ FuncRParamAST::FuncRParamAST(unique_ptr<ExprAST>&& expr) : expr(std::move(expr))
 
 namespace {
 
-template<typename T>
-void Flatten(CodeGen* cg, vector<llvm::Value*>& flatValues, const vector<int>& shape, int dim, T& initVal) {
-    if (!initVal->isArray) {
-        flatValues.push_back(initVal->expr->ToNumber(cg));
-        return;
-    }
-
-    int startIndex = flatValues.size();
-    int totalElements = 1;
-    for (int i = shape.size() - 2; i >= dim; i--) {
-        if (startIndex % (totalElements * shape[i]) == 0) {
-            totalElements *= shape[i];
-        }
-    }
-
-    for (auto& val : initVal->subVals) {
-        Flatten(cg, flatValues, shape, dim + 1, val);
-    }
-
-    int filledElements = flatValues.size() - startIndex;
-    if (filledElements < totalElements) {
-        for (int i = filledElements; i < totalElements; i++) {
-            flatValues.push_back(cg->GetInt32(0));
-        }
-    }
-}
-
 // Collect an array's dimension sizes from the (constant) size expressions.
 template<typename T>
 vector<int> ArrayDims(CodeGen* cg, T* def) {
@@ -154,13 +165,17 @@ vector<int> ArrayDims(CodeGen* cg, T* def) {
     return dims;
 }
 
-// Flatten an initializer into a row-major, zero-padded list of i32 scalars.
+// Flatten an initializer into a row-major, zero-padded list of i32 scalars:
+// folded constants, or with `fold` off (a local variable's initializer),
+// values computed at run time.
 template<typename T>
-vector<llvm::Value*> FlattenInit(CodeGen* cg, const vector<int>& dims, T& initVal) {
+vector<llvm::Value*> FlattenInit(CodeGen* cg, const vector<int>& dims, T& initVal, bool fold = true) {
     vector<int> shape = dims;
-    shape.push_back(0); // sentinel used by Flatten
+    shape.push_back(0); // sentinel used by FlattenInitList
     vector<llvm::Value*> flat;
-    Flatten(cg, flat, shape, 0, initVal);
+    FlattenInitList(flat, shape, 0, initVal,
+                    [cg, fold](auto& expr) { return fold ? expr->ToNumber(cg) : expr->ToValue(cg); },
+                    cg->GetInt32(0));
     return flat;
 }
 
@@ -174,6 +189,124 @@ void StoreFlatInit(CodeGen* cg, llvm::Value* addr, llvm::Type* elemType,
     }
 }
 
+// Instructions emitted while in scope carry `loc`, when it is known; the
+// enclosing construct's location comes back afterwards.
+class LocationScope {
+public:
+    LocationScope(CodeGen* cg, SourceLoc loc) : cg(cg), saved(cg->GetLocation()) {
+        if (loc.line) cg->SetLocation(loc);
+    }
+    ~LocationScope() { cg->SetLocation(saved); }
+
+private:
+    CodeGen* cg;
+    SourceLoc saved;
+};
+
+// Emit a run of block items. Anything after a `break`, `continue` or
+// `return` is unreachable; it goes into a fresh block with no predecessors
+// so the terminated block stays well-formed.
+void EmitItems(CodeGen* cg, ASTVector<unique_ptr<BlockItemAST>>& items) {
+    for (auto& item : items) {
+        if (cg->EndWithTerminator())
+            cg->SetInsertPoint(cg->CreateBasicBlock("dead", cg->GetFunction()));
+        item->ToValue(cg);
+    }
+}
+
+// Map `__attribute__((...))` names onto LLVM function attributes. Hot and
+// cold functions go to `.text.hot` / `.text.unlikely`, which the linker
+// groups so that rarely run code stays off the hot pages.
+void ApplyAttributes(CodeGen* cg, llvm::Function* func, const ASTVector<SymbolId>& attributes) {
+    auto has = [&](llvm::Attribute::AttrKind kind) { return func->hasFnAttribute(kind); };
+    for (auto attribute : attributes) {
+        auto& name = cg->Name(attribute);
+        auto conflict = [&](const char* other) {
+            cg->Warning("attribute '" + name + "' on '" + func->getName().str()
+                        + "' ignored: conflicts with '" + other + "'");
+        };
+        if (name == "hot") {
+            if (has(llvm::Attribute::Cold)) { conflict("cold"); continue; }
+            func->addFnAttr(llvm::Attribute::Hot);
+            func->setSection(".text.hot");
+        } else if (name == "cold") {
+            if (has(llvm::Attribute::Hot)) { conflict("hot"); continue; }
+            func->addFnAttr(llvm::Attribute::Cold);
+            func->setSection(".text.unlikely");
+        } else if (name == "noinline") {
+            if (has(llvm::Attribute::AlwaysInline)) { conflict("always_inline"); continue; }
+            func->addFnAttr(llvm::Attribute::NoInline);
+        } else if (name == "always_inline") {
+            if (has(llvm::Attribute::NoInline)) { conflict("noinline"); continue; }
+            func->addFnAttr(llvm::Attribute::AlwaysInline);
+        } else if (name == "used") {
+            // Only keeps the function emitted when nothing calls it.
+        } else {
+            cg->Warning("unknown attribute '" + name + "' ignored");
+        }
+    }
+}
+
+llvm::Value* EmitBinary(CodeGen* cg, ExprAST::Kind kind, llvm::Value* l, llvm::Value* r) {
+    using Kind = ExprAST::Kind;
+    switch (kind) {
+    case Kind::Add: return cg->CreateAdd(l, r);
+    case Kind::Sub: return cg->CreateSub(l, r);
+    case Kind::Mul: return cg->CreateMul(l, r);
+    case Kind::Div: return cg->CreateDiv(l, r);
+    case Kind::Mod: return cg->CreateMod(l, r);
+    case Kind::Lt:  return cg->CreateICmpLT(l, r);
+    case Kind::Gt:  return cg->CreateICmpGT(l, r);
+    case Kind::Le:  return cg->CreateICmpLE(l, r);
+    case Kind::Ge:  return cg->CreateICmpGE(l, r);
+    case Kind::Eq:  return cg->CreateICmpEQ(l, r);
+    case Kind::Ne:  return cg->CreateICmpNE(l, r);
+    case Kind::BitAnd: return cg->CreateAnd(l, r);
+    case Kind::BitOr:  return cg->CreateOr(l, r);
+    case Kind::Xor:    return cg->CreateXor(l, r);
+    case Kind::Shl:    return cg->CreateShl(l, r);
+    case Kind::Shr:    return cg->CreateShr(l, r);
+    default:           return nullptr;
+    }
+}
+
+// Wrap-around int32 arithmetic, as the generated code would compute it.
+int Wrap(int64_t v) { return (int)(uint32_t)v; }
+
+// `&&` and `||` are folded by ExprAST::ToNumber, which skips the rhs when
+// the lhs decides the result.
+llvm::Value* FoldBinary(CodeGen* cg, ExprAST::Kind kind, llvm::Value* l, llvm::Value* r) {
+    using Kind = ExprAST::Kind;
+    switch (kind) {
+    case Kind::Add: return cg->CalculateBinaryOp([](int a, int b) { return Wrap((int64_t)a + b); }, l, r);
+    case Kind::Sub: return cg->CalculateBinaryOp([](int a, int b) { return Wrap((int64_t)a - b); }, l, r);
+    case Kind::Mul: return cg->CalculateBinaryOp([](int a, int b) { return Wrap((int64_t)a * b); }, l, r);
+    case Kind::Div:
+    case Kind::Mod: {
+        int a = cg->GetValueInt(l), b = cg->GetValueInt(r);
+        if (b == 0 || (a == INT32_MIN && b == -1)) {
+            cg->Error(b == 0 ? "division by zero in a constant expression"
+                             : "signed division overflow in a constant expression");
+            return cg->GetInt32(0);
+        }
+        return cg->GetInt32(kind == Kind::Div ? a / b : a % b);
+    }
+    case Kind::Lt:  return cg->CalculateBinaryOp([](int a, int b) { return a < b; }, l, r);
+    case Kind::Gt:  return cg->CalculateBinaryOp([](int a, int b) { return a > b; }, l, r);
+    case Kind::Le:  return cg->CalculateBinaryOp([](int a, int b) { return a <= b; }, l, r);
+    case Kind::Ge:  return cg->CalculateBinaryOp([](int a, int b) { return a >= b; }, l, r);
+    case Kind::Eq:  return cg->CalculateBinaryOp([](int a, int b) { return a == b; }, l, r);
+    case Kind::Ne:  return cg->CalculateBinaryOp([](int a, int b) { return a != b; }, l, r);
+    case Kind::BitAnd: return cg->CalculateBinaryOp([](int a, int b) { return a & b; }, l, r);
+    case Kind::BitOr:  return cg->CalculateBinaryOp([](int a, int b) { return a | b; }, l, r);
+    case Kind::Xor:    return cg->CalculateBinaryOp([](int a, int b) { return a ^ b; }, l, r);
+    // Shift counts are taken mod 32, as the hardware does.
+    case Kind::Shl: return cg->CalculateBinaryOp([](int a, int b) { return (int)((unsigned)a << (b & 31)); }, l, r);
+    case Kind::Shr: return cg->CalculateBinaryOp([](int a, int b) { return a >> (b & 31); }, l, r);
+    default:         return nullptr;
+    }
+}
+
 } // anonymous namespace
 
 // ========== Code Generation ==========
@@ -184,10 +317,10 @@ void ConstDefAST::Codegen(CodeGen* cg, llvm::Type* elemType) {
         // reused in later constant expressions (e.g. array dimensions).
         llvm::Value* val = initVal->ToNumber(cg);
         if (cg->IsGlobalScope()) {
-            auto* var = cg->CreateGlobal(elemType, ident, val);
-            cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::CONST, .type = elemType});
+            auto* var = cg->CreateGlobal(elemType, cg->Name(id), val, true);
+            cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::CONST, .type = elemType});
         } else {
-            cg->AddSymbol(ident, {.value = val, .kind = VAR_TYPE::CONST, .type = elemType});
+            cg->AddSymbol(id, {.value = val, .kind = VAR_TYPE::CONST, .type = elemType});
         }
         return;
     }
@@ -198,26 +331,26 @@ void ConstDefAST::Codegen(CodeGen* cg, llvm::Type* elemType) {
 
     if (cg->IsGlobalScope()) {
         llvm::Value* init = initVal ? cg->MakeArrayConstant(elemType, dims, flat) : nullptr;
-        auto* var = cg->CreateGlobal(arrType, ident, init);
-        cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::CONST, .type = arrType});
+        auto* var = cg->CreateGlobal(arrType, cg->Name(id), init, true);
+        cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::CONST, .type = arrType});
     } else {
-        auto* var = cg->CreateAlloca(arrType, ident);
+        auto* var = cg->CreateLocalArray(arrType, cg->Name(id));
         StoreFlatInit(cg, var, elemType, flat);
-        cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::CONST, .type = arrType});
+        cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::CONST, .type = arrType});
     }
 }
 
 void VarDefAST::Codegen(CodeGen* cg, llvm::Type* elemType) {
     if (sizeExprs.empty()) {
-        // Scalar variable.
-        llvm::Value* init = initVal ? initVal->ToValue(cg, nullptr) : cg->GetInt32(0);
+        // Scalar variable. A global's initializer must fold to a constant.
         if (cg->IsGlobalScope()) {
-            auto* var = cg->CreateGlobal(elemType, ident, init);
-            cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::GLOBAL, .type = elemType});
+            llvm::Value* init = initVal ? initVal->expr->ToNumber(cg) : cg->GetInt32(0);
+            auto* var = cg->CreateGlobal(elemType, cg->Name(id), init);
+            cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::GLOBAL, .type = elemType});
         } else {
-            auto* var = cg->CreateAlloca(elemType, ident);
-            if (initVal) cg->StoreScalar(init, var, elemType);
-            cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::VAR, .type = elemType});
+            auto* var = cg->CreateAlloca(elemType, cg->Name(id));
+            if (initVal) cg->StoreScalar(initVal->ToValue(cg, nullptr), var, elemType);
+            cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::VAR, .type = elemType});
         }
         return;
     }
@@ -229,54 +362,93 @@ void VarDefAST::Codegen(CodeGen* cg, llvm::Type* elemType) {
         llvm::Value* init = initVal
             ? cg->MakeArrayConstant(elemType, dims, FlattenInit(cg, dims, initVal))
             : nullptr;
-        auto* var = cg->CreateGlobal(arrType, ident, init);
-        cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::GLOBAL, .type = arrType});
+        auto* var = cg->CreateGlobal(arrType, cg->Name(id), init);
+        cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::GLOBAL, .type = arrType});
     } else {
-        auto* var = cg->CreateAlloca(arrType, ident);
-        if (initVal) StoreFlatInit(cg, var, elemType, FlattenInit(cg, dims, initVal));
-        cg->AddSymbol(ident, {.value = var, .kind = VAR_TYPE::VAR, .type = arrType});
+        auto* var = cg->CreateLocalArray(arrType, cg->Name(id));
+        if (initVal) {
+            StoreFlatInit(cg, var, elemType, FlattenInit(cg, dims, initVal, false));
+        } else if (!filled && !cg->IsAllocaSlot(var)) {
+            // Static storage keeps the previous call's contents; zero it as
+            // -interp zeroes every local array, unless the next statement
+            // overwrites all of it anyway.
+            cg->CreateMemZero(var, arrType);
+        }
+        cg->AddSymbol(id, {.value = var, .kind = VAR_TYPE::VAR, .type = arrType});
     }
 }
 
 void CompUnitAST::Codegen(CodeGen* cg) {
+    TimeScope timer("Codegen");
     auto* intType = cg->GetInt32Type();
     auto* ptrType = cg->GetPointerType(cg->GetInt8Type());
 
     cg->CreateBuiltin("printf", intType, {ptrType}, true);
     cg->CreateBuiltin("scanf", intType, {ptrType}, true);
 
+    CallGraph graph(*this);
+    if (size_t dropped = MarkUnreachable(*this, graph, cg->GetNames())) {
+        cg->Note("skipped " + std::to_string(dropped) + " function" + (dropped == 1 ? "" : "s")
+                 + " unreachable from 'main'");
+    }
+    if (cg->GetStaticLocalLimit()) {
+        for (auto& funcDef : funcDefs) {
+            funcDef->recursive = graph.IsRecursive(funcDef->id);
+            MarkFilledArrays(funcDef.get());
+        }
+        MarkConcurrent(*this, graph);
+    }
+
+    ConstEval eval(*this);
+    cg->SetConstEval(&eval);
     for (auto& decl : decls) decl->Codegen(cg);
-    for (auto& funcDef : funcDefs) funcDef->Codegen(cg);
+    for (auto& funcDef : funcDefs) {
+        if (!funcDef->reachable) continue;
+        TimeScope timer("Codegen function", cg->Name(funcDef->id));
+        funcDef->Codegen(cg);
+    }
+    cg->FinishProfile();
+    cg->SetConstEval(nullptr);
 }
 
 void FuncDefAST::Codegen(CodeGen* cg) {
+    LocationScope at(cg, loc);
     std::vector<llvm::Type*> paramTypes;
     std::vector<std::string> paramNames;
     for (auto& param : params) {
         paramTypes.push_back(param->ToType(cg));
-        paramNames.push_back(param->ident);
+        paramNames.push_back(cg->Name(param->id));
     }
 
     auto* funcType = cg->CreateFuncType(this->funcType->Codegen(cg), paramTypes);
-    auto* func = cg->CreateFunction(funcType, ident, paramNames);
+    auto* func = cg->CreateFunction(funcType, cg->Name(id), paramNames);
+    ApplyAttributes(cg, func, attributes);
     cg->SetInsertPoint(cg->CreateBasicBlock("entry", func));
+    cg->BeginFunctionProfile();
+    cg->SetStaticLocalsAllowed(!recursive && !concurrent);
     cg->EnterScope();
 
     for (size_t i = 0; i < params.size(); ++i)
         cg->CreateStore(cg->GetFunctionArg(i), params[i]->Alloca(cg, paramTypes[i]));
 
     block->Codegen(cg);
-    if (!cg->EndWithTerminator()) cg->CreateRet(nullptr);
+    // Falling off the end of a non-void function returns 0.
+    if (!cg->EndWithTerminator()) {
+        auto* retType = func->getReturnType();
+        cg->CreateRet(retType->isVoidTy() ? nullptr : cg->CreateZero(retType));
+    }
+    cg->EndFunctionProfile();
     cg->ExitScope();
 }
 
 void BlockAST::Codegen(CodeGen* cg) {
     cg->EnterScope();
-    for (auto& item : items) item->ToValue(cg);
+    EmitItems(cg, items);
     cg->ExitScope();
 }
 
 void StmtAST::Codegen(CodeGen* cg) {
+    LocationScope at(cg, loc);
     switch (type) {
     case TYPE::Assign: {
         llvm::Type* elemType = nullptr;
@@ -293,26 +465,29 @@ void StmtAST::Codegen(CodeGen* cg) {
         break;
     }
     case TYPE::If: {
-        auto* condVal = cond->ToValue(cg);
+        // An `else if` ladder is emitted arm by arm in this loop rather than
+        // by recursing into each `else`, and all arms meet in one end block.
         auto* func = cg->GetFunction();
-        auto* thenBB = cg->CreateBasicBlock("then", func);
-        llvm::BasicBlock* endBB{};
-
-        if (elseStmt) {
-            auto* elseBB = cg->CreateBasicBlock("else", func);
-            endBB = cg->CreateBasicBlock("if_end", func);
+        auto* endBB = cg->CreateBasicBlock("if_end", func);
+        for (auto* arm = this;;) {
+            auto* condVal = arm->cond->ToValue(cg);
+            auto* thenBB = cg->CreateBasicBlock("then", func);
+            auto* elseBB = arm->elseStmt ? cg->CreateBasicBlock("else", func) : endBB;
             cg->CreateCondBr(condVal, thenBB, elseBB);
+
+            cg->SetInsertPoint(thenBB);
+            arm->thenStmt->Codegen(cg);
+            if (!cg->EndWithTerminator()) cg->CreateBr(endBB);
+            if (elseBB == endBB) break;
+
             cg->SetInsertPoint(elseBB);
-            elseStmt->Codegen(cg);
-            cg->CreateBr(endBB);
-        } else {
-            endBB = cg->CreateBasicBlock("if_end", func);
-            cg->CreateCondBr(condVal, thenBB, endBB);
+            arm = arm->elseStmt.get();
+            if (arm->type != TYPE::If) {
+                arm->Codegen(cg);
+                if (!cg->EndWithTerminator()) cg->CreateBr(endBB);
+                break;
+            }
         }
-
-        cg->SetInsertPoint(thenBB);
-        thenStmt->Codegen(cg);
-        if (!cg->EndWithTerminator()) cg->CreateBr(endBB);
         cg->SetInsertPoint(endBB);
         break;
     }
@@ -330,25 +505,72 @@ void StmtAST::Codegen(CodeGen* cg) {
         auto* endBB = cg->CreateBasicBlock("while_end", func);
 
         cg->EnterWhile(condBB, endBB);
+        auto* entryBB = cg->GetInsertBlock();
         cg->CreateBr(condBB);
         cg->SetInsertPoint(condBB);
         cg->CreateCondBr(cond->ToValue(cg), bodyBB, endBB);
         cg->SetInsertPoint(bodyBB);
         thenStmt->Codegen(cg);
-        cg->CreateBr(condBB);
+        if (!cg->EndWithTerminator()) cg->CreateBr(condBB);
+        AttachLoopHints(cg, condBB, entryBB);
         cg->SetInsertPoint(endBB);
         cg->ExitWhile();
         break;
     }
     case TYPE::Break: {
-        cg->CreateBr(cg->GetWhileEnd());
+        if (auto* target = cg->GetWhileEnd()) cg->CreateBr(target);
+        else cg->Error("'break' outside of a loop or switch");
         break;
     }
     case TYPE::Continue: {
-        cg->CreateBr(cg->GetWhileEntry());
+        if (auto* target = cg->GetWhileEntry()) cg->CreateBr(target);
+        else cg->Error("'continue' outside of a loop");
+        break;
+    }
+    case TYPE::Switch: {
+        auto* value = expr->ToValue(cg);
+        auto* func = cg->GetFunction();
+        auto* endBB = cg->CreateBasicBlock("switch_end", func);
+
+        // One block per label, in source order, so that falling off the end
+        // of a label's items enters the next label.
+        vector<llvm::BasicBlock*> labels;
+        llvm::BasicBlock* defaultBB = nullptr;
+        for (auto& c : cases) {
+            labels.push_back(cg->CreateBasicBlock(c->value ? "case" : "default", func));
+            if (!c->value) {
+                if (defaultBB) cg->Error("multiple 'default' labels in one switch");
+                defaultBB = labels.back();
+            }
+        }
+
+        auto* inst = cg->CreateSwitch(value, defaultBB ? defaultBB : endBB, cases.size());
+        std::set<int> seen;
+        for (size_t i = 0; i < cases.size(); ++i) {
+            if (!cases[i]->value) continue;
+            int label = cases[i]->value->ToInteger(cg);
+            if (!seen.insert(label).second)
+                cg->Error("duplicate case value " + std::to_string(label));
+            else
+                cg->AddSwitchCase(inst, label, labels[i]);
+        }
+
+        // `break` leaves the switch; `continue` still targets the enclosing loop.
+        cg->EnterWhile(cg->GetWhileEntry(), endBB);
+        cg->EnterScope();
+        for (size_t i = 0; i < cases.size(); ++i) {
+            if (!cg->EndWithTerminator()) cg->CreateBr(labels[i]);
+            cg->SetInsertPoint(labels[i]);
+            EmitItems(cg, cases[i]->items);
+        }
+        if (!cg->EndWithTerminator()) cg->CreateBr(endBB);
+        cg->ExitScope();
+        cg->ExitWhile();
+        cg->SetInsertPoint(endBB);
         break;
     }
     case TYPE::For: {
+        if (parallel && EmitParallelFor(cg, this)) break;
         bool hasScope = (forDecl != nullptr);
         if (hasScope) cg->EnterScope();
         if (forDecl) forDecl->Codegen(cg);
@@ -361,6 +583,7 @@ void StmtAST::Codegen(CodeGen* cg) {
         auto* endBB = cg->CreateBasicBlock("for_end", func);
 
         cg->EnterWhile(stepBB, endBB);
+        auto* entryBB = cg->GetInsertBlock();
         cg->CreateBr(condBB);
         cg->SetInsertPoint(condBB);
         if (cond) cg->CreateCondBr(cond->ToValue(cg), bodyBB, endBB);
@@ -373,6 +596,7 @@ void StmtAST::Codegen(CodeGen* cg) {
         cg->SetInsertPoint(stepBB);
         if (forStepStmt) forStepStmt->Codegen(cg);
         cg->CreateBr(condBB);
+        AttachLoopHints(cg, condBB, entryBB);
 
         cg->SetInsertPoint(endBB);
         cg->ExitWhile();
@@ -382,159 +606,276 @@ void StmtAST::Codegen(CodeGen* cg) {
     }
 }
 
-llvm::Value* ExprAST::ToValue(CodeGen* cg)  { return lorExpr->ToValue(cg); }
-llvm::Value* ExprAST::ToNumber(CodeGen* cg) { return lorExpr->ToNumber(cg); }
-
-llvm::Value* PrimaryExprAST::ToValue(CodeGen* cg) {
-    switch (type) {
-        case TYPE::Expr:   return expr->ToValue(cg);
-        case TYPE::LVal:   return lval->ToValue(cg);
-        case TYPE::Number: return value->ToValue(cg);
-        case TYPE::String: return cg->CreateGlobalString(strVal);
-    }
-    return nullptr;
-}
-
-llvm::Value* PrimaryExprAST::ToNumber(CodeGen* cg) {
-    switch (type) {
-        case TYPE::Expr:   return expr->ToNumber(cg);
-        case TYPE::LVal:   return lval->ToNumber(cg);
-        case TYPE::Number: return value->ToValue(cg);
-        case TYPE::String: return cg->CreateGlobalString(strVal);
-    }
-    return nullptr;
-}
-
-llvm::Value* NumberAST::ToValue(CodeGen* cg) { return cg->GetInt32(value); }
+void StmtAST::AttachLoopHints(CodeGen* cg, llvm::BasicBlock* header, llvm::BasicBlock* entry) {
+    vector<llvm::Metadata*> properties;
+    if (hints.noUnroll) {
+        if (hints.unroll) cg->Warning("loop hint 'unroll' ignored: the loop is also marked 'nounroll'");
+        properties.push_back(cg->CreateLoopProperty("llvm.loop.unroll.disable"));
+    } else if (hints.unroll) {
+        properties.push_back(cg->CreateLoopProperty("llvm.loop.unroll.count", hints.unroll));
+    }
+    if (hints.vectorize & (hints.vectorize - 1)) {
+        cg->Warning("loop hint 'vectorize(" + std::to_string(hints.vectorize)
+                    + ")' ignored: the width must be a power of two");
+    } else if (hints.vectorize) {
+        // A width of 1 keeps the loop scalar.
+        properties.push_back(cg->CreateLoopProperty("llvm.loop.vectorize.width", hints.vectorize));
+        properties.push_back(cg->CreateLoopProperty("llvm.loop.vectorize.enable", hints.vectorize > 1, 1));
+    }
+    if (hints.interleave)
+        properties.push_back(cg->CreateLoopProperty("llvm.loop.interleave.count", hints.interleave));
+
+    if (properties.empty()) return;
+    if (!cg->SetLoopProperties(header, entry, properties))
+        cg->Warning("loop hints ignored: the loop body never repeats");
+}
+
+// Each task is a node plus the number of steps already taken on it; the
+// values of finished operands wait on `values` until their parent combines
+// them. A task is done once it has pushed its own value and been popped.
+llvm::Value* ExprAST::ToValue(CodeGen* cg) {
+    struct Task {
+        ExprAST* expr;
+        int step = 0;
+        // Short-circuit: join block and result slot. `?:`: else, join and
+        // end-of-then blocks.
+        llvm::BasicBlock* blocks[3] = {};
+        llvm::Value* slot = nullptr;
+    };
+    vector<Task> tasks{{this}};
+    vector<llvm::Value*> values;
+    auto pop = [&values] {
+        auto* value = values.back();
+        values.pop_back();
+        return value;
+    };
+
+    while (!tasks.empty()) {
+        // `task` dangles once a child is pushed, so each case pushes last.
+        auto& task = tasks.back();
+        auto* expr = task.expr;
+        int step = task.step++;
+
+        switch (expr->kind) {
+        case Kind::Number: values.push_back(cg->GetInt32(expr->value)); break;
+        case Kind::String: values.push_back(cg->CreateGlobalString(cg->Name(expr->id))); break;
+        case Kind::LVal:   values.push_back(expr->lval->ToValue(cg)); break;
+
+        case Kind::Call:
+            if (expr->IsBranchHint(cg) && expr->args.size() != 1) {
+                cg->Error("'" + cg->Name(expr->id) + "' takes exactly one argument");
+                values.push_back(cg->GetInt32(0));
+                break;
+            }
+            if (step < (int)expr->args.size()) {
+                tasks.push_back({expr->args[step].get()});
+                continue;
+            }
+            if (expr->IsBranchHint(cg)) {
+                values.push_back(cg->CreateExpect(pop(), cg->Name(expr->id) == "likely"));
+            } else {
+                vector<llvm::Value*> args(values.end() - expr->args.size(), values.end());
+                values.resize(values.size() - args.size());
+                // Widen a narrow (char) return to i32 so expression values stay uniform.
+                auto* call = cg->CreateCall(cg->GetSymbol(expr->id).function, args);
+                values.push_back(cg->ConvertInt(call, cg->GetInt32Type()));
+            }
+            break;
+
+        case Kind::Neg:
+        case Kind::Not:
+        case Kind::BitNot:
+            if (step == 0) {
+                tasks.push_back({expr->lhs.get()});
+                continue;
+            }
+            if (expr->kind == Kind::Neg) values.push_back(cg->CreateSub(cg->GetInt32(0), pop()));
+            else if (expr->kind == Kind::Not) values.push_back(cg->CreateICmpEQ(pop(), cg->GetInt32(0)));
+            else values.push_back(cg->CreateNot(pop()));
+            break;
+
+        // The right operand only runs when the left one does not already
+        // decide the result.
+        case Kind::LAnd:
+        case Kind::LOr: {
+            bool isAnd = expr->kind == Kind::LAnd;
+            string prefix = isAnd ? "land" : "lor";
+            if (step == 0) {
+                tasks.push_back({expr->lhs.get()});
+                continue;
+            }
+            if (step == 1) {
+                auto* func = cg->GetFunction();
+                auto* rightBB = cg->CreateBasicBlock(prefix + "_right", func);
+                auto* endBB = cg->CreateBasicBlock(prefix + "_end", func);
+                auto* result = cg->CreateAlloca(cg->GetInt32Type(), prefix + "_result");
+                auto* cond = cg->CreateICmpNE(pop(), cg->GetInt32(0));
+                cg->CreateStore(cond, result);
+                if (isAnd) cg->CreateCondBr(cond, rightBB, endBB);
+                else cg->CreateCondBr(cond, endBB, rightBB);
+                cg->SetInsertPoint(rightBB);
+                task.blocks[0] = endBB;
+                task.slot = result;
+                tasks.push_back({expr->rhs.get()});
+                continue;
+            }
+            cg->CreateStore(cg->CreateICmpNE(pop(), cg->GetInt32(0)), task.slot);
+            cg->CreateBr(task.blocks[0]);
+            cg->SetInsertPoint(task.blocks[0]);
+            values.push_back(cg->CreateLoad(task.slot));
+            break;
+        }
 
-llvm::Value* UnaryExprAST::ToValue(CodeGen* cg) {
-    switch (type) {
-    case TYPE::Primary: return primaryExpr->ToValue(cg);
-    case TYPE::Unary: {
-        auto* val = unaryExpr->ToValue(cg);
-        switch (op) {
-            case OP::PLUS:  return val;
-            case OP::MINUS: return cg->CreateSub(cg->GetInt32(0), val);
-            case OP::NOT:   return cg->CreateICmpEQ(val, cg->GetInt32(0));
+        // Arms that cannot fault or have side effects are both evaluated and
+        // picked with a select, so the conditional costs no branch; otherwise
+        // each arm gets its own block and a phi joins them.
+        case Kind::Cond: {
+            bool select = expr->lhs->speculatable && expr->rhs->speculatable;
+            if (step == 0) {
+                tasks.push_back({expr->cond.get()});
+                continue;
+            }
+            if (step == 1) {
+                if (!select) {
+                    auto* func = cg->GetFunction();
+                    auto* thenBB = cg->CreateBasicBlock("cond_then", func);
+                    task.blocks[0] = cg->CreateBasicBlock("cond_else", func);
+                    task.blocks[1] = cg->CreateBasicBlock("cond_end", func);
+                    cg->CreateCondBr(pop(), thenBB, task.blocks[0]);
+                    cg->SetInsertPoint(thenBB);
+                }
+                tasks.push_back({expr->lhs.get()});
+                continue;
+            }
+            if (step == 2) {
+                if (!select) {
+                    task.blocks[2] = cg->GetInsertBlock();
+                    cg->CreateBr(task.blocks[1]);
+                    cg->SetInsertPoint(task.blocks[0]);
+                }
+                tasks.push_back({expr->rhs.get()});
+                continue;
+            }
+            auto* elseVal = pop();
+            auto* elseBB = cg->GetInsertBlock();
+            auto* thenVal = pop();
+            if (!select) {
+                cg->CreateBr(task.blocks[1]);
+                cg->SetInsertPoint(task.blocks[1]);
+            }
+            if (thenVal->getType() != elseVal->getType()) {
+                cg->Error("operands of '?:' have different types");
+                if (select) pop();
+                values.push_back(thenVal);
+            } else if (select) {
+                values.push_back(cg->CreateSelect(pop(), thenVal, elseVal));
+            } else {
+                values.push_back(cg->CreatePhi(thenVal, task.blocks[2], elseVal, elseBB));
+            }
+            break;
         }
-    }
-    case TYPE::Call: {
-        std::vector<llvm::Value*> args;
-        for (auto& arg : callArgs) args.push_back(arg->ToValue(cg));
-        // Widen a narrow (char) return to i32 so expression values stay uniform.
-        return cg->ConvertInt(cg->CreateCall(cg->GetSymbol(ident).function, args), cg->GetInt32Type());
-    }
-    }
-    return nullptr;
-}
 
-llvm::Value* UnaryExprAST::ToNumber(CodeGen* cg) {
-    switch (type) {
-    case TYPE::Primary: return primaryExpr->ToNumber(cg);
-    case TYPE::Unary: {
-        auto* val = unaryExpr->ToNumber(cg);
-        switch (op) {
-            case OP::PLUS:  return val;
-            case OP::MINUS: return cg->CalculateBinaryOp([](int a, int b) { return a - b; }, cg->GetInt32(0), val);
-            case OP::NOT:   return cg->CalculateBinaryOp([](int a, int b) { return a == b; }, val, cg->GetInt32(0));
+        default:
+            if (step < 2) {
+                tasks.push_back({(step == 0 ? expr->lhs : expr->rhs).get()});
+                continue;
+            }
+            auto* r = pop();
+            values.push_back(EmitBinary(cg, expr->kind, pop(), r));
+            break;
         }
+        tasks.pop_back();
     }
-    case TYPE::Call:
-        assert(false && "Call expressions should not be calculated directly");
-    }
-    return nullptr;
+    return values.back();
 }
 
-llvm::Value* BinaryExprAST::ToValue(CodeGen* cg) {
-    if (!lhs) return operand->ToValue(cg);
-    auto *l = lhs->ToValue(cg), *r = rhs->ToValue(cg);
-    switch (op) {
-        case Op::ADD: return cg->CreateAdd(l, r);
-        case Op::SUB: return cg->CreateSub(l, r);
-        case Op::MUL: return cg->CreateMul(l, r);
-        case Op::DIV: return cg->CreateDiv(l, r);
-        case Op::MOD: return cg->CreateMod(l, r);
-        case Op::LT:  return cg->CreateICmpLT(l, r);
-        case Op::GT:  return cg->CreateICmpGT(l, r);
-        case Op::LE:  return cg->CreateICmpLE(l, r);
-        case Op::GE:  return cg->CreateICmpGE(l, r);
-        case Op::EQ:  return cg->CreateICmpEQ(l, r);
-        case Op::NE:  return cg->CreateICmpNE(l, r);
-    }
-    return nullptr;
-}
+// Same scheme as ToValue, folding instead of emitting code.
+llvm::Value* ExprAST::ToNumber(CodeGen* cg) {
+    vector<std::pair<ExprAST*, int>> tasks{{this, 0}};
+    vector<llvm::Value*> values;
+    auto pop = [&values] {
+        auto* value = values.back();
+        values.pop_back();
+        return value;
+    };
+
+    while (!tasks.empty()) {
+        auto* expr = tasks.back().first;
+        int step = tasks.back().second++;
+
+        switch (expr->kind) {
+        case Kind::Number: values.push_back(cg->GetInt32(expr->value)); break;
+        case Kind::String: values.push_back(cg->CreateGlobalString(cg->Name(expr->id))); break;
+        case Kind::LVal:   values.push_back(expr->lval->ToNumber(cg)); break;
+        case Kind::Call:   values.push_back(cg->GetInt32(cg->GetConstEval()->EvalCall(cg, expr))); break;
+
+        case Kind::Neg:
+        case Kind::Not:
+        case Kind::BitNot: {
+            if (step == 0) {
+                tasks.push_back({expr->lhs.get(), 0});
+                continue;
+            }
+            auto* val = pop();
+            if (expr->kind == Kind::Neg)
+                values.push_back(cg->GetInt32(Wrap(-(int64_t)cg->GetValueInt(val))));
+            else if (expr->kind == Kind::Not)
+                values.push_back(cg->CalculateBinaryOp([](int a, int b) { return a == b; }, val, cg->GetInt32(0)));
+            else
+                values.push_back(cg->CalculateBinaryOp([](int a, int b) { return a ^ b; }, val, cg->GetInt32(-1)));
+            break;
+        }
 
-llvm::Value* BinaryExprAST::ToNumber(CodeGen* cg) {
-    if (!lhs) return operand->ToNumber(cg);
-    auto *l = lhs->ToNumber(cg), *r = rhs->ToNumber(cg);
-    switch (op) {
-        case Op::ADD: return cg->CalculateBinaryOp([](int a, int b) { return a + b; }, l, r);
-        case Op::SUB: return cg->CalculateBinaryOp([](int a, int b) { return a - b; }, l, r);
-        case Op::MUL: return cg->CalculateBinaryOp([](int a, int b) { return a * b; }, l, r);
-        case Op::DIV: return cg->CalculateBinaryOp([](int a, int b) { return a / b; }, l, r);
-        case Op::MOD: return cg->CalculateBinaryOp([](int a, int b) { return a % b; }, l, r);
-        case Op::LT:  return cg->CalculateBinaryOp([](int a, int b) { return a < b; }, l, r);
-        case Op::GT:  return cg->CalculateBinaryOp([](int a, int b) { return a > b; }, l, r);
-        case Op::LE:  return cg->CalculateBinaryOp([](int a, int b) { return a <= b; }, l, r);
-        case Op::GE:  return cg->CalculateBinaryOp([](int a, int b) { return a >= b; }, l, r);
-        case Op::EQ:  return cg->CalculateBinaryOp([](int a, int b) { return a == b; }, l, r);
-        case Op::NE:  return cg->CalculateBinaryOp([](int a, int b) { return a != b; }, l, r);
+        // The rhs is folded only when the lhs does not decide the result, so
+        // `0 && f()` never runs `f`.
+        case Kind::LAnd:
+        case Kind::LOr:
+            if (step == 0) {
+                tasks.push_back({expr->lhs.get(), 0});
+                continue;
+            }
+            if (step == 1) {
+                bool lhs = cg->GetValueInt(pop()) != 0;
+                if (lhs != (expr->kind == Kind::LOr)) {
+                    tasks.push_back({expr->rhs.get(), 0});
+                    continue;
+                }
+                values.push_back(cg->GetInt32(lhs));
+                break;
+            }
+            values.push_back(cg->GetInt32(cg->GetValueInt(pop()) != 0));
+            break;
+
+        // Only the chosen arm is folded; its value becomes this node's.
+        case Kind::Cond:
+            if (step == 0) {
+                tasks.push_back({expr->cond.get(), 0});
+                continue;
+            }
+            if (step == 1) {
+                tasks.push_back({(cg->GetValueInt(pop()) ? expr->lhs : expr->rhs).get(), 0});
+                continue;
+            }
+            break;
+
+        default:
+            if (step < 2) {
+                tasks.push_back({(step == 0 ? expr->lhs : expr->rhs).get(), 0});
+                continue;
+            }
+            auto* r = pop();
+            values.push_back(FoldBinary(cg, expr->kind, pop(), r));
+            break;
+        }
+        tasks.pop_back();
     }
-    return nullptr;
-}
-
-llvm::Value* LAndExprAST::ToValue(CodeGen* cg) {
-    if (!left) return operand->ToValue(cg);
-
-    auto* leftVal = left->ToValue(cg);
-    auto* func = cg->GetFunction();
-    auto* rightBB = cg->CreateBasicBlock("land_right", func);
-    auto* endBB = cg->CreateBasicBlock("land_end", func);
-    auto* result = cg->CreateAlloca(cg->GetInt32Type(), "land_result");
-    auto* cond = cg->CreateICmpNE(leftVal, cg->GetInt32(0));
-
-    cg->CreateStore(cond, result);
-    cg->CreateCondBr(cond, rightBB, endBB);
-
-    cg->SetInsertPoint(rightBB);
-    cond = cg->CreateICmpNE(right->ToValue(cg), cg->GetInt32(0));
-    cg->CreateStore(cond, result);
-    cg->CreateBr(endBB);
-
-    cg->SetInsertPoint(endBB);
-    return cg->CreateLoad(result);
-}
-
-llvm::Value* LAndExprAST::ToNumber(CodeGen* cg) {
-    if (!left) return operand->ToNumber(cg);
-    return cg->CalculateBinaryOp([](int a, int b) { return a && b; }, left->ToNumber(cg), right->ToNumber(cg));
-}
-
-llvm::Value* LOrExprAST::ToValue(CodeGen* cg) {
-    if (!left) return operand->ToValue(cg);
-
-    auto* leftVal = left->ToValue(cg);
-    auto* func = cg->GetFunction();
-    auto* rightBB = cg->CreateBasicBlock("lor_right", func);
-    auto* endBB = cg->CreateBasicBlock("lor_end", func);
-    auto* result = cg->CreateAlloca(cg->GetInt32Type(), "lor_result");
-    auto* cond = cg->CreateICmpNE(leftVal, cg->GetInt32(0));
-
-    cg->CreateStore(cond, result);
-    cg->CreateCondBr(cond, endBB, rightBB);
-
-    cg->SetInsertPoint(rightBB);
-    cond = cg->CreateICmpNE(right->ToValue(cg), cg->GetInt32(0));
-    cg->CreateStore(cond, result);
-    cg->CreateBr(endBB);
-
-    cg->SetInsertPoint(endBB);
-    return cg->CreateLoad(result);
+    return values.back();
 }
 
-llvm::Value* LOrExprAST::ToNumber(CodeGen* cg) {
-    if (!left) return operand->ToNumber(cg);
-    return cg->CalculateBinaryOp([](int a, int b) { return a || b; }, left->ToNumber(cg), right->ToNumber(cg));
+bool ExprAST::IsBranchHint(CodeGen* cg) const {
+    if (kind != Kind::Call) return false;
+    auto& name = cg->Name(id);
+    return (name == "likely" || name == "unlikely") && !cg->GetSymbol(id).function;
 }
 
 void DeclAST::Codegen(CodeGen* cg) {
@@ -576,12 +917,13 @@ llvm::Value* InitValAST::ToNumber(CodeGen* cg, vector<int> shape, int dim) {
 }
 
 void BlockItemAST::ToValue(CodeGen* cg) {
+    LocationScope at(cg, loc);
     if (decl) decl->Codegen(cg);
     else if (stmt) stmt->Codegen(cg);
 }
 
 llvm::Value* LValAST::ToValue(CodeGen* cg) {
-    auto sym = cg->GetSymbol(ident);
+    const auto& sym = cg->GetSymbol(id);
 
     // A bare array parameter used as a value is the (loaded) pointer it holds.
     if (sym.pointerParam && indies.empty())
@@ -600,7 +942,13 @@ llvm::Value* LValAST::ToValue(CodeGen* cg) {
 }
 
 llvm::Value* LValAST::ToNumber(CodeGen* cg) {
-    return cg->GetBaseValue(cg->GetSymbol(ident).value);
+    const auto& sym = cg->GetSymbol(id);
+    // A variable's initial value is not its value by the time it is read.
+    if (sym.kind != VAR_TYPE::CONST) {
+        cg->Error("'" + cg->Name(id) + "' is not a constant expression");
+        return cg->GetInt32(0);
+    }
+    return cg->GetBaseValue(sym.value);
 }
 
 llvm::Value* LValAST::ToPointer(CodeGen* cg) {
@@ -609,7 +957,7 @@ llvm::Value* LValAST::ToPointer(CodeGen* cg) {
 }
 
 llvm::Value* LValAST::ToPointer(CodeGen* cg, llvm::Type*& elemOut) {
-    auto sym = cg->GetSymbol(ident);
+    const auto& sym = cg->GetSymbol(id);
     llvm::Value* addr = sym.value;
     llvm::Type* container = sym.type; // array type, scalar type, or param pointee type
 
@@ -654,16 +1002,16 @@ llvm::Type* FuncFParamAST::ToType(CodeGen* cg) {
 }
 
 llvm::Value* FuncFParamAST::Alloca(CodeGen* cg, llvm::Type* type) {
-    auto* addr = cg->CreateAlloca(type, ident);
+    auto* addr = cg->CreateAlloca(type, cg->Name(id));
     if (isArray) {
         // The slot holds a decayed pointer; record the element type it points to
         // (the declared base with any inner dimensions applied).
         llvm::Type* elem = btype->Codegen(cg);
         for (auto& sizeExpr : sizeExprs)
             elem = cg->GetArrayType(elem, sizeExpr->ToInteger(cg));
-        cg->AddSymbol(ident, {.value = addr, .kind = VAR_TYPE::VAR, .type = elem, .pointerParam = true});
+        cg->AddSymbol(id, {.value = addr, .kind = VAR_TYPE::VAR, .type = elem, .pointerParam = true});
     } else {
-        cg->AddSymbol(ident, {.value = addr, .kind = VAR_TYPE::VAR, .type = type});
+        cg->AddSymbol(id, {.value = addr, .kind = VAR_TYPE::VAR, .type = type});
     }
     return addr;
 }
@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "type.h"
+#include "util/intern.h"
+#include "util/source.h"
 
 using std::unique_ptr;
 using std::vector;
@@ -27,80 +29,98 @@ class StmtAST;
 class ConstInitValAST;
 class InitValAST;
 class LValAST;
-class NumberAST;
 class ExprAST;
-class LOrExprAST;
 class ConstDeclAST;
 class VarDeclAST;
 class ConstExprAST;
 class DeclAST;
-class PrimaryExprAST;
-class UnaryExprAST;
-class BinaryExprAST;
-class LAndExprAST;
 class FuncRParamAST;
+class CaseAST;
 
-class ConstDefAST {
+class ConstDefAST : public ASTNode {
 public:
-    ConstDefAST(string ident, unique_ptr<ConstInitValAST>&& initVal);
-    ConstDefAST(string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<ConstInitValAST>&& initVal);
+    ConstDefAST(Ident name, unique_ptr<ConstInitValAST>&& initVal);
+    ConstDefAST(Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<ConstInitValAST>&& initVal);
 
     void Codegen(CodeGen* cg, llvm::Type* type);
 
-    string ident;
-    vector<unique_ptr<ConstExprAST>> sizeExprs;
+    SymbolId id = kNoSymbol;   // the interned name, set by the parser
+    ASTVector<unique_ptr<ConstExprAST>> sizeExprs;
     unique_ptr<ConstInitValAST> initVal;
 };
 
-class VarDefAST {
+class VarDefAST : public ASTNode {
 public:
-    VarDefAST(string ident);
-    VarDefAST(string ident, unique_ptr<InitValAST>&& initVal);
-    VarDefAST(string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs);
-    VarDefAST(string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<InitValAST>&& initVal);
+    VarDefAST(Ident name);
+    VarDefAST(Ident name, unique_ptr<InitValAST>&& initVal);
+    VarDefAST(Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs);
+    VarDefAST(Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs, unique_ptr<InitValAST>&& initVal);
 
     void Codegen(CodeGen* cg, llvm::Type* type);
 
-    string ident;
-    vector<unique_ptr<ConstExprAST>> sizeExprs;
+    SymbolId id = kNoSymbol;   // the interned name, set by the parser
+    ASTVector<unique_ptr<ConstExprAST>> sizeExprs;
     unique_ptr<InitValAST> initVal;
+    // Uninitialized local array that the next statement fills (see analysis.h).
+    bool filled = false;
 };
 
+// The root, owned by the Scanner next to the arena holding the rest of the
+// tree. It lets the nodes go without running their destructors: nothing in
+// them owns memory outside the arena.
 struct CompUnitAST {
 public:
+    ~CompUnitAST();
+
     void AddFuncDef(unique_ptr<FuncDefAST>&& funcDef);
     void AddDecl(unique_ptr<DeclAST>&& decl);
     void Codegen(CodeGen* cg);
 
-    vector<unique_ptr<FuncDefAST>> funcDefs;
-    vector<unique_ptr<DeclAST>> decls;
+    ASTVector<unique_ptr<FuncDefAST>> funcDefs;
+    ASTVector<unique_ptr<DeclAST>> decls;
 };
 
-class FuncDefAST {
+class FuncDefAST : public ASTNode {
 public:
-    FuncDefAST(unique_ptr<BaseType>&& funcType, string ident, unique_ptr<BlockAST>&& block);
-    FuncDefAST(unique_ptr<BaseType>&& funcType, string ident, vector<unique_ptr<FuncFParamAST>>&& params, unique_ptr<BlockAST>&& block);
+    FuncDefAST(unique_ptr<BaseType>&& funcType, Ident name, unique_ptr<BlockAST>&& block);
+    FuncDefAST(unique_ptr<BaseType>&& funcType, Ident name, ASTVector<unique_ptr<FuncFParamAST>>&& params, unique_ptr<BlockAST>&& block);
 
     void Codegen(CodeGen* cg);
 
     unique_ptr<BaseType> funcType;
-    string ident;
-    vector<unique_ptr<FuncFParamAST>> params;
+    SymbolId id = kNoSymbol;   // the interned name, set by the parser
+    ASTVector<unique_ptr<FuncFParamAST>> params;
     unique_ptr<BlockAST> block;
+    bool recursive = false;
+    // Reachable from a parallel loop body, so it may run on several threads.
+    bool concurrent = false;
+    // Reachable from `main` or a `used` function; no IR is emitted otherwise.
+    bool reachable = true;
+    // `__attribute__((...))` names, in source order.
+    ASTVector<SymbolId> attributes;
+    SourceLoc loc;
 };
 
-class BlockAST {
+class BlockAST : public ASTNode {
 public:
-    BlockAST(vector<unique_ptr<BlockItemAST>>&& items);
+    BlockAST(ASTVector<unique_ptr<BlockItemAST>>&& items);
     void Codegen(CodeGen* cg);
 
-    vector<unique_ptr<BlockItemAST>> items;
+    ASTVector<unique_ptr<BlockItemAST>> items;
+};
+
+// `#pragma` hints on a loop; zero means "not given".
+struct LoopHints {
+    int unroll = 0;        // unroll(N)
+    bool noUnroll = false; // nounroll
+    int vectorize = 0;     // vectorize(width)
+    int interleave = 0;    // interleave(N)
 };
 
-class StmtAST {
+class StmtAST : public ASTNode {
 public:
     enum class TYPE {
-        Assign, Expr, Block, If, Ret, While, For, Break, Continue
+        Assign, Expr, Block, If, Ret, While, For, Break, Continue, Switch
     };
 
     StmtAST(TYPE type);
@@ -109,8 +129,13 @@ public:
     StmtAST(TYPE type, unique_ptr<LValAST>&& lval, unique_ptr<ExprAST>&& expr);
     StmtAST(TYPE type, unique_ptr<ExprAST>&& cond, unique_ptr<StmtAST>&& thenStmt);
     StmtAST(TYPE type, unique_ptr<ExprAST>&& cond, unique_ptr<StmtAST>&& thenStmt, unique_ptr<StmtAST>&& elseStmt);
+    StmtAST(TYPE type, unique_ptr<ExprAST>&& expr, ASTVector<unique_ptr<CaseAST>>&& cases);
+    ~StmtAST();
 
     void Codegen(CodeGen* cg);
+    // Tag the back edges of a loop whose condition block is `header` with the
+    // hints; `entry` is the block that falls into the loop.
+    void AttachLoopHints(CodeGen* cg, llvm::BasicBlock* header, llvm::BasicBlock* entry);
 
     TYPE type;
     unique_ptr<LValAST> lval;
@@ -122,112 +147,73 @@ public:
     unique_ptr<DeclAST> forDecl;
     unique_ptr<StmtAST> forInitStmt;
     unique_ptr<StmtAST> forStepStmt;
+    // `parallel [reduction(+: ...)] for`: iterations may run concurrently.
+    bool parallel = false;
+    ASTVector<SymbolId> reductions;
+    LoopHints hints;
+    // `switch (expr)`: labels in source order, sharing one scope.
+    ASTVector<unique_ptr<CaseAST>> cases;
+    SourceLoc loc;
 };
 
-class ExprAST {
-public:
-    ExprAST(unique_ptr<LOrExprAST>&& lorExpr);
-
-    llvm::Value* ToValue(CodeGen* cg);
-    llvm::Value* ToNumber(CodeGen* cg);
-
-    unique_ptr<LOrExprAST> lorExpr;
-};
-
-class PrimaryExprAST {
-public:
-    enum class TYPE { Expr, LVal, Number, String };
-
-    PrimaryExprAST(TYPE type, unique_ptr<ExprAST>&& expr);
-    PrimaryExprAST(TYPE type, unique_ptr<LValAST>&& lval);
-    PrimaryExprAST(TYPE type, unique_ptr<NumberAST>&& value);
-    PrimaryExprAST(string strVal);
-
-    llvm::Value* ToValue(CodeGen* cg);
-    llvm::Value* ToNumber(CodeGen* cg);
-
-    TYPE type;
-    unique_ptr<ExprAST> expr;
-    unique_ptr<LValAST> lval;
-    unique_ptr<NumberAST> value;
-    string strVal;
-};
-
-class NumberAST {
-public:
-    NumberAST(int value);
-    llvm::Value* ToValue(CodeGen* cg);
-
-    int value;
-};
-
-class UnaryExprAST {
+// A `case value:` label (or `default:` when `value` is null) and the items
+// up to the next label; control falls through into the next label's items.
+class CaseAST : public ASTNode {
 public:
-    enum class TYPE { Primary, Unary, Call };
-    enum class OP { PLUS, MINUS, NOT };
-
-    UnaryExprAST(TYPE type, unique_ptr<PrimaryExprAST>&& primaryExpr);
-    UnaryExprAST(TYPE type, OP op, unique_ptr<UnaryExprAST>&& unaryExpr);
-    UnaryExprAST(TYPE type, string ident);
-    UnaryExprAST(TYPE type, string ident, vector<unique_ptr<ExprAST>>&& callArgs);
-
-    llvm::Value* ToValue(CodeGen* cg);
-    llvm::Value* ToNumber(CodeGen* cg);
+    CaseAST(ASTVector<unique_ptr<BlockItemAST>>&& items);
+    CaseAST(unique_ptr<ConstExprAST>&& value, ASTVector<unique_ptr<BlockItemAST>>&& items);
 
-    TYPE type;
-    OP op;
-    string ident;
-    unique_ptr<PrimaryExprAST> primaryExpr;
-    unique_ptr<UnaryExprAST> unaryExpr;
-    vector<unique_ptr<ExprAST>> callArgs;
+    unique_ptr<ConstExprAST> value;
+    ASTVector<unique_ptr<BlockItemAST>> items;
 };
 
-class BinaryExprAST {
+// Every expression is one node; `kind` says which of the fields below are in
+// use. Parentheses and unary `+` leave no node behind.
+class ExprAST : public ASTNode {
 public:
-    enum class Op {
-        ADD, SUB, MUL, DIV, MOD,
-        LT, GT, LE, GE, EQ, NE,
+    enum class Kind {
+        Number,                                 // value
+        String,                                 // id: the literal's contents, interned
+        LVal,                                   // lval
+        Call,                                   // id, args
+        Neg, Not, BitNot,                       // lhs
+        Add, Sub, Mul, Div, Mod,                // lhs, rhs
+        Lt, Gt, Le, Ge, Eq, Ne,
+        BitAnd, BitOr, Xor, Shl, Shr,
+        LAnd, LOr,                              // lhs, rhs; rhs only runs when needed
+        Cond,                                   // cond ? lhs : rhs
     };
 
-    BinaryExprAST(unique_ptr<UnaryExprAST>&& operand);
-    BinaryExprAST(Op op, unique_ptr<BinaryExprAST>&& lhs, unique_ptr<BinaryExprAST>&& rhs);
-
-    llvm::Value* ToValue(CodeGen* cg);
-    llvm::Value* ToNumber(CodeGen* cg);
-
-    Op op;
-    unique_ptr<UnaryExprAST> operand;
-    unique_ptr<BinaryExprAST> lhs;
-    unique_ptr<BinaryExprAST> rhs;
-};
-
-class LAndExprAST {
-public:
-    LAndExprAST(unique_ptr<BinaryExprAST>&& operand);
-    LAndExprAST(unique_ptr<LAndExprAST>&& left, unique_ptr<BinaryExprAST>&& right);
-
-    llvm::Value* ToValue(CodeGen* cg);
-    llvm::Value* ToNumber(CodeGen* cg);
-
-    unique_ptr<BinaryExprAST> operand;
-    unique_ptr<LAndExprAST> left;
-    unique_ptr<BinaryExprAST> right;
-};
-
-class LOrExprAST {
-public:
-    LOrExprAST(unique_ptr<LAndExprAST>&& operand);
-    LOrExprAST(unique_ptr<LOrExprAST>&& left, unique_ptr<LAndExprAST>&& right);
-
+    ExprAST(int value);
+    ExprAST(unique_ptr<LValAST>&& lval);
+    ExprAST(Kind kind, SymbolId literal);
+    ExprAST(Ident callee, ASTVector<unique_ptr<ExprAST>>&& args);
+    ExprAST(Kind kind, unique_ptr<ExprAST>&& operand);
+    ExprAST(Kind kind, unique_ptr<ExprAST>&& lhs, unique_ptr<ExprAST>&& rhs);
+    ExprAST(unique_ptr<ExprAST>&& cond, unique_ptr<ExprAST>&& thenExpr, unique_ptr<ExprAST>&& elseExpr);
+    ~ExprAST();
+
+    // Both evaluate with an explicit work stack, so operand chains of any
+    // depth are fine.
     llvm::Value* ToValue(CodeGen* cg);
     llvm::Value* ToNumber(CodeGen* cg);
-
-    unique_ptr<LAndExprAST> operand;
-    unique_ptr<LOrExprAST> left;
-    unique_ptr<LAndExprAST> right;
+    // A call to the `likely(x)` / `unlikely(x)` builtins, which evaluate to
+    // `x != 0`; a user function of the same name takes precedence.
+    bool IsBranchHint(CodeGen* cg) const;
+
+    Kind kind;
+    int value = 0;
+    SymbolId id = kNoSymbol;   // the interned callee or literal, set by the parser
+    // The expression can be evaluated even if the program would not have
+    // evaluated it: it makes no calls, divides by nothing, and loads no array
+    // elements, so it can neither fault nor have side effects.
+    bool speculatable = true;
+    unique_ptr<LValAST> lval;
+    unique_ptr<ExprAST> lhs, rhs, cond;
+    ASTVector<unique_ptr<ExprAST>> args;
 };
 
-class DeclAST {
+class DeclAST : public ASTNode {
 public:
     DeclAST(unique_ptr<ConstDeclAST>&& constDecl);
     DeclAST(unique_ptr<VarDeclAST>&& varDecl);
@@ -238,54 +224,54 @@ public:
     unique_ptr<VarDeclAST> varDecl;
 };
 
-class ConstDeclAST {
+class ConstDeclAST : public ASTNode {
 public:
-    ConstDeclAST(unique_ptr<BaseType>&& btype, vector<unique_ptr<ConstDefAST>>&& constDefs);
+    ConstDeclAST(unique_ptr<BaseType>&& btype, ASTVector<unique_ptr<ConstDefAST>>&& constDefs);
     void Codegen(CodeGen* cg);
 
     unique_ptr<BaseType> btype;
-    vector<unique_ptr<ConstDefAST>> constDefs;
+    ASTVector<unique_ptr<ConstDefAST>> constDefs;
 };
 
-class VarDeclAST {
+class VarDeclAST : public ASTNode {
 public:
-    VarDeclAST(unique_ptr<BaseType>&& btype, vector<unique_ptr<VarDefAST>>&& varDefs);
+    VarDeclAST(unique_ptr<BaseType>&& btype, ASTVector<unique_ptr<VarDefAST>>&& varDefs);
     void Codegen(CodeGen* cg);
 
     unique_ptr<BaseType> btype;
-    vector<unique_ptr<VarDefAST>> varDefs;
+    ASTVector<unique_ptr<VarDefAST>> varDefs;
 };
 
-class ConstInitValAST {
+class ConstInitValAST : public ASTNode {
 public:
     ConstInitValAST();
     ConstInitValAST(unique_ptr<ConstExprAST>&& expr);
-    ConstInitValAST(vector<unique_ptr<ConstExprAST>>&& constExprs);
-    ConstInitValAST(vector<unique_ptr<ConstInitValAST>>&& subVals);
+    ConstInitValAST(ASTVector<unique_ptr<ConstExprAST>>&& constExprs);
+    ConstInitValAST(ASTVector<unique_ptr<ConstInitValAST>>&& subVals);
 
     llvm::Value* ToNumber(CodeGen* cg);
 
     unique_ptr<ConstExprAST> expr;
-    vector<unique_ptr<ConstInitValAST>> subVals;
+    ASTVector<unique_ptr<ConstInitValAST>> subVals;
     bool isArray;
 };
 
-class InitValAST {
+class InitValAST : public ASTNode {
 public:
     InitValAST();
     InitValAST(unique_ptr<ExprAST>&& expr);
-    InitValAST(vector<unique_ptr<ExprAST>>&& exprs);
-    InitValAST(vector<unique_ptr<InitValAST>>&& subVals);
+    InitValAST(ASTVector<unique_ptr<ExprAST>>&& exprs);
+    InitValAST(ASTVector<unique_ptr<InitValAST>>&& subVals);
 
     llvm::Value* ToValue(CodeGen* cg, llvm::Value* addr);
     llvm::Value* ToNumber(CodeGen* cg, vector<int> shape, int dim);
 
     unique_ptr<ExprAST> expr;
-    vector<unique_ptr<InitValAST>> subVals;
+    ASTVector<unique_ptr<InitValAST>> subVals;
     bool isArray;
 };
 
-class BlockItemAST {
+class BlockItemAST : public ASTNode {
 public:
     BlockItemAST(unique_ptr<DeclAST>&& decl);
     BlockItemAST(unique_ptr<StmtAST>&& stmt);
@@ -294,12 +280,13 @@ public:
 
     unique_ptr<DeclAST> decl;
     unique_ptr<StmtAST> stmt;
+    SourceLoc loc;   // of `decl`; a statement carries its own
 };
 
-class LValAST {
+class LValAST : public ASTNode {
 public:
-    LValAST(string ident);
-    LValAST(string ident, vector<unique_ptr<ExprAST>>&& indies);
+    LValAST(Ident name);
+    LValAST(Ident name, ASTVector<unique_ptr<ExprAST>>&& indies);
 
     llvm::Value* ToValue(CodeGen* cg);
     llvm::Value* ToNumber(CodeGen* cg);
@@ -307,11 +294,11 @@ public:
     // Address of the l-value, also reporting the pointee element type via `elemOut`.
     llvm::Value* ToPointer(CodeGen* cg, llvm::Type*& elemOut);
 
-    string ident;
-    vector<unique_ptr<ExprAST>> indies;
+    SymbolId id = kNoSymbol;   // the interned name, set by the parser
+    ASTVector<unique_ptr<ExprAST>> indies;
 };
 
-class ConstExprAST {
+class ConstExprAST : public ASTNode {
 public:
     ConstExprAST(unique_ptr<ExprAST>&& expr);
 
@@ -322,21 +309,21 @@ public:
     unique_ptr<ExprAST> expr;
 };
 
-class FuncFParamAST {
+class FuncFParamAST : public ASTNode {
 public:
-    FuncFParamAST(unique_ptr<BaseType>&& btype, string ident, bool isArray = false);
-    FuncFParamAST(unique_ptr<BaseType>&& btype, string ident, vector<unique_ptr<ConstExprAST>>&& sizeExprs);
+    FuncFParamAST(unique_ptr<BaseType>&& btype, Ident name, bool isArray = false);
+    FuncFParamAST(unique_ptr<BaseType>&& btype, Ident name, ASTVector<unique_ptr<ConstExprAST>>&& sizeExprs);
 
     llvm::Type* ToType(CodeGen* cg);
     llvm::Value* Alloca(CodeGen* cg, llvm::Type* type);
 
     unique_ptr<BaseType> btype;
-    string ident;
-    vector<unique_ptr<ConstExprAST>> sizeExprs;
+    SymbolId id = kNoSymbol;   // the interned name, set by the parser
+    ASTVector<unique_ptr<ConstExprAST>> sizeExprs;
     bool isArray;
 };
 
-class FuncRParamAST {
+class FuncRParamAST : public ASTNode {
 public:
     FuncRParamAST(unique_ptr<ExprAST>&& expr);
     llvm::Value* ToValue(CodeGen* cg);
@@ -0,0 +1,427 @@
+#include "ast/eval.h"
+#include "ast/analysis.h"
+#include "ast/init.h"
+#include "ir/codegen.h"
+
+#include <cstdint>
+
+namespace {
+
+// Wrap-around int32 arithmetic, as the generated code would compute it.
+int Wrap(int64_t v) { return (int)(uint32_t)v; }
+
+} // anonymous namespace
+
+ConstEval::ConstEval(const CompUnitAST& unit) {
+    for (auto& funcDef : unit.funcDefs) funcs[funcDef->id] = funcDef.get();
+}
+
+ConstEval::~ConstEval() = default;
+
+int ConstEval::EvalCall(CodeGen* cg, ExprAST* call) {
+    this->cg = cg;
+    frames.clear();
+    steps = 0;
+    failed = false;
+    error.clear();
+
+    int result = Call(call);
+    if (failed) {
+        cg->Error("cannot evaluate '" + cg->Name(call->id) + "(...)' at compile time: " + error);
+        return 0;
+    }
+    return result;
+}
+
+bool ConstEval::Fail(const string& reason) {
+    if (!failed) {
+        failed = true;
+        error = reason;
+    }
+    return false;
+}
+
+bool ConstEval::Tick() {
+    if (failed) return false;
+    if (++steps > kMaxSteps) return Fail("step limit exceeded");
+    return true;
+}
+
+// --- Name resolution ---
+
+ConstEval::Var* ConstEval::Lookup(SymbolId name) {
+    if (!frames.empty()) {
+        auto& scopes = frames.back().scopes;
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            auto found = it->find(name);
+            if (found != it->end()) return &found->second;
+        }
+    }
+    return FromSymbol(name, !frames.empty());
+}
+
+ConstEval::Var* ConstEval::FromSymbol(SymbolId name, bool globalOnly) {
+    auto cached = globals.find(name);
+    auto global = cg->GetGlobalSymbol(name);
+    auto sym = globalOnly ? global : cg->GetSymbol(name);
+    bool isGlobal = sym.value && sym.value == global.value;
+    if (isGlobal && cached != globals.end()) return &cached->second;
+
+    if (!sym.value) {
+        Fail("'" + cg->Name(name) + "' is not visible here");
+        return nullptr;
+    }
+    if (sym.kind != VAR_TYPE::CONST) {
+        Fail("reads mutable variable '" + cg->Name(name) + "'");
+        return nullptr;
+    }
+
+    Var var;
+    var.isConst = true;
+    var.isChar = cg->PeelArray(sym.type, 1 << 16) == cg->GetInt8Type();
+    if (cg->IsArrayType(sym.type)) {
+        if (!isGlobal) {
+            Fail("reads local array '" + cg->Name(name) + "'");
+            return nullptr;
+        }
+        var.storage = std::make_shared<Array>();
+        var.storage->data = cg->FlattenConstant(sym.value);
+        var.array = var.storage.get();
+        var.dims = cg->GetArrayDims(sym.type);
+    } else {
+        auto flat = cg->FlattenConstant(sym.value);
+        if (flat.size() != 1) {
+            Fail("'" + cg->Name(name) + "' has no constant value");
+            return nullptr;
+        }
+        var.value = flat[0];
+    }
+
+    if (isGlobal) return &(globals[name] = std::move(var));
+    outerScratch = std::move(var);
+    return &outerScratch;
+}
+
+// --- Expressions ---
+
+int ConstEval::Eval(ExprAST* expr) {
+    using Kind = ExprAST::Kind;
+    switch (expr->kind) {
+    case Kind::Number: return expr->value;
+    case Kind::String: return Fail("string literal in constant expression"), 0;
+    case Kind::LVal:   return Eval(expr->lval.get());
+    case Kind::Call:   return Call(expr);
+    case Kind::Neg:    return Wrap(-(int64_t)Eval(expr->lhs.get()));
+    case Kind::Not:    return Eval(expr->lhs.get()) == 0;
+    case Kind::BitNot: return ~Eval(expr->lhs.get());
+    case Kind::LAnd:   return Eval(expr->lhs.get()) && Eval(expr->rhs.get());
+    case Kind::LOr:    return Eval(expr->lhs.get()) || Eval(expr->rhs.get());
+    case Kind::Cond:   return Eval(Eval(expr->cond.get()) ? expr->lhs.get() : expr->rhs.get());
+    default:           break;
+    }
+
+    int64_t l = Eval(expr->lhs.get()), r = Eval(expr->rhs.get());
+    if (failed) return 0;
+    switch (expr->kind) {
+    case Kind::Add: return Wrap(l + r);
+    case Kind::Sub: return Wrap(l - r);
+    case Kind::Mul: return Wrap(l * r);
+    case Kind::Div:
+    case Kind::Mod:
+        if (r == 0) return Fail("division by zero"), 0;
+        if (l == INT32_MIN && r == -1) return Fail("signed division overflow"), 0;
+        return expr->kind == Kind::Div ? l / r : l % r;
+    case Kind::Lt: return l < r;
+    case Kind::Gt: return l > r;
+    case Kind::Le: return l <= r;
+    case Kind::Ge: return l >= r;
+    case Kind::Eq: return l == r;
+    case Kind::Ne: return l != r;
+    case Kind::BitAnd: return l & r;
+    case Kind::BitOr:  return l | r;
+    case Kind::Xor:    return l ^ r;
+    // Shift counts are taken mod 32, as the generated code does.
+    case Kind::Shl: return Wrap((int64_t)(uint32_t)l << (r & 31));
+    case Kind::Shr: return (int)l >> (r & 31);
+    default:
+        return 0;
+    }
+}
+
+int ConstEval::Eval(ConstExprAST* expr) { return Eval(expr->expr.get()); }
+
+int ConstEval::Eval(LValAST* lval) {
+    Var* var;
+    int offset;
+    bool indexed;
+    if (!Locate(lval, var, offset, indexed)) return 0;
+    return indexed ? var->array->data[offset] : var->value;
+}
+
+bool ConstEval::Locate(LValAST* lval, Var*& var, int& offset, bool& indexed) {
+    var = Lookup(lval->id);
+    if (!var) return false;
+
+    indexed = var->array != nullptr;
+    offset = var->base;
+    if (!indexed) {
+        if (!lval->indies.empty()) return Fail("subscript of scalar '" + cg->Name(lval->id) + "'");
+        return true;
+    }
+    if (lval->indies.size() != var->dims.size())
+        return Fail("array '" + cg->Name(lval->id) + "' used as a scalar");
+
+    int stride = 1;
+    for (int i = (int)var->dims.size() - 1; i >= 0; --i) {
+        int index = Eval(lval->indies[i].get());
+        if (failed) return false;
+        if (index < 0 || (var->dims[i] && index >= var->dims[i]))
+            return Fail("index out of bounds on '" + cg->Name(lval->id) + "'");
+        offset += index * stride;
+        stride *= var->dims[i];
+    }
+    if (offset < 0 || offset >= (int)var->array->data.size())
+        return Fail("index out of bounds on '" + cg->Name(lval->id) + "'");
+    return true;
+}
+
+// Bind an array argument: `arg` must name an array (or a sub-array of one);
+// the callee indexes it with its own parameter dimensions `dims`.
+bool ConstEval::View(ExprAST* arg, const vector<int>& dims, Var& out) {
+    auto* lval = AsLVal(arg);
+    Var* var = lval ? Lookup(lval->id) : nullptr;
+    if (!var || !var->array) return Fail("array argument is not an array");
+    if (lval->indies.size() >= var->dims.size()) return Fail("array argument is not an array");
+
+    int offset = var->base, stride = 1;
+    for (size_t i = lval->indies.size(); i < var->dims.size(); ++i) stride *= var->dims[i];
+    for (int i = (int)lval->indies.size() - 1; i >= 0; --i) {
+        int index = Eval(lval->indies[i].get());
+        if (failed) return false;
+        offset += index * stride;
+        stride *= var->dims[i];
+    }
+    if (offset < 0 || offset > (int)var->array->data.size())
+        return Fail("index out of bounds on '" + cg->Name(lval->id) + "'");
+
+    out.array = var->array;
+    out.storage = var->storage;
+    out.isChar = var->isChar;
+    out.isConst = var->isConst;
+    out.base = offset;
+    out.dims = dims;
+    return true;
+}
+
+void ConstEval::Store(Var* var, int offset, bool indexed, int value) {
+    if (var->isConst) {
+        Fail("assignment to a constant");
+        return;
+    }
+    if (var->isChar) value = (int8_t)value;
+    if (indexed) var->array->data[offset] = value;
+    else var->value = value;
+}
+
+int ConstEval::Call(ExprAST* call) {
+    if (!Tick()) return 0;
+    if (call->IsBranchHint(cg)) {
+        if (call->args.size() != 1) return Fail("'" + cg->Name(call->id) + "' takes exactly one argument"), 0;
+        return Eval(call->args[0].get()) != 0;
+    }
+    auto found = funcs.find(call->id);
+    if (found == funcs.end()) return Fail("calls '" + cg->Name(call->id) + "', which is not a user function"), 0;
+    const FuncDefAST* func = found->second;
+    if (func->funcType->GetType() == BaseType::TYPE::VOID)
+        return Fail("'" + cg->Name(call->id) + "' returns void"), 0;
+    if (func->params.size() != call->args.size())
+        return Fail("wrong number of arguments to '" + cg->Name(call->id) + "'"), 0;
+    if ((int)frames.size() >= kMaxDepth) return Fail("recursion limit exceeded"), 0;
+
+    // Bind arguments in the caller's frame before pushing the callee's.
+    Scope params;
+    vector<int> scalars;
+    bool pure = true;
+    for (size_t i = 0; i < func->params.size(); ++i) {
+        auto& param = func->params[i];
+        Var var;
+        var.isChar = param->btype->GetType() == BaseType::TYPE::CHAR;
+        if (param->isArray) {
+            vector<int> dims{0};
+            for (auto& sizeExpr : param->sizeExprs) dims.push_back(sizeExpr->ToInteger(cg));
+            if (!View(call->args[i].get(), dims, var)) return 0;
+            var.isChar = param->btype->GetType() == BaseType::TYPE::CHAR;
+            pure = false;
+        } else {
+            int value = Eval(call->args[i].get());
+            if (failed) return 0;
+            var.value = var.isChar ? (int8_t)value : value;
+            scalars.push_back(var.value);
+        }
+        params[param->id] = std::move(var);
+    }
+
+    // A call that only takes scalars cannot observe or change caller state,
+    // so its result is reusable.
+    auto key = std::make_pair(func, scalars);
+    if (pure) {
+        auto hit = memo.find(key);
+        if (hit != memo.end()) return hit->second;
+    }
+
+    frames.push_back({});
+    frames.back().scopes.push_back(std::move(params));
+    Flow flow = Exec(func->block.get());
+    int result = frames.back().ret;
+    frames.pop_back();
+    if (failed) return 0;
+    if (flow != Flow::Return) return Fail("'" + cg->Name(call->id) + "' does not return a value"), 0;
+
+    if (func->funcType->GetType() == BaseType::TYPE::CHAR) result = (int8_t)result;
+    if (pure) memo[key] = result;
+    return result;
+}
+
+// --- Statements ---
+
+ConstEval::Flow ConstEval::Exec(BlockAST* block) {
+    auto& scopes = frames.back().scopes;
+    scopes.push_back({});
+    Flow flow = Flow::Next;
+    for (auto& item : block->items) {
+        if (item->decl) Declare(item->decl.get());
+        else flow = Exec(item->stmt.get());
+        if (failed || flow != Flow::Next) break;
+    }
+    frames.back().scopes.pop_back();
+    return flow;
+}
+
+ConstEval::Flow ConstEval::Exec(StmtAST* stmt) {
+    if (!Tick()) return Flow::Return;
+    switch (stmt->type) {
+    case StmtAST::TYPE::Assign: {
+        Var* var;
+        int offset;
+        bool indexed;
+        if (!Locate(stmt->lval.get(), var, offset, indexed)) return Flow::Return;
+        int value = Eval(stmt->expr.get());
+        if (!failed) Store(var, offset, indexed, value);
+        break;
+    }
+    case StmtAST::TYPE::Expr:
+        if (stmt->expr) Eval(stmt->expr.get());
+        break;
+    case StmtAST::TYPE::Block:
+        return Exec(stmt->block.get());
+    case StmtAST::TYPE::If:
+        if (Eval(stmt->cond.get())) return Exec(stmt->thenStmt.get());
+        if (stmt->elseStmt && !failed) return Exec(stmt->elseStmt.get());
+        break;
+    case StmtAST::TYPE::Ret:
+        if (stmt->expr) frames.back().ret = Eval(stmt->expr.get());
+        return Flow::Return;
+    case StmtAST::TYPE::While:
+        while (Tick() && Eval(stmt->cond.get()) && !failed) {
+            Flow flow = Exec(stmt->thenStmt.get());
+            if (flow == Flow::Break) break;
+            if (flow == Flow::Return) return flow;
+        }
+        break;
+    case StmtAST::TYPE::For: {
+        frames.back().scopes.push_back({});
+        if (stmt->forDecl) Declare(stmt->forDecl.get());
+        else if (stmt->forInitStmt) Exec(stmt->forInitStmt.get());
+        Flow result = Flow::Next;
+        while (Tick() && (!stmt->cond || Eval(stmt->cond.get())) && !failed) {
+            Flow flow = Exec(stmt->thenStmt.get());
+            if (flow == Flow::Break) break;
+            if (flow == Flow::Return) {
+                result = flow;
+                break;
+            }
+            if (stmt->forStepStmt) Exec(stmt->forStepStmt.get());
+        }
+        frames.back().scopes.pop_back();
+        return result;
+    }
+    case StmtAST::TYPE::Switch: {
+        int value = Eval(stmt->expr.get());
+        if (failed) return Flow::Return;
+        size_t start = stmt->cases.size();
+        for (size_t i = 0; i < stmt->cases.size(); ++i) {
+            auto& label = stmt->cases[i]->value;
+            if (label ? Eval(label.get()) == value : start == stmt->cases.size()) {
+                start = i;
+                if (label) break;
+            }
+        }
+        frames.back().scopes.push_back({});
+        Flow flow = Flow::Next;
+        for (size_t i = start; i < stmt->cases.size() && flow == Flow::Next && !failed; ++i) {
+            for (auto& item : stmt->cases[i]->items) {
+                if (item->decl) Declare(item->decl.get());
+                else flow = Exec(item->stmt.get());
+                if (failed || flow != Flow::Next) break;
+            }
+        }
+        frames.back().scopes.pop_back();
+        return flow == Flow::Break ? Flow::Next : flow;
+    }
+    case StmtAST::TYPE::Break:
+        return Flow::Break;
+    case StmtAST::TYPE::Continue:
+        return Flow::Continue;
+    }
+    return failed ? Flow::Return : Flow::Next;
+}
+
+void ConstEval::Declare(DeclAST* decl) {
+    if (decl->constDecl) {
+        bool isChar = decl->constDecl->btype->GetType() == BaseType::TYPE::CHAR;
+        for (auto& def : decl->constDecl->constDefs) Define(def.get(), def->initVal, isChar, true);
+    } else {
+        bool isChar = decl->varDecl->btype->GetType() == BaseType::TYPE::CHAR;
+        for (auto& def : decl->varDecl->varDefs) Define(def.get(), def->initVal, isChar, false);
+    }
+}
+
+template<typename Def, typename Init>
+void ConstEval::Define(Def* def, Init& initVal, bool isChar, bool isConst) {
+    Var var;
+    var.isChar = isChar;
+    var.isConst = isConst;
+
+    if (def->sizeExprs.empty()) {
+        if (initVal) var.value = Eval(initVal->expr.get());
+        if (isChar) var.value = (int8_t)var.value;
+    } else {
+        long total = 1;
+        for (auto& sizeExpr : def->sizeExprs) {
+            int dim = Eval(sizeExpr.get());
+            if (failed) return;
+            if (dim <= 0) {
+                Fail("array '" + cg->Name(def->id) + "' has non-positive size");
+                return;
+            }
+            total *= dim;
+            if (total > kMaxArrayElements) {
+                Fail("array '" + cg->Name(def->id) + "' is too large");
+                return;
+            }
+            var.dims.push_back(dim);
+        }
+
+        var.storage = std::make_shared<Array>();
+        if (initVal) {
+            vector<int> shape = var.dims;
+            shape.push_back(0);
+            FlattenInitList(var.storage->data, shape, 0, initVal,
+                            [this](auto& expr) { return Eval(expr.get()); }, 0);
+            for (auto& v : var.storage->data) if (isChar) v = (int8_t)v;
+        }
+        var.storage->data.resize(total);
+        var.array = var.storage.get();
+    }
+    if (!failed) frames.back().scopes.back()[def->id] = std::move(var);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+
+// Compile-time interpreter for calls that appear in constant contexts
+// (`const int N = fact(5);`, array dimensions, global initializers).
+//
+// Only pure calls fold: the callee may read its parameters, its own locals
+// and global constants, and call other user functions under the same rules.
+// Reading or writing a mutable global, calling a builtin (printf/scanf) or
+// exceeding the step/recursion limits makes the call non-constant.
+class ConstEval {
+public:
+    static constexpr long kMaxSteps = 4000000;
+    static constexpr int kMaxDepth = 512;
+    static constexpr long kMaxArrayElements = 1 << 24;
+
+    explicit ConstEval(const CompUnitAST& unit);
+    ~ConstEval();
+
+    // Fold a call expression to its integer result (limits apply per call).
+    // On failure the reason is reported through `CodeGen::Error` and 0 is
+    // returned.
+    int EvalCall(CodeGen* cg, ExprAST* call);
+
+private:
+    struct Array {
+        vector<int> data;
+    };
+
+    // A name binding inside the interpreter: either a scalar, or a view into
+    // an array. `dims` drive the index arithmetic; for a decayed parameter the
+    // leading dimension is 0 (unknown), matching `int a[][N]`.
+    struct Var {
+        int value = 0;
+        bool isChar = false;
+        bool isConst = false;
+        Array* array = nullptr;
+        int base = 0;
+        vector<int> dims;
+        std::shared_ptr<Array> storage;
+    };
+
+    using Scope = std::map<SymbolId, Var>;
+    enum class Flow { Next, Break, Continue, Return };
+
+    struct Frame {
+        vector<Scope> scopes;
+        int ret = 0;
+    };
+
+    bool Fail(const string& reason);
+    bool Tick();
+
+    // Name resolution: innermost frame first, then the caller's constants
+    // (at the top level) or global constants (inside an interpreted call).
+    Var* Lookup(SymbolId name);
+    Var* FromSymbol(SymbolId name, bool globalOnly);
+
+    // Expressions. Each returns 0 once `failed` is set; callers check it.
+    int Eval(ExprAST* expr);
+    int Eval(ConstExprAST* expr);
+    int Eval(LValAST* lval);
+    int Call(ExprAST* call);
+
+    // Resolve an l-value to a scalar slot (`*slot`) or an array element
+    // (`var->array->data[offset]`). `indexed` reports which one was found.
+    bool Locate(LValAST* lval, Var*& var, int& offset, bool& indexed);
+    bool View(ExprAST* arg, const vector<int>& dims, Var& out);
+    void Store(Var* var, int offset, bool indexed, int value);
+
+    Flow Exec(StmtAST* stmt);
+    Flow Exec(BlockAST* block);
+    void Declare(DeclAST* decl);
+    template<typename Def, typename Init>
+    void Define(Def* def, Init& initVal, bool isChar, bool isConst);
+
+    std::map<SymbolId, const FuncDefAST*> funcs;
+    std::map<std::pair<const FuncDefAST*, vector<int>>, int> memo;
+    std::map<SymbolId, Var> globals;
+    Var outerScratch;
+
+    CodeGen* cg = nullptr;
+    vector<Frame> frames;
+    long steps = 0;
+    bool failed = false;
+    string error;
+};
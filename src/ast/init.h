@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+// Flatten a (possibly nested) brace initializer into row-major order.
+// `shape` holds the array dimensions followed by a trailing 0 sentinel.
+// Each scalar leaf is produced by `leaf(initVal->expr)`, and every brace
+// level is padded with `zero` up to the size of the sub-array it starts.
+template<typename V, typename T, typename Leaf>
+void FlattenInitList(std::vector<V>& flatValues, const std::vector<int>& shape, int dim,
+                     T& initVal, const Leaf& leaf, const V& zero) {
+    if (!initVal->isArray) {
+        flatValues.push_back(leaf(initVal->expr));
+        return;
+    }
+
+    int startIndex = flatValues.size();
+    int totalElements = 1;
+    for (int i = shape.size() - 2; i >= dim; i--) {
+        if (startIndex % (totalElements * shape[i]) == 0) {
+            totalElements *= shape[i];
+        }
+    }
+
+    for (auto& val : initVal->subVals) {
+        FlattenInitList(flatValues, shape, dim + 1, val, leaf, zero);
+    }
+
+    int filledElements = flatValues.size() - startIndex;
+    if (filledElements < totalElements) {
+        for (int i = filledElements; i < totalElements; i++) {
+            flatValues.push_back(zero);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#include "ast/node.h"
+#include "util/arena.h"
+
+namespace {
+
+thread_local Arena* current = nullptr;
+
+Arena& Current() {
+    if (current) return *current;
+    static Arena fallback;
+    return fallback;
+}
+
+} // anonymous namespace
+
+void* ASTNode::operator new(size_t size) {
+    return Current().Allocate(size);
+}
+
+void* AllocateAST(size_t size, size_t align) {
+    return Current().Allocate(size, align);
+}
+
+ASTArenaScope::ASTArenaScope(Arena& arena) : previous(current) {
+    current = &arena;
+}
+
+ASTArenaScope::~ASTArenaScope() {
+    current = previous;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class Arena;
+
+// Base of every AST node. Nodes are carved from the arena made current by an
+// ASTArenaScope, so a parse leaves the tree packed in a few large blocks in
+// creation order. `delete` only runs destructors; the memory itself goes
+// back when the arena is destroyed.
+struct ASTNode {
+    static void* operator new(size_t size);
+    static void operator delete(void*) {}
+};
+
+// `size` bytes from the current AST arena.
+void* AllocateAST(size_t size, size_t align);
+
+// Lets a node's lists live in the arena next to it. Buffers a list outgrows
+// stay where they are until the arena goes away.
+template<typename T>
+struct ASTAllocator {
+    using value_type = T;
+
+    ASTAllocator() = default;
+    template<typename U> ASTAllocator(const ASTAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(AllocateAST(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template<typename U> bool operator==(const ASTAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const ASTAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using ASTVector = std::vector<T, ASTAllocator<T>>;
+
+// Makes `arena` the one new nodes are allocated from until the scope ends.
+// Nodes created with no scope active come from an arena that lives until
+// exit.
+class ASTArenaScope {
+public:
+    explicit ASTArenaScope(Arena& arena);
+    ~ASTArenaScope();
+    ASTArenaScope(const ASTArenaScope&) = delete;
+    ASTArenaScope& operator=(const ASTArenaScope&) = delete;
+
+private:
+    Arena* previous;
+};
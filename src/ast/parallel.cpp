@@ -0,0 +1,267 @@
+#include "ast/parallel.h"
+#include "ast/analysis.h"
+#include "ast/walk.h"
+#include "ir/codegen.h"
+
+#include <set>
+
+namespace {
+
+// `for (i = lo; i < hi; i = i + step)`; `inclusive` for `i <= hi`.
+struct CanonicalLoop {
+    SymbolId var = kNoSymbol;
+    llvm::Type* varType = nullptr;
+    bool declared = false;   // `int i = lo` in the header, so no value survives the loop
+    ExprAST* lo = nullptr;
+    ExprAST* hi = nullptr;
+    bool inclusive = false;
+    int step = 1;
+};
+
+class NameCollector : public ASTWalker {
+public:
+    explicit NameCollector(std::set<SymbolId>& names) : names(names) {}
+    void OnRead(LValAST* lval) override { names.insert(lval->id); }
+    void OnWrite(LValAST* lval) override { names.insert(lval->id); }
+
+private:
+    std::set<SymbolId>& names;
+};
+
+class WriteFinder : public ASTWalker {
+public:
+    explicit WriteFinder(SymbolId name) : name(name) {}
+    void OnWrite(LValAST* lval) override { found = found || lval->id == name; }
+
+    bool found = false;
+
+private:
+    SymbolId name;
+};
+
+bool Reject(string& why, const string& reason) {
+    why = reason;
+    return false;
+}
+
+bool MatchLoop(CodeGen* cg, StmtAST* loop, CanonicalLoop& out, string& why) {
+    if (loop->forDecl) {
+        auto* varDecl = loop->forDecl->varDecl.get();
+        if (!varDecl || varDecl->varDefs.size() != 1)
+            return Reject(why, "the header must declare a single induction variable");
+        auto* def = varDecl->varDefs[0].get();
+        if (!def->sizeExprs.empty() || !def->initVal || def->initVal->isArray)
+            return Reject(why, "the induction variable must be an initialized scalar");
+        out.var = def->id;
+        out.varType = varDecl->btype->Codegen(cg);
+        out.declared = true;
+        out.lo = def->initVal->expr.get();
+    } else if (loop->forInitStmt && loop->forInitStmt->type == StmtAST::TYPE::Assign
+               && loop->forInitStmt->lval->indies.empty()) {
+        auto sym = cg->GetSymbol(loop->forInitStmt->lval->id);
+        if (!sym.value || sym.kind == VAR_TYPE::CONST || sym.pointerParam || cg->IsArrayType(sym.type))
+            return Reject(why, "the induction variable must be a scalar variable");
+        out.var = loop->forInitStmt->lval->id;
+        out.varType = sym.type;
+        out.lo = loop->forInitStmt->expr.get();
+    } else {
+        return Reject(why, "the header must initialize an induction variable");
+    }
+
+    using Kind = ExprAST::Kind;
+    auto& var = cg->Name(out.var);
+    auto* cmp = loop->cond.get();
+    if (!cmp || (cmp->kind != Kind::Lt && cmp->kind != Kind::Le))
+        return Reject(why, "the condition must be `" + var + " < bound` or `" + var + " <= bound`");
+    auto* bound = AsLVal(cmp->lhs.get());
+    if (!bound || bound->id != out.var || !bound->indies.empty())
+        return Reject(why, "the condition must compare the induction variable");
+    out.hi = cmp->rhs.get();
+    out.inclusive = cmp->kind == Kind::Le;
+
+    auto* step = loop->forStepStmt.get();
+    auto* add = step && step->type == StmtAST::TYPE::Assign && step->lval->id == out.var
+                && step->lval->indies.empty() ? step->expr.get() : nullptr;
+    auto* self = add && add->kind == Kind::Add ? AsLVal(add->lhs.get()) : nullptr;
+    auto* stride = self && add->rhs->kind == Kind::Number ? add->rhs.get() : nullptr;
+    if (!stride || self->id != out.var || !self->indies.empty() || stride->value <= 0)
+        return Reject(why, "the step must be `" + var + " = " + var + " + <positive constant>`");
+    out.step = stride->value;
+    return true;
+}
+
+// The first statement that would leave the loop from inside an iteration:
+// any `return`, or a `break` that is not nested in an inner loop.
+const char* FindEscape(StmtAST* stmt, bool innerLoop) {
+    if (!stmt) return nullptr;
+    switch (stmt->type) {
+    case StmtAST::TYPE::Ret:   return "return";
+    case StmtAST::TYPE::Break: return innerLoop ? nullptr : "break";
+    case StmtAST::TYPE::Block:
+        for (auto& item : stmt->block->items)
+            if (auto* found = FindEscape(item->stmt.get(), innerLoop)) return found;
+        return nullptr;
+    case StmtAST::TYPE::If: {
+        auto* found = FindEscape(stmt->thenStmt.get(), innerLoop);
+        return found ? found : FindEscape(stmt->elseStmt.get(), innerLoop);
+    }
+    case StmtAST::TYPE::While:
+    case StmtAST::TYPE::For:
+        return FindEscape(stmt->thenStmt.get(), true);
+    case StmtAST::TYPE::Switch:
+        // `break` leaves the switch, but `continue` and `return` pass through.
+        for (auto& label : stmt->cases)
+            for (auto& item : label->items)
+                if (auto* found = FindEscape(item->stmt.get(), true)) return found;
+        return nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+// Where a reduction's partial sum is folded in, and the private slot that
+// accumulates it inside a chunk.
+struct Reduction {
+    SymbolId name;
+    CodeGen::Symbol shared;
+    llvm::Value* local = nullptr;
+};
+
+} // anonymous namespace
+
+bool EmitParallelFor(CodeGen* cg, StmtAST* loop) {
+    CanonicalLoop shape;
+    string why;
+    if (MatchLoop(cg, loop, shape, why)) {
+        if (auto* escape = FindEscape(loop->thenStmt.get(), false))
+            why = string("the body contains `") + escape + "`";
+        else {
+            WriteFinder writes(shape.var);
+            writes.Walk(loop->thenStmt.get());
+            if (writes.found) why = "the body assigns the induction variable";
+        }
+    }
+    if (!why.empty()) {
+        cg->Warning("parallel loop runs serially: " + why);
+        return false;
+    }
+
+    std::vector<Reduction> reductions;
+    for (auto name : loop->reductions) {
+        auto sym = cg->GetSymbol(name);
+        if (!sym.value || sym.kind == VAR_TYPE::CONST || sym.pointerParam
+            || cg->IsArrayType(sym.type) || name == shape.var) {
+            cg->Error("reduction variable '" + cg->Name(name) + "' must be a scalar variable");
+            return false;
+        }
+        reductions.push_back({name, sym});
+    }
+
+    // Locals the body refers to are reached through `ctx`; constants and
+    // globals are visible from the outlined function as they are.
+    std::set<SymbolId> names;
+    NameCollector(names).Walk(loop->thenStmt.get());
+    for (auto& reduction : reductions) names.insert(reduction.name);
+    std::vector<std::pair<SymbolId, CodeGen::Symbol>> captures;
+    for (auto name : names) {
+        auto sym = cg->GetSymbol(name);
+        if (name == shape.var || !sym.value || llvm::isa<llvm::Constant>(sym.value)) continue;
+        captures.push_back({name, sym});
+    }
+
+    auto* intType = cg->GetInt32Type();
+    auto* ptrType = cg->GetPointerType(cg->GetInt8Type());
+    auto* ctxType = cg->GetArrayType(ptrType, (int)captures.size() + 1);
+    auto slotOf = [&](llvm::Value* ctx, size_t index) {
+        return cg->CreateGEP(ctxType, ctx, {cg->GetInt32(0), cg->GetInt32((int)index)});
+    };
+
+    // Bounds are evaluated once, before any iteration runs.
+    auto* lo = shape.lo->ToValue(cg);
+    auto* hi = shape.hi->ToValue(cg);
+    auto* span = cg->CreateSub(hi, lo);
+    auto* last = shape.inclusive ? span : cg->CreateSub(span, cg->GetInt32(1));
+    auto* count = cg->CreateAdd(cg->CreateDiv(last, cg->GetInt32(shape.step)), cg->GetInt32(1));
+    auto* any = shape.inclusive ? cg->CreateICmpLE(lo, hi) : cg->CreateICmpLT(lo, hi);
+    count = cg->CreateSelect(any, count, cg->GetInt32(0));
+
+    auto* ctx = cg->CreateAlloca(ctxType, "par.ctx");
+    auto* loSlot = cg->CreateAlloca(intType, "par.lo");
+    cg->CreateStore(lo, loSlot);
+    cg->CreateStore(loSlot, slotOf(ctx, 0));
+    for (size_t i = 0; i < captures.size(); ++i)
+        cg->CreateStore(captures[i].second.value, slotOf(ctx, i + 1));
+
+    // Outline the body. Static local arrays would be shared by all threads.
+    auto* parent = cg->GetInsertBlock();
+    bool staticLocals = cg->GetStaticLocalsAllowed();
+    auto* bodyType = cg->CreateFuncType(cg->GetVoidType(), {ptrType, intType, intType});
+    auto* body = cg->CreateHelperFunction(bodyType, cg->GetFunction()->getName().str() + ".parallel");
+    cg->SetStaticLocalsAllowed(false);
+    cg->SetInsertPoint(cg->CreateBasicBlock("entry", body));
+    cg->EnterScope();
+
+    auto* ctxArg = cg->GetFunctionArg(0);
+    for (size_t i = 0; i < captures.size(); ++i) {
+        auto sym = captures[i].second;
+        sym.value = cg->LoadPointer(slotOf(ctxArg, i + 1));
+        cg->AddSymbol(captures[i].first, sym);
+        for (auto& reduction : reductions)
+            if (reduction.name == captures[i].first) reduction.shared.value = sym.value;
+    }
+    auto* base = cg->CreateLoadInt(cg->LoadPointer(slotOf(ctxArg, 0)), intType);
+    for (auto& reduction : reductions) {
+        auto* type = reduction.shared.type;
+        reduction.local = cg->CreateAlloca(type, cg->Name(reduction.name));
+        cg->StoreScalar(cg->GetInt32(0), reduction.local, type);
+        cg->AddSymbol(reduction.name, {.value = reduction.local, .kind = VAR_TYPE::VAR, .type = type});
+    }
+    auto* var = cg->CreateAlloca(shape.varType, cg->Name(shape.var));
+    cg->AddSymbol(shape.var, {.value = var, .kind = VAR_TYPE::VAR, .type = shape.varType});
+    auto* index = cg->CreateAlloca(intType, "par.idx");
+    cg->CreateStore(cg->GetFunctionArg(1), index);
+
+    auto* condBB = cg->CreateBasicBlock("par_cond", body);
+    auto* bodyBB = cg->CreateBasicBlock("par_body", body);
+    auto* stepBB = cg->CreateBasicBlock("par_step", body);
+    auto* endBB = cg->CreateBasicBlock("par_end", body);
+
+    auto* entryBB = cg->GetInsertBlock();
+    cg->CreateBr(condBB);
+    cg->SetInsertPoint(condBB);
+    cg->CreateCondBr(cg->CreateICmpLT(cg->CreateLoad(index), cg->GetFunctionArg(2)), bodyBB, endBB);
+
+    cg->SetInsertPoint(bodyBB);
+    auto* offset = cg->CreateMul(cg->CreateLoad(index), cg->GetInt32(shape.step));
+    cg->StoreScalar(cg->CreateAdd(base, offset), var, shape.varType);
+    cg->EnterWhile(stepBB, endBB);
+    loop->thenStmt->Codegen(cg);
+    cg->ExitWhile();
+    if (!cg->EndWithTerminator()) cg->CreateBr(stepBB);
+
+    cg->SetInsertPoint(stepBB);
+    cg->CreateStore(cg->CreateAdd(cg->CreateLoad(index), cg->GetInt32(1)), index);
+    cg->CreateBr(condBB);
+    loop->AttachLoopHints(cg, condBB, entryBB);
+
+    cg->SetInsertPoint(endBB);
+    for (auto& reduction : reductions)
+        cg->CreateAtomicAdd(reduction.shared.value, cg->CreateLoad(reduction.local));
+    cg->CreateRet(nullptr);
+
+    cg->ExitScope();
+    cg->SetInsertPoint(parent);
+    cg->SetStaticLocalsAllowed(staticLocals);
+
+    auto* runtimeType = cg->CreateFuncType(cg->GetVoidType(), {ptrType, ptrType, intType});
+    cg->CreateCall(cg->GetRuntimeFunction("__zcc_parallel_for", runtimeType), {body, ctx, count});
+
+    // An induction variable declared outside the loop ends at its first
+    // failing value, as it would after the serial loop.
+    if (!shape.declared) {
+        auto sym = cg->GetSymbol(shape.var);
+        auto* end = cg->CreateAdd(lo, cg->CreateMul(count, cg->GetInt32(shape.step)));
+        cg->StoreScalar(end, sym.value, sym.type);
+    }
+    return true;
+}
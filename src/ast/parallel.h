@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ast/ast.h"
+
+// Code generation for `parallel [reduction(+: a, b)] for (...)`.
+//
+// A loop of the form `for (i = lo; i < hi; i = i + step)` (or `<=`, with a
+// positive literal step) has its body outlined into an internal function
+// `void body(ptr ctx, i32 begin, i32 end)` that runs the iterations with
+// logical indices [begin, end). The enclosing function evaluates `lo` and
+// `hi` once, passes the addresses of the locals the body uses through `ctx`,
+// and hands the iteration count to the runtime's `__zcc_parallel_for`, which
+// splits it across threads. Each reduction variable gets a private copy per
+// chunk that is atomically added back when the chunk finishes.
+//
+// Returns false, after a warning, when the loop does not have that shape or
+// can leave early (`break`, `return`); the caller then emits a serial loop.
+bool EmitParallelFor(CodeGen* cg, StmtAST* loop);
@@ -2,10 +2,12 @@
 
 #include <cassert>
 
+#include "node.h"
+
 namespace llvm { class Type; }
 class CodeGen;
 
-struct BaseType {
+struct BaseType : ASTNode {
     enum class TYPE { INT, CHAR, VOID };
 
     BaseType(TYPE type) : type(type) {}
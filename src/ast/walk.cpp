@@ -0,0 +1,119 @@
+#include "ast/walk.h"
+
+void ASTWalker::Walk(FuncDefAST* func) {
+    EnterScope();
+    Walk(func->block);
+    ExitScope();
+}
+
+void ASTWalker::Walk(BlockAST* block) {
+    EnterScope();
+    WalkItems(block->items);
+    ExitScope();
+}
+
+void ASTWalker::WalkItems(ASTVector<unique_ptr<BlockItemAST>>& items) {
+    for (auto& item : items) {
+        if (item->decl) Walk(item->decl);
+        else Walk(item->stmt);
+    }
+}
+
+// The `else` of an if statement is walked by the loop rather than by a
+// recursive call, so long `else if` ladders stay flat.
+void ASTWalker::Walk(StmtAST* stmt) {
+    for (; stmt; stmt = stmt->type == StmtAST::TYPE::If ? stmt->elseStmt.get() : nullptr) {
+        OnStmt(stmt);
+        switch (stmt->type) {
+        case StmtAST::TYPE::Assign:
+            WalkIndices(stmt->lval.get());
+            Walk(stmt->expr);
+            OnWrite(stmt->lval.get());
+            break;
+        case StmtAST::TYPE::For:
+            EnterScope();
+            Walk(stmt->forDecl);
+            Walk(stmt->forInitStmt);
+            Walk(stmt->cond);
+            Walk(stmt->thenStmt);
+            Walk(stmt->forStepStmt);
+            ExitScope();
+            break;
+        case StmtAST::TYPE::Switch:
+            Walk(stmt->expr);
+            EnterScope();
+            for (auto& label : stmt->cases) WalkItems(label->items);
+            ExitScope();
+            break;
+        default:
+            Walk(stmt->expr);
+            Walk(stmt->block);
+            Walk(stmt->cond);
+            Walk(stmt->thenStmt);
+            break;
+        }
+    }
+}
+
+template<typename T>
+void ASTWalker::WalkInit(T& initVal) {
+    if (!initVal) return;
+    if (!initVal->isArray) {
+        Walk(initVal->expr);
+        return;
+    }
+    for (auto& sub : initVal->subVals) WalkInit(sub);
+}
+
+void ASTWalker::Walk(DeclAST* decl) {
+    if (decl->constDecl) {
+        for (auto& def : decl->constDecl->constDefs) {
+            WalkInit(def->initVal);
+            OnConstDef(def.get());
+        }
+    } else if (decl->varDecl) {
+        for (auto& def : decl->varDecl->varDefs) {
+            WalkInit(def->initVal);
+            OnVarDef(def.get());
+        }
+    }
+}
+
+// Iterative, so that operand chains of any depth are fine. A call is
+// pushed back behind its arguments and reported when it surfaces again.
+void ASTWalker::Walk(ExprAST* expr) {
+    vector<std::pair<ExprAST*, bool>> pending{{expr, false}};
+    while (!pending.empty()) {
+        auto [node, argsDone] = pending.back();
+        pending.pop_back();
+        switch (node->kind) {
+        case ExprAST::Kind::LVal:
+            Walk(node->lval);
+            break;
+        case ExprAST::Kind::Call:
+            if (argsDone) {
+                OnCall(node);
+                break;
+            }
+            pending.push_back({node, true});
+            for (auto it = node->args.rbegin(); it != node->args.rend(); ++it)
+                pending.push_back({it->get(), false});
+            break;
+        default:
+            for (auto* operand : {&node->rhs, &node->lhs, &node->cond})
+                if (*operand) pending.push_back({operand->get(), false});
+            break;
+        }
+    }
+}
+
+void ASTWalker::Walk(ConstExprAST* expr) { Walk(expr->expr); }
+
+void ASTWalker::Walk(LValAST* lval) {
+    WalkIndices(lval);
+    OnRead(lval);
+}
+
+void ASTWalker::WalkIndices(LValAST* lval) {
+    for (auto& index : lval->indies) Walk(index);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ast/ast.h"
+
+// Pre-order traversal over function bodies, in source evaluation order.
+// Subclasses override the hooks they need; every Walk overload visits all
+// children, so an analysis only has to describe what it collects.
+class ASTWalker {
+public:
+    virtual ~ASTWalker() = default;
+
+    // A call to `call->id`, reported after its arguments are walked.
+    virtual void OnCall(ExprAST* call) {}
+    // An l-value whose contents are read (including an array passed by
+    // reference), or that is the target of an assignment.
+    virtual void OnRead(LValAST* lval) {}
+    virtual void OnWrite(LValAST* lval) {}
+    // A local definition, reported after its initializer is walked.
+    virtual void OnVarDef(VarDefAST* def) {}
+    virtual void OnConstDef(ConstDefAST* def) {}
+    // A statement, reported before any of its parts are walked.
+    virtual void OnStmt(StmtAST* stmt) {}
+    // Block, `for` and function-parameter scopes.
+    virtual void EnterScope() {}
+    virtual void ExitScope() {}
+
+    void Walk(FuncDefAST* func);
+    void Walk(BlockAST* block);
+    void Walk(StmtAST* stmt);
+    void Walk(DeclAST* decl);
+    void Walk(ExprAST* expr);
+    void Walk(ConstExprAST* expr);
+    void Walk(LValAST* lval);
+    template<typename T> void Walk(unique_ptr<T>& node) { if (node) Walk(node.get()); }
+
+private:
+    void WalkIndices(LValAST* lval);
+    void WalkItems(ASTVector<unique_ptr<BlockItemAST>>& items);
+    template<typename T> void WalkInit(T& initVal);
+};
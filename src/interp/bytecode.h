@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Register bytecode for the direct-execution mode (-interp).
+//
+// Every function runs in a window of 32-bit registers: its parameters come
+// first, then its scalar locals, then expression temporaries. A call passes
+// its arguments in consecutive registers at the top of the caller's window,
+// and the callee's window starts at the first of them, so arguments are
+// never copied. Arrays, globals and string literals live in one flat byte
+// memory, and pointers are plain offsets into it.
+//
+// R[x] is register x of the current window, M[x] the word (or, for the
+// byte forms, the sign-extended byte) at memory offset x. Jump targets are
+// instruction indices within the function.
+#define ZCC_BYTECODE_OPS(X)                                                   \
+    X(Mov)      /* R[a] = R[b] */                                             \
+    X(Li)       /* R[a] = b */                                                \
+    X(Lea)      /* R[a] = address of byte b of the frame's memory */          \
+    /* R[a] = R[b] op R[c], with wrap-around arithmetic */                    \
+    X(Add) X(Sub) X(Mul) X(Div) X(Mod)                                        \
+    X(And) X(Or) X(Xor) X(Shl) X(Shr)                                         \
+    X(Lt) X(Le) X(Gt) X(Ge) X(Eq) X(Ne)                                       \
+    X(AddI) X(MulI)     /* R[a] = R[b] op c */                                \
+    X(Neg) X(Not) X(BitNot) X(Bool) X(Sext8)    /* R[a] = op R[b] */          \
+    /* Memory; word forms scale an index register by 4 */                     \
+    X(Ldw) X(Ldb)       /* R[a] = M[R[b] + R[c]] */                           \
+    X(Stw) X(Stb)       /* M[R[b] + R[c]] = R[a] */                           \
+    X(LdwO) X(LdbO)     /* R[a] = M[R[b] + c] */                              \
+    X(StwO) X(StbO)     /* M[R[b] + c] = R[a] */                              \
+    X(Ldg) X(Ldgb)      /* R[a] = M[b] */                                     \
+    X(Stg) X(Stgb)      /* M[b] = R[a] */                                     \
+    X(LdgX) X(LdgbX)    /* R[a] = M[c + R[b]] */                              \
+    X(StgX) X(StgbX)    /* M[c + R[b]] = R[a] */                              \
+    X(Zero)             /* clear b bytes at R[a] */                           \
+    /* Load-add-store superinstructions (words) */                            \
+    X(AddM)             /* M[R[b] + R[c]] += R[a] */                          \
+    X(AddGX)            /* M[c + R[b]] += R[a] */                             \
+    X(AddG)             /* M[b] += R[a] */                                    \
+    X(AddGI)            /* M[b] += a */                                       \
+    /* Control flow; the compare-branch forms are superinstructions too */    \
+    X(Jmp)              /* goto a */                                          \
+    X(Jz) X(Jnz)        /* if (R[a] == 0 / != 0) goto b */                    \
+    X(JLt) X(JLe) X(JGt) X(JGe) X(JEq) X(JNe)       /* if (R[a] op R[b]) goto c */ \
+    X(JLtI) X(JLeI) X(JGtI) X(JGeI) X(JEqI) X(JNeI) /* if (R[a] op b) goto c */    \
+    X(Switch)           /* goto the target for R[a] in switch table b */      \
+    X(Call)             /* R[b] = function a(R[b], ..., R[b + c - 1]) */      \
+    X(Printf) X(Scanf)  /* R[a] = printf/scanf(R[a], ..., R[a + b - 1]) */    \
+    X(Ret)              /* return R[a] */                                     \
+    X(Ret0)             /* return 0 */
+
+enum class Op : uint8_t {
+#define ZCC_OP_ENUM(name) name,
+    ZCC_BYTECODE_OPS(ZCC_OP_ENUM)
+#undef ZCC_OP_ENUM
+};
+
+struct Insn {
+    Op op;
+    int32_t a = 0, b = 0, c = 0;
+};
+
+// `switch` dispatch: (value, target) pairs sorted by value.
+struct SwitchTable {
+    std::vector<std::pair<int32_t, int32_t>> cases;
+    int32_t defaultTarget = 0;
+};
+
+struct Function {
+    std::string name;
+    std::vector<Insn> code;
+    std::vector<SwitchTable> switches;
+    int params = 0;
+    int registers = 1;     // window size; at least 1, for the return value
+    int frameBytes = 0;    // memory for local arrays
+};
+
+struct Program {
+    std::vector<Function> functions;
+    // Globals and string literals occupy memory [0, globalBytes); the stack
+    // of local arrays starts above them.
+    uint32_t globalBytes = 0;
+};
@@ -0,0 +1,1364 @@
+#include "interp/interp.h"
+#include "interp/bytecode.h"
+#include "interp/vm.h"
+#include "ast/analysis.h"
+#include "ast/init.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+
+namespace {
+
+using Kind = ExprAST::Kind;
+
+int32_t Wrap(int64_t v) { return (int32_t)(uint32_t)v; }
+
+// What a name stands for while its scope is being compiled.
+struct Binding {
+    enum class Type : uint8_t { None, Reg, Imm, Global, Array };
+    Type type = Type::None;
+    bool isChar = false;
+    bool isConst = false;
+    // Array: the base address is held in register `value` (a local array or
+    // a decayed parameter) instead of being the absolute address `value`.
+    bool inReg = false;
+    // 0 at file scope, else the nesting depth of the function compile that
+    // made it (a constant context can compile a callee mid-function).
+    int level = 0;
+    int32_t value = 0;
+    vector<int> dims;   // Array; a decayed parameter's leading one is 0
+};
+
+// An expression's value: an immediate, or the register that holds it.
+struct Val {
+    bool imm;
+    int32_t v;
+};
+
+Val Imm(int32_t v) { return {true, v}; }
+Val Reg(int r) { return {false, r}; }
+
+ExprAST* Unwrap(unique_ptr<ExprAST>& expr) { return expr.get(); }
+ExprAST* Unwrap(unique_ptr<ConstExprAST>& expr) { return expr->expr.get(); }
+
+bool IsCompare(Kind kind) { return kind >= Kind::Lt && kind <= Kind::Ne; }
+
+// `!(a op b)` as `a op' b`, and `b op a` as `a op' b`.
+Kind Negate(Kind kind) {
+    switch (kind) {
+    case Kind::Lt: return Kind::Ge;
+    case Kind::Gt: return Kind::Le;
+    case Kind::Le: return Kind::Gt;
+    case Kind::Ge: return Kind::Lt;
+    case Kind::Eq: return Kind::Ne;
+    default:       return Kind::Eq;
+    }
+}
+
+Kind Swap(Kind kind) {
+    switch (kind) {
+    case Kind::Lt: return Kind::Gt;
+    case Kind::Gt: return Kind::Lt;
+    case Kind::Le: return Kind::Ge;
+    case Kind::Ge: return Kind::Le;
+    default:       return kind;
+    }
+}
+
+Op BranchOp(Kind kind, bool imm) {
+    switch (kind) {
+    case Kind::Lt: return imm ? Op::JLtI : Op::JLt;
+    case Kind::Gt: return imm ? Op::JGtI : Op::JGt;
+    case Kind::Le: return imm ? Op::JLeI : Op::JLe;
+    case Kind::Ge: return imm ? Op::JGeI : Op::JGe;
+    case Kind::Eq: return imm ? Op::JEqI : Op::JEq;
+    default:       return imm ? Op::JNeI : Op::JNe;
+    }
+}
+
+Op BinaryOp(Kind kind) {
+    switch (kind) {
+    case Kind::Add: return Op::Add;
+    case Kind::Sub: return Op::Sub;
+    case Kind::Mul: return Op::Mul;
+    case Kind::Div: return Op::Div;
+    case Kind::Mod: return Op::Mod;
+    case Kind::Lt:  return Op::Lt;
+    case Kind::Gt:  return Op::Gt;
+    case Kind::Le:  return Op::Le;
+    case Kind::Ge:  return Op::Ge;
+    case Kind::Eq:  return Op::Eq;
+    case Kind::Ne:  return Op::Ne;
+    case Kind::BitAnd: return Op::And;
+    case Kind::BitOr:  return Op::Or;
+    case Kind::Xor:    return Op::Xor;
+    case Kind::Shl:    return Op::Shl;
+    default:           return Op::Shr;
+    }
+}
+
+// The VM's arithmetic on constants. Division by zero and INT_MIN / -1 do
+// not fold; they are left to fault at run time.
+bool FoldBinary(Kind kind, int32_t l, int32_t r, int32_t& out) {
+    switch (kind) {
+    case Kind::Add: out = Wrap((int64_t)l + r); return true;
+    case Kind::Sub: out = Wrap((int64_t)l - r); return true;
+    case Kind::Mul: out = Wrap((int64_t)l * r); return true;
+    case Kind::Div:
+    case Kind::Mod:
+        if (r == 0 || (l == INT32_MIN && r == -1)) return false;
+        out = kind == Kind::Div ? l / r : l % r;
+        return true;
+    case Kind::Lt: out = l < r; return true;
+    case Kind::Gt: out = l > r; return true;
+    case Kind::Le: out = l <= r; return true;
+    case Kind::Ge: out = l >= r; return true;
+    case Kind::Eq: out = l == r; return true;
+    case Kind::Ne: out = l != r; return true;
+    case Kind::BitAnd: out = l & r; return true;
+    case Kind::BitOr:  out = l | r; return true;
+    case Kind::Xor:    out = l ^ r; return true;
+    case Kind::Shl:    out = Wrap((int64_t)((uint32_t)l << (r & 31))); return true;
+    case Kind::Shr:    out = l >> (r & 31); return true;
+    default:           return false;
+    }
+}
+
+// Whether evaluating `expr` can call anything (and so have side effects).
+bool HasCall(ExprAST* expr) {
+    vector<ExprAST*> pending{expr};
+    while (!pending.empty()) {
+        auto* e = pending.back();
+        pending.pop_back();
+        if (e->kind == Kind::Call) return true;
+        for (auto* operand : {e->lhs.get(), e->rhs.get(), e->cond.get()})
+            if (operand) pending.push_back(operand);
+        if (e->lval)
+            for (auto& index : e->lval->indies) pending.push_back(index.get());
+    }
+    return false;
+}
+
+bool SameExpr(ExprAST* a, ExprAST* b);
+
+bool SameLVal(LValAST* a, LValAST* b) {
+    if (a->id != b->id || a->indies.size() != b->indies.size()) return false;
+    for (size_t i = 0; i < a->indies.size(); ++i)
+        if (!SameExpr(a->indies[i].get(), b->indies[i].get())) return false;
+    return true;
+}
+
+// Structural equality of two call-free expressions.
+bool SameExpr(ExprAST* a, ExprAST* b) {
+    vector<std::pair<ExprAST*, ExprAST*>> pending{{a, b}};
+    while (!pending.empty()) {
+        auto [x, y] = pending.back();
+        pending.pop_back();
+        if (!x || !y) {
+            if (x != y) return false;
+            continue;
+        }
+        if (x->kind != y->kind || x->value != y->value || x->id != y->id) return false;
+        if (x->kind == Kind::Call) return false;
+        if (x->lval && !SameLVal(x->lval.get(), y->lval.get())) return false;
+        pending.push_back({x->lhs.get(), y->lhs.get()});
+        pending.push_back({x->rhs.get(), y->rhs.get()});
+        pending.push_back({x->cond.get(), y->cond.get()});
+    }
+    return true;
+}
+
+class FunctionCompiler;
+
+// Program-level state: bindings, globals and the functions' compile status.
+class Compiler {
+public:
+    Compiler(CompUnitAST& unit, Interner& names, Program& program, VM& vm, FILE* diagnostics);
+
+    bool Compile();
+    int Entry() const { return entry; }
+
+    void Error(const string& message);
+    int ErrorCount() const { return errors; }
+
+    // Scopes work as in CodeGen: each id holds its innermost binding, and
+    // shadowed ones wait in an undo log. A binding made by an enclosing
+    // function compile is invisible to a nested one.
+    const Binding& Lookup(SymbolId id) const;
+    void Bind(SymbolId id, Binding binding);
+    void EnterScope();
+    void ExitScope();
+
+    // The spelling of an interned name.
+    const string& Name(SymbolId id) const { return names.Name(id); }
+    // The index of the user function `id` names, or -1.
+    int FindFunction(SymbolId id) const;
+    size_t Arity(int func) const { return unit.funcDefs[func]->params.size(); }
+    // A call to `likely`/`unlikely`/`printf`/`scanf` that no user function
+    // of the same name overrides.
+    bool IsBuiltin(ExprAST* call, const char* name) const;
+
+    // Constant folding, which may run user functions; reports failures.
+    bool Fold(ExprAST* expr, int32_t& out);
+    template<typename Sizes>
+    bool ArrayDims(SymbolId name, Sizes& sizeExprs, vector<int>& dims, uint64_t& elements);
+
+    uint32_t AllocGlobal(uint64_t bytes);
+    // The address of the interned string literal `str`.
+    int32_t StringAddress(SymbolId str);
+
+    int level = 0;
+
+private:
+    enum class State { Pending, Compiling, Done };
+
+    bool CompileFunction(int index);
+    bool FoldLVal(LValAST* lval, int32_t& out);
+    bool FoldCall(ExprAST* call, int32_t& out);
+    void Declare(DeclAST* decl);
+    template<typename Def, typename Init>
+    void Define(Def* def, Init& initVal, bool isChar, bool isConst);
+
+    CompUnitAST& unit;
+    Interner& names;
+    Program& program;
+    VM& vm;
+    FILE* diagnostics;
+
+    struct Shadowed { SymbolId id; Binding previous; };
+    vector<Binding> bindings;
+    vector<Binding> globals;
+    vector<Shadowed> undo;
+    vector<size_t> scopeStarts;
+
+    vector<int> functionIds;   // function index by SymbolId, or -1
+    vector<State> states;
+    std::unique_ptr<CallGraph> graph;
+    std::map<SymbolId, int32_t> strings;
+    int entry = -1;
+    int errors = 0;
+};
+
+// Translates one function body. Scalar locals get registers for the life
+// of their scope; temporaries are allocated above them in stack order, so
+// every subexpression leaves its value (if it needs a register at all) in
+// the lowest one that was free when it started.
+class FunctionCompiler {
+public:
+    FunctionCompiler(Compiler& c, FuncDefAST* def, Function& fn);
+    ~FunctionCompiler();
+
+    void Compile();
+
+private:
+    // An array element or sub-array: the constant part of its element
+    // index, and the register with the variable part (or -1).
+    struct Ref {
+        int32_t offset = 0;
+        int index = -1;
+        int scratch = 0;
+        bool whole = false;
+    };
+
+    // Where `break` and `continue` go; a switch only takes `break`.
+    struct Targets {
+        vector<size_t> breaks;
+        vector<size_t> continues;
+        bool loop;
+    };
+
+    size_t Emit(Op op, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+    int32_t Here() const { return (int32_t)fn.code.size(); }
+    void Patch(const vector<size_t>& jumps, int32_t target);
+
+    int Temp();
+    void SetTop(int reg);
+    Val Result(int out, int base);
+    void Place(Val v, int reg);
+    int InReg(Val v);
+
+    Val Expr(ExprAST* root, int dst = -1);
+    Val Unary(Kind kind, Val v, int out, int base);
+    Val Binary(Kind kind, Val l, Val r, int out, int base);
+    Val Call(ExprAST* call, int base);
+    Val Load(LValAST* lval, int out);
+    bool Locate(LValAST* lval, const Binding& b, Ref& ref);
+    // Jump to a target patched into `jumps` when `cond` is `onTrue`.
+    void Branch(ExprAST* cond, bool onTrue, vector<size_t>& jumps);
+
+    void Stmt(StmtAST* stmt);
+    void Assign(StmtAST* stmt);
+    bool AddInPlace(StmtAST* stmt, const Binding& b, const Ref* ref);
+    void EndLoop(int32_t next, int32_t end);
+    void Block(BlockAST* block);
+    void Items(ASTVector<unique_ptr<BlockItemAST>>& items);
+    void Declare(DeclAST* decl);
+    template<typename Def, typename Init>
+    void Define(Def* def, Init& initVal, bool isChar, bool isConst);
+    void EnterScope();
+    void ExitScope();
+
+    Compiler& c;
+    FuncDefAST* def;
+    Function& fn;
+    int top = 0;
+    vector<int> scopeTops;
+    vector<Targets> targets;
+};
+
+// Flatten an initializer to one expression per element (null for zero).
+template<typename Init>
+vector<ExprAST*> FlattenInit(const vector<int>& dims, Init& initVal) {
+    vector<int> shape = dims;
+    shape.push_back(0);
+    vector<ExprAST*> flat;
+    ExprAST* zero = nullptr;
+    FlattenInitList(flat, shape, 0, initVal, [](auto& expr) { return Unwrap(expr); }, zero);
+    return flat;
+}
+
+// ========== Compiler ==========
+
+Compiler::Compiler(CompUnitAST& unit, Interner& names, Program& program, VM& vm, FILE* diagnostics)
+    : unit(unit), names(names), program(program), vm(vm), diagnostics(diagnostics),
+      bindings(names.Size()), globals(names.Size()), functionIds(names.Size(), -1) {}
+
+void Compiler::Error(const string& message) {
+    fprintf(diagnostics, "error: %s\n", message.c_str());
+    ++errors;
+}
+
+const Binding& Compiler::Lookup(SymbolId id) const {
+    const Binding& b = bindings[id];
+    if (b.type != Binding::Type::None && (b.level == level || b.level == 0)) return b;
+    return globals[id];
+}
+
+void Compiler::Bind(SymbolId id, Binding binding) {
+    binding.level = level;
+    if (scopeStarts.empty()) {
+        globals[id] = binding;
+    } else {
+        undo.push_back({id, std::move(bindings[id])});
+    }
+    bindings[id] = std::move(binding);
+}
+
+void Compiler::EnterScope() { scopeStarts.push_back(undo.size()); }
+
+void Compiler::ExitScope() {
+    size_t start = scopeStarts.back();
+    scopeStarts.pop_back();
+    while (undo.size() > start) {
+        bindings[undo.back().id] = std::move(undo.back().previous);
+        undo.pop_back();
+    }
+}
+
+int Compiler::FindFunction(SymbolId id) const {
+    return id < functionIds.size() ? functionIds[id] : -1;
+}
+
+bool Compiler::IsBuiltin(ExprAST* call, const char* name) const {
+    return call->kind == Kind::Call && Name(call->id) == name && FindFunction(call->id) < 0;
+}
+
+bool Compiler::Compile() {
+    if (!vm.Memory()) {
+        Error("cannot reserve memory for the interpreter");
+        return false;
+    }
+    // Offset 0 stays unused, so no object has a null address.
+    program.globalBytes = 16;
+    program.functions.resize(unit.funcDefs.size());
+    states.assign(unit.funcDefs.size(), State::Pending);
+    for (size_t i = 0; i < unit.funcDefs.size(); ++i) {
+        functionIds[unit.funcDefs[i]->id] = (int)i;
+        program.functions[i].name = Name(unit.funcDefs[i]->id);
+    }
+
+    for (auto& decl : unit.decls) Declare(decl.get());
+    for (size_t i = 0; i < unit.funcDefs.size(); ++i) CompileFunction((int)i);
+
+    entry = FindFunction(names.Find("main"));
+    if (entry < 0) Error("no 'main' function");
+    return errors == 0;
+}
+
+bool Compiler::CompileFunction(int index) {
+    if (states[index] == State::Done) return true;
+    if (states[index] == State::Compiling) {
+        Error("'" + program.functions[index].name + "' is needed in a constant expression inside its own body");
+        return false;
+    }
+    int before = errors;
+    states[index] = State::Compiling;
+    FunctionCompiler(*this, unit.funcDefs[index].get(), program.functions[index]).Compile();
+    states[index] = State::Done;
+    return errors == before;
+}
+
+uint32_t Compiler::AllocGlobal(uint64_t bytes) {
+    uint32_t addr = (program.globalBytes + 3) & ~3u;
+    if (addr + bytes > VM::kMemoryBytes / 2) {
+        Error("globals do not fit in the interpreter's memory");
+        return 0;
+    }
+    program.globalBytes = addr + (uint32_t)bytes;
+    // A constant-context call may have used this memory as its stack.
+    memset(vm.Memory() + addr, 0, bytes);
+    return addr;
+}
+
+int32_t Compiler::StringAddress(SymbolId str) {
+    auto found = strings.find(str);
+    if (found != strings.end()) return found->second;
+    auto& text = Name(str);
+    uint32_t addr = AllocGlobal(text.size() + 1);
+    memcpy(vm.Memory() + addr, text.c_str(), text.size() + 1);
+    return strings[str] = (int32_t)addr;
+}
+
+template<typename Sizes>
+bool Compiler::ArrayDims(SymbolId name, Sizes& sizeExprs, vector<int>& dims, uint64_t& elements) {
+    elements = 1;
+    for (auto& sizeExpr : sizeExprs) {
+        int32_t dim;
+        if (!Fold(Unwrap(sizeExpr), dim)) return false;
+        if (dim <= 0) {
+            Error("array '" + Name(name) + "' has non-positive size");
+            return false;
+        }
+        elements *= dim;
+        if (elements > VM::kMemoryBytes / 4) {
+            Error("array '" + Name(name) + "' is too large");
+            return false;
+        }
+        dims.push_back(dim);
+    }
+    return true;
+}
+
+void Compiler::Declare(DeclAST* decl) {
+    if (decl->constDecl) {
+        bool isChar = decl->constDecl->btype->GetType() == BaseType::TYPE::CHAR;
+        for (auto& def : decl->constDecl->constDefs) Define(def.get(), def->initVal, isChar, true);
+    } else {
+        bool isChar = decl->varDecl->btype->GetType() == BaseType::TYPE::CHAR;
+        for (auto& def : decl->varDecl->varDefs) Define(def.get(), def->initVal, isChar, false);
+    }
+}
+
+// Globals are laid out and initialized in declaration order; a scalar const
+// becomes an immediate.
+template<typename Def, typename Init>
+void Compiler::Define(Def* def, Init& initVal, bool isChar, bool isConst) {
+    int size = isChar ? 1 : 4;
+    auto store = [&](uint32_t addr, int32_t value) {
+        if (isChar) vm.Memory()[addr] = (uint8_t)value;
+        else memcpy(vm.Memory() + addr, &value, 4);
+    };
+
+    Binding b;
+    b.isChar = isChar;
+    b.isConst = isConst;
+    if (def->sizeExprs.empty()) {
+        int32_t value = 0;
+        // On failure, still define it, so its uses are not reported too.
+        if (initVal && initVal->expr && !Fold(Unwrap(initVal->expr), value)) value = 0;
+        if (isChar) value = (int8_t)value;
+        b.type = isConst ? Binding::Type::Imm : Binding::Type::Global;
+        b.value = value;
+        if (!isConst) {
+            b.value = AllocGlobal(size);
+            store(b.value, value);
+        }
+    } else {
+        uint64_t elements;
+        if (!ArrayDims(def->id, def->sizeExprs, b.dims, elements)) return;
+        b.type = Binding::Type::Array;
+        b.value = AllocGlobal(elements * size);
+        if (initVal) {
+            auto flat = FlattenInit(b.dims, initVal);
+            for (size_t i = 0; i < flat.size() && i < elements; ++i) {
+                int32_t value;
+                if (flat[i] && Fold(flat[i], value)) store(b.value + i * size, value);
+            }
+        }
+    }
+    Bind(def->id, std::move(b));
+}
+
+bool Compiler::Fold(ExprAST* expr, int32_t& out) {
+    int32_t l, r;
+    switch (expr->kind) {
+    case Kind::Number:
+        out = expr->value;
+        return true;
+    case Kind::String:
+        Error("string literal in a constant expression");
+        return false;
+    case Kind::LVal:
+        return FoldLVal(expr->lval.get(), out);
+    case Kind::Call:
+        return FoldCall(expr, out);
+    case Kind::Neg:
+    case Kind::Not:
+    case Kind::BitNot:
+        if (!Fold(expr->lhs.get(), l)) return false;
+        out = expr->kind == Kind::Neg ? Wrap(-(int64_t)l) : expr->kind == Kind::Not ? l == 0 : ~l;
+        return true;
+    case Kind::LAnd:
+    case Kind::LOr:
+        if (!Fold(expr->lhs.get(), l)) return false;
+        if ((l != 0) == (expr->kind == Kind::LOr)) {
+            out = l != 0;
+            return true;
+        }
+        if (!Fold(expr->rhs.get(), r)) return false;
+        out = r != 0;
+        return true;
+    case Kind::Cond:
+        if (!Fold(expr->cond.get(), l)) return false;
+        return Fold((l ? expr->lhs : expr->rhs).get(), out);
+    default:
+        if (!Fold(expr->lhs.get(), l) || !Fold(expr->rhs.get(), r)) return false;
+        if (FoldBinary(expr->kind, l, r, out)) return true;
+        Error(r == 0 ? "division by zero in a constant expression"
+                     : "signed division overflow in a constant expression");
+        return false;
+    }
+}
+
+// Constants: a scalar const's immediate, or an element of a global const
+// array. A variable's initializer is only its first value, so reading one
+// is not constant.
+bool Compiler::FoldLVal(LValAST* lval, int32_t& out) {
+    const Binding& b = Lookup(lval->id);
+    if (b.type == Binding::Type::None) {
+        Error("use of undeclared identifier '" + Name(lval->id) + "'");
+        return false;
+    }
+    if (!b.isConst) {
+        Error("'" + Name(lval->id) + "' is not a constant expression");
+        return false;
+    }
+    bool global = b.level == 0 && !b.inReg;
+    if (b.type == Binding::Type::Imm && lval->indies.empty()) {
+        out = b.value;
+        return true;
+    }
+    if (b.type == Binding::Type::Array && global && lval->indies.size() == b.dims.size()) {
+        int64_t offset = 0;
+        for (size_t i = 0; i < b.dims.size(); ++i) {
+            int32_t index;
+            if (!Fold(lval->indies[i].get(), index)) return false;
+            if (index < 0 || index >= b.dims[i]) {
+                Error("index out of bounds on '" + Name(lval->id) + "'");
+                return false;
+            }
+            offset = offset * b.dims[i] + index;
+        }
+        uint32_t addr = b.value + (uint32_t)offset * (b.isChar ? 1 : 4);
+        out = b.isChar ? (int8_t)vm.Memory()[addr] : 0;
+        if (!b.isChar) memcpy(&out, vm.Memory() + addr, 4);
+        return true;
+    }
+    Error("'" + Name(lval->id) + "' is not a constant");
+    return false;
+}
+
+// A call runs on the VM once everything it can reach is compiled.
+bool Compiler::FoldCall(ExprAST* call, int32_t& out) {
+    if (IsBuiltin(call, "likely") || IsBuiltin(call, "unlikely")) {
+        if (call->args.size() != 1) {
+            Error("'" + Name(call->id) + "' takes exactly one argument");
+            return false;
+        }
+        if (!Fold(call->args[0].get(), out)) return false;
+        out = out != 0;
+        return true;
+    }
+    int func = FindFunction(call->id);
+    if (func < 0) {
+        Error("cannot evaluate '" + Name(call->id) + "(...)' at compile time: it is not a user function");
+        return false;
+    }
+    auto* funcDef = unit.funcDefs[func].get();
+    if (funcDef->params.size() != call->args.size()) {
+        Error("wrong number of arguments to '" + Name(call->id) + "'");
+        return false;
+    }
+    vector<int32_t> args;
+    for (size_t i = 0; i < call->args.size(); ++i) {
+        if (funcDef->params[i]->isArray) {
+            Error("cannot evaluate '" + Name(call->id) + "(...)' at compile time: it takes an array");
+            return false;
+        }
+        args.push_back(0);
+        if (!Fold(call->args[i].get(), args.back())) return false;
+    }
+
+    if (!graph) graph = std::make_unique<CallGraph>(unit);
+    vector<int> pending{func};
+    std::set<int> seen{func};
+    while (!pending.empty()) {
+        int next = pending.back();
+        pending.pop_back();
+        if (!CompileFunction(next)) return false;
+        for (auto& callee : graph->Callees(unit.funcDefs[next]->id)) {
+            int index = FindFunction(callee);
+            if (index >= 0 && seen.insert(index).second) pending.push_back(index);
+        }
+    }
+
+    if (!vm.Invoke(func, args, out)) {
+        Error("cannot evaluate '" + Name(call->id) + "(...)' at compile time: " + vm.Fault());
+        return false;
+    }
+    return true;
+}
+
+// ========== FunctionCompiler ==========
+
+FunctionCompiler::FunctionCompiler(Compiler& c, FuncDefAST* def, Function& fn) : c(c), def(def), fn(fn) {
+    ++c.level;
+}
+
+FunctionCompiler::~FunctionCompiler() { --c.level; }
+
+size_t FunctionCompiler::Emit(Op op, int32_t a, int32_t b, int32_t c) {
+    fn.code.push_back({op, a, b, c});
+    return fn.code.size() - 1;
+}
+
+void FunctionCompiler::Patch(const vector<size_t>& jumps, int32_t target) {
+    for (size_t at : jumps) {
+        Insn& insn = fn.code[at];
+        if (insn.op == Op::Jmp) insn.a = target;
+        else if (insn.op == Op::Jz || insn.op == Op::Jnz) insn.b = target;
+        else insn.c = target;
+    }
+}
+
+int FunctionCompiler::Temp() {
+    SetTop(top + 1);
+    return top - 1;
+}
+
+void FunctionCompiler::SetTop(int reg) {
+    top = reg;
+    fn.registers = std::max(fn.registers, top);
+}
+
+// The value a node computed into `out`: its own base register (which stays
+// allocated), or the caller's destination.
+Val FunctionCompiler::Result(int out, int base) {
+    SetTop(out == base ? base + 1 : base);
+    return Reg(out);
+}
+
+void FunctionCompiler::Place(Val v, int reg) {
+    if (v.imm) Emit(Op::Li, reg, v.v);
+    else if (v.v != reg) Emit(Op::Mov, reg, v.v);
+}
+
+int FunctionCompiler::InReg(Val v) {
+    if (!v.imm) return v.v;
+    int reg = Temp();
+    Emit(Op::Li, reg, v.v);
+    return reg;
+}
+
+// Same scheme as ExprAST::ToValue: an explicit task stack, so operand
+// chains of any depth compile without recursion. A node whose value comes
+// from one final instruction writes it straight to `dst` when it is the
+// root.
+Val FunctionCompiler::Expr(ExprAST* root, int dst) {
+    struct Task {
+        ExprAST* expr;
+        int base;
+        int step = 0;
+        vector<size_t> jumps;   // ?: the jump to the else arm, then to the end
+    };
+    vector<Task> tasks;
+    tasks.push_back({root, top});
+    vector<Val> values;
+    auto pop = [&values] {
+        Val v = values.back();
+        values.pop_back();
+        return v;
+    };
+
+    while (!tasks.empty()) {
+        // `task` dangles once a child is pushed, so each case pushes last.
+        auto& task = tasks.back();
+        auto* expr = task.expr;
+        int base = task.base;
+        int step = task.step++;
+        int out = tasks.size() == 1 && dst >= 0 ? dst : base;
+
+        switch (expr->kind) {
+        case Kind::Number: values.push_back(Imm(expr->value)); break;
+        case Kind::String: values.push_back(Imm(c.StringAddress(expr->id))); break;
+        case Kind::LVal:   values.push_back(Load(expr->lval.get(), out)); break;
+
+        // Each argument lands in the register after the previous one.
+        case Kind::Call:
+            if (step > 0) {
+                SetTop(base + step);
+                Place(pop(), base + step - 1);
+            }
+            if (step < (int)expr->args.size()) {
+                tasks.push_back({expr->args[step].get(), top});
+                continue;
+            }
+            values.push_back(Call(expr, base));
+            break;
+
+        case Kind::Neg:
+        case Kind::Not:
+        case Kind::BitNot:
+            if (step == 0) {
+                tasks.push_back({expr->lhs.get(), base});
+                continue;
+            }
+            values.push_back(Unary(expr->kind, pop(), out, base));
+            break;
+
+        // 0, replaced by 1 once the condition is known to hold.
+        case Kind::LAnd:
+        case Kind::LOr: {
+            vector<size_t> isFalse;
+            Emit(Op::Li, base, 0);
+            SetTop(base + 1);
+            Branch(expr, false, isFalse);
+            Emit(Op::Li, base, 1);
+            Patch(isFalse, Here());
+            values.push_back(Reg(base));
+            break;
+        }
+
+        case Kind::Cond:
+            if (step == 0) {
+                Branch(expr->cond.get(), false, task.jumps);
+                tasks.push_back({expr->lhs.get(), base});
+                continue;
+            }
+            SetTop(base + 1);
+            Place(pop(), base);
+            if (step == 1) {
+                size_t end = Emit(Op::Jmp);
+                Patch(task.jumps, Here());
+                task.jumps = {end};
+                SetTop(base);
+                tasks.push_back({expr->rhs.get(), base});
+                continue;
+            }
+            Patch(task.jumps, Here());
+            values.push_back(Reg(base));
+            break;
+
+        default:
+            if (step < 2) {
+                tasks.push_back({(step == 0 ? expr->lhs : expr->rhs).get(), top});
+                continue;
+            }
+            Val r = pop();
+            Val l = pop();
+            values.push_back(Binary(expr->kind, l, r, out, base));
+            break;
+        }
+        tasks.pop_back();
+    }
+    return values.back();
+}
+
+Val FunctionCompiler::Unary(Kind kind, Val v, int out, int base) {
+    if (v.imm) return Imm(kind == Kind::Neg ? Wrap(-(int64_t)v.v) : kind == Kind::Not ? v.v == 0 : ~v.v);
+    Emit(kind == Kind::Neg ? Op::Neg : kind == Kind::Not ? Op::Not : Op::BitNot, out, v.v);
+    return Result(out, base);
+}
+
+Val FunctionCompiler::Binary(Kind kind, Val l, Val r, int out, int base) {
+    int32_t folded;
+    if (l.imm && r.imm && FoldBinary(kind, l.v, r.v, folded)) return Imm(folded);
+    if (kind == Kind::Add || kind == Kind::Mul) {
+        if (l.imm) std::swap(l, r);
+        if (r.imm) {
+            Emit(kind == Kind::Add ? Op::AddI : Op::MulI, out, l.v, r.v);
+            return Result(out, base);
+        }
+    }
+    if (kind == Kind::Sub && r.imm) {
+        Emit(Op::AddI, out, l.v, Wrap(-(int64_t)r.v));
+        return Result(out, base);
+    }
+    int lhs = InReg(l);
+    int rhs = InReg(r);
+    Emit(BinaryOp(kind), out, lhs, rhs);
+    return Result(out, base);
+}
+
+// The arguments are already in consecutive registers from `base`.
+Val FunctionCompiler::Call(ExprAST* call, int base) {
+    int count = (int)call->args.size();
+    SetTop(std::max(top, base + 1));
+    if (c.IsBuiltin(call, "likely") || c.IsBuiltin(call, "unlikely")) {
+        if (count != 1) {
+            c.Error("'" + c.Name(call->id) + "' takes exactly one argument");
+            return Imm(0);
+        }
+        Emit(Op::Bool, base, base);
+    } else if (c.IsBuiltin(call, "printf") || c.IsBuiltin(call, "scanf")) {
+        if (count == 0) {
+            c.Error("'" + c.Name(call->id) + "' needs a format string");
+            return Imm(0);
+        }
+        Emit(c.Name(call->id) == "printf" ? Op::Printf : Op::Scanf, base, count);
+    } else {
+        int func = c.FindFunction(call->id);
+        if (func < 0) {
+            c.Error("call to undeclared function '" + c.Name(call->id) + "'");
+            return Imm(0);
+        }
+        if (count != (int)c.Arity(func)) {
+            c.Error("wrong number of arguments to '" + c.Name(call->id) + "'");
+            return Imm(0);
+        }
+        Emit(Op::Call, func, base, count);
+    }
+    return Result(base, base);
+}
+
+Val FunctionCompiler::Load(LValAST* lval, int out) {
+    int base = top;
+    const Binding& b = c.Lookup(lval->id);
+    if (b.type == Binding::Type::None) {
+        c.Error("use of undeclared identifier '" + c.Name(lval->id) + "'");
+        return Imm(0);
+    }
+    if (b.type != Binding::Type::Array) {
+        if (!lval->indies.empty()) {
+            c.Error("subscript of scalar '" + c.Name(lval->id) + "'");
+            return Imm(0);
+        }
+        if (b.type == Binding::Type::Imm) return Imm(b.value);
+        if (b.type == Binding::Type::Reg) return Reg(b.value);
+        Emit(b.isChar ? Op::Ldgb : Op::Ldg, out, b.value);
+        return Result(out, base);
+    }
+
+    Ref ref;
+    if (!Locate(lval, b, ref)) return Imm(0);
+    int size = b.isChar ? 1 : 4;
+    if (ref.whole) {
+        // A sub-array decays to its address.
+        int index = ref.index;
+        if (index >= 0 && size != 1) {
+            Emit(Op::MulI, ref.scratch, index, size);
+            index = ref.scratch;
+        }
+        if (!b.inReg) {
+            if (index < 0) return Imm(Wrap(b.value + (int64_t)ref.offset * size));
+            Emit(Op::AddI, out, index, b.value);
+        } else if (index >= 0) {
+            Emit(Op::Add, out, b.value, index);
+        } else if (ref.offset) {
+            Emit(Op::AddI, out, b.value, Wrap((int64_t)ref.offset * size));
+        } else {
+            SetTop(base);
+            return Reg(b.value);
+        }
+    } else if (!b.inReg) {
+        if (ref.index < 0) Emit(b.isChar ? Op::Ldgb : Op::Ldg, out, Wrap(b.value + (int64_t)ref.offset * size));
+        else Emit(b.isChar ? Op::LdgbX : Op::LdgX, out, ref.index, b.value);
+    } else {
+        if (ref.index < 0) Emit(b.isChar ? Op::LdbO : Op::LdwO, out, b.value, Wrap((int64_t)ref.offset * size));
+        else Emit(b.isChar ? Op::Ldb : Op::Ldw, out, b.value, ref.index);
+    }
+    return Result(out, base);
+}
+
+// Evaluate the indices of `lval` into a Ref. The element index is the sum
+// of each index times the size of the sub-array it steps over; constant
+// indices fold into `offset`, and the rest accumulate in a scratch register
+// (reserved at the current top) unless a single variable covers them.
+bool FunctionCompiler::Locate(LValAST* lval, const Binding& b, Ref& ref) {
+    if (lval->indies.size() > b.dims.size()) {
+        c.Error("too many subscripts on '" + c.Name(lval->id) + "'");
+        return false;
+    }
+    ref.scratch = Temp();
+    int64_t stride = 1;
+    for (size_t i = lval->indies.size(); i < b.dims.size(); ++i) stride *= b.dims[i];
+    vector<int32_t> strides(lval->indies.size());
+    for (int i = (int)lval->indies.size() - 1; i >= 0; --i) {
+        strides[i] = (int32_t)stride;
+        stride *= b.dims[i];
+    }
+
+    for (size_t i = 0; i < lval->indies.size(); ++i) {
+        bool first = ref.index < 0;
+        Val v = Expr(lval->indies[i].get(), first && strides[i] == 1 ? ref.scratch : -1);
+        if (v.imm) {
+            ref.offset = Wrap(ref.offset + (int64_t)v.v * strides[i]);
+            continue;
+        }
+        int term = v.v;
+        if (strides[i] != 1) {
+            int into = first ? ref.scratch : term > ref.scratch ? term : Temp();
+            Emit(Op::MulI, into, term, strides[i]);
+            term = into;
+        }
+        if (first) {
+            // Keep it below the temporaries the next index will use.
+            if (term > ref.scratch) {
+                Emit(Op::Mov, ref.scratch, term);
+                term = ref.scratch;
+            }
+            ref.index = term;
+        } else {
+            Emit(Op::Add, ref.scratch, ref.index, term);
+            ref.index = ref.scratch;
+        }
+        SetTop(ref.scratch + 1);
+    }
+    if (ref.index >= 0 && ref.offset) {
+        Emit(Op::AddI, ref.scratch, ref.index, ref.offset);
+        ref.index = ref.scratch;
+        ref.offset = 0;
+    }
+    SetTop(ref.scratch + 1);
+    ref.whole = lval->indies.size() < b.dims.size();
+    return true;
+}
+
+void FunctionCompiler::Branch(ExprAST* cond, bool onTrue, vector<size_t>& jumps) {
+    int saved = top;
+    for (;;) {
+        if (cond->kind == Kind::Not) {
+            cond = cond->lhs.get();
+            onTrue = !onTrue;
+        } else if ((c.IsBuiltin(cond, "likely") || c.IsBuiltin(cond, "unlikely")) && cond->args.size() == 1) {
+            cond = cond->args[0].get();
+        } else {
+            break;
+        }
+    }
+
+    if (cond->kind == Kind::LAnd || cond->kind == Kind::LOr) {
+        // A chain `a && b && c` parses left-deep; walk it as a list.
+        vector<ExprAST*> operands;
+        ExprAST* e = cond;
+        for (; e->kind == cond->kind; e = e->lhs.get()) operands.push_back(e->rhs.get());
+        operands.push_back(e);
+        std::reverse(operands.begin(), operands.end());
+
+        // The outcome any single operand can decide on its own.
+        bool decides = cond->kind == Kind::LOr;
+        if (onTrue == decides) {
+            for (auto* operand : operands) Branch(operand, onTrue, jumps);
+        } else {
+            vector<size_t> decided;
+            for (size_t i = 0; i + 1 < operands.size(); ++i) Branch(operands[i], decides, decided);
+            Branch(operands.back(), onTrue, jumps);
+            Patch(decided, Here());
+        }
+    } else if (IsCompare(cond->kind)) {
+        Val l = Expr(cond->lhs.get());
+        Val r = Expr(cond->rhs.get());
+        Kind kind = onTrue ? cond->kind : Negate(cond->kind);
+        int32_t holds;
+        if (l.imm && r.imm) {
+            FoldBinary(kind, l.v, r.v, holds);
+            if (holds) jumps.push_back(Emit(Op::Jmp));
+        } else {
+            if (l.imm) {
+                std::swap(l, r);
+                kind = Swap(kind);
+            }
+            jumps.push_back(Emit(BranchOp(kind, r.imm), l.v, r.v));
+        }
+    } else {
+        Val v = Expr(cond);
+        if (!v.imm) jumps.push_back(Emit(onTrue ? Op::Jnz : Op::Jz, v.v));
+        else if ((v.v != 0) == onTrue) jumps.push_back(Emit(Op::Jmp));
+    }
+    SetTop(saved);
+}
+
+void FunctionCompiler::Compile() {
+    fn.params = (int)def->params.size();
+    EnterScope();
+    for (int i = 0; i < fn.params; ++i) {
+        auto& param = def->params[i];
+        Binding b;
+        b.isChar = param->btype->GetType() == BaseType::TYPE::CHAR;
+        b.value = i;
+        if (param->isArray) {
+            b.type = Binding::Type::Array;
+            b.inReg = true;
+            b.dims.push_back(0);
+            for (auto& sizeExpr : param->sizeExprs) {
+                int32_t dim = 0;
+                c.Fold(Unwrap(sizeExpr), dim);
+                b.dims.push_back(dim);
+            }
+        } else {
+            b.type = Binding::Type::Reg;
+            // The caller passes an int; a char parameter keeps its low byte.
+            if (b.isChar) Emit(Op::Sext8, i, i);
+        }
+        c.Bind(param->id, std::move(b));
+    }
+    SetTop(fn.params);
+    Block(def->block.get());
+    // Falling off the end of a non-void function returns 0.
+    Emit(Op::Ret0);
+    ExitScope();
+}
+
+void FunctionCompiler::EnterScope() {
+    c.EnterScope();
+    scopeTops.push_back(top);
+}
+
+void FunctionCompiler::ExitScope() {
+    c.ExitScope();
+    top = scopeTops.back();
+    scopeTops.pop_back();
+}
+
+void FunctionCompiler::Block(BlockAST* block) {
+    EnterScope();
+    Items(block->items);
+    ExitScope();
+}
+
+void FunctionCompiler::Items(ASTVector<unique_ptr<BlockItemAST>>& items) {
+    for (auto& item : items) {
+        if (item->decl) Declare(item->decl.get());
+        else Stmt(item->stmt.get());
+    }
+}
+
+void FunctionCompiler::Declare(DeclAST* decl) {
+    if (decl->constDecl) {
+        bool isChar = decl->constDecl->btype->GetType() == BaseType::TYPE::CHAR;
+        for (auto& def : decl->constDecl->constDefs) Define(def.get(), def->initVal, isChar, true);
+    } else {
+        bool isChar = decl->varDecl->btype->GetType() == BaseType::TYPE::CHAR;
+        for (auto& def : decl->varDecl->varDefs) Define(def.get(), def->initVal, isChar, false);
+    }
+}
+
+// A scalar gets the next register, and its initializer (which still sees
+// any outer binding of the name) is computed straight into it. An array
+// gets a slice of the frame's memory, cleared each time the declaration
+// runs, and a register with its address.
+template<typename Def, typename Init>
+void FunctionCompiler::Define(Def* def, Init& initVal, bool isChar, bool isConst) {
+    Binding b;
+    b.isChar = isChar;
+    b.isConst = isConst;
+    if (def->sizeExprs.empty()) {
+        if (isConst) {
+            int32_t value = 0;
+            if (initVal && initVal->expr) c.Fold(Unwrap(initVal->expr), value);
+            b.type = Binding::Type::Imm;
+            b.value = isChar ? (int8_t)value : value;
+        } else {
+            int reg = top;
+            b.type = Binding::Type::Reg;
+            b.value = reg;
+            if (initVal && initVal->expr) {
+                Val v = Expr(Unwrap(initVal->expr), isChar ? -1 : reg);
+                SetTop(reg + 1);
+                if (isChar && v.imm) Emit(Op::Li, reg, (int8_t)v.v);
+                else if (isChar) Emit(Op::Sext8, reg, v.v);
+                else Place(v, reg);
+            }
+            SetTop(reg + 1);
+        }
+    } else {
+        uint64_t elements;
+        if (!c.ArrayDims(def->id, def->sizeExprs, b.dims, elements)) return;
+        int size = isChar ? 1 : 4;
+        uint64_t bytes = elements * size;
+        uint64_t offset = (fn.frameBytes + 3) & ~3u;
+        if (offset + bytes > VM::kMemoryBytes / 2) {
+            c.Error("local arrays of '" + fn.name + "' do not fit in the interpreter's memory");
+            return;
+        }
+        fn.frameBytes = (int)(offset + bytes);
+
+        int reg = Temp();
+        Emit(Op::Lea, reg, (int32_t)offset);
+        Emit(Op::Zero, reg, (int32_t)bytes);
+        if (initVal) {
+            auto flat = FlattenInit(b.dims, initVal);
+            for (size_t i = 0; i < flat.size() && i < elements; ++i) {
+                if (!flat[i]) continue;
+                Val v = Expr(flat[i]);
+                if (v.imm && v.v == 0) continue;
+                Emit(isChar ? Op::StbO : Op::StwO, InReg(v), reg, (int32_t)(i * size));
+                SetTop(reg + 1);
+            }
+        }
+        b.type = Binding::Type::Array;
+        b.inReg = true;
+        b.value = reg;
+    }
+    c.Bind(def->id, std::move(b));
+}
+
+void FunctionCompiler::Stmt(StmtAST* stmt) {
+    int saved = top;
+    switch (stmt->type) {
+    case StmtAST::TYPE::Assign:
+        Assign(stmt);
+        break;
+    case StmtAST::TYPE::Expr:
+        if (stmt->expr) Expr(stmt->expr.get());
+        break;
+    case StmtAST::TYPE::Block:
+        Block(stmt->block.get());
+        break;
+    case StmtAST::TYPE::If: {
+        // An `else if` ladder is compiled arm by arm in this loop.
+        vector<size_t> ends;
+        for (auto* arm = stmt;;) {
+            vector<size_t> skip;
+            Branch(arm->cond.get(), false, skip);
+            Stmt(arm->thenStmt.get());
+            if (!arm->elseStmt) {
+                Patch(skip, Here());
+                break;
+            }
+            ends.push_back(Emit(Op::Jmp));
+            Patch(skip, Here());
+            arm = arm->elseStmt.get();
+            if (arm->type != StmtAST::TYPE::If) {
+                Stmt(arm);
+                break;
+            }
+        }
+        Patch(ends, Here());
+        break;
+    }
+    case StmtAST::TYPE::Ret: {
+        if (!stmt->expr) {
+            Emit(Op::Ret0);
+            break;
+        }
+        Val v = Expr(stmt->expr.get());
+        if (def->funcType->GetType() == BaseType::TYPE::CHAR) {
+            if (v.imm) {
+                v.v = (int8_t)v.v;
+            } else {
+                int reg = Temp();
+                Emit(Op::Sext8, reg, v.v);
+                v = Reg(reg);
+            }
+        }
+        if (v.imm && v.v == 0) Emit(Op::Ret0);
+        else Emit(Op::Ret, InReg(v));
+        break;
+    }
+    // Loops are rotated: the condition is tested at the bottom, so every
+    // iteration ends in a single compare-branch back to the body.
+    case StmtAST::TYPE::While: {
+        size_t entry = Emit(Op::Jmp);
+        int32_t body = Here();
+        targets.push_back({{}, {}, true});
+        Stmt(stmt->thenStmt.get());
+        int32_t test = Here();
+        Patch({entry}, test);
+        vector<size_t> back;
+        Branch(stmt->cond.get(), true, back);
+        Patch(back, body);
+        EndLoop(test, Here());
+        break;
+    }
+    // `parallel for` runs serially, which is one of its valid schedules.
+    case StmtAST::TYPE::For: {
+        EnterScope();
+        if (stmt->forDecl) Declare(stmt->forDecl.get());
+        else if (stmt->forInitStmt) Stmt(stmt->forInitStmt.get());
+        size_t entry = Emit(Op::Jmp);
+        int32_t body = Here();
+        targets.push_back({{}, {}, true});
+        Stmt(stmt->thenStmt.get());
+        int32_t step = Here();
+        if (stmt->forStepStmt) Stmt(stmt->forStepStmt.get());
+        Patch({entry}, Here());
+        if (stmt->cond) {
+            vector<size_t> back;
+            Branch(stmt->cond.get(), true, back);
+            Patch(back, body);
+        } else {
+            Emit(Op::Jmp, body);
+        }
+        EndLoop(step, Here());
+        ExitScope();
+        break;
+    }
+    case StmtAST::TYPE::Break:
+        if (targets.empty()) c.Error("'break' outside of a loop or switch");
+        else targets.back().breaks.push_back(Emit(Op::Jmp));
+        break;
+    case StmtAST::TYPE::Continue: {
+        auto loop = std::find_if(targets.rbegin(), targets.rend(), [](auto& t) { return t.loop; });
+        if (loop == targets.rend()) c.Error("'continue' outside of a loop");
+        else loop->continues.push_back(Emit(Op::Jmp));
+        break;
+    }
+    case StmtAST::TYPE::Switch: {
+        int value = InReg(Expr(stmt->expr.get()));
+        // The table's slot is taken now: switches in the cases add their own.
+        int index = (int)fn.switches.size();
+        fn.switches.emplace_back();
+        Emit(Op::Switch, value, index);
+
+        SwitchTable table;
+        bool hasDefault = false;
+        std::set<int32_t> seen;
+        targets.push_back({{}, {}, false});
+        EnterScope();
+        for (auto& label : stmt->cases) {
+            if (!label->value) {
+                if (hasDefault) c.Error("multiple 'default' labels in one switch");
+                hasDefault = true;
+                table.defaultTarget = Here();
+            } else if (int32_t v; c.Fold(Unwrap(label->value), v)) {
+                if (!seen.insert(v).second) c.Error("duplicate case value " + std::to_string(v));
+                else table.cases.push_back({v, Here()});
+            }
+            Items(label->items);
+        }
+        ExitScope();
+        if (!hasDefault) table.defaultTarget = Here();
+        std::sort(table.cases.begin(), table.cases.end());
+        fn.switches[index] = std::move(table);
+        EndLoop(0, Here());
+        break;
+    }
+    }
+    SetTop(saved);
+}
+
+void FunctionCompiler::EndLoop(int32_t next, int32_t end) {
+    Patch(targets.back().continues, next);
+    Patch(targets.back().breaks, end);
+    targets.pop_back();
+}
+
+// The target's indices are evaluated before the value, as in CodeGen.
+void FunctionCompiler::Assign(StmtAST* stmt) {
+    auto* lval = stmt->lval.get();
+    const Binding& b = c.Lookup(lval->id);
+    if (b.type == Binding::Type::None) {
+        c.Error("use of undeclared identifier '" + c.Name(lval->id) + "'");
+        return;
+    }
+    if (b.isConst) {
+        c.Error("assignment to constant '" + c.Name(lval->id) + "'");
+        return;
+    }
+    if (b.type != Binding::Type::Array && !lval->indies.empty()) {
+        c.Error("subscript of scalar '" + c.Name(lval->id) + "'");
+        return;
+    }
+
+    if (b.type == Binding::Type::Reg) {
+        Val v = Expr(stmt->expr.get(), b.isChar ? -1 : b.value);
+        if (b.isChar && v.imm) Emit(Op::Li, b.value, (int8_t)v.v);
+        else if (b.isChar) Emit(Op::Sext8, b.value, v.v);
+        else Place(v, b.value);
+        return;
+    }
+    if (b.type == Binding::Type::Global) {
+        if (AddInPlace(stmt, b, nullptr)) return;
+        int value = InReg(Expr(stmt->expr.get()));
+        Emit(b.isChar ? Op::Stgb : Op::Stg, value, b.value);
+        return;
+    }
+
+    Ref ref;
+    if (!Locate(lval, b, ref)) return;
+    if (ref.whole) {
+        c.Error("cannot assign to array '" + c.Name(lval->id) + "'");
+        return;
+    }
+    if (AddInPlace(stmt, b, &ref)) return;
+    int value = InReg(Expr(stmt->expr.get()));
+    int size = b.isChar ? 1 : 4;
+    if (!b.inReg) {
+        if (ref.index < 0) Emit(b.isChar ? Op::Stgb : Op::Stg, value, Wrap(b.value + (int64_t)ref.offset * size));
+        else Emit(b.isChar ? Op::StgbX : Op::StgX, value, ref.index, b.value);
+    } else {
+        if (ref.index < 0) Emit(b.isChar ? Op::StbO : Op::StwO, value, b.value, Wrap((int64_t)ref.offset * size));
+        else Emit(b.isChar ? Op::Stb : Op::Stw, value, b.value, ref.index);
+    }
+}
+
+// `m = m + e`, `m = e + m` and `m = m - k` on an int in memory, as one
+// load-add-store. Only when nothing in the statement makes a call, so that
+// evaluating `e` before loading `m` (and the indices once) is unobservable.
+bool FunctionCompiler::AddInPlace(StmtAST* stmt, const Binding& b, const Ref* ref) {
+    auto* expr = stmt->expr.get();
+    if (b.isChar || (expr->kind != Kind::Add && expr->kind != Kind::Sub)) return false;
+    auto same = [&](ExprAST* e) { return e->kind == Kind::LVal && SameLVal(e->lval.get(), stmt->lval.get()); };
+    ExprAST* other = nullptr;
+    if (same(expr->lhs.get())) other = expr->rhs.get();
+    else if (expr->kind == Kind::Add && same(expr->rhs.get())) other = expr->lhs.get();
+    if (!other || HasCall(expr) || (expr->kind == Kind::Sub && other->kind != Kind::Number)) return false;
+
+    Val v = Expr(other);
+    if (expr->kind == Kind::Sub) v.v = Wrap(-(int64_t)v.v);
+    if (!b.inReg && (!ref || ref->index < 0)) {
+        int32_t addr = ref ? Wrap(b.value + (int64_t)ref->offset * 4) : b.value;
+        if (v.imm) Emit(Op::AddGI, v.v, addr);
+        else Emit(Op::AddG, v.v, addr);
+    } else if (!b.inReg) {
+        Emit(Op::AddGX, InReg(v), ref->index, b.value);
+    } else {
+        int index = ref->index;
+        if (index < 0) index = InReg(Imm(ref->offset));
+        Emit(Op::AddM, InReg(v), b.value, index);
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+// ========== Interpreter ==========
+
+Interpreter::Interpreter(CompUnitAST& unit, Interner& names)
+    : unit(unit), names(names), program(std::make_unique<Program>()), vm(std::make_unique<VM>(*program)) {}
+
+Interpreter::~Interpreter() = default;
+
+bool Interpreter::Compile() {
+    Compiler compiler(unit, names, *program, *vm, diagnostics);
+    bool ok = compiler.Compile();
+    entry = compiler.Entry();
+    return ok;
+}
+
+const uint8_t* Interpreter::Image() const { return vm->Memory(); }
+
+bool Interpreter::Run(int& status) {
+    int32_t result;
+    if (!vm->Invoke(entry, {}, result)) {
+        fflush(stdout);
+        fprintf(diagnostics, "runtime error: %s\n", vm->Fault().c_str());
+        return false;
+    }
+    status = result;
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include "ast/ast.h"
+
+struct Program;
+class VM;
+
+// Direct execution of a parsed program (-interp), without LLVM.
+//
+// Compile() translates every function into register bytecode (see
+// bytecode.h) and lays out the globals, evaluating their initializers and
+// array dimensions as it goes; a call in a constant context is run on the
+// VM as soon as the functions it reaches are compiled. Run() then calls
+// `main` with printf and scanf built in. The semantics follow the LLVM
+// backend: wrap-around int arithmetic, chars truncated on store, shift
+// counts taken mod 32, and `parallel for` loops run serially.
+class Interpreter {
+public:
+    Interpreter(CompUnitAST& unit, Interner& names);
+    ~Interpreter();
+
+    // Where errors are reported; stderr by default.
+    void SetDiagnostics(FILE* out) { diagnostics = out; }
+
+    // Reports errors as `error: ...`; false if there were any.
+    bool Compile();
+    // Runs `main` and sets `status` to its result. A runtime fault is
+    // reported as `runtime error: ...` and returns false.
+    bool Run(int& status);
+
+    // After Compile(): the bytecode, and the memory holding the globals'
+    // initial values (the first GetProgram().globalBytes bytes), for a
+    // backend that lowers the bytecode further.
+    const Program& GetProgram() const { return *program; }
+    const uint8_t* Image() const;
+
+private:
+    CompUnitAST& unit;
+    Interner& names;
+    std::unique_ptr<Program> program;
+    std::unique_ptr<VM> vm;
+    int entry = -1;
+    FILE* diagnostics = stderr;
+};
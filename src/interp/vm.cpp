@@ -0,0 +1,469 @@
+#include "interp/vm.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+
+namespace {
+
+// Zeroed pages that are only backed once they are written.
+void* Reserve(size_t bytes) {
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+inline int32_t LoadWord(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline void StoreWord(uint8_t* p, int32_t v) { memcpy(p, &v, 4); }
+
+inline int32_t Wrap(uint32_t v) { return (int32_t)v; }
+
+} // anonymous namespace
+
+VM::VM(const Program& program) : program(program) {
+    memory = (uint8_t*)Reserve(kMemoryBytes);
+    registers = (int32_t*)Reserve(kRegisters * sizeof(int32_t));
+}
+
+VM::~VM() {
+    if (memory) munmap(memory, kMemoryBytes);
+    if (registers) munmap(registers, kRegisters * sizeof(int32_t));
+}
+
+bool VM::Fail(const std::string& message) {
+    fault = message;
+    return false;
+}
+
+bool VM::Invoke(int func, const std::vector<int32_t>& args, int32_t& result) {
+    if (!memory || !registers) return Fail("cannot reserve interpreter memory");
+    const Function* callee = &program.functions[func];
+    if ((uint32_t)callee->registers > kRegisters) return Fail("stack overflow");
+    std::copy(args.begin(), args.end(), registers);
+    frames.clear();
+    fault.clear();
+    return Execute(callee, result);
+}
+
+// With GCC and Clang every handler jumps straight to the next one through
+// a table of label addresses; elsewhere the loop falls back to a switch.
+bool VM::Execute(const Function* func, int32_t& result) {
+    const Insn* code = func->code.data();
+    const Insn* ip = code;
+    uint32_t base = 0;
+    uint32_t stack = (program.globalBytes + 15) & ~15u;
+    int32_t* R = registers;
+    uint8_t* M = memory;
+    const char* error = nullptr;
+
+#if defined(__GNUC__)
+    static void* const kHandlers[] = {
+#define ZCC_OP_LABEL(name) &&op_##name,
+        ZCC_BYTECODE_OPS(ZCC_OP_LABEL)
+#undef ZCC_OP_LABEL
+    };
+#define OP(name) op_##name:
+#define DISPATCH() goto *kHandlers[(size_t)ip->op]
+#else
+#define OP(name) case Op::name:
+#define DISPATCH() continue
+#endif
+#define NEXT() { ++ip; DISPATCH(); }
+#define JUMP(target) { ip = code + (target); DISPATCH(); }
+#define FAULT(message) { error = message; goto fault; }
+// Bounds check for an access of `size` bytes at `addr`.
+#define CHECK(addr, size) if ((uint32_t)(addr) > kMemoryBytes - (size)) FAULT("memory access out of bounds")
+#define BINARY(name, expr) OP(name) { int32_t x = R[ip->b], y = R[ip->c]; R[ip->a] = (expr); NEXT(); }
+#define BRANCH(name, cmp) OP(name) { if (R[ip->a] cmp R[ip->b]) JUMP(ip->c); NEXT(); }
+#define BRANCH_IMM(name, cmp) OP(name) { if (R[ip->a] cmp ip->b) JUMP(ip->c); NEXT(); }
+
+#if defined(__GNUC__)
+    DISPATCH();
+#else
+    for (;;) {
+    switch (ip->op) {
+#endif
+
+    OP(Mov)  { R[ip->a] = R[ip->b]; NEXT(); }
+    OP(Li)   { R[ip->a] = ip->b; NEXT(); }
+    OP(Lea)  { R[ip->a] = (int32_t)(stack + ip->b); NEXT(); }
+
+    BINARY(Add, Wrap((uint32_t)x + (uint32_t)y))
+    BINARY(Sub, Wrap((uint32_t)x - (uint32_t)y))
+    BINARY(Mul, Wrap((uint32_t)x * (uint32_t)y))
+    OP(Div) {
+        int32_t x = R[ip->b], y = R[ip->c];
+        if (y == 0) FAULT("division by zero");
+        if (x == INT32_MIN && y == -1) FAULT("division overflow");
+        R[ip->a] = x / y;
+        NEXT();
+    }
+    OP(Mod) {
+        int32_t x = R[ip->b], y = R[ip->c];
+        if (y == 0) FAULT("division by zero");
+        if (x == INT32_MIN && y == -1) FAULT("division overflow");
+        R[ip->a] = x % y;
+        NEXT();
+    }
+    BINARY(And, x & y)
+    BINARY(Or,  x | y)
+    BINARY(Xor, x ^ y)
+    // Shift counts are taken mod 32, as the hardware does.
+    BINARY(Shl, Wrap((uint32_t)x << (y & 31)))
+    BINARY(Shr, x >> (y & 31))
+    BINARY(Lt, x < y)
+    BINARY(Le, x <= y)
+    BINARY(Gt, x > y)
+    BINARY(Ge, x >= y)
+    BINARY(Eq, x == y)
+    BINARY(Ne, x != y)
+    OP(AddI) { R[ip->a] = Wrap((uint32_t)R[ip->b] + (uint32_t)ip->c); NEXT(); }
+    OP(MulI) { R[ip->a] = Wrap((uint32_t)R[ip->b] * (uint32_t)ip->c); NEXT(); }
+    OP(Neg)    { R[ip->a] = Wrap(0u - (uint32_t)R[ip->b]); NEXT(); }
+    OP(Not)    { R[ip->a] = R[ip->b] == 0; NEXT(); }
+    OP(BitNot) { R[ip->a] = ~R[ip->b]; NEXT(); }
+    OP(Bool)   { R[ip->a] = R[ip->b] != 0; NEXT(); }
+    OP(Sext8)  { R[ip->a] = (int8_t)R[ip->b]; NEXT(); }
+
+    OP(Ldw) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)R[ip->c] * 4;
+        CHECK(addr, 4);
+        R[ip->a] = LoadWord(M + addr);
+        NEXT();
+    }
+    OP(Ldb) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)R[ip->c];
+        CHECK(addr, 1);
+        R[ip->a] = (int8_t)M[addr];
+        NEXT();
+    }
+    OP(Stw) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)R[ip->c] * 4;
+        CHECK(addr, 4);
+        StoreWord(M + addr, R[ip->a]);
+        NEXT();
+    }
+    OP(Stb) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)R[ip->c];
+        CHECK(addr, 1);
+        M[addr] = (uint8_t)R[ip->a];
+        NEXT();
+    }
+    OP(LdwO) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)ip->c;
+        CHECK(addr, 4);
+        R[ip->a] = LoadWord(M + addr);
+        NEXT();
+    }
+    OP(LdbO) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)ip->c;
+        CHECK(addr, 1);
+        R[ip->a] = (int8_t)M[addr];
+        NEXT();
+    }
+    OP(StwO) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)ip->c;
+        CHECK(addr, 4);
+        StoreWord(M + addr, R[ip->a]);
+        NEXT();
+    }
+    OP(StbO) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)ip->c;
+        CHECK(addr, 1);
+        M[addr] = (uint8_t)R[ip->a];
+        NEXT();
+    }
+    OP(Ldg)  { CHECK(ip->b, 4); R[ip->a] = LoadWord(M + ip->b); NEXT(); }
+    OP(Ldgb) { CHECK(ip->b, 1); R[ip->a] = (int8_t)M[ip->b]; NEXT(); }
+    OP(Stg)  { CHECK(ip->b, 4); StoreWord(M + ip->b, R[ip->a]); NEXT(); }
+    OP(Stgb) { CHECK(ip->b, 1); M[ip->b] = (uint8_t)R[ip->a]; NEXT(); }
+    OP(LdgX) {
+        uint32_t addr = (uint32_t)ip->c + (uint32_t)R[ip->b] * 4;
+        CHECK(addr, 4);
+        R[ip->a] = LoadWord(M + addr);
+        NEXT();
+    }
+    OP(LdgbX) {
+        uint32_t addr = (uint32_t)ip->c + (uint32_t)R[ip->b];
+        CHECK(addr, 1);
+        R[ip->a] = (int8_t)M[addr];
+        NEXT();
+    }
+    OP(StgX) {
+        uint32_t addr = (uint32_t)ip->c + (uint32_t)R[ip->b] * 4;
+        CHECK(addr, 4);
+        StoreWord(M + addr, R[ip->a]);
+        NEXT();
+    }
+    OP(StgbX) {
+        uint32_t addr = (uint32_t)ip->c + (uint32_t)R[ip->b];
+        CHECK(addr, 1);
+        M[addr] = (uint8_t)R[ip->a];
+        NEXT();
+    }
+    OP(Zero) {
+        uint32_t addr = (uint32_t)R[ip->a];
+        if ((uint64_t)addr + (uint32_t)ip->b > kMemoryBytes) FAULT("memory access out of bounds");
+        memset(M + addr, 0, (uint32_t)ip->b);
+        NEXT();
+    }
+
+    OP(AddM) {
+        uint32_t addr = (uint32_t)R[ip->b] + (uint32_t)R[ip->c] * 4;
+        CHECK(addr, 4);
+        StoreWord(M + addr, Wrap((uint32_t)LoadWord(M + addr) + (uint32_t)R[ip->a]));
+        NEXT();
+    }
+    OP(AddGX) {
+        uint32_t addr = (uint32_t)ip->c + (uint32_t)R[ip->b] * 4;
+        CHECK(addr, 4);
+        StoreWord(M + addr, Wrap((uint32_t)LoadWord(M + addr) + (uint32_t)R[ip->a]));
+        NEXT();
+    }
+    OP(AddG) {
+        CHECK(ip->b, 4);
+        StoreWord(M + ip->b, Wrap((uint32_t)LoadWord(M + ip->b) + (uint32_t)R[ip->a]));
+        NEXT();
+    }
+    OP(AddGI) {
+        CHECK(ip->b, 4);
+        StoreWord(M + ip->b, Wrap((uint32_t)LoadWord(M + ip->b) + (uint32_t)ip->a));
+        NEXT();
+    }
+
+    OP(Jmp) JUMP(ip->a)
+    OP(Jz)  { if (R[ip->a] == 0) JUMP(ip->b); NEXT(); }
+    OP(Jnz) { if (R[ip->a] != 0) JUMP(ip->b); NEXT(); }
+    BRANCH(JLt, <)
+    BRANCH(JLe, <=)
+    BRANCH(JGt, >)
+    BRANCH(JGe, >=)
+    BRANCH(JEq, ==)
+    BRANCH(JNe, !=)
+    BRANCH_IMM(JLtI, <)
+    BRANCH_IMM(JLeI, <=)
+    BRANCH_IMM(JGtI, >)
+    BRANCH_IMM(JGeI, >=)
+    BRANCH_IMM(JEqI, ==)
+    BRANCH_IMM(JNeI, !=)
+    OP(Switch) {
+        auto& table = func->switches[ip->b];
+        int32_t value = R[ip->a];
+        auto it = std::lower_bound(table.cases.begin(), table.cases.end(), std::make_pair(value, INT32_MIN));
+        JUMP(it != table.cases.end() && it->first == value ? it->second : table.defaultTarget);
+    }
+
+    OP(Call) {
+        const Function* callee = &program.functions[ip->a];
+        uint32_t calleeBase = base + ip->b;
+        uint32_t calleeStack = stack + func->frameBytes;
+        if (calleeBase + callee->registers > kRegisters || calleeStack + callee->frameBytes > kMemoryBytes)
+            FAULT("stack overflow");
+        frames.push_back({func, ip, base, stack});
+        func = callee;
+        code = ip = func->code.data();
+        base = calleeBase;
+        stack = calleeStack;
+        R = registers + base;
+        DISPATCH();
+    }
+    OP(Printf) {
+        if (!Printf(R + ip->a, ip->b, R[ip->a])) goto fault;
+        NEXT();
+    }
+    OP(Scanf) {
+        if (!Scanf(R + ip->a, ip->b, R[ip->a])) goto fault;
+        NEXT();
+    }
+    // The callee's first register is where the caller expects the result.
+    OP(Ret)  { R[0] = R[ip->a]; goto leave; }
+    OP(Ret0) { R[0] = 0; goto leave; }
+
+#if !defined(__GNUC__)
+    }
+#endif
+
+leave:
+    if (frames.empty()) {
+        result = R[0];
+        return true;
+    }
+    {
+        Frame frame = frames.back();
+        frames.pop_back();
+        func = frame.func;
+        code = func->code.data();
+        ip = frame.call;
+        base = frame.base;
+        stack = frame.stack;
+        R = registers + base;
+    }
+    NEXT();
+
+fault:
+    if (error) fault = error;
+    fault += " in '" + func->name + "'";
+    return false;
+
+#if !defined(__GNUC__)
+    }
+#endif
+
+#undef OP
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef FAULT
+#undef CHECK
+#undef BINARY
+#undef BRANCH
+#undef BRANCH_IMM
+}
+
+bool VM::CString(int32_t addr, const char*& out) {
+    if ((uint32_t)addr >= kMemoryBytes) return Fail("string pointer out of bounds");
+    if (!memchr(memory + (uint32_t)addr, 0, kMemoryBytes - (uint32_t)addr)) return Fail("unterminated string");
+    out = (const char*)memory + (uint32_t)addr;
+    return true;
+}
+
+// Each conversion is handed to the host printf on its own, with any `*`
+// width or precision spelled out, so the formatting is libc's.
+bool VM::Printf(const int32_t* args, int count, int32_t& result) {
+    const char* format;
+    if (!CString(args[0], format)) return false;
+    int next = 1;
+    auto arg = [&]() { return next < count ? args[next++] : 0; };
+
+    long written = 0;
+    for (const char* p = format; *p;) {
+        if (*p != '%') {
+            size_t n = strcspn(p, "%");
+            written += fwrite(p, 1, n, stdout);
+            p += n;
+            continue;
+        }
+
+        std::string spec = "%";
+        const char* s = p + 1;
+        while (*s && strchr("-+ #0", *s)) spec += *s++;
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1) {
+                if (*s != '.') break;
+                spec += *s++;
+            }
+            if (*s == '*') {
+                spec += std::to_string(arg());
+                ++s;
+            }
+            while (*s >= '0' && *s <= '9') spec += *s++;
+        }
+        while (*s && strchr("hlLqjzt", *s)) ++s;   // every argument is an int
+
+        char conv = *s;
+        if (!conv) {
+            written += fwrite(p, 1, s - p, stdout);
+            break;
+        }
+        p = s + 1;
+        spec += conv;
+        switch (conv) {
+        case 'd': case 'i': case 'c':
+            written += fprintf(stdout, spec.c_str(), arg());
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            written += fprintf(stdout, spec.c_str(), (unsigned)arg());
+            break;
+        case 's': {
+            const char* str;
+            if (!CString(arg(), str)) return false;
+            written += fprintf(stdout, spec.c_str(), str);
+            break;
+        }
+        case 'p':
+            written += fprintf(stdout, "%#x", (unsigned)arg());
+            break;
+        case '%':
+            written += fputc('%', stdout) != EOF;
+            break;
+        default:
+            written += fwrite(spec.data(), 1, spec.size(), stdout);
+            break;
+        }
+    }
+    result = (int32_t)written;
+    return true;
+}
+
+// The format is cut after each conversion, and each piece (with the text
+// before it) goes to the host scanf. Integers are read into a local and
+// stored as a word; `%c` and `%s` read straight into memory, with `%s`
+// bounded by the memory that is left.
+bool VM::Scanf(const int32_t* args, int count, int32_t& result) {
+    const char* format;
+    if (!CString(args[0], format)) return false;
+    int next = 1;
+    int assigned = 0;
+    std::string piece;
+
+    result = 0;
+    for (const char* p = format; *p;) {
+        if (*p != '%' || p[1] == '%') {
+            piece += *p;
+            if (*p++ == '%') piece += *p++;
+            continue;
+        }
+
+        const char* s = p + 1;
+        bool suppress = *s == '*';
+        if (suppress) ++s;
+        int width = 0;
+        while (*s >= '0' && *s <= '9') width = width * 10 + (*s++ - '0');
+        while (*s && strchr("hlLqjzt", *s)) ++s;
+        char conv = *s;
+        if (!conv || !strchr("diuoxXcs", conv)) break;
+        p = s + 1;
+
+        int32_t addr = suppress ? 0 : (next < count ? args[next++] : -1);
+        uint32_t room = (uint32_t)addr < kMemoryBytes ? kMemoryBytes - (uint32_t)addr : 0;
+        if (conv == 's' && !suppress) {
+            if (room < 2) return Fail("scanf destination out of bounds");
+            width = (int)std::min<uint32_t>(width ? width : INT_MAX, room - 1);
+        }
+        if (conv == 'c' && !width) width = 1;
+
+        piece += suppress ? "%*" : "%";
+        if (width) piece += std::to_string(width);
+        piece += conv;
+
+        int got;
+        if (suppress) {
+            got = scanf(piece.c_str(), nullptr);   // the argument is unused
+        } else if (conv == 'c' || conv == 's') {
+            if (room < (uint32_t)width + (conv == 's')) return Fail("scanf destination out of bounds");
+            got = scanf(piece.c_str(), (char*)memory + addr);
+        } else {
+            if (room < 4) return Fail("scanf destination out of bounds");
+            int value;
+            got = scanf(piece.c_str(), &value);
+            if (got == 1) StoreWord(memory + addr, value);
+        }
+        piece.clear();
+
+        if (got == EOF) {
+            result = assigned ? assigned : EOF;
+            return true;
+        }
+        if (got < !suppress) break;
+        assigned += !suppress;
+        result = assigned;
+    }
+    if (!piece.empty()) scanf(piece.c_str(), nullptr);
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "interp/bytecode.h"
+
+// Executes the bytecode of a Program. Memory and registers are reserved up
+// front (the pages are only touched as they are used); every memory access
+// is bounds-checked, and faults such as division by zero stop the run with
+// a message instead of crashing the host.
+class VM {
+public:
+    static constexpr uint32_t kMemoryBytes = 1u << 28;
+    static constexpr uint32_t kRegisters = 1u << 22;
+
+    explicit VM(const Program& program);
+    ~VM();
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    // Call function `func` with `args`. The functions it can reach must all
+    // have been compiled. Returns false, with Fault() set, on a runtime error.
+    bool Invoke(int func, const std::vector<int32_t>& args, int32_t& result);
+    const std::string& Fault() const { return fault; }
+
+    uint8_t* Memory() { return memory; }
+
+private:
+    struct Frame {
+        const Function* func;
+        const Insn* call;   // the Call instruction to resume after
+        uint32_t base;      // register window
+        uint32_t stack;     // frame memory
+    };
+
+    bool Execute(const Function* func, int32_t& result);
+    bool CString(int32_t addr, const char*& out);
+    bool Printf(const int32_t* args, int count, int32_t& result);
+    bool Scanf(const int32_t* args, int count, int32_t& result);
+    bool Fail(const std::string& message);
+
+    const Program& program;
+    uint8_t* memory;
+    int32_t* registers;
+    std::vector<Frame> frames;
+    std::string fault;
+};
@@ -1,13 +1,25 @@
 #include "codegen.h"
 
 #include "llvm/Passes/PassBuilder.h"
-#include "llvm/Transforms/Scalar/ADCE.h"
-#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Regex.h"
 #include "llvm/Support/raw_os_ostream.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
+#include "llvm/IR/ProfileSummary.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "profile.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
+#include "util/timing.h"
 
+#include <cstdio>
 #include <fstream>
+#include <optional>
 
 // --- Lifecycle ---
 
@@ -16,9 +28,27 @@ CodeGen::CodeGen(const std::string& moduleName)
     EnterScope();
 }
 
+void CodeGen::SetOptLevel(unsigned level) { optLevel = level; }
+
 void CodeGen::Optimize() {
-#if 0
-    llvm::PassBuilder pb;
+    TimeScope timer("Optimize");
+    if (debug) debug->finalize();
+    if (optLevel == 0) return;
+
+    // Each pass is timed as a phase of its own.
+    llvm::PassInstrumentationCallbacks pic;
+    auto passTimers = std::make_shared<std::vector<std::unique_ptr<TimeScope>>>();
+    pic.registerBeforeNonSkippedPassCallback([passTimers](llvm::StringRef pass, llvm::Any) {
+        passTimers->push_back(std::make_unique<TimeScope>(std::string_view(pass.data(), pass.size())));
+    });
+    pic.registerAfterPassCallback([passTimers](llvm::StringRef, llvm::Any, const llvm::PreservedAnalyses&) {
+        passTimers->pop_back();
+    });
+    pic.registerAfterPassInvalidatedCallback([passTimers](llvm::StringRef, const llvm::PreservedAnalyses&) {
+        passTimers->pop_back();
+    });
+
+    llvm::PassBuilder pb(nullptr, llvm::PipelineTuningOptions(), llvm::None, &pic);
     llvm::FunctionAnalysisManager fam;
     llvm::ModuleAnalysisManager mam;
     llvm::CGSCCAnalysisManager cgam;
@@ -30,26 +60,32 @@ void CodeGen::Optimize() {
     pb.registerLoopAnalyses(lam);
     pb.crossRegisterProxies(lam, fam, cgam, mam);
 
-    llvm::FunctionPassManager fpm;
-    fpm.addPass(llvm::ADCEPass());
-    fpm.addPass(llvm::SimplifyCFGPass());
-
-    llvm::ModulePassManager mpm;
-    mpm.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(fpm)));
+    auto level = optLevel == 1 ? llvm::OptimizationLevel::O1
+               : optLevel == 2 ? llvm::OptimizationLevel::O2 : llvm::OptimizationLevel::O3;
+    llvm::ModulePassManager mpm = pb.buildPerModuleDefaultPipeline(level);
     mpm.run(Module, mam);
-#endif
 }
 
 void CodeGen::Print() {
     Module.print(llvm::outs(), nullptr);
 }
 
+std::string CodeGen::IR() {
+    std::string text;
+    llvm::raw_string_ostream out(text);
+    Module.print(out, nullptr);
+    out.flush();
+    return text;
+}
+
 void CodeGen::Dump(const char* output) {
     std::ofstream outFile(output);
     llvm::raw_os_ostream rawOutFile(outFile);
     Module.print(rawOutFile, nullptr);
 }
 
+llvm::Module& CodeGen::GetModule() { return Module; }
+
 // --- Types ---
 
 llvm::FunctionType* CodeGen::CreateFuncType(llvm::Type* retType, std::vector<llvm::Type*> params) {
@@ -102,6 +138,10 @@ llvm::Type* CodeGen::GetAllocatedType(llvm::Value* value) {
     return nullptr;
 }
 
+uint64_t CodeGen::GetTypeSize(llvm::Type* type) {
+    return Module.getDataLayout().getTypeAllocSize(type);
+}
+
 bool CodeGen::IsArrayType(llvm::Type* type)   { return type->isArrayTy(); }
 bool CodeGen::IsPointerType(llvm::Type* type) { return type->isPointerTy(); }
 
@@ -119,6 +159,7 @@ llvm::Function* CodeGen::CreateFunction(llvm::FunctionType* funcType, const std:
         ++args;
     }
     AddSymbol(name, { .function = func, .kind = VAR_TYPE::FUNC });
+    AttachSubprogram(func, false);
     return func;
 }
 
@@ -128,6 +169,17 @@ void CodeGen::CreateBuiltin(const std::string& name, llvm::Type* retType, std::v
     AddSymbol(name, { .function = func, .kind = VAR_TYPE::FUNC });
 }
 
+llvm::Function* CodeGen::CreateHelperFunction(llvm::FunctionType* funcType, const std::string& name) {
+    auto* func = llvm::Function::Create(funcType, llvm::Function::InternalLinkage, name, &Module);
+    AttachSubprogram(func, true);
+    return func;
+}
+
+llvm::Function* CodeGen::GetRuntimeFunction(const std::string& name, llvm::FunctionType* funcType) {
+    if (auto* func = Module.getFunction(name)) return func;
+    return llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, name, &Module);
+}
+
 llvm::Function* CodeGen::GetFunction() {
     return Builder.GetInsertBlock()->getParent();
 }
@@ -145,7 +197,28 @@ llvm::Value* CodeGen::CreateAlloca(llvm::Type* type, const std::string& name) {
     return Builder.CreateAlloca(type, nullptr, name);
 }
 
-llvm::Value* CodeGen::CreateGlobal(llvm::Type* type, const std::string& name, llvm::Value* init) {
+llvm::Value* CodeGen::CreateLocalArray(llvm::Type* type, const std::string& name) {
+    if (!staticLocalLimit || !staticLocalsAllowed || GetTypeSize(type) < staticLocalLimit)
+        return CreateAlloca(type, name);
+    auto* func = GetFunction();
+    return new llvm::GlobalVariable(Module, type, false, llvm::GlobalValue::InternalLinkage,
+                                    llvm::Constant::getNullValue(type),
+                                    func->getName() + "." + name);
+}
+
+bool CodeGen::IsAllocaSlot(llvm::Value* value) { return llvm::isa<llvm::AllocaInst>(value); }
+
+void CodeGen::CreateMemZero(llvm::Value* dest, llvm::Type* type) {
+    auto& layout = Module.getDataLayout();
+    Builder.CreateMemSet(dest, GetInt8(0), layout.getTypeAllocSize(type), layout.getABITypeAlign(type));
+}
+
+void CodeGen::SetStaticLocalLimit(uint64_t bytes) { staticLocalLimit = bytes; }
+uint64_t CodeGen::GetStaticLocalLimit() const { return staticLocalLimit; }
+void CodeGen::SetStaticLocalsAllowed(bool allowed) { staticLocalsAllowed = allowed; }
+bool CodeGen::GetStaticLocalsAllowed() const { return staticLocalsAllowed; }
+
+llvm::Value* CodeGen::CreateGlobal(llvm::Type* type, const std::string& name, llvm::Value* init, bool isConst) {
     llvm::Constant* initVal = init ? llvm::dyn_cast<llvm::Constant>(init) : nullptr;
     // A scalar initializer is produced as i32; narrow it to the global's type
     // (e.g. an i8 `char` global) so the GlobalVariable type and init agree.
@@ -154,7 +227,7 @@ llvm::Value* CodeGen::CreateGlobal(llvm::Type* type, const std::string& name, ll
             initVal = llvm::ConstantInt::get(type, ci->getSExtValue());
     }
     if (!initVal) initVal = llvm::Constant::getNullValue(type);
-    return new llvm::GlobalVariable(Module, type, false, llvm::GlobalValue::ExternalLinkage, initVal, name);
+    return new llvm::GlobalVariable(Module, type, isConst, llvm::GlobalValue::ExternalLinkage, initVal, name);
 }
 
 void CodeGen::CreateStore(llvm::Value* value, llvm::Value* dest) {
@@ -241,6 +314,21 @@ llvm::Value* CodeGen::CreateDiv(llvm::Value* lhs, llvm::Value* rhs) { return Bui
 llvm::Value* CodeGen::CreateMod(llvm::Value* lhs, llvm::Value* rhs) { return Builder.CreateSRem(lhs, rhs); }
 llvm::Value* CodeGen::CreateAnd(llvm::Value* lhs, llvm::Value* rhs) { return Builder.CreateAnd(lhs, rhs); }
 llvm::Value* CodeGen::CreateOr(llvm::Value* lhs, llvm::Value* rhs)  { return Builder.CreateOr(lhs, rhs); }
+llvm::Value* CodeGen::CreateXor(llvm::Value* lhs, llvm::Value* rhs) { return Builder.CreateXor(lhs, rhs); }
+// Shift counts are taken mod 32, as the constant folders and the VM do; an
+// unmasked count of 32 or more would make the result poison.
+llvm::Value* CodeGen::CreateShl(llvm::Value* lhs, llvm::Value* rhs) {
+    return Builder.CreateShl(lhs, Builder.CreateAnd(rhs, 31));
+}
+llvm::Value* CodeGen::CreateShr(llvm::Value* lhs, llvm::Value* rhs) {
+    return Builder.CreateAShr(lhs, Builder.CreateAnd(rhs, 31));
+}
+llvm::Value* CodeGen::CreateNot(llvm::Value* value) { return Builder.CreateNot(value); }
+
+void CodeGen::CreateAtomicAdd(llvm::Value* ptr, llvm::Value* value) {
+    Builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, ptr, value, llvm::MaybeAlign(),
+                            llvm::AtomicOrdering::SequentiallyConsistent);
+}
 
 // --- Comparisons ---
 
@@ -265,14 +353,79 @@ llvm::Value* CodeGen::CreateICmpGE(llvm::Value* lhs, llvm::Value* rhs) {
 
 // --- Control flow ---
 
+namespace {
+
+// The outcome a condition was marked with by likely()/unlikely(), looking
+// through the extensions and comparisons against zero that turn an i32
+// expression value into an i1 branch condition.
+std::optional<bool> ExpectedOutcome(llvm::Value* cond) {
+    bool negated = false;
+    for (;;) {
+        if (auto* ext = llvm::dyn_cast<llvm::ZExtInst>(cond)) {
+            cond = ext->getOperand(0);
+            continue;
+        }
+        auto* cmp = llvm::dyn_cast<llvm::ICmpInst>(cond);
+        auto* zero = cmp ? llvm::dyn_cast<llvm::ConstantInt>(cmp->getOperand(1)) : nullptr;
+        if (zero && zero->isZero() && cmp->isEquality()) {
+            negated ^= cmp->getPredicate() == llvm::ICmpInst::ICMP_EQ;
+            cond = cmp->getOperand(0);
+            continue;
+        }
+        break;
+    }
+    auto* expect = llvm::dyn_cast<llvm::IntrinsicInst>(cond);
+    if (!expect || expect->getIntrinsicID() != llvm::Intrinsic::expect) return std::nullopt;
+    auto* expected = llvm::dyn_cast<llvm::ConstantInt>(expect->getArgOperand(1));
+    if (!expected) return std::nullopt;
+    return !expected->isZero() != negated;
+}
+
+// Same ratio as LLVM's own lowering of llvm.expect.
+constexpr uint32_t kLikelyWeight = 2000, kUnlikelyWeight = 1;
+
+llvm::MDNode* BranchWeights(llvm::LLVMContext& context, llvm::Value* cond) {
+    auto outcome = ExpectedOutcome(cond);
+    if (!outcome) return nullptr;
+    return llvm::MDBuilder(context).createBranchWeights(*outcome ? kLikelyWeight : kUnlikelyWeight,
+                                                        *outcome ? kUnlikelyWeight : kLikelyWeight);
+}
+
+} // anonymous namespace
+
 void CodeGen::CreateCondBr(llvm::Value* cond, llvm::BasicBlock* trueBB, llvm::BasicBlock* falseBB) {
     auto* boolCond = Builder.CreateICmpNE(cond, GetInt32(0));
-    Builder.CreateCondBr(boolCond, trueBB, falseBB);
+    unsigned slot = profiled.slots;
+    if (profileMode == ProfileMode::Generate && profiled.func)
+        CountProfileSlot(Builder.CreateSelect(boolCond, Builder.getInt64(slot), Builder.getInt64(slot + 1)));
+    auto* br = Builder.CreateCondBr(boolCond, trueBB, falseBB, BranchWeights(Context, boolCond));
+    AddProfileSite(br, 2);
 }
 
 void CodeGen::CreateBr(llvm::BasicBlock* dest) { Builder.CreateBr(dest); }
 
+llvm::SwitchInst* CodeGen::CreateSwitch(llvm::Value* value, llvm::BasicBlock* defaultDest, unsigned numCases) {
+    if (profileMode == ProfileMode::Generate && profiled.func) defaultDest = CountingEdge(defaultDest, profiled.slots);
+    auto* inst = Builder.CreateSwitch(value, defaultDest, numCases);
+    AddProfileSite(inst, 1);
+    return inst;
+}
+
+void CodeGen::AddSwitchCase(llvm::SwitchInst* inst, int value, llvm::BasicBlock* dest) {
+    if (profiled.func && profileMode != ProfileMode::None) {
+        // Each case takes the slot after the switch's last one.
+        for (auto site = profileSites.rbegin(); site != profileSites.rend(); ++site) {
+            if (site->inst != inst) continue;
+            site->slots.push_back(profiled.slots++);
+            if (profileMode == ProfileMode::Generate) dest = CountingEdge(dest, site->slots.back());
+            break;
+        }
+    }
+    inst->addCase(llvm::cast<llvm::ConstantInt>(GetInt32(value)), dest);
+}
+
 void CodeGen::CreateRet(llvm::Value* value) {
+    if (cycleFunc && GetFunction() == cycleFunc) ExitCycleProfile();
     if (value)
         Builder.CreateRet(value);
     else
@@ -290,7 +443,61 @@ llvm::Value* CodeGen::CreateCall(llvm::Function* func, std::vector<llvm::Value*>
     return Builder.CreateCall(func, args);
 }
 
-void CodeGen::SetInsertPoint(llvm::BasicBlock* bb) { Builder.SetInsertPoint(bb); }
+llvm::Value* CodeGen::CreateSelect(llvm::Value* cond, llvm::Value* trueVal, llvm::Value* falseVal) {
+    auto* boolCond = Builder.CreateICmpNE(cond, GetInt32(0));
+    auto* select = Builder.CreateSelect(boolCond, trueVal, falseVal);
+    if (auto* weights = BranchWeights(Context, boolCond))
+        llvm::cast<llvm::Instruction>(select)->setMetadata(llvm::LLVMContext::MD_prof, weights);
+    return select;
+}
+
+llvm::Value* CodeGen::CreateExpect(llvm::Value* value, bool expected) {
+    auto* truth = CreateICmpNE(value, GetInt32(0));
+    auto* expect = llvm::Intrinsic::getDeclaration(&Module, llvm::Intrinsic::expect, {GetInt32Type()});
+    return Builder.CreateCall(expect, {truth, GetInt32(expected)});
+}
+
+llvm::Value* CodeGen::CreatePhi(llvm::Value* a, llvm::BasicBlock* fromA, llvm::Value* b, llvm::BasicBlock* fromB) {
+    auto* phi = Builder.CreatePHI(a->getType(), 2);
+    phi->addIncoming(a, fromA);
+    phi->addIncoming(b, fromB);
+    return phi;
+}
+
+void CodeGen::SetInsertPoint(llvm::BasicBlock* bb) {
+    bool sameFunction = Builder.GetInsertBlock() && Builder.GetInsertBlock()->getParent() == bb->getParent();
+    Builder.SetInsertPoint(bb);
+    // The location's scope is the function; an outlined helper needs its own.
+    if (debug && !sameFunction) UpdateDebugLocation();
+}
+llvm::BasicBlock* CodeGen::GetInsertBlock() { return Builder.GetInsertBlock(); }
+
+llvm::Metadata* CodeGen::CreateLoopProperty(const std::string& name) {
+    return llvm::MDNode::get(Context, llvm::MDString::get(Context, name));
+}
+
+llvm::Metadata* CodeGen::CreateLoopProperty(const std::string& name, int value, unsigned bits) {
+    auto* constant = llvm::ConstantInt::get(llvm::Type::getIntNTy(Context, bits), value);
+    return llvm::MDNode::get(Context, {llvm::MDString::get(Context, name),
+                                       llvm::ConstantAsMetadata::get(constant)});
+}
+
+int CodeGen::SetLoopProperties(llvm::BasicBlock* header, llvm::BasicBlock* entry,
+                               const std::vector<llvm::Metadata*>& properties) {
+    // The first operand refers to the node itself, which keeps it distinct.
+    std::vector<llvm::Metadata*> operands{nullptr};
+    operands.insert(operands.end(), properties.begin(), properties.end());
+    auto* loopID = llvm::MDNode::getDistinct(Context, operands);
+    loopID->replaceOperandWith(0, loopID);
+
+    int latches = 0;
+    for (auto* pred : llvm::predecessors(header)) {
+        if (pred == entry) continue;
+        pred->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+        ++latches;
+    }
+    return latches;
+}
 
 bool CodeGen::EndWithTerminator() {
     auto* bb = Builder.GetInsertBlock();
@@ -331,29 +538,393 @@ llvm::Value* CodeGen::GetArrayElement(llvm::Value* array, int index) {
     return Builder.CreateGEP(arrayType->getElementType(), array, {GetInt32(index)});
 }
 
-llvm::Value* CodeGen::GetBaseValue(llvm::Value* value) { return value; }
+// The folded value behind a constant binding: a global const is bound to its
+// GlobalVariable, whose initializer holds the value. A mutable global's
+// initializer is only its first value, so it stays as it is.
+llvm::Value* CodeGen::GetBaseValue(llvm::Value* value) {
+    if (auto* gv = llvm::dyn_cast_or_null<llvm::GlobalVariable>(value))
+        if (gv->isConstant() && gv->hasInitializer()) return gv->getInitializer();
+    return value;
+}
+
+std::vector<int> CodeGen::FlattenConstant(llvm::Value* value) {
+    std::vector<int> flat;
+    std::function<void(llvm::Constant*)> walk = [&](llvm::Constant* c) {
+        if (auto* ci = llvm::dyn_cast<llvm::ConstantInt>(c)) {
+            flat.push_back(ci->getSExtValue());
+        } else if (auto* arrTy = llvm::dyn_cast<llvm::ArrayType>(c->getType())) {
+            for (unsigned i = 0; i < arrTy->getNumElements(); ++i)
+                walk(c->getAggregateElement(i));
+        }
+    };
+    if (auto* c = llvm::dyn_cast_or_null<llvm::Constant>(GetBaseValue(value)))
+        walk(c);
+    return flat;
+}
+
+std::vector<int> CodeGen::GetArrayDims(llvm::Type* type) {
+    std::vector<int> dims;
+    for (; type->isArrayTy(); type = type->getArrayElementType())
+        dims.push_back(type->getArrayNumElements());
+    return dims;
+}
 
 // --- Scope management ---
 
-void CodeGen::EnterScope() { locals.push_back({}); }
-void CodeGen::ExitScope()  { locals.pop_back(); }
-bool CodeGen::IsGlobalScope() const { return locals.size() == 1; }
+void CodeGen::EnterScope() { scopeStarts.push_back(undo.size()); }
+
+void CodeGen::ExitScope() {
+    for (size_t start = scopeStarts.back(); undo.size() > start; undo.pop_back())
+        bindings[undo.back().id] = undo.back().previous;
+    scopeStarts.pop_back();
+}
+
+bool CodeGen::IsGlobalScope() const { return scopeStarts.size() == 1; }
+Interner& CodeGen::GetNames() { return names; }
 
-void CodeGen::AddSymbol(const std::string& name, const Symbol& sym) {
-    locals.back()[name] = sym;
+void CodeGen::AddSymbol(SymbolId id, const Symbol& sym) {
+    if (id >= bindings.size()) bindings.resize(names.Size());
+    undo.push_back({id, bindings[id]});
+    bindings[id] = sym;
+    if (IsGlobalScope()) {
+        if (id >= globals.size()) globals.resize(names.Size());
+        globals[id] = sym;
+    }
+}
+
+void CodeGen::AddSymbol(const std::string& name, const Symbol& sym) { AddSymbol(names.Intern(name), sym); }
+
+const CodeGen::Symbol& CodeGen::GetSymbol(SymbolId id) const {
+    static const Symbol unbound;
+    return id < bindings.size() ? bindings[id] : unbound;
+}
+
+const CodeGen::Symbol& CodeGen::GetGlobalSymbol(SymbolId id) const {
+    static const Symbol unbound;
+    return id < globals.size() ? globals[id] : unbound;
+}
+
+// --- Compile-time evaluation ---
+
+void CodeGen::SetConstEval(ConstEval* eval) { constEval = eval; }
+ConstEval* CodeGen::GetConstEval() { return constEval; }
+
+// --- Diagnostics ---
+
+void CodeGen::Error(const std::string& message) {
+    fprintf(diagnostics, "error: %s\n", message.c_str());
+    ++errors;
+}
+
+void CodeGen::Warning(const std::string& message) {
+    fprintf(diagnostics, "warning: %s\n", message.c_str());
+}
+
+void CodeGen::Note(const std::string& message) {
+    fprintf(diagnostics, "note: %s\n", message.c_str());
+}
+
+int CodeGen::ErrorCount() const { return errors; }
+
+// --- Debug locations and remarks ---
+
+namespace {
+
+// Prints the remarks selected by -Rpass and friends in the form of the other
+// diagnostics, at the source location the instruction carries.
+class RemarkPrinter : public llvm::DiagnosticHandler {
+public:
+    RemarkPrinter(FILE* const& out, std::optional<llvm::Regex> passed, std::optional<llvm::Regex> missed,
+                  std::optional<llvm::Regex> analysis)
+        : out(out), passed(std::move(passed)), missed(std::move(missed)), analysis(std::move(analysis)) {}
+
+    bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override { return Matches(analysis, pass); }
+    bool isMissedOptRemarkEnabled(llvm::StringRef pass) const override { return Matches(missed, pass); }
+    bool isPassedOptRemarkEnabled(llvm::StringRef pass) const override { return Matches(passed, pass); }
+    bool isAnyRemarkEnabled() const override { return passed || missed || analysis; }
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+        auto* remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+        if (!remark) return false;
+        const char* flag = nullptr;
+        if (llvm::isa<llvm::OptimizationRemark>(remark) && isPassedOptRemarkEnabled(remark->getPassName()))
+            flag = "-Rpass";
+        else if (llvm::isa<llvm::OptimizationRemarkMissed>(remark) && isMissedOptRemarkEnabled(remark->getPassName()))
+            flag = "-Rpass-missed";
+        else if (llvm::isa<llvm::OptimizationRemarkAnalysis>(remark) && isAnalysisRemarkEnabled(remark->getPassName()))
+            flag = "-Rpass-analysis";
+        if (!flag) return true;
+
+        std::string where;
+        if (remark->isLocationAvailable()) {
+            auto loc = remark->getLocation();
+            where = loc.getRelativePath().str() + ":" + std::to_string(loc.getLine()) + ":" +
+                    std::to_string(loc.getColumn()) + ": ";
+        }
+        fprintf(out, "%sremark: %s [%s=%s]\n", where.c_str(), remark->getMsg().c_str(), flag,
+                remark->getPassName().str().c_str());
+        return true;
+    }
+
+private:
+    static bool Matches(const std::optional<llvm::Regex>& pattern, llvm::StringRef pass) {
+        return pattern && pattern->match(pass);
+    }
+
+    FILE* const& out;
+    std::optional<llvm::Regex> passed, missed, analysis;
+};
+
+} // anonymous namespace
+
+void CodeGen::EnableDebugInfo() {
+    if (debug) return;
+    debug = std::make_unique<llvm::DIBuilder>(Module);
+    llvm::StringRef name = Module.getModuleIdentifier();
+    debugFile = debug->createFile(llvm::sys::path::filename(name), llvm::sys::path::parent_path(name));
+    debug->createCompileUnit(llvm::dwarf::DW_LANG_C99, debugFile, "zcc", optLevel > 0, "", 0, "",
+                             llvm::DICompileUnit::LineTablesOnly);
+    Module.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    Module.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+void CodeGen::SetLocation(SourceLoc loc) {
+    location = loc;
+    if (debug) UpdateDebugLocation();
 }
 
-CodeGen::Symbol CodeGen::GetSymbol(const std::string& name) {
-    for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
-        auto found = it->find(name);
-        if (found != it->end()) return found->second;
+void CodeGen::AttachSubprogram(llvm::Function* func, bool localToUnit) {
+    if (!debug) return;
+    auto* type = debug->createSubroutineType(debug->getOrCreateTypeArray({}));
+    auto flags = llvm::DISubprogram::SPFlagDefinition;
+    if (localToUnit) flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+    func->setSubprogram(debug->createFunction(debugFile, func->getName(), {}, debugFile, location.line, type,
+                                              location.line, llvm::DINode::FlagZero, flags));
+}
+
+void CodeGen::UpdateDebugLocation() {
+    auto* bb = Builder.GetInsertBlock();
+    auto* scope = bb && bb->getParent() ? bb->getParent()->getSubprogram() : nullptr;
+    // Every instruction of a function with a subprogram needs a location
+    // (the verifier insists for calls), so an unknown one becomes line 0.
+    if (scope) Builder.SetCurrentDebugLocation(llvm::DILocation::get(Context, location.line, location.column, scope));
+    else Builder.SetCurrentDebugLocation(llvm::DebugLoc());
+}
+
+bool CodeGen::SetRemarkFilters(const std::string& passed, const std::string& missed, const std::string& analysis) {
+    bool ok = true;
+    auto compile = [&](const std::string& pattern, const char* flag) -> std::optional<llvm::Regex> {
+        if (pattern.empty()) return std::nullopt;
+        llvm::Regex regex(pattern);
+        std::string problem;
+        if (!regex.isValid(problem)) {
+            Error(std::string("invalid regular expression '") + pattern + "' in " + flag + ": " + problem);
+            ok = false;
+            return std::nullopt;
+        }
+        return std::optional<llvm::Regex>(std::move(regex));
+    };
+    auto p = compile(passed, "-Rpass"), m = compile(missed, "-Rpass-missed"), a = compile(analysis, "-Rpass-analysis");
+    if (ok && (p || m || a))
+        Context.setDiagnosticHandler(std::make_unique<RemarkPrinter>(diagnostics, std::move(p), std::move(m), std::move(a)));
+    return ok;
+}
+
+bool CodeGen::SaveOptimizationRecord(const std::string& path) {
+    auto file = llvm::setupLLVMOptimizationRemarks(Context, path, "", "yaml", false);
+    if (!file) {
+        Error("cannot write '" + path + "': " + llvm::toString(file.takeError()));
+        return false;
+    }
+    remarksFile = std::move(*file);
+    remarksFile->keep();
+    return true;
+}
+
+// --- Profile-guided optimization ---
+
+namespace {
+
+// The size of libzccrt's -fcycle-profile table (MAX_SLOTS in cycle.c).
+constexpr unsigned kCycleProfileSlots = 1024;
+
+// Branch weights from counts, scaled into 32 bits the way clang does; none
+// for a branch that never ran, which keeps any likely()/unlikely() hint.
+llvm::MDNode* ProfileWeights(llvm::LLVMContext& context, const std::vector<uint64_t>& counts) {
+    uint64_t max = 0;
+    for (auto count : counts) max = std::max(max, count);
+    if (counts.size() < 2 || max == 0) return nullptr;
+    uint64_t scale = max / UINT32_MAX + 1;
+    std::vector<uint32_t> weights;
+    for (auto count : counts) weights.push_back(uint32_t(count / scale + 1));
+    return llvm::MDBuilder(context).createBranchWeights(weights);
+}
+
+} // anonymous namespace
+
+void CodeGen::SetProfileGenerate(const std::string& path) {
+    profileMode = ProfileMode::Generate;
+    profilePath = path;
+}
+
+void CodeGen::SetProfileUse(const ProfileData* profile) {
+    profileMode = ProfileMode::Use;
+    profileData = profile;
+}
+
+void CodeGen::BeginFunctionProfile() {
+    if (cycleProfile) EnterCycleProfile();
+    if (profileMode == ProfileMode::None) return;
+    profiled = ProfiledFunction();
+    profiled.func = GetFunction();
+    profileSites.clear();
+    profiled.slots = 1;   // entries
+    if (profileMode == ProfileMode::Use) {
+        profiled.counts = profileData->Find(profiled.func->getName().str());
+        return;
+    }
+    // The array's size is known at the end; until then, a stand-in.
+    auto* type = llvm::ArrayType::get(Builder.getInt64Ty(), 0);
+    profiled.counters = new llvm::GlobalVariable(Module, type, false, llvm::GlobalValue::ExternalLinkage,
+                                                 nullptr, "__zcc_prof.pending");
+    CountProfileSlot(Builder.getInt64(0));
+}
+
+void CodeGen::AddProfileSite(llvm::Instruction* inst, unsigned successors) {
+    if (profileMode == ProfileMode::None || !profiled.func) return;
+    ProfileSite site{inst, {}};
+    for (unsigned i = 0; i < successors; ++i) site.slots.push_back(profiled.slots++);
+    profileSites.push_back(std::move(site));
+}
+
+void CodeGen::CountProfileSlot(llvm::Value* slot) {
+    auto* type = Builder.getInt64Ty();
+    auto* counter = Builder.CreateGEP(type, profiled.counters, slot);
+    if (GetFunction() != profiled.func) {
+        // An outlined parallel loop body: its threads share the counters.
+        Builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter, Builder.getInt64(1), llvm::MaybeAlign(8),
+                                llvm::AtomicOrdering::Monotonic);
+        return;
+    }
+    Builder.CreateStore(Builder.CreateAdd(Builder.CreateLoad(type, counter), Builder.getInt64(1)), counter);
+}
+
+llvm::BasicBlock* CodeGen::CountingEdge(llvm::BasicBlock* dest, unsigned slot) {
+    llvm::IRBuilderBase::InsertPointGuard guard(Builder);
+    auto* edge = CreateBasicBlock("prof.edge", GetFunction());
+    Builder.SetInsertPoint(edge);
+    CountProfileSlot(Builder.getInt64(slot));
+    Builder.CreateBr(dest);
+    return edge;
+}
+
+void CodeGen::EndFunctionProfile() {
+    cycleFunc = nullptr;
+    if (profileMode == ProfileMode::None || !profiled.func) return;
+    profiled.hash = kProfileHashSeed;
+    for (auto& site : profileSites) profiled.hash = HashProfileSite(profiled.hash, site.slots.size());
+
+    auto* func = profiled.func;
+    if (profileMode == ProfileMode::Generate) {
+        auto* type = llvm::ArrayType::get(Builder.getInt64Ty(), profiled.slots);
+        auto* counters = new llvm::GlobalVariable(Module, type, false, llvm::GlobalValue::InternalLinkage,
+                                                  llvm::Constant::getNullValue(type),
+                                                  "__zcc_prof." + func->getName());
+        profiled.counters->replaceAllUsesWith(llvm::ConstantExpr::getBitCast(counters, profiled.counters->getType()));
+        profiled.counters->eraseFromParent();
+        profiled.counters = counters;
+        profiledFunctions.push_back(profiled);
+    } else if (auto* counts = profiled.counts) {
+        if (counts->hash != profiled.hash || counts->counts.size() != profiled.slots) {
+            Warning("profile of '" + func->getName().str() + "' does not match its code; ignored");
+        } else {
+            func->setEntryCount(llvm::Function::ProfileCount(counts->counts[0], llvm::Function::PCT_Real));
+            for (auto& site : profileSites) {
+                std::vector<uint64_t> taken;
+                for (auto slot : site.slots) taken.push_back(counts->counts[slot]);
+                if (auto* weights = ProfileWeights(Context, taken)) site.inst->setMetadata(llvm::LLVMContext::MD_prof, weights);
+            }
+            profiledFunctions.push_back(profiled);
+        }
+    }
+    profiled = ProfiledFunction();
+    profileSites.clear();
+}
+
+void CodeGen::SetCycleProfile(bool enabled) { cycleProfile = enabled; }
+
+void CodeGen::EnterCycleProfile() {
+    if (cycleSlots == kCycleProfileSlots) {
+        Warning("-fcycle-profile: only the first " + std::to_string(kCycleProfileSlots) +
+                " functions get a slot; '" + GetFunction()->getName().str() + "' is not profiled");
+        ++cycleSlots;
+    }
+    if (cycleSlots > kCycleProfileSlots) return;
+    cycleFunc = GetFunction();
+    cycleSlot = cycleSlots++;
+    auto* type = llvm::FunctionType::get(GetVoidType(), {GetInt32Type(), Builder.getInt8PtrTy()}, false);
+    Builder.CreateCall(GetRuntimeFunction("__zcc_cycle_enter", type),
+                       {GetInt32(cycleSlot), Builder.CreateGlobalStringPtr(cycleFunc->getName(), "", 0, &Module)});
+}
+
+void CodeGen::ExitCycleProfile() {
+    auto* type = llvm::FunctionType::get(GetVoidType(), {GetInt32Type()}, false);
+    Builder.CreateCall(GetRuntimeFunction("__zcc_cycle_exit", type), {GetInt32(cycleSlot)});
+}
+
+void CodeGen::FinishProfile() {
+    if (profileMode == ProfileMode::Generate) {
+        // The table libzccrt walks at exit; see src/runtime/profile.c.
+        auto* ptrType = Builder.getInt8PtrTy();
+        auto* entryType = llvm::StructType::get(Context, {Builder.getInt64Ty(), ptrType, ptrType, Builder.getInt32Ty()});
+        std::vector<llvm::Constant*> entries;
+        for (auto& f : profiledFunctions) {
+            entries.push_back(llvm::ConstantStruct::get(entryType, {
+                Builder.getInt64(f.hash),
+                Builder.CreateGlobalStringPtr(f.func->getName(), "", 0, &Module),
+                llvm::ConstantExpr::getBitCast(f.counters, ptrType),
+                Builder.getInt32(f.slots),
+            }));
+        }
+        auto* tableType = llvm::ArrayType::get(entryType, entries.size());
+        auto* table = new llvm::GlobalVariable(Module, tableType, true, llvm::GlobalValue::PrivateLinkage,
+                                               llvm::ConstantArray::get(tableType, entries), "__zcc_profile.functions");
+        auto* profileType = llvm::StructType::get(Context, {ptrType, ptrType, Builder.getInt32Ty()});
+        new llvm::GlobalVariable(Module, profileType, true, llvm::GlobalValue::ExternalLinkage,
+                                 llvm::ConstantStruct::get(profileType, {
+                                     Builder.CreateGlobalStringPtr(profilePath, "", 0, &Module),
+                                     llvm::ConstantExpr::getBitCast(table, ptrType),
+                                     Builder.getInt32(entries.size()),
+                                 }),
+                                 "__zcc_profile");
+        return;
+    }
+    if (profileMode != ProfileMode::Use || profiledFunctions.empty()) return;
+
+    llvm::InstrProfSummaryBuilder builder(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+    for (auto& f : profiledFunctions) builder.addRecord(llvm::InstrProfRecord(f.counts->counts));
+    auto summary = builder.getSummary();
+    Module.setProfileSummary(summary->getMD(Context), llvm::ProfileSummary::PSK_Instr);
+
+    // Like __attribute__((hot/cold)), unless the source already says which.
+    uint64_t hot = llvm::ProfileSummaryBuilder::getHotCountThreshold(summary->getDetailedSummary());
+    for (auto& f : profiledFunctions) {
+        auto* func = f.func;
+        if (func->hasFnAttribute(llvm::Attribute::Hot) || func->hasFnAttribute(llvm::Attribute::Cold)) continue;
+        uint64_t entries = f.counts->counts[0];
+        if (entries == 0) {
+            func->addFnAttr(llvm::Attribute::Cold);
+            if (!func->hasSection()) func->setSection(".text.unlikely");
+        } else if (entries >= hot) {
+            func->addFnAttr(llvm::Attribute::Hot);
+            if (!func->hasSection()) func->setSection(".text.hot");
+        }
     }
-    return {};
 }
 
 // --- While loop tracking ---
 
 void CodeGen::EnterWhile(llvm::BasicBlock* entry, llvm::BasicBlock* end) { whiles.push_back({entry, end}); }
 void CodeGen::ExitWhile() { whiles.pop_back(); }
-llvm::BasicBlock* CodeGen::GetWhileEntry() { return whiles.back().entry; }
-llvm::BasicBlock* CodeGen::GetWhileEnd()   { return whiles.back().end; }
+llvm::BasicBlock* CodeGen::GetWhileEntry() { return whiles.empty() ? nullptr : whiles.back().entry; }
+llvm::BasicBlock* CodeGen::GetWhileEnd()   { return whiles.empty() ? nullptr : whiles.back().end; }
@@ -6,14 +6,22 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/Support/ToolOutputFile.h"
 
 #include <string>
 #include <vector>
-#include <map>
 #include <functional>
 
+#include "util/intern.h"
+#include "util/source.h"
+
 enum class VAR_TYPE { CONST, VAR, GLOBAL, FUNC };
 
+class ConstEval;
+class ProfileData;
+struct FunctionCounts;
+
 class CodeGen {
 public:
     // A name binding. `value` is the storage (alloca / global) or, for a local
@@ -31,9 +39,15 @@ public:
 
     CodeGen(const std::string& moduleName);
 
+    // -O<level>: 0 leaves the IR as emitted; 1-3 run LLVM's default module
+    // pipeline for that level.
+    void SetOptLevel(unsigned level);
     void Optimize();
     void Print();
     void Dump(const char* output);
+    // The module's textual IR, as Print and Dump write it.
+    std::string IR();
+    llvm::Module& GetModule();
 
     // Types
     llvm::FunctionType* CreateFuncType(llvm::Type* retType, std::vector<llvm::Type*> params);
@@ -47,6 +61,7 @@ public:
     llvm::Type* GetValueType(llvm::Value* value);
     llvm::Type* GetElementType(llvm::Type* type);
     llvm::Type* GetAllocatedType(llvm::Value* value);
+    uint64_t GetTypeSize(llvm::Type* type);
     bool IsArrayType(llvm::Type* type);
     bool IsPointerType(llvm::Type* type);
 
@@ -54,12 +69,26 @@ public:
     llvm::BasicBlock* CreateBasicBlock(const std::string& name, llvm::Function* func);
     llvm::Function* CreateFunction(llvm::FunctionType* funcType, const std::string& name, std::vector<std::string> names);
     void CreateBuiltin(const std::string& name, llvm::Type* retType, std::vector<llvm::Type*> params, bool isVarArg = false);
+    // A compiler-generated internal function; it gets no symbol binding.
+    llvm::Function* CreateHelperFunction(llvm::FunctionType* funcType, const std::string& name);
+    // Declaration of a runtime library entry point, created on first use.
+    llvm::Function* GetRuntimeFunction(const std::string& name, llvm::FunctionType* funcType);
     llvm::Function* GetFunction();
     llvm::Value* GetFunctionArg(int index);
 
     // Memory
     llvm::Value* CreateAlloca(llvm::Type* type, const std::string& name);
-    llvm::Value* CreateGlobal(llvm::Type* type, const std::string& name, llvm::Value* init);
+    // Storage for a local array: a stack slot, or a zero-initialized internal
+    // global when the array reaches the static-local limit and the current
+    // function cannot re-enter itself.
+    llvm::Value* CreateLocalArray(llvm::Type* type, const std::string& name);
+    bool IsAllocaSlot(llvm::Value* value);
+    void CreateMemZero(llvm::Value* dest, llvm::Type* type);
+    void SetStaticLocalLimit(uint64_t bytes);
+    uint64_t GetStaticLocalLimit() const;
+    void SetStaticLocalsAllowed(bool allowed);
+    bool GetStaticLocalsAllowed() const;
+    llvm::Value* CreateGlobal(llvm::Type* type, const std::string& name, llvm::Value* init, bool isConst = false);
     void CreateStore(llvm::Value* value, llvm::Value* dest);
     void StoreScalar(llvm::Value* value, llvm::Value* dest, llvm::Type* elemType);
     llvm::Value* CreateLoad(llvm::Value* src);
@@ -84,6 +113,12 @@ public:
     llvm::Value* CreateMod(llvm::Value* lhs, llvm::Value* rhs);
     llvm::Value* CreateAnd(llvm::Value* lhs, llvm::Value* rhs);
     llvm::Value* CreateOr(llvm::Value* lhs, llvm::Value* rhs);
+    llvm::Value* CreateXor(llvm::Value* lhs, llvm::Value* rhs);
+    llvm::Value* CreateShl(llvm::Value* lhs, llvm::Value* rhs);
+    llvm::Value* CreateShr(llvm::Value* lhs, llvm::Value* rhs);   // arithmetic
+    llvm::Value* CreateNot(llvm::Value* value);
+    // Atomically add `value` to the integer at `ptr` (sequentially consistent).
+    void CreateAtomicAdd(llvm::Value* ptr, llvm::Value* value);
 
     // Comparisons
     llvm::Value* CreateICmpNE(llvm::Value* lhs, llvm::Value* rhs);
@@ -96,10 +131,25 @@ public:
     // Control flow
     void CreateCondBr(llvm::Value* cond, llvm::BasicBlock* trueBB, llvm::BasicBlock* falseBB);
     void CreateBr(llvm::BasicBlock* dest);
+    llvm::SwitchInst* CreateSwitch(llvm::Value* value, llvm::BasicBlock* defaultDest, unsigned numCases);
+    void AddSwitchCase(llvm::SwitchInst* inst, int value, llvm::BasicBlock* dest);
     void CreateRet(llvm::Value* value);
     llvm::Value* CreateCall(llvm::Function* func, std::vector<llvm::Value*> args);
+    llvm::Value* CreateSelect(llvm::Value* cond, llvm::Value* trueVal, llvm::Value* falseVal);
+    // `likely(value)` / `unlikely(value)`: `value != 0` passed through
+    // llvm.expect. Branches and selects on the result get branch weights.
+    llvm::Value* CreateExpect(llvm::Value* value, bool expected);
+    llvm::Value* CreatePhi(llvm::Value* a, llvm::BasicBlock* fromA, llvm::Value* b, llvm::BasicBlock* fromB);
     void SetInsertPoint(llvm::BasicBlock* bb);
+    llvm::BasicBlock* GetInsertBlock();
     bool EndWithTerminator();
+    // Loop metadata: the properties form one distinct `llvm.loop` node that is
+    // attached to every branch back to `header` (any predecessor but `entry`).
+    // Returns the number of back edges tagged.
+    llvm::Metadata* CreateLoopProperty(const std::string& name);
+    llvm::Metadata* CreateLoopProperty(const std::string& name, int value, unsigned bits = 32);
+    int SetLoopProperties(llvm::BasicBlock* header, llvm::BasicBlock* entry,
+                          const std::vector<llvm::Metadata*>& properties);
 
     // Type conversions
     llvm::Value* CreateTrunc(llvm::Value* value, llvm::Type* type);
@@ -113,26 +163,126 @@ public:
     int GetValueInt(llvm::Value* value);
     llvm::Value* GetArrayElement(llvm::Value* array, int index);
     llvm::Value* GetBaseValue(llvm::Value* value);
+    // Row-major integer contents of a constant (or of a global's initializer).
+    std::vector<int> FlattenConstant(llvm::Value* value);
+    std::vector<int> GetArrayDims(llvm::Type* type);
 
-    // Scope management
+    // Scope management. Names are interned to dense ids and each id holds its
+    // innermost binding; a binding that shadows another saves the old one in
+    // an undo log, which ExitScope replays back to the scope's start. An
+    // unbound name yields an empty Symbol.
     void EnterScope();
     void ExitScope();
     bool IsGlobalScope() const;
+    Interner& GetNames();
+    // The spelling of an interned name.
+    const std::string& Name(SymbolId id) const { return names.Name(id); }
+    void AddSymbol(SymbolId id, const Symbol& sym);
     void AddSymbol(const std::string& name, const Symbol& sym);
-    Symbol GetSymbol(const std::string& name);
+    const Symbol& GetSymbol(SymbolId id) const;
+    const Symbol& GetGlobalSymbol(SymbolId id) const;
+
+    // Compile-time evaluation of calls in constant contexts
+    void SetConstEval(ConstEval* eval);
+    ConstEval* GetConstEval();
+
+    // Diagnostics, written to stderr unless redirected
+    void SetDiagnostics(FILE* out) { diagnostics = out; }
+    void Error(const std::string& message);
+    void Warning(const std::string& message);
+    void Note(const std::string& message);
+    int ErrorCount() const;
+
+    // Source locations (-g). Once enabled, before the first function is
+    // created, every function gets a subprogram and every instruction the
+    // line and column last set; optimization remarks are mapped back to the
+    // source through them.
+    void EnableDebugInfo();
+    void SetLocation(SourceLoc loc);
+    SourceLoc GetLocation() const { return location; }
 
-    // While loop tracking
+    // Optimization remarks. Those of passes whose name matches `passed`
+    // (-Rpass), `missed` (-Rpass-missed) or `analysis` (-Rpass-analysis) are
+    // printed with the diagnostics; an empty pattern selects none. Reports an
+    // error and returns false for an invalid pattern.
+    bool SetRemarkFilters(const std::string& passed, const std::string& missed, const std::string& analysis);
+    // -fsave-optimization-record: every remark, as YAML, to `path`.
+    bool SaveOptimizationRecord(const std::string& path);
+
+    // Profile-guided optimization (profile.h). With -fprofile-generate, code
+    // counts function entries and branch outcomes into per-function arrays
+    // that libzccrt writes to `path` at exit. With -fprofile-use, the counts
+    // in `profile` become entry counts and branch weights, and functions never
+    // entered in training are made cold. Begin/End bracket each user function
+    // from its entry block on; FinishProfile follows the last one.
+    void SetProfileGenerate(const std::string& path);
+    void SetProfileUse(const ProfileData* profile);
+    void BeginFunctionProfile();
+    void EndFunctionProfile();
+    void FinishProfile();
+    // -fcycle-profile: user functions report entry and every return to
+    // libzccrt, which times them, each under a slot number of its own.
+    void SetCycleProfile(bool enabled);
+
+    // While loop tracking. `break` targets the innermost end (a switch
+    // pushes its own end); both getters return null outside any loop.
     void EnterWhile(llvm::BasicBlock* entry, llvm::BasicBlock* end);
     void ExitWhile();
     llvm::BasicBlock* GetWhileEntry();
     llvm::BasicBlock* GetWhileEnd();
 
 private:
+    void AttachSubprogram(llvm::Function* func, bool localToUnit);
+    void UpdateDebugLocation();
+    // Reserves the next counter slot for each successor of `inst`.
+    void AddProfileSite(llvm::Instruction* inst, unsigned successors);
+    void CountProfileSlot(llvm::Value* slot);
+    // A block on the way to `dest` that counts `slot`, for switch edges.
+    llvm::BasicBlock* CountingEdge(llvm::BasicBlock* dest, unsigned slot);
+    void EnterCycleProfile();
+    void ExitCycleProfile();
+
+    // Declared ahead of the context, whose remark streamer writes to it.
+    std::unique_ptr<llvm::ToolOutputFile> remarksFile;
     llvm::LLVMContext Context;
     llvm::Module Module;
     llvm::IRBuilder<llvm::NoFolder> Builder;
 
     struct WhileData { llvm::BasicBlock* entry; llvm::BasicBlock* end; };
-    std::vector<std::map<std::string, Symbol>> locals;
+    struct Shadowed { SymbolId id; Symbol previous; };
+    Interner names;
+    std::vector<Symbol> bindings;      // innermost binding, indexed by id
+    std::vector<Symbol> globals;       // file-scope binding, indexed by id
+    std::vector<Shadowed> undo;
+    std::vector<size_t> scopeStarts;   // undo log size at each EnterScope
     std::vector<WhileData> whiles;
+    ConstEval* constEval = nullptr;
+    int errors = 0;
+    FILE* diagnostics = stderr;
+    uint64_t staticLocalLimit = 0;
+    bool staticLocalsAllowed = false;
+    unsigned optLevel = 0;
+    std::unique_ptr<llvm::DIBuilder> debug;
+    llvm::DIFile* debugFile = nullptr;
+    SourceLoc location;
+
+    enum class ProfileMode { None, Generate, Use };
+    struct ProfileSite { llvm::Instruction* inst; std::vector<unsigned> slots; };
+    struct ProfiledFunction {
+        llvm::Function* func = nullptr;
+        llvm::GlobalVariable* counters = nullptr;   // -fprofile-generate
+        const FunctionCounts* counts = nullptr;     // -fprofile-use
+        uint64_t hash = 0;
+        unsigned slots = 0;
+    };
+    ProfileMode profileMode = ProfileMode::None;
+    std::string profilePath;
+    const ProfileData* profileData = nullptr;
+    ProfiledFunction profiled;                     // the function being emitted
+    std::vector<ProfileSite> profileSites;         // ... and its branches
+    std::vector<ProfiledFunction> profiledFunctions;
+    bool cycleProfile = false;
+    unsigned cycleSlots = 0;                       // slots handed out so far
+    llvm::Function* cycleFunc = nullptr;           // instrumented, being emitted
+    unsigned cycleSlot = 0;
 };
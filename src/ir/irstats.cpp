@@ -0,0 +1,167 @@
+#include "irstats.h"
+#include "stackusage.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+#include <elf.h>
+#include <cstring>
+#include <set>
+
+namespace {
+
+IRStats Collect(llvm::Function& func) {
+    IRStats stats;
+    stats.function = func.getName().str();
+    llvm::DominatorTree dom(func);
+    std::set<llvm::BasicBlock*> headers;
+    for (auto& bb : func) {
+        ++stats.basicBlocks;
+        for (auto* succ : llvm::successors(&bb))
+            if (dom.dominates(succ, &bb)) headers.insert(succ);
+        for (auto& inst : bb) {
+            ++stats.instructions;
+            ++stats.opcodes[inst.getOpcodeName()];
+            if (llvm::isa<llvm::AllocaInst>(inst)) {
+                ++stats.allocas;
+                if (&bb != &func.getEntryBlock()) ++stats.dynamicAllocas;
+            } else if (llvm::isa<llvm::LoadInst>(inst)) {
+                ++stats.loads;
+            } else if (llvm::isa<llvm::StoreInst>(inst)) {
+                ++stats.stores;
+            } else if (llvm::isa<llvm::CallInst>(inst) && !llvm::isa<llvm::IntrinsicInst>(inst)) {
+                ++stats.calls;
+            }
+        }
+    }
+    stats.loops = headers.size();
+    return stats;
+}
+
+llvm::json::Object ToJSON(const IRStats& stats) {
+    llvm::json::Object opcodes;
+    for (auto& op : stats.opcodes) opcodes[op.first] = (int64_t)op.second;
+    llvm::json::Object obj{
+        {"instructions", (int64_t)stats.instructions},
+        {"basic_blocks", (int64_t)stats.basicBlocks},
+        {"loops", (int64_t)stats.loops},
+        {"allocas", (int64_t)stats.allocas},
+        {"dynamic_allocas", (int64_t)stats.dynamicAllocas},
+        {"loads", (int64_t)stats.loads},
+        {"stores", (int64_t)stats.stores},
+        {"calls", (int64_t)stats.calls},
+        {"frame_bytes", (int64_t)stats.frameBytes},
+        {"opcodes", std::move(opcodes)},
+    };
+    if (stats.codeBytes >= 0) obj["code_bytes"] = stats.codeBytes;
+    return obj;
+}
+
+// Adds `value` and the constants it is built from, each once.
+void MeasureConstant(const llvm::Value* value, llvm::DenseSet<const llvm::Constant*>& seen, IRFootprint& footprint) {
+    auto* constant = llvm::dyn_cast<llvm::Constant>(value);
+    if (!constant || llvm::isa<llvm::GlobalValue>(constant) || !seen.insert(constant).second) return;
+    ++footprint.constants;
+    footprint.constantBytes += sizeof(llvm::Constant) + constant->getNumOperands() * sizeof(llvm::Use);
+    if (auto* data = llvm::dyn_cast<llvm::ConstantDataSequential>(constant))
+        footprint.constantBytes += data->getRawDataValues().size();
+    for (auto& op : constant->operands()) MeasureConstant(op.get(), seen, footprint);
+}
+
+} // anonymous namespace
+
+IRFootprint MeasureIR(const llvm::Module& module) {
+    IRFootprint footprint;
+    llvm::DenseSet<const llvm::Constant*> seen;
+    for (auto& global : module.globals())
+        if (global.hasInitializer()) MeasureConstant(global.getInitializer(), seen, footprint);
+    for (auto& func : module) {
+        for (auto& inst : llvm::instructions(func)) {
+            ++footprint.instructions;
+            footprint.instructionBytes += sizeof(llvm::Instruction) + inst.getNumOperands() * sizeof(llvm::Use);
+            for (auto& op : inst.operands()) MeasureConstant(op.get(), seen, footprint);
+        }
+    }
+    return footprint;
+}
+
+std::vector<IRStats> CollectIRStats(llvm::Module& module) {
+    std::vector<IRStats> stats;
+    for (auto& func : module)
+        if (!func.isDeclaration()) stats.push_back(Collect(func));
+
+    // AnalyzeStackUsage visits the same definitions in the same order.
+    auto usage = AnalyzeStackUsage(module);
+    for (size_t i = 0; i < stats.size(); ++i) stats[i].frameBytes = usage[i].frameBytes;
+    return stats;
+}
+
+void AddCodeSizes(std::vector<IRStats>& stats, const std::string& object) {
+    auto* data = reinterpret_cast<const uint8_t*>(object.data());
+    auto fits = [&](uint64_t offset, uint64_t size) { return offset <= object.size() && size <= object.size() - offset; };
+    Elf64_Ehdr ehdr;
+    if (!fits(0, sizeof(ehdr)) || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64) return;
+    memcpy(&ehdr, data, sizeof(ehdr));
+    if (ehdr.e_shentsize != sizeof(Elf64_Shdr) || !fits(ehdr.e_shoff, (uint64_t)ehdr.e_shnum * sizeof(Elf64_Shdr))) return;
+
+    std::map<std::string, uint64_t> sizes;
+    for (unsigned i = 0; i < ehdr.e_shnum; ++i) {
+        Elf64_Shdr symtab, strtab;
+        memcpy(&symtab, data + ehdr.e_shoff + i * sizeof(Elf64_Shdr), sizeof(symtab));
+        if (symtab.sh_type != SHT_SYMTAB || symtab.sh_link >= ehdr.e_shnum) continue;
+        memcpy(&strtab, data + ehdr.e_shoff + symtab.sh_link * sizeof(Elf64_Shdr), sizeof(strtab));
+        if (!fits(symtab.sh_offset, symtab.sh_size) || !fits(strtab.sh_offset, strtab.sh_size)) continue;
+
+        for (uint64_t at = 0; at + sizeof(Elf64_Sym) <= symtab.sh_size; at += sizeof(Elf64_Sym)) {
+            Elf64_Sym sym;
+            memcpy(&sym, data + symtab.sh_offset + at, sizeof(sym));
+            if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_shndx == SHN_UNDEF || sym.st_name >= strtab.sh_size)
+                continue;
+            auto* name = reinterpret_cast<const char*>(data + strtab.sh_offset + sym.st_name);
+            sizes[std::string(name, strnlen(name, strtab.sh_size - sym.st_name))] = sym.st_size;
+        }
+    }
+    for (auto& entry : stats) {
+        auto found = sizes.find(entry.function);
+        if (found != sizes.end()) entry.codeBytes = (int64_t)found->second;
+    }
+}
+
+void WriteIRStats(const std::vector<IRStats>& stats, const std::string& source, std::ostream& out) {
+    IRStats total;
+    total.codeBytes = stats.empty() ? -1 : 0;
+    llvm::json::Array functions;
+    for (auto& entry : stats) {
+        total.instructions += entry.instructions;
+        total.basicBlocks += entry.basicBlocks;
+        total.loops += entry.loops;
+        total.allocas += entry.allocas;
+        total.dynamicAllocas += entry.dynamicAllocas;
+        total.loads += entry.loads;
+        total.stores += entry.stores;
+        total.calls += entry.calls;
+        total.frameBytes += entry.frameBytes;
+        if (total.codeBytes >= 0) total.codeBytes = entry.codeBytes >= 0 ? total.codeBytes + entry.codeBytes : -1;
+        for (auto& op : entry.opcodes) total.opcodes[op.first] += op.second;
+
+        auto obj = ToJSON(entry);
+        obj["name"] = entry.function;
+        functions.push_back(std::move(obj));
+    }
+    auto module = ToJSON(total);
+    module["functions"] = (int64_t)stats.size();
+
+    llvm::json::Value report = llvm::json::Object{
+        {"source", source},
+        {"module", std::move(module)},
+        {"functions", std::move(functions)},
+    };
+    out << llvm::formatv("{0:2}", report).str() << "\n";
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace llvm { class Module; }
+
+// Code-quality counters for one function of the optimized IR (-stats-json),
+// meant to be compared across compiler versions with tools/statsdiff.
+struct IRStats {
+    std::string function;
+    uint64_t instructions = 0;
+    uint64_t basicBlocks = 0;
+    uint64_t loops = 0;            // natural loops, counted by header
+    uint64_t allocas = 0;
+    uint64_t dynamicAllocas = 0;   // outside the entry block: run per iteration
+    uint64_t loads = 0;
+    uint64_t stores = 0;
+    uint64_t calls = 0;
+    uint64_t frameBytes = 0;       // as -fstack-usage computes it
+    int64_t codeBytes = -1;        // machine code, when an object was produced
+    std::map<std::string, uint64_t> opcodes;
+};
+
+std::vector<IRStats> CollectIRStats(llvm::Module& module);
+
+// The instructions of `module` and the constants they and the globals'
+// initializers use, with roughly the bytes each takes (-fmem-report): the
+// object, its operand list and, for constant data, its elements.
+struct IRFootprint {
+    uint64_t constants = 0;
+    uint64_t constantBytes = 0;
+    uint64_t instructions = 0;
+    uint64_t instructionBytes = 0;
+};
+
+IRFootprint MeasureIR(const llvm::Module& module);
+
+// Fill in `codeBytes` from the function symbols of the ELF object `object`.
+void AddCodeSizes(std::vector<IRStats>& stats, const std::string& object);
+
+// `{"source": ..., "module": {...}, "functions": [{...}, ...]}`, where the
+// module entry sums every function.
+void WriteIRStats(const std::vector<IRStats>& stats, const std::string& source, std::ostream& out);
@@ -0,0 +1,66 @@
+#include "profile.h"
+
+#include <sstream>
+
+bool ProfileData::Parse(const std::string& text, std::string& error) {
+    std::istringstream in(text);
+    std::string line;
+    int lineNo = 0;
+    bool inBlock = false;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        if (!inBlock) {
+            inBlock = line == "zcc-profile 1";
+            continue;
+        }
+        if (line == "end") {
+            inBlock = false;
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string name;
+        FunctionCounts entry;
+        size_t slots = 0;
+        if (!(fields >> name >> entry.hash >> slots)) {
+            error = "line " + std::to_string(lineNo) + ": expected '<function> <hash> <slots> <count>...'";
+            return false;
+        }
+        // Counts are read as they come, so a bad <slots> cannot size anything.
+        uint64_t count;
+        while (fields >> count) entry.counts.push_back(count);
+        if (!fields.eof() || entry.counts.size() != slots) {
+            error = "line " + std::to_string(lineNo) + ": '" + name + "' has " +
+                    std::to_string(entry.counts.size()) + " counts instead of " + std::to_string(slots);
+            return false;
+        }
+
+        auto found = functions.find(name);
+        if (found == functions.end()) {
+            functions.emplace(name, std::move(entry));
+        } else if (found->second.hash == entry.hash && found->second.counts.size() == slots) {
+            for (size_t i = 0; i < slots; ++i) found->second.counts[i] += entry.counts[i];
+        } else {
+            error = "line " + std::to_string(lineNo) + ": '" + name + "' was profiled from different code";
+            return false;
+        }
+    }
+    if (inBlock) {
+        error = "profile ends without 'end'";
+        return false;
+    }
+    return true;
+}
+
+const FunctionCounts* ProfileData::Find(const std::string& function) const {
+    auto found = functions.find(function);
+    return found != functions.end() ? &found->second : nullptr;
+}
+
+uint64_t HashProfileSite(uint64_t hash, unsigned successors) {
+    for (int i = 0; i < 4; ++i) {
+        hash ^= (successors >> (8 * i)) & 0xff;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Edge profiles for -fprofile-generate / -fprofile-use.
+//
+// An instrumented function owns an array of 64-bit counters: slot 0 counts
+// its entries, and each conditional branch and switch CodeGen emits takes
+// one slot per successor, in emission order. `hash` summarizes that layout,
+// so a profile taken from different code is recognized and ignored.
+//
+// libzccrt writes the counters at exit as text:
+//
+//     zcc-profile 1
+//     <function> <hash> <slots> <count>...
+//     end
+//
+// Anything outside such a block is skipped, so a profile captured from the
+// program's stderr can be used as is, and the blocks of several runs can
+// simply be concatenated: their counts are summed.
+struct FunctionCounts {
+    uint64_t hash = 0;
+    std::vector<uint64_t> counts;
+};
+
+class ProfileData {
+public:
+    // Returns false with `error` set on a malformed block.
+    bool Parse(const std::string& text, std::string& error);
+    // Null for a function the profile does not cover.
+    const FunctionCounts* Find(const std::string& function) const;
+    bool Empty() const { return functions.empty(); }
+
+private:
+    std::map<std::string, FunctionCounts> functions;
+};
+
+// The running layout hash: FNV-1a over each site's successor count.
+constexpr uint64_t kProfileHashSeed = 0xcbf29ce484222325ull;
+uint64_t HashProfileSite(uint64_t hash, unsigned successors);
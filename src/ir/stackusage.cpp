@@ -0,0 +1,93 @@
+#include "stackusage.h"
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Alignment.h"
+
+#include "util/scc.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+
+namespace {
+
+// Lay out the function's allocas in order, honoring each slot's alignment,
+// and round the frame to the 16-byte stack alignment both targets use.
+uint64_t FrameSize(llvm::Function& func, bool& dynamic) {
+    auto& layout = func.getParent()->getDataLayout();
+    uint64_t offset = 0;
+    for (auto& bb : func) {
+        for (auto& inst : bb) {
+            auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst);
+            if (!alloca) continue;
+            if (&bb != &func.getEntryBlock() || !alloca->isStaticAlloca()) dynamic = true;
+            auto size = alloca->getAllocationSizeInBits(layout);
+            offset = llvm::alignTo(offset, alloca->getAlign()) + (size ? *size / 8 : 0);
+        }
+    }
+    return llvm::alignTo(offset, 16);
+}
+
+} // anonymous namespace
+
+std::vector<StackUsage> AnalyzeStackUsage(llvm::Module& module) {
+    std::vector<StackUsage> usage;
+    std::map<llvm::Function*, size_t> slot;
+    std::map<llvm::Function*, std::set<llvm::Function*>> callees;
+
+    for (auto& func : module) {
+        if (func.isDeclaration()) continue;
+        StackUsage entry;
+        entry.function = func.getName().str();
+        entry.frameBytes = FrameSize(func, entry.dynamic);
+        slot[&func] = usage.size();
+        usage.push_back(entry);
+
+        auto& edges = callees[&func];
+        for (auto& bb : func)
+            for (auto& inst : bb)
+                if (auto* call = llvm::dyn_cast<llvm::CallInst>(&inst))
+                    if (auto* callee = call->getCalledFunction())
+                        if (!callee->isDeclaration()) edges.insert(callee);
+    }
+
+    // Recursion makes the depth input-dependent, so any chain that reaches a
+    // cycle is unbounded; otherwise the graph is a DAG and depths memoize.
+    for (auto* func : CyclicNodes(callees)) {
+        usage[slot[func]].recursive = true;
+        usage[slot[func]].bounded = false;
+    }
+    std::set<llvm::Function*> done;
+    std::function<void(llvm::Function*)> visit = [&](llvm::Function* func) {
+        done.insert(func);
+        auto& self = usage[slot[func]];
+        uint64_t deepest = 0;
+        for (auto* callee : callees[func]) {
+            if (usage[slot[callee]].recursive) {
+                self.bounded = false;
+                continue;
+            }
+            if (!done.count(callee)) visit(callee);
+            auto& child = usage[slot[callee]];
+            self.bounded = self.bounded && child.bounded;
+            deepest = std::max(deepest, child.chainBytes);
+        }
+        self.chainBytes = self.frameBytes + deepest;
+    };
+    for (auto& entry : slot)
+        if (!done.count(entry.first)) visit(entry.first);
+
+    return usage;
+}
+
+void WriteStackUsage(const std::vector<StackUsage>& usage, const std::string& source, std::ostream& out) {
+    for (auto& entry : usage) {
+        out << source << ":" << entry.function << "\t" << entry.frameBytes << "\t"
+            << (entry.dynamic ? "dynamic" : "static");
+        if (entry.recursive) out << ",recursive";
+        if (entry.bounded) out << "\tchain " << entry.chainBytes << "\n";
+        else out << "\tchain unbounded\n";
+    }
+}
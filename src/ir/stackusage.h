@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace llvm { class Module; }
+
+// Per-function stack estimate computed from the allocas in the emitted IR.
+// `frameBytes` covers the function's own slots; `chainBytes` adds the deepest
+// chain of calls below it, and is meaningless when `bounded` is false
+// (recursion anywhere along a chain makes the depth input-dependent).
+struct StackUsage {
+    std::string function;
+    uint64_t frameBytes = 0;
+    bool dynamic = false;   // allocas outside the entry block
+    bool recursive = false;
+    bool bounded = true;
+    uint64_t chainBytes = 0;
+};
+
+std::vector<StackUsage> AnalyzeStackUsage(llvm::Module& module);
+
+// Write a `-fstack-usage` style report: `<source>:<function>\t<bytes>\t<qualifiers>`
+// followed by the worst-case call-chain depth.
+void WriteStackUsage(const std::vector<StackUsage>& usage, const std::string& source, std::ostream& out);
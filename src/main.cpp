@@ -1,16 +1,28 @@
+#include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
 
+#include "zcc.h"
 #include "scanner/scanner.h"
-#include "ir/codegen.h"
+#include "interp/interp.h"
+#include "util/memreport.h"
+#include "util/timing.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace fs = std::filesystem;
 
 enum class Arch { NONE, X64, RISCV64 };
+enum class Backend { LLVM, Baseline };
 
 struct Options {
     Arch        arch = Arch::NONE;
@@ -20,17 +32,81 @@ struct Options {
     std::string linkerScript;    // -T <script>
     std::vector<std::string> libDirs;   // -L <dir> (repeatable)
     std::vector<std::string> libs;      // -l <name> (repeatable)
+    bool        stackUsage = false;      // -fstack-usage
+    uint64_t    staticLocalLimit = 0;    // -fstatic-local-arrays=<bytes>
+    LexerKind   lexer = LexerKind::Flex;  // -lexer=<flex|hand>
+    bool        dumpTokens = false;      // -dump-tokens
+    bool        lexOnly = false;         // -lex-only
+    bool        interp = false;          // -interp: run instead of compiling
+    Backend     backend = Backend::LLVM; // -backend=<llvm|baseline>
+    bool        objectOnly = false;      // -c
+    bool        timeReport = false;      // -ftime-report
+    bool        memReport = false;       // -fmem-report
+    std::string timeTrace;               // -ftime-trace=<file>
+    unsigned    timeTraceGranularity = 500;   // -ftime-trace-granularity=<us>
+    std::string statsJson;               // -stats-json=<file>
+    unsigned    optLevel = 0;            // -O<0-3>
+    bool        debugInfo = false;       // -g
+    std::string remarksPassed;           // -Rpass=<regex>
+    std::string remarksMissed;           // -Rpass-missed=<regex>
+    std::string remarksAnalysis;         // -Rpass-analysis=<regex>
+    std::string optimizationRecord;      // -fsave-optimization-record=<file>
+    std::string profileGenerate;         // -fprofile-generate[=<file>]
+    std::string profileUse;              // -fprofile-use[=<file>]
+    bool        cycleProfile = false;    // -fcycle-profile
 };
 
 static void usage(const char* prog) {
     fprintf(stderr,
         "Usage: %s <-llvm|-x64|-riscv64> <input.c> -o <output> [options]\n"
+        "       %s -interp <input.c> [options]\n"
         "\nOptions:\n"
         "  -sysroot <dir>   Runtime library root (default: <compiler>/../lib/<arch>)\n"
         "  -T <script>      Linker script\n"
         "  -L <dir>         Additional library search path (repeatable)\n"
-        "  -l <name>        Link library lib<name>.a (repeatable)\n",
-        prog);
+        "  -l <name>        Link library lib<name>.a (repeatable)\n"
+        "  -fstack-usage    Write per-function frame and call-chain sizes to <output>.su\n"
+        "  -fstatic-local-arrays=<bytes>\n"
+        "                   Move local arrays of at least <bytes> in non-recursive\n"
+        "                   functions from the stack into static storage\n"
+        "  -lexer=<flex|hand>\n"
+        "                   Scanner to use: the flex one (default) or the\n"
+        "                   hand-written vectorized one\n"
+        "  -dump-tokens     Print the token stream to stdout instead of compiling\n"
+        "  -lex-only        Only lex the input, and report the lexer's throughput\n"
+        "  -backend=<llvm|baseline>\n"
+        "                   Code generator for -x64: LLVM (default), or the fast\n"
+        "                   single-pass baseline that needs no llc or clang\n"
+        "  -c               Stop after writing the object file to <output>\n"
+        "  -ftime-report    Print the time spent in each phase to stderr\n"
+        "  -fmem-report     Print the memory each phase takes, and the AST and IR\n"
+        "                   objects it leaves, to stderr\n"
+        "  -ftime-trace=<file>\n"
+        "                   Write the phases as Chrome trace events (chrome://tracing)\n"
+        "  -ftime-trace-granularity=<us>\n"
+        "                   Leave out trace events shorter than this (default: 500)\n"
+        "  -stats-json=<file>\n"
+        "                   Write per-function statistics of the optimized IR, and\n"
+        "                   machine code sizes when an object is built, as JSON\n"
+        "  -O<0-3>          Optimization level of the LLVM backend (default: 0)\n"
+        "  -g               Attach source lines and columns to the LLVM IR\n"
+        "  -Rpass=<regex>   Report the optimizations done by passes matching <regex>\n"
+        "  -Rpass-missed=<regex>\n"
+        "                   Report the optimizations such passes failed to do\n"
+        "  -Rpass-analysis=<regex>\n"
+        "                   Report why, from their analyses\n"
+        "  -fsave-optimization-record=<file>\n"
+        "                   Write every optimization remark to <file> as YAML\n"
+        "  -fprofile-generate[=<file>]\n"
+        "                   Count function entries and branches; the program\n"
+        "                   writes them to <file> (default: zcc.profile) at exit\n"
+        "  -fprofile-use[=<file>]\n"
+        "                   Optimize with the counts of such a profile\n"
+        "  -fcycle-profile  Time every function in CPU cycles; the program prints\n"
+        "                   a flat profile when main returns\n"
+        "\n-interp runs the program at once, with printf and scanf built in, and\n"
+        "exits with the status main returns.\n",
+        prog, prog);
     exit(1);
 }
 
@@ -49,10 +125,11 @@ static fs::path default_sysroot(const char* argv0, Arch arch) {
 
 static Options parse_args(int argc, const char* argv[]) {
     Options opts;
-    if (argc < 5) usage(argv[0]);
+    if (argc < 3) usage(argv[0]);
 
     /* First positional: arch mode */
-    if (strcmp(argv[1], "-llvm") == 0)       opts.arch = Arch::NONE;
+    if (strcmp(argv[1], "-interp") == 0)     opts.interp = true;
+    else if (strcmp(argv[1], "-llvm") == 0)  opts.arch = Arch::NONE;
     else if (strcmp(argv[1], "-x64") == 0)   opts.arch = Arch::X64;
     else if (strcmp(argv[1], "-riscv64") == 0) opts.arch = Arch::RISCV64;
     else usage(argv[0]);
@@ -70,20 +147,99 @@ static Options parse_args(int argc, const char* argv[]) {
             opts.libDirs.push_back(argv[++i]);
         } else if (strncmp(argv[i], "-L", 2) == 0 && strlen(argv[i]) > 2) {
             opts.libDirs.push_back(argv[i] + 2);
+        } else if (strcmp(argv[i], "-lexer=flex") == 0) {
+            opts.lexer = LexerKind::Flex;
+        } else if (strcmp(argv[i], "-lexer=hand") == 0) {
+            opts.lexer = LexerKind::Hand;
+        } else if (strcmp(argv[i], "-dump-tokens") == 0) {
+            opts.dumpTokens = true;
+        } else if (strcmp(argv[i], "-lex-only") == 0) {
+            opts.lexOnly = true;
+        } else if (strcmp(argv[i], "-backend=llvm") == 0) {
+            opts.backend = Backend::LLVM;
+        } else if (strcmp(argv[i], "-backend=baseline") == 0) {
+            opts.backend = Backend::Baseline;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            opts.objectOnly = true;
         } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
             opts.libs.push_back(argv[++i]);
         } else if (strncmp(argv[i], "-l", 2) == 0 && strlen(argv[i]) > 2) {
             opts.libs.push_back(argv[i] + 2);
+        } else if (strcmp(argv[i], "-fstack-usage") == 0) {
+            opts.stackUsage = true;
+        } else if (strncmp(argv[i], "-fstatic-local-arrays=", 22) == 0) {
+            opts.staticLocalLimit = strtoull(argv[i] + 22, nullptr, 10);
+        } else if (strcmp(argv[i], "-ftime-report") == 0) {
+            opts.timeReport = true;
+        } else if (strcmp(argv[i], "-fmem-report") == 0) {
+            opts.memReport = true;
+        } else if (strncmp(argv[i], "-ftime-trace=", 13) == 0) {
+            opts.timeTrace = argv[i] + 13;
+        } else if (strncmp(argv[i], "-ftime-trace-granularity=", 25) == 0) {
+            opts.timeTraceGranularity = strtoul(argv[i] + 25, nullptr, 10);
+        } else if (strncmp(argv[i], "-stats-json=", 12) == 0) {
+            opts.statsJson = argv[i] + 12;
+        } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '3' && !argv[i][3]) {
+            opts.optLevel = argv[i][2] - '0';
+        } else if (strcmp(argv[i], "-g") == 0) {
+            opts.debugInfo = true;
+        } else if (strncmp(argv[i], "-Rpass=", 7) == 0) {
+            opts.remarksPassed = argv[i] + 7;
+        } else if (strncmp(argv[i], "-Rpass-missed=", 14) == 0) {
+            opts.remarksMissed = argv[i] + 14;
+        } else if (strncmp(argv[i], "-Rpass-analysis=", 16) == 0) {
+            opts.remarksAnalysis = argv[i] + 16;
+        } else if (strncmp(argv[i], "-fsave-optimization-record=", 27) == 0) {
+            opts.optimizationRecord = argv[i] + 27;
+        } else if (strcmp(argv[i], "-fprofile-generate") == 0) {
+            opts.profileGenerate = "zcc.profile";
+        } else if (strncmp(argv[i], "-fprofile-generate=", 19) == 0) {
+            opts.profileGenerate = argv[i] + 19;
+        } else if (strcmp(argv[i], "-fprofile-use") == 0) {
+            opts.profileUse = "zcc.profile";
+        } else if (strncmp(argv[i], "-fprofile-use=", 14) == 0) {
+            opts.profileUse = argv[i] + 14;
+        } else if (strcmp(argv[i], "-fcycle-profile") == 0) {
+            opts.cycleProfile = true;
         }
     }
 
-    if (!opts.output) usage(argv[0]);
+    if (!opts.output && !opts.interp) usage(argv[0]);
+    if (opts.backend == Backend::Baseline && (opts.arch != Arch::X64 || opts.interp)) {
+        fprintf(stderr, "-backend=baseline only targets -x64\n");
+        exit(1);
+    }
+    if (!opts.statsJson.empty() && (opts.backend == Backend::Baseline || opts.interp)) {
+        fprintf(stderr, "-stats-json needs the LLVM backend\n");
+        exit(1);
+    }
+    bool remarks = !opts.remarksPassed.empty() || !opts.remarksMissed.empty() ||
+                   !opts.remarksAnalysis.empty() || !opts.optimizationRecord.empty();
+    if (remarks && (opts.backend == Backend::Baseline || opts.interp)) {
+        fprintf(stderr, "optimization remarks need the LLVM backend\n");
+        exit(1);
+    }
+    bool profile = !opts.profileGenerate.empty() || !opts.profileUse.empty();
+    if (profile && (opts.backend == Backend::Baseline || opts.interp)) {
+        fprintf(stderr, "-fprofile-generate and -fprofile-use need the LLVM backend\n");
+        exit(1);
+    }
+    if (opts.cycleProfile && (opts.backend == Backend::Baseline || opts.interp)) {
+        fprintf(stderr, "-fcycle-profile needs the LLVM backend\n");
+        exit(1);
+    }
+    if (!opts.profileGenerate.empty() && !opts.profileUse.empty()) {
+        fprintf(stderr, "-fprofile-generate and -fprofile-use are exclusive\n");
+        exit(1);
+    }
     return opts;
 }
 
 /* Run a shell command; abort on failure */
 static void run(const std::string& cmd) {
     fprintf(stderr, "[zcc] %s\n", cmd.c_str());
+    std::string tool = cmd.substr(0, cmd.find(' '));
+    TimeScope timer(tool, cmd);
     int ret = system(cmd.c_str());
     if (ret != 0) {
         fprintf(stderr, "[zcc] command failed (exit %d)\n", ret);
@@ -104,17 +260,28 @@ static std::string find_file(const std::string& name, const fs::path& sysroot,
     exit(1);
 }
 
-/* After LLVM IR is generated, produce a static ELF via llc + clang -c + ld */
-static void link_elf(const Options& opts, const char* llFile, const char* argv0) {
+/* LLVM IR → object file via llc + clang -c */
+static void llvm_object(const Options& opts, const char* llFile, const std::string& oFile) {
+    std::string llcArch = (opts.arch == Arch::X64) ? "x86-64"  : "riscv64";
+    std::string target  = (opts.arch == Arch::X64) ? "x86_64"  : "riscv64";
+    std::string sFile = std::string(opts.output) + ".s";
+
+    /* LLVM IR → assembly */
+    run("llc -march=" + llcArch + " -filetype=asm -O" + std::to_string(opts.optLevel) + " " + llFile + " -o " + sFile);
+
+    /* assembly → object */
+    run("clang --target=" + target + " -c " + sFile + " -o " + oFile);
+    std::remove(sFile.c_str());
+}
+
+/* Link an object into a static ELF with ld */
+static void link_elf(const Options& opts, const std::string& oFile, const char* argv0) {
     fs::path sysroot;
     if (!opts.sysroot.empty())
         sysroot = fs::path(opts.sysroot);
     else
         sysroot = default_sysroot(argv0, opts.arch);
 
-    std::string llcArch = (opts.arch == Arch::X64) ? "x86-64"  : "riscv64";
-    std::string target  = (opts.arch == Arch::X64) ? "x86_64"  : "riscv64";
-
     /* Resolve linker script, crt0.o, libzccrt.a */
     std::string linkerScript = opts.linkerScript.empty()
         ? find_file("linker.ld", sysroot, opts.libDirs)
@@ -122,15 +289,6 @@ static void link_elf(const Options& opts, const char* llFile, const char* argv0)
     std::string crt0  = find_file("crt0.o",      sysroot, opts.libDirs);
     std::string rtLib = find_file("libzccrt.a",   sysroot, opts.libDirs);
 
-    std::string sFile = std::string(opts.output) + ".s";
-    std::string oFile = std::string(opts.output) + ".o";
-
-    /* LLVM IR → assembly */
-    run("llc -march=" + llcArch + " -filetype=asm -O0 " + llFile + " -o " + sFile);
-
-    /* assembly → object */
-    run("clang --target=" + target + " -c " + sFile + " -o " + oFile);
-
     /* link: crt0.o + user.o + libzccrt.a + extra -l libs → ELF */
     std::string ldCmd = "ld -T " + linkerScript + " -o " + std::string(opts.output)
                       + " " + crt0 + " " + oFile + " " + rtLib;
@@ -139,43 +297,164 @@ static void link_elf(const Options& opts, const char* llFile, const char* argv0)
     for (auto& lib : opts.libs)
         ldCmd += " -l" + lib;
     run(ldCmd);
-
-    /* Cleanup intermediate files */
-    std::remove(sFile.c_str());
-    std::remove(oFile.c_str());
 }
 
-int main(int argc, const char *argv[]) {
-    Options opts = parse_args(argc, argv);
+/* The contents of `path`, or empty if it cannot be read */
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream bytes;
+    bytes << in.rdbuf();
+    return bytes.str();
+}
 
-    /* Frontend: source → LLVM IR */
-    Scanner scanner{};
-    CodeGen cg(opts.input);
+/* Write `bytes` to `path`; abort on failure */
+static void write_file(const std::string& path, const std::string& bytes) {
+    FILE* out = fopen(path.c_str(), "wb");
+    bool ok = out && fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    if (out && fclose(out) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "[zcc] cannot write %s: %s\n", path.c_str(), strerror(errno));
+        exit(1);
+    }
+}
 
-    auto* file = fopen(opts.input, "r");
-    if (!file) {
+static int compile(const Options& opts, const char* argv0) {
+    SourceFile source;
+    if (!source.Open(opts.input)) {
         fprintf(stderr, "Cannot open input: %s\n", opts.input);
         return 1;
     }
-    scanner.Parse(file, &cg);
-    fclose(file);
 
-    cg.Optimize();
+    if (opts.dumpTokens || opts.lexOnly) {
+        Scanner scanner{};
+        scanner.SetLexer(opts.lexer);
+        Interner names;
+        if (opts.dumpTokens) {
+            scanner.Tokenize(source, names, stdout);
+            return 0;
+        }
+        auto start = std::chrono::steady_clock::now();
+        size_t tokens = scanner.Tokenize(source, names, nullptr);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double mb = source.Size() / 1e6;
+        fprintf(stderr, "%zu tokens, %.2f MB in %.1f ms: %.1f MB/s\n",
+                tokens, mb, elapsed.count() * 1e3, mb / elapsed.count());
+        return 0;
+    }
+
+    if (opts.interp) {
+        /* -interp: straight from the AST to bytecode, no LLVM context */
+        Scanner scanner{};
+        scanner.SetLexer(opts.lexer);
+        Interner names;
+        if (!scanner.Parse(source, names)) return 1;
+        Interpreter interp(scanner.ast, names);
+        {
+            TimeScope timer("Bytecode");
+            if (!interp.Compile()) return 1;
+        }
+        TimeScope timer("Execute");
+        int status;
+        return interp.Run(status) ? status : 1;
+    }
+
+    /* Frontend and code generation: source → LLVM IR or a baseline object */
+    zcc::Options options;
+    options.output = opts.backend == Backend::Baseline ? zcc::Output::X64Object : zcc::Output::LLVMIR;
+    options.filename = opts.input;
+    options.handLexer = opts.lexer == LexerKind::Hand;
+    options.staticLocalLimit = opts.staticLocalLimit;
+    options.stackUsage = opts.stackUsage;
+    options.stats = !opts.statsJson.empty();
+    options.optLevel = opts.optLevel;
+    options.debugInfo = opts.debugInfo;
+    options.remarksPassed = opts.remarksPassed;
+    options.remarksMissed = opts.remarksMissed;
+    options.remarksAnalysis = opts.remarksAnalysis;
+    options.optimizationRecord = opts.optimizationRecord;
+    options.profileGenerate = opts.profileGenerate;
+    options.cycleProfile = opts.cycleProfile;
+    if (!opts.profileUse.empty()) {
+        options.profileUse = read_file(opts.profileUse);
+        if (options.profileUse.empty()) {
+            fprintf(stderr, "[zcc] cannot read profile %s\n", opts.profileUse.c_str());
+            return 1;
+        }
+    }
+    zcc::Result result = zcc::Compile(source.Data(), source.Size(), options);
+    fputs(result.diagnostics.c_str(), stderr);
+    if (!result.ok) return 1;
+
+    if (opts.stackUsage && options.output == zcc::Output::LLVMIR) {
+        /* -fstack-usage: <output>.su, beside the output like GCC's */
+        write_file(fs::path(opts.output).replace_extension(".su").string(), result.stackUsage);
+    }
+
+    /* -stats-json: once the object exists, with its function sizes */
+    auto write_stats = [&](const std::string& object) {
+        if (opts.statsJson.empty()) return;
+        AddCodeSizes(result.stats, object);
+        std::ostringstream out;
+        WriteIRStats(result.stats, opts.input, out);
+        write_file(opts.statsJson, out.str());
+    };
 
     if (opts.arch == Arch::NONE) {
         /* -llvm: just dump IR */
-        cg.Dump(opts.output);
-        cg.Print();
+        write_file(opts.output, result.output);
+        fputs(result.output.c_str(), stdout);
+        write_stats({});
+        return 0;
+    }
+
+    /* -x64 / -riscv64: generate ELF */
+    std::string oFile = opts.objectOnly ? opts.output : std::string(opts.output) + ".o";
+    if (opts.backend == Backend::Baseline) {
+        write_file(oFile, result.output);
     } else {
-        /* -x64 / -riscv64: generate ELF */
         std::string tmpLL = std::string(opts.output) + ".ll";
-        cg.Dump(tmpLL.c_str());
-
-        link_elf(opts, tmpLL.c_str(), argv[0]);
+        write_file(tmpLL, result.output);
+        llvm_object(opts, tmpLL.c_str(), oFile);
         std::remove(tmpLL.c_str());
-
+        write_stats(read_file(oFile));
+    }
+    if (!opts.objectOnly) {
+        link_elf(opts, oFile, argv0);
+        std::remove(oFile.c_str());
         fprintf(stderr, "[zcc] Generated ELF: %s\n", opts.output);
     }
-
     return 0;
 }
+
+int main(int argc, const char *argv[]) {
+    Options opts = parse_args(argc, argv);
+
+    /* -ftime-report / -ftime-trace: every phase on this thread is timed */
+    TimeReport report;
+    if (opts.timeReport) SetTimeReport(&report);
+    /* -fmem-report: and measured */
+    MemReport memReport;
+    if (opts.memReport) SetMemReport(&memReport);
+    if (!opts.timeTrace.empty()) llvm::timeTraceProfilerInitialize(opts.timeTraceGranularity, argv[0]);
+    auto start = std::chrono::steady_clock::now();
+
+    int status = compile(opts, argv[0]);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (opts.timeReport) {
+        SetTimeReport(nullptr);
+        report.Print(stderr, elapsed.count());
+    }
+    if (opts.memReport) {
+        SetMemReport(nullptr);
+        memReport.Print(stderr);
+    }
+    if (!opts.timeTrace.empty()) {
+        std::error_code ec;
+        llvm::raw_fd_ostream out(opts.timeTrace, ec, llvm::sys::fs::OF_Text);
+        if (ec) fprintf(stderr, "[zcc] cannot write %s: %s\n", opts.timeTrace.c_str(), ec.message().c_str());
+        else llvm::timeTraceProfilerWrite(out);
+        llvm::timeTraceProfilerCleanup();
+    }
+    return status;
+}
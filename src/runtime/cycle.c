@@ -0,0 +1,149 @@
+/*
+ * Runtime for -fcycle-profile
+ *
+ * The compiler numbers the functions of an instrumented program and calls
+ * __zcc_cycle_enter(slot, name) on entry and __zcc_cycle_exit(slot) before
+ * every return. Each slot accumulates its calls and its inclusive and
+ * exclusive cycles, read with rdtsc (x86-64) or rdcycle (riscv64); a small
+ * shadow stack of active calls tells a callee's cycles from its caller's.
+ * A recursive function's inclusive cycles count its outermost call only.
+ *
+ * __zcc_cycle_report prints a flat profile, most exclusive cycles first.
+ * Freestanding, crt0 calls it once main returns (it is a weak reference
+ * there, so programs built without the flag do not link this file); hosted
+ * builds report from an atexit handler. Nothing here allocates: the table
+ * is a fixed array in .bss.
+ *
+ * Hosted, parallel loop bodies run on a thread pool (parallel.c), so each
+ * thread keeps its own shadow stack and count of active calls, and the
+ * shared slot counters are updated atomically.
+ */
+
+#define MAX_SLOTS 1024   /* kCycleProfileSlots in the compiler */
+#define MAX_DEPTH 512
+
+int printf(const char *fmt, ...);
+
+#if __STDC_HOSTED__
+#include <stdlib.h>
+#define PER_THREAD __thread
+#define ADD(counter, n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+#define SET(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#else
+#define PER_THREAD
+#define ADD(counter, n) ((counter) += (n))
+#define SET(field, value) ((field) = (value))
+#endif
+
+struct slot {
+    unsigned long long calls;
+    unsigned long long inclusive;
+    unsigned long long exclusive;
+    const char *name;
+};
+
+struct frame {
+    unsigned long long start;
+    unsigned long long children;   /* inclusive cycles of its callees */
+};
+
+static struct slot slots[MAX_SLOTS];
+static PER_THREAD struct frame stack[MAX_DEPTH];
+static PER_THREAD unsigned int depth;
+static PER_THREAD unsigned int active[MAX_SLOTS];   /* calls of each function on the stack */
+
+static inline unsigned long long read_cycles(void) {
+#if defined(__x86_64__)
+    unsigned int lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+#elif defined(__riscv)
+    unsigned long long cycles;
+    __asm__ volatile("rdcycle %0" : "=r"(cycles));
+    return cycles;
+#else
+    return 0;
+#endif
+}
+
+#if __STDC_HOSTED__
+void __zcc_cycle_report(void);
+
+__attribute__((constructor)) static void register_report(void) {
+    atexit(__zcc_cycle_report);
+}
+#endif
+
+void __zcc_cycle_enter(int slot, const char *name) {
+    if ((unsigned int)slot >= MAX_SLOTS) return;
+    struct slot *s = &slots[slot];
+    /* Every thread that gets here first stores the same name. */
+    if (!s->name) SET(s->name, name);
+    ADD(s->calls, 1);
+    active[slot]++;
+    /* Frames past MAX_DEPTH are counted but not timed. */
+    if (depth < MAX_DEPTH) {
+        stack[depth].children = 0;
+        stack[depth].start = read_cycles();
+    }
+    depth++;
+}
+
+void __zcc_cycle_exit(int slot) {
+    unsigned long long now = read_cycles();
+    if ((unsigned int)slot >= MAX_SLOTS || depth == 0) return;
+    struct slot *s = &slots[slot];
+    active[slot]--;
+    depth--;
+    if (depth >= MAX_DEPTH) return;
+
+    unsigned long long elapsed = now - stack[depth].start;
+    ADD(s->exclusive, elapsed - stack[depth].children);
+    if (active[slot] == 0) ADD(s->inclusive, elapsed);
+    if (depth > 0 && depth - 1 < MAX_DEPTH) stack[depth - 1].children += elapsed;
+}
+
+/* printf has no 64-bit conversions: format into `buf`, right-aligned to `width`. */
+static const char *u64(char *buf, int width, unsigned long long n) {
+    char digits[21];
+    int len = 0;
+    do {
+        digits[len++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    int i = 0;
+    while (i < width - len) buf[i++] = ' ';
+    while (len) buf[i++] = digits[--len];
+    buf[i] = 0;
+    return buf;
+}
+
+void __zcc_cycle_report(void) {
+    unsigned long long total = 0;
+    unsigned int order[MAX_SLOTS];
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < MAX_SLOTS; i++) {
+        if (!slots[i].calls) continue;
+        total += slots[i].exclusive;
+        order[n++] = i;
+    }
+    /* Selection sort by exclusive cycles: the table is small. */
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned int best = i;
+        for (unsigned int j = i + 1; j < n; j++)
+            if (slots[order[j]].exclusive > slots[order[best]].exclusive) best = j;
+        unsigned int t = order[i];
+        order[i] = order[best];
+        order[best] = t;
+    }
+
+    char a[24], b[24], c[24], d[24];
+    printf("\ncycle profile: %s cycles\n", u64(a, 0, total));
+    printf("  self%%       self cycles      total cycles       calls  function\n");
+    for (unsigned int i = 0; i < n; i++) {
+        const struct slot *s = &slots[order[i]];
+        unsigned long long permille = total ? s->exclusive * 1000 / total : 0;
+        printf("  %s.%d  %s  %s  %s  %s\n", u64(a, 3, permille / 10), (int)(permille % 10),
+               u64(b, 16, s->exclusive), u64(c, 16, s->inclusive), u64(d, 10, s->calls), s->name);
+    }
+}
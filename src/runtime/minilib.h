@@ -9,7 +9,13 @@ int sys_open(const char* path, int flags);
 int sys_close(int fd);
 void sys_exit(int code) __attribute__((noreturn));
 int sys_pause(void);
+int sys_ioctl(int fd, unsigned long request, void* arg);
 
 int printf(const char* fmt, ...);
+/* Write out what printf has buffered */
+void __zcc_stdout_flush(void);
+
+void* memset(void* dst, int c, unsigned long n);
+void* memcpy(void* dst, const void* src, unsigned long n);
 
 #endif
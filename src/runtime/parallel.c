@@ -0,0 +1,181 @@
+/*
+ * Runtime for `parallel for` loops
+ *
+ * __zcc_parallel_for(body, ctx, n) calls body(ctx, begin, end) on disjoint
+ * ranges that together cover [0, n), and returns once all of them are done.
+ *
+ * Hosted builds (the -llvm path linked against libc) run the ranges on a
+ * pthread pool: the iteration space is split evenly between the threads,
+ * each thread takes small chunks from the front of its own range, and a
+ * thread whose range runs dry steals the back half of another thread's.
+ * The pool size is the number of online CPUs, or ZCC_NUM_THREADS if set.
+ * A parallel loop reached from inside another one runs inline.
+ *
+ * The freestanding runtime has no threads and runs the whole range inline.
+ */
+
+typedef void (*loop_body)(void *ctx, int begin, int end);
+
+#if __STDC_HOSTED__
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+#define CHUNKS_PER_THREAD 16
+
+struct range {
+    pthread_mutex_t lock;
+    int begin, end;
+    char pad[64];   /* keep neighbouring ranges off one cache line */
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    unsigned long generation;   /* bumped once per loop */
+    int threads;
+    int running;                /* workers still busy with this loop */
+    loop_body body;
+    void *ctx;
+    int grain;
+    struct range ranges[MAX_THREADS];
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static __thread int in_loop;
+
+/* Take the next chunk from the front of this thread's own range. */
+static int take(int self, int *begin, int *end) {
+    struct range *r = &pool.ranges[self];
+    pthread_mutex_lock(&r->lock);
+    int found = r->begin < r->end;
+    if (found) {
+        *begin = r->begin;
+        *end = r->end - r->begin > pool.grain ? r->begin + pool.grain : r->end;
+        r->begin = *end;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+/* Move the back half of some other thread's range into our own. */
+static int steal(int self) {
+    for (int k = 1; k < pool.threads; k++) {
+        struct range *victim = &pool.ranges[(self + k) % pool.threads];
+        int begin = 0, end = 0;
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->begin;
+        if (left > 0) {
+            end = victim->end;
+            begin = end - (left + 1) / 2;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (left > 0) {
+            struct range *own = &pool.ranges[self];
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run(int self) {
+    int begin, end;
+    do {
+        while (take(self, &begin, &end))
+            pool.body(pool.ctx, begin, end);
+    } while (steal(self));
+}
+
+static void *worker(void *arg) {
+    int self = (int)(long)arg;
+    unsigned long seen = 0;
+    in_loop = 1;
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.generation == seen)
+            pthread_cond_wait(&pool.start, &pool.lock);
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        run(self);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.running == 0)
+            pthread_cond_signal(&pool.done);
+        pthread_mutex_unlock(&pool.lock);
+    }
+    return 0;
+}
+
+static void pool_init(void) {
+    const char *env = getenv("ZCC_NUM_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+
+    for (int i = 0; i < n; i++)
+        pthread_mutex_init(&pool.ranges[i].lock, 0);
+
+    /* Thread 0 is whoever calls __zcc_parallel_for. */
+    pool.threads = 1;
+    for (int i = 1; i < n; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, worker, (void *)(long)i) != 0)
+            break;
+        pthread_detach(thread);
+        pool.threads++;
+    }
+}
+
+void __zcc_parallel_for(loop_body body, void *ctx, int n) {
+    if (n <= 0) return;
+    pthread_once(&pool_once, pool_init);
+    if (in_loop || pool.threads == 1 || n == 1) {
+        body(ctx, 0, n);
+        return;
+    }
+
+    int threads = pool.threads;
+    pool.body = body;
+    pool.ctx = ctx;
+    pool.grain = n / (threads * CHUNKS_PER_THREAD);
+    if (pool.grain < 1) pool.grain = 1;
+    for (int i = 0; i < threads; i++) {
+        pool.ranges[i].begin = (int)((long long)n * i / threads);
+        pool.ranges[i].end = (int)((long long)n * (i + 1) / threads);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.running = threads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    in_loop = 1;
+    run(0);
+    in_loop = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.running > 0)
+        pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+#else
+
+void __zcc_parallel_for(loop_body body, void *ctx, int n) {
+    if (n > 0) body(ctx, 0, n);
+}
+
+#endif
@@ -2,8 +2,15 @@
  * Minimal printf for custom OS
  * Supports: %d, %s, %c, %x, %%, \n
  * Uses sys_write syscall directly — no libc dependency
+ *
+ * Output collects in a buffer instead of costing a syscall per character.
+ * The buffer is written out when it fills, after every newline when stdout
+ * is a terminal, before sys_read and sys_exit, and by crt0 once main and
+ * the exit hooks are done. Build with -DSTDOUT_BUFSIZE=<bytes> to size it.
  */
 
+#include "syscall.h"
+
 typedef __builtin_va_list va_list;
 #define va_start(ap, param) __builtin_va_start(ap, param)
 #define va_arg(ap, type)    __builtin_va_arg(ap, type)
@@ -11,16 +18,41 @@ typedef __builtin_va_list va_list;
 
 /* Implemented in arch-specific syscall.S */
 long sys_write(int fd, const void *buf, long count);
+int sys_ioctl(int fd, unsigned long request, void *arg);
+
+#ifndef STDOUT_BUFSIZE
+#define STDOUT_BUFSIZE 4096
+#endif
+
+static char out_buf[STDOUT_BUFSIZE];
+static long out_len;
+static int line_buffered = -1;   /* -1 until the first newline asks */
+
+void __zcc_stdout_flush(void) {
+    long done = 0;
+    while (done < out_len) {
+        long n = sys_write(STDOUT_FD, out_buf + done, out_len - done);
+        if (n <= 0) break;   /* nowhere to write it: drop it */
+        done += n;
+    }
+    out_len = 0;
+}
+
+static int stdout_is_terminal(void) {
+    char termios[64];   /* only whether TCGETS succeeds matters */
+    return sys_ioctl(STDOUT_FD, TCGETS, termios) == 0;
+}
 
 static void put_char(char c) {
-    sys_write(1, &c, 1);
+    if (out_len == STDOUT_BUFSIZE) __zcc_stdout_flush();
+    out_buf[out_len++] = c;
+    if (c != '\n') return;
+    if (line_buffered < 0) line_buffered = stdout_is_terminal();
+    if (line_buffered) __zcc_stdout_flush();
 }
 
 static void put_string(const char *s) {
-    long len = 0;
-    const char *p = s;
-    while (*p++) len++;
-    sys_write(1, s, len);
+    while (*s) put_char(*s++);
 }
 
 static void put_int(int n) {
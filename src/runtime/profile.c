@@ -0,0 +1,115 @@
+/*
+ * Runtime for -fprofile-generate
+ *
+ * An instrumented program defines __zcc_profile: the file to write and,
+ * for each function, its counters (entries first, then one per branch
+ * successor) with the hash of their layout. __zcc_profile_dump writes them
+ * in the format src/ir/profile.h describes, to be read by -fprofile-use.
+ * In any other program __zcc_profile is a null weak reference and the dump
+ * does nothing.
+ *
+ * Freestanding, crt0 calls the dump once main returns. When the file
+ * cannot be created the profile goes to stderr instead, from where it can
+ * be used as captured. Hosted builds (the -llvm path linked against libc)
+ * dump from an atexit handler.
+ */
+
+struct zcc_profile_function {
+    unsigned long long hash;
+    const char *name;
+    unsigned long long *counters;
+    unsigned int slots;
+};
+
+struct zcc_profile {
+    const char *path;
+    const struct zcc_profile_function *functions;
+    unsigned int count;
+};
+
+extern const struct zcc_profile __zcc_profile __attribute__((weak));
+
+#if __STDC_HOSTED__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void __zcc_profile_dump(void) {
+    if (!&__zcc_profile) return;
+    FILE *out = fopen(__zcc_profile.path, "w");
+    if (!out) out = stderr;
+    fprintf(out, "zcc-profile 1\n");
+    for (unsigned int i = 0; i < __zcc_profile.count; i++) {
+        const struct zcc_profile_function *f = &__zcc_profile.functions[i];
+        fprintf(out, "%s %llu %u", f->name, f->hash, f->slots);
+        for (unsigned int j = 0; j < f->slots; j++) fprintf(out, " %llu", f->counters[j]);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "end\n");
+    if (out != stderr) fclose(out);
+}
+
+__attribute__((constructor)) static void register_dump(void) {
+    if (&__zcc_profile) atexit(__zcc_profile_dump);
+}
+
+#else
+
+#include "syscall.h"
+
+long sys_write(int fd, const void *buf, long count);
+int sys_open(const char *path, int flags);
+int sys_close(int fd);
+
+/* Output is collected in a small buffer rather than written piecewise. */
+static char buf[512];
+static int used;
+static int out_fd;
+
+static void flush(void) {
+    if (used) sys_write(out_fd, buf, used);
+    used = 0;
+}
+
+static void put(const char *s) {
+    while (*s) {
+        if (used == (int)sizeof(buf)) flush();
+        buf[used++] = *s++;
+    }
+}
+
+static void put_u64(unsigned long long n) {
+    char digits[21];
+    int i = sizeof(digits) - 1;
+    digits[i] = 0;
+    do {
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    put(digits + i);
+}
+
+void __zcc_profile_dump(void) {
+    if (!&__zcc_profile) return;
+    out_fd = sys_open(__zcc_profile.path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (out_fd < 0) out_fd = STDERR_FD;
+    put("zcc-profile 1\n");
+    for (unsigned int i = 0; i < __zcc_profile.count; i++) {
+        const struct zcc_profile_function *f = &__zcc_profile.functions[i];
+        put(f->name);
+        put(" ");
+        put_u64(f->hash);
+        put(" ");
+        put_u64(f->slots);
+        for (unsigned int j = 0; j < f->slots; j++) {
+            put(" ");
+            put_u64(f->counters[j]);
+        }
+        put("\n");
+    }
+    put("end\n");
+    flush();
+    if (out_fd != STDERR_FD) sys_close(out_fd);
+}
+
+#endif
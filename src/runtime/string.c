@@ -0,0 +1,20 @@
+/*
+ * Minimal memory routines for custom OS
+ * LLVM lowers memset/memcpy intrinsics to calls to these symbols
+ * when it does not expand them inline
+ */
+
+typedef unsigned long size_t;
+
+void *memset(void *dst, int c, size_t n) {
+    unsigned char *p = dst;
+    while (n--) *p++ = (unsigned char)c;
+    return dst;
+}
+
+void *memcpy(void *dst, const void *src, size_t n) {
+    unsigned char *d = dst;
+    const unsigned char *s = src;
+    while (n--) *d++ = *s++;
+    return dst;
+}
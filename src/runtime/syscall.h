@@ -20,6 +20,15 @@
 #define NR_OPEN  5
 #define NR_CLOSE 6
 #define NR_PAUSE 29
+#define NR_IOCTL 54
+
+/* ---- sys_open flags ---- */
+#define O_WRONLY 0x001
+#define O_CREAT  0x040
+#define O_TRUNC  0x200
+
+/* ---- sys_ioctl requests ---- */
+#define TCGETS   0x5401   /* fails unless the fd is a terminal */
 
 /* ---- Stdout / Stderr fd constants ---- */
 #define STDIN_FD  0
@@ -0,0 +1,353 @@
+#include "scanner/lexer.h"
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Token = yy::Parser::token;
+using symbol_type = yy::Parser::symbol_type;
+
+// Byte classes, following the character sets in sysy.l.
+enum : uint8_t { kOther, kBlank, kIdentStart, kDigit };
+
+struct ClassTable {
+    uint8_t of[256] = {};
+    constexpr ClassTable() {
+        of[(int)' '] = of[(int)'\t'] = of[(int)'\r'] = kBlank;
+        for (int c = 'a'; c <= 'z'; ++c) of[c] = kIdentStart;
+        for (int c = 'A'; c <= 'Z'; ++c) of[c] = kIdentStart;
+        of[(int)'_'] = kIdentStart;
+        for (int c = '0'; c <= '9'; ++c) of[c] = kDigit;
+    }
+};
+constexpr ClassTable kClass;
+
+inline uint8_t ClassOf(char c) { return kClass.of[(unsigned char)c]; }
+
+inline bool IsHexDigit(char c) {
+    return ClassOf(c) == kDigit || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+#if defined(__x86_64__)
+
+// Bit i set when byte i of the 16 at `p` is in [ \t\r].
+inline unsigned BlankMask(const char* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    return (unsigned)_mm_movemask_epi8(m);
+}
+
+// Bytes in [lo, hi]: shift lo down to -128 so one signed compare does it.
+inline __m128i InRange(__m128i v, char lo, char hi) {
+    __m128i biased = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(biased, _mm_set1_epi8((char)(hi - lo + 1 - 0x80)));
+}
+
+// Bit i set when byte i of the 16 at `p` is in [a-zA-Z0-9_].
+inline unsigned IdentMask(const char* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i alpha = InRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i m = _mm_or_si128(_mm_or_si128(alpha, InRange(v, '0', '9')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    return (unsigned)_mm_movemask_epi8(m);
+}
+
+// The end of the run starting at `p` of bytes whose bits `Mask` sets. The
+// NUL padding after the input is in no class, so every run ends before it.
+template <unsigned (*Mask)(const char*)>
+inline const char* SkipRun(const char* p) {
+    for (;; p += 16)
+        if (unsigned miss = ~Mask(p) & 0xffff) return p + __builtin_ctz(miss);
+}
+
+inline const char* SkipBlanks(const char* p) { return SkipRun<BlankMask>(p); }
+inline const char* SkipIdentChars(const char* p) { return SkipRun<IdentMask>(p); }
+
+const char* FindSse2(const char* p, const char* end, char a, char b) {
+    __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    for (; p < end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned hit = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (hit) return p + __builtin_ctz(hit) < end ? p + __builtin_ctz(hit) : end;
+    }
+    return end;
+}
+
+__attribute__((target("avx2")))
+const char* FindAvx2(const char* p, const char* end, char a, char b) {
+    __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+    for (; p < end; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned hit = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (hit) return p + __builtin_ctz(hit) < end ? p + __builtin_ctz(hit) : end;
+    }
+    return end;
+}
+
+// The first byte in [p, end) equal to `a` or `b`, or `end`. Comment and
+// string bodies are long enough for the wider loads to pay off.
+const auto Find = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? FindAvx2 : FindSse2;
+}();
+
+#else
+
+inline const char* SkipBlanks(const char* p) {
+    while (ClassOf(*p) == kBlank) ++p;
+    return p;
+}
+
+inline const char* SkipIdentChars(const char* p) {
+    while (ClassOf(*p) == kIdentStart || ClassOf(*p) == kDigit) ++p;
+    return p;
+}
+
+const char* Find(const char* p, const char* end, char a, char b) {
+    while (p < end && *p != a && *p != b) ++p;
+    return p;
+}
+
+#endif
+
+struct Keyword {
+    const char* text;
+    size_t length;
+    yy::Parser::token_kind_type token;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"int", 3, Token::INT},           {"char", 4, Token::CHAR},
+    {"void", 4, Token::VOID},         {"const", 5, Token::CONST},
+    {"return", 6, Token::RETURN},     {"if", 2, Token::IF},
+    {"else", 4, Token::ELSE},         {"while", 5, Token::WHILE},
+    {"for", 3, Token::FOR},           {"break", 5, Token::BREAK},
+    {"continue", 8, Token::CONTINUE}, {"parallel", 8, Token::PARALLEL},
+    {"switch", 6, Token::SWITCH},     {"case", 4, Token::CASE},
+    {"default", 7, Token::DEFAULT},   {"__attribute__", 13, Token::ATTRIBUTE},
+};
+
+// A perfect hash over kKeywords: one probe and one compare per identifier.
+constexpr unsigned KeywordSlot(char first, char last, size_t length) {
+    return (3u * (unsigned char)first + 7u * (unsigned char)last + (unsigned)length) & 31;
+}
+
+struct KeywordTable {
+    Keyword slots[32] = {};
+    bool perfect = true;
+    constexpr KeywordTable() {
+        for (const Keyword& k : kKeywords) {
+            Keyword& slot = slots[KeywordSlot(k.text[0], k.text[k.length - 1], k.length)];
+            perfect = perfect && slot.length == 0;
+            slot = k;
+        }
+    }
+};
+constexpr KeywordTable kKeywordTable;
+static_assert(kKeywordTable.perfect, "two keywords share a slot; pick new KeywordSlot factors");
+
+inline const Keyword* FindKeyword(const char* p, size_t length) {
+    const Keyword& k = kKeywordTable.slots[KeywordSlot(p[0], p[length - 1], length)];
+    return k.length == length && memcmp(k.text, p, length) == 0 ? &k : nullptr;
+}
+
+// parse_char_escape in sysy.l.
+int CharEscape(char c) {
+    switch (c) {
+        case 'n':  return '\n';
+        case 't':  return '\t';
+        case 'r':  return '\r';
+        case '\\': return '\\';
+        case '\'': return '\'';
+        case '\"': return '\"';
+        case '0':  return '\0';
+        case 'a':  return '\a';
+        case 'b':  return '\b';
+        case 'f':  return '\f';
+        case 'v':  return '\v';
+        default:   return c;
+    }
+}
+
+// The escapes sysy.l accepts in a character literal.
+inline bool IsCharEscape(char c) { return c && strchr("nrt\\'\"0abfv", c); }
+
+// What sysy.l computes for an integer literal, strtol(text, nullptr, 0)
+// narrowed to int: values past LONG_MAX saturate before the narrowing.
+int IntValue(const char* p, const char* q, unsigned base) {
+    unsigned long value = 0;
+    for (; p < q; ++p) {
+        unsigned digit = ClassOf(*p) == kDigit ? *p - '0' : (*p | 0x20) - 'a' + 10;
+        if (value > ((unsigned long)LONG_MAX - digit) / base) return (int)LONG_MAX;
+        value = value * base + digit;
+    }
+    return (int)(long)value;
+}
+
+} // anonymous namespace
+
+Lexer::Lexer(const char* begin, const char* end, Interner& names)
+    : cur(begin), end(end), names(names) {}
+
+// Locations move exactly as in sysy.l: every token extends `loc` by its
+// length, and only whitespace and newlines step its start forward.
+symbol_type Lexer::Next(yy::location& loc) {
+    for (;;) {
+        if (cur >= end) return yy::Parser::make_END(loc);
+        const char* p = cur;
+        auto op = [&](yy::Parser::token_kind_type token) {
+            cur = p + 2;
+            loc.columns(2);
+            return symbol_type(token, loc);
+        };
+
+        switch (*p) {
+        case '\n':
+            ++cur;
+            loc.lines(1);
+            loc.step();
+            continue;
+        case ' ': case '\t': case '\r':
+            cur = SkipBlanks(p);
+            loc.columns(cur - p);
+            loc.step();
+            continue;
+        case '/':
+            if (p[1] == '/') {
+                cur = Find(p + 2, end, '\n', '\n');
+                loc.columns(cur - p);
+                continue;
+            }
+            if (p[1] == '*') {
+                SkipBlockComment(loc);
+                continue;
+            }
+            break;
+        case '#':
+            if (end - p >= 7 && memcmp(p, "#pragma", 7) == 0) {
+                cur = Find(p + 7, end, '\n', '\n');
+                loc.columns(cur - p);
+                return yy::Parser::make_PRAGMA(std::string(p + 7, cur), loc);
+            }
+            break;
+        case '\'':
+            // The closing quote cannot be padding, so it is in the input.
+            if (p[1] != '\\' && p[1] != '\'' && p[2] == '\'') {
+                cur = p + 3;
+                loc.columns(3);
+                return yy::Parser::make_INT_CONST((unsigned char)p[1], loc);
+            }
+            if (p[1] == '\\' && IsCharEscape(p[2]) && p[3] == '\'') {
+                cur = p + 4;
+                loc.columns(4);
+                return yy::Parser::make_INT_CONST(CharEscape(p[2]), loc);
+            }
+            break;
+        case '"':
+            return String(loc);
+        case '&': if (p[1] == '&') return op(Token::AND); break;
+        case '|': if (p[1] == '|') return op(Token::OR); break;
+        case '=': if (p[1] == '=') return op(Token::EQ); break;
+        case '!': if (p[1] == '=') return op(Token::NE); break;
+        case '<':
+            if (p[1] == '=') return op(Token::LE);
+            if (p[1] == '<') return op(Token::SHL);
+            break;
+        case '>':
+            if (p[1] == '=') return op(Token::GE);
+            if (p[1] == '>') return op(Token::SHR);
+            break;
+        default:
+            if (ClassOf(*p) == kIdentStart) {
+                cur = SkipIdentChars(p + 1);
+                size_t length = cur - p;
+                loc.columns(length);
+                if (auto* keyword = FindKeyword(p, length)) return symbol_type(keyword->token, loc);
+                SymbolId id = names.Intern(std::string_view(p, length));
+                return yy::Parser::make_IDENT(Ident{id, names.Name(id)}, loc);
+            }
+            if (ClassOf(*p) == kDigit) return Number(loc);
+            break;
+        }
+
+        // Any other byte is a token of its own.
+        ++cur;
+        loc.columns(1);
+        return symbol_type(yy::Parser::token_type(*p), loc);
+    }
+}
+
+void Lexer::SkipBlockComment(yy::location& loc) {
+    const char* p = cur + 2;
+    loc.columns(2);
+    for (;;) {
+        const char* q = Find(p, end, '*', '\n');
+        loc.columns(q - p);
+        if (q == end) {
+            cur = end;   // unterminated: sysy.l ends the input quietly too
+            return;
+        }
+        if (*q == '\n') {
+            loc.lines(1);
+            loc.step();
+        } else if (q[1] == '/') {
+            cur = q + 2;
+            loc.columns(2);
+            return;
+        } else {
+            loc.columns(1);
+        }
+        p = q + 1;
+    }
+}
+
+symbol_type Lexer::Number(yy::location& loc) {
+    const char* p = cur;
+    const char* q = p + 1;
+    int value;
+    if (*p != '0') {
+        while (ClassOf(*q) == kDigit) ++q;
+        value = IntValue(p, q, 10);
+    } else if ((p[1] | 0x20) == 'x' && IsHexDigit(p[2])) {
+        for (q = p + 2; IsHexDigit(*q); ++q) {}
+        value = IntValue(p + 2, q, 16);
+    } else {
+        while (*q >= '0' && *q <= '7') ++q;
+        value = IntValue(p, q, 8);
+    }
+    cur = q;
+    loc.columns(q - p);
+    return yy::Parser::make_INT_CONST(value, loc);
+}
+
+symbol_type Lexer::String(yy::location& loc) {
+    const char* p = cur;
+    const char* q = p + 1;
+    for (;; q += 2) {
+        q = Find(q, end, '"', '\\');
+        if (q == end || (*q == '\\' && (q + 1 == end || q[1] == '\n'))) {
+            // No closing quote: the quote is a token of its own.
+            cur = p + 1;
+            loc.columns(1);
+            return symbol_type(yy::Parser::token_type('"'), loc);
+        }
+        if (*q == '"') break;
+    }
+    cur = q + 1;
+    loc.columns(cur - p);
+
+    std::string value;
+    value.reserve(q - p - 1);
+    for (const char* s = p + 1; s < q; ++s)
+        value += *s == '\\' ? (char)CharEscape(*++s) : *s;
+    return yy::Parser::make_STR_CONST(std::move(value), loc);
+}
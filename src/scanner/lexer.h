@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+#include "sysy.tab.hpp"
+#include "util/intern.h"
+
+// Hand-written scanner for the language of parser/sysy.l. It produces the
+// same tokens with the same locations as the flex scanner (which remains
+// the reference; `-lexer=flex`), but skips whitespace, comment and string
+// bodies and identifier tails a vector at a time, and recognizes keywords
+// with a perfect hash instead of a DFA.
+//
+// The input must be followed by at least SourceFile::kPadding NUL bytes:
+// vector loads may run past `end`, and a NUL ends every run it scans.
+class Lexer {
+public:
+    Lexer(const char* begin, const char* end, Interner& names);
+
+    yy::Parser::symbol_type Next(yy::location& loc);
+
+private:
+    void SkipBlockComment(yy::location& loc);
+    yy::Parser::symbol_type Number(yy::location& loc);
+    yy::Parser::symbol_type String(yy::location& loc);
+
+    const char* cur;
+    const char* end;
+    Interner& names;
+};
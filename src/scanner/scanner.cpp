@@ -1,27 +1,106 @@
 #include "scanner.h"
+#include "scanner/lexer.h"
 #include "ir/codegen.h"
+#include "util/memreport.h"
+#include "util/timing.h"
 
 #include "sysy.tab.hpp"
 #include "sysy.lex.hpp"
 
+// The flex scanner, generated from sysy.l.
+yy::Parser::symbol_type FlexLex(void* yyscanner, yy::location& loc);
+
+yy::Parser::symbol_type yylex(Scanner& ctx, yy::location& loc) {
+    if (auto* hand = ctx.HandLexer()) return hand->Next(loc);
+    return FlexLex(ctx.FlexState(), loc);
+}
+
 Scanner::Scanner() {
     yylex_init(&lexer);
     loc = std::make_unique<yy::location>();
-    parser = std::make_unique<yy::Parser>(lexer, *loc, *this);
+    parser = std::make_unique<yy::Parser>(*loc, *this);
 }
 
 Scanner::~Scanner() {
     yylex_destroy(lexer);
 }
 
-void Scanner::Parse(FILE* input, CodeGen* cg) {
-    yyset_in(input, lexer);
-    int ret = parser->parse();
-    if (ret == 0) {
-        ast.Codegen(cg);
+void Scanner::Begin(SourceFile& source, Interner& names) {
+    this->names = &names;
+    if (lexerKind == LexerKind::Hand) {
+        hand = std::make_unique<Lexer>(source.Data(), source.Data() + source.Size(), names);
     } else {
-        fprintf(stderr, "Parse error at %s:%d:%d\n",
+        yyset_extra(&names, lexer);
+        // flex scans its two end-of-buffer NULs as part of the buffer.
+        flexBuffer = yy_scan_buffer(source.Data(), source.Size() + 2, lexer);
+    }
+}
+
+void Scanner::End() {
+    hand.reset();
+    if (flexBuffer) yy_delete_buffer(flexBuffer, lexer);
+    flexBuffer = nullptr;
+}
+
+bool Scanner::Parse(SourceFile& source, CodeGen* cg) {
+    if (!Parse(source, cg->GetNames())) return false;
+    ast.Codegen(cg);
+    return true;
+}
+
+bool Scanner::Parse(SourceFile& source, Interner& names) {
+    TimeScope timer("Parse");
+    Begin(source, names);
+    int ret;
+    {
+        ASTArenaScope scope(arena);
+        ret = parser->parse();
+    }
+    End();
+    if (auto* report = GetMemReport())
+        report->AddObjects("AST", arena.Allocations(), arena.BytesUsed(), arena.BytesReserved());
+    if (ret != 0) {
+        fprintf(diagnostics, "Parse error at %s:%d:%d\n",
                 loc->begin.filename ? loc->begin.filename->c_str() : "unknown",
                 loc->begin.line, loc->begin.column);
     }
+    return ret == 0;
+}
+
+size_t Scanner::Tokenize(SourceFile& source, Interner& names, FILE* out) {
+    using Kind = yy::Parser::symbol_kind;
+    TimeScope timer("Lex");
+    Begin(source, names);
+    size_t count = 0;
+    for (;;) {
+        auto token = yylex(*this, *loc);
+        if (token.kind() == Kind::S_YYEOF) break;
+        ++count;
+        if (!out) continue;
+
+        fprintf(out, "%d.%d-%d.%d %s", loc->begin.line, loc->begin.column,
+                loc->end.line, loc->end.column, token.name().c_str());
+        switch (token.kind()) {
+        case Kind::S_IDENT:
+            fprintf(out, " %.*s", (int)token.value.as<Ident>().name.size(), token.value.as<Ident>().name.data());
+            break;
+        case Kind::S_INT_CONST:
+            fprintf(out, " %d", token.value.as<int>());
+            break;
+        case Kind::S_STR_CONST:
+        case Kind::S_PRAGMA:
+            // Escaped, so that every token stays on one line.
+            fputs(" \"", out);
+            for (unsigned char c : token.value.as<std::string>())
+                if (c < ' ' || c >= 0x7f || c == '"' || c == '\\') fprintf(out, "\\x%02x", c);
+                else fputc(c, out);
+            fputc('"', out);
+            break;
+        default:
+            break;
+        }
+        fputc('\n', out);
+    }
+    End();
+    return count;
 }
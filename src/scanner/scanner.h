@@ -1,28 +1,70 @@
 #pragma once
 
-#include <fstream>
+#include <cstdio>
 #include <string>
 #include <memory>
 
 #include "ast/ast.h"
 #include "ast/type.h"
+#include "util/arena.h"
+#include "util/source.h"
 
 namespace yy {
     class Parser;
     class location;
 }
 
+class Lexer;
+struct yy_buffer_state;
+
+// Which scanner feeds the parser: the flex one generated from sysy.l, or
+// the hand-written Lexer, which produces the same tokens faster.
+enum class LexerKind { Flex, Hand };
+
 class Scanner {
 public:
     Scanner();
     ~Scanner();
 
-    void Parse(FILE* input, CodeGen* cg);
+    void SetLexer(LexerKind kind) { lexerKind = kind; }
+    // Where syntax errors go; stderr by default.
+    void SetDiagnostics(FILE* out) { diagnostics = out; }
+    FILE* Diagnostics() const { return diagnostics; }
+
+    // Scans `source` in place, interning identifiers into the CodeGen's
+    // name table as they are lexed, then generates code for the AST.
+    // Reports a parse error and returns false on failure.
+    bool Parse(SourceFile& source, CodeGen* cg);
+    // Only builds `ast`, for a consumer other than CodeGen; reports a parse
+    // error and returns false on failure.
+    bool Parse(SourceFile& source, Interner& names);
 
+    // Runs only the lexer over `source`, printing one token per line to
+    // `out` (for -dump-tokens) unless it is null. Returns the token count.
+    size_t Tokenize(SourceFile& source, Interner& names, FILE* out);
+
+    // The token source the parser's yylex reads from: `HandLexer()` while
+    // the hand-written lexer is scanning, otherwise the flex state.
+    Lexer* HandLexer() const { return hand.get(); }
+    void* FlexState() const { return lexer; }
+    // The table identifiers are being interned into, for the parser to
+    // intern string literals alongside them.
+    Interner& Names() const { return *names; }
+
+    // Storage for every node of `ast`; declared first so it outlives the tree.
+    Arena arena;
     CompUnitAST ast;
 
 private:
+    void Begin(SourceFile& source, Interner& names);
+    void End();
+
+    LexerKind lexerKind = LexerKind::Flex;
+    FILE* diagnostics = stderr;
+    Interner* names = nullptr;
+    std::unique_ptr<Lexer> hand;
     void* lexer;
+    yy_buffer_state* flexBuffer = nullptr;
     std::unique_ptr<yy::Parser> parser;
     std::unique_ptr<yy::location> loc;
 };
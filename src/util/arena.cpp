@@ -0,0 +1,35 @@
+#include "util/arena.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+Arena::Arena(size_t blockSize) : blockSize(blockSize) {}
+
+Arena::~Arena() {
+    for (char* block : blocks) std::free(block);
+}
+
+void Arena::NewBlock(size_t minSize) {
+    // Oversized requests get a block of their own.
+    size_t size = minSize > blockSize ? minSize : blockSize;
+    char* block = (char*)std::malloc(size);
+    if (!block) {
+        fprintf(stderr, "Out of memory\n");
+        std::abort();
+    }
+    blocks.push_back(block);
+    cur = block;
+    end = block + size;
+    reserved += size;
+}
+
+void* Arena::Allocate(size_t size, size_t align) {
+    auto aligned = [&] { return (char*)(((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1)); };
+    if (!cur || aligned() + size > end) NewBlock(size + align);
+    char* p = aligned();
+    cur = p + size;
+    used += size;
+    ++allocations;
+    return p;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator. Memory is carved from large blocks in allocation order and
+// is only given back all at once, when the arena is destroyed; nothing
+// allocated from it has its destructor run by the arena.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    // Bytes handed out, and bytes held in blocks.
+    size_t BytesUsed() const { return used; }
+    size_t BytesReserved() const { return reserved; }
+    size_t Allocations() const { return allocations; }
+
+private:
+    void NewBlock(size_t minSize);
+
+    std::vector<char*> blocks;
+    char* cur = nullptr;
+    char* end = nullptr;
+    size_t blockSize;
+    size_t used = 0;
+    size_t reserved = 0;
+    size_t allocations = 0;
+};
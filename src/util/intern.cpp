@@ -0,0 +1,40 @@
+#include "util/intern.h"
+
+namespace {
+
+// FNV-1a
+size_t Hash(std::string_view name) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : name) h = (h ^ c) * 1099511628211ull;
+    return (size_t)h;
+}
+
+} // anonymous namespace
+
+Interner::Interner() : slots(64, kNoSymbol) {}
+
+// The slot holding `name`, or the empty slot where it would go.
+size_t Interner::Probe(std::string_view name) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = Hash(name) & mask;; i = (i + 1) & mask)
+        if (slots[i] == kNoSymbol || names[slots[i]] == name) return i;
+}
+
+SymbolId Interner::Find(std::string_view name) const { return slots[Probe(name)]; }
+
+SymbolId Interner::Intern(std::string_view name) {
+    size_t slot = Probe(name);
+    if (slots[slot] != kNoSymbol) return slots[slot];
+
+    auto id = (SymbolId)names.size();
+    names.emplace_back(name);
+    slots[slot] = id;
+    // Keep the load factor at or below one half.
+    if (names.size() * 2 > slots.size()) Grow();
+    return id;
+}
+
+void Interner::Grow() {
+    slots.assign(slots.size() * 2, kNoSymbol);
+    for (SymbolId id = 0; id < names.size(); ++id) slots[Probe(names[id])] = id;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Dense ids for identifiers, so that later passes compare and index by
+// integer instead of by string.
+using SymbolId = uint32_t;
+constexpr SymbolId kNoSymbol = UINT32_MAX;
+
+// An identifier as the lexer hands it to the parser: its id, and its
+// spelling as stored in the Interner.
+struct Ident {
+    SymbolId id = kNoSymbol;
+    std::string_view name;
+};
+
+// String-to-id table with open addressing and linear probing. Ids are handed
+// out in first-seen order, starting at zero. Interned names never move, so
+// views of them stay valid for the life of the table.
+class Interner {
+public:
+    Interner();
+
+    SymbolId Intern(std::string_view name);
+    // The id of `name`, or kNoSymbol if it was never interned.
+    SymbolId Find(std::string_view name) const;
+    const std::string& Name(SymbolId id) const { return names[id]; }
+    size_t Size() const { return names.size(); }
+
+private:
+    size_t Probe(std::string_view name) const;
+    void Grow();
+
+    std::deque<std::string> names;
+    std::vector<SymbolId> slots;   // power-of-two sized; kNoSymbol marks an empty slot
+};
@@ -0,0 +1,63 @@
+#include "util/memreport.h"
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+namespace {
+
+thread_local MemReport* report = nullptr;
+
+} // anonymous namespace
+
+void SetMemReport(MemReport* r) { report = r; }
+
+MemReport* GetMemReport() { return report; }
+
+MemUsage MemUsage::Now() {
+    MemUsage usage;
+    // Small chunks from the arenas plus the ones malloc mmapped on its own.
+    struct mallinfo2 info = mallinfo2();
+    usage.live = (int64_t)(info.uordblks + info.hblkhd);
+    struct rusage self;
+    if (getrusage(RUSAGE_SELF, &self) == 0) usage.peakRSS = (int64_t)self.ru_maxrss * 1024;
+    return usage;
+}
+
+MemReport::MemReport() : start(MemUsage::Now()) {}
+
+size_t MemReport::Row(std::string_view phase) {
+    for (size_t i = 0; i < phases.size(); ++i)
+        if (phases[i].name == phase) return i;
+    phases.push_back({std::string(phase), 0, 0, 0});
+    return phases.size() - 1;
+}
+
+void MemReport::Add(size_t row, const MemUsage& before, const MemUsage& after) {
+    auto& p = phases[row];
+    ++p.count;
+    p.liveDelta += after.live - before.live;
+    if (after.peakRSS > p.peakRSS) p.peakRSS = after.peakRSS;
+}
+
+void MemReport::AddObjects(std::string_view kind, uint64_t count, uint64_t bytes, uint64_t reserved) {
+    objects.push_back({std::string(kind), count, bytes, reserved});
+}
+
+void MemReport::Print(FILE* out) const {
+    MemUsage now = MemUsage::Now();
+    fprintf(out, "===== Memory =====\n");
+    fprintf(out, "%-32s %8s %14s %12s\n", "phase", "count", "live delta KB", "peak RSS KB");
+    for (auto& p : phases)
+        fprintf(out, "%-32s %8zu %+14lld %12lld\n", p.name.c_str(), p.count,
+                (long long)p.liveDelta / 1024, (long long)p.peakRSS / 1024);
+    fprintf(out, "%-32s %8s %+14lld %12lld\n", "total", "", (long long)(now.live - start.live) / 1024,
+            (long long)now.peakRSS / 1024);
+    if (objects.empty()) return;
+    fprintf(out, "%-32s %8s %14s %12s\n", "objects", "count", "KB", "reserved KB");
+    for (auto& o : objects) {
+        fprintf(out, "%-32s %8llu %14llu", o.kind.c_str(), (unsigned long long)o.count,
+                (unsigned long long)o.bytes / 1024);
+        if (o.reserved) fprintf(out, " %12llu", (unsigned long long)o.reserved / 1024);
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Memory accounting of the compile pipeline, for -fmem-report. While a
+// MemReport is installed on the calling thread, every outermost TimeScope
+// (parse, codegen, optimize, emit, external commands) also records how the
+// heap bytes in use changed over the phase and the process's peak RSS at
+// its end. Nested scopes are left out, so a phase costs two samples of a
+// few system calls each, cheap enough to leave on in CI.
+struct MemUsage {
+    int64_t live = 0;       // bytes malloc handed out and has not got back
+    int64_t peakRSS = 0;    // bytes
+
+    static MemUsage Now();
+};
+
+class MemReport {
+public:
+    MemReport();
+
+    // The row of `phase`, added on first use.
+    size_t Row(std::string_view phase);
+    void Add(size_t row, const MemUsage& before, const MemUsage& after);
+    // `count` objects of one kind taking `bytes`; `reserved`, when not 0,
+    // is what was set aside for them.
+    void AddObjects(std::string_view kind, uint64_t count, uint64_t bytes, uint64_t reserved = 0);
+    // The phases in the order they first started, then the objects.
+    void Print(FILE* out) const;
+
+private:
+    struct Phase {
+        std::string name;
+        size_t count;
+        int64_t liveDelta;
+        int64_t peakRSS;
+    };
+    struct Objects {
+        std::string kind;
+        uint64_t count;
+        uint64_t bytes;
+        uint64_t reserved;
+    };
+    MemUsage start;
+    std::vector<Phase> phases;
+    std::vector<Objects> objects;
+};
+
+// Installs `report` (or null) for the calling thread.
+void SetMemReport(MemReport* report);
+MemReport* GetMemReport();
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+// Tarjan's strongly connected components over a graph given as an adjacency
+// map. Returns the nodes that lie on a cycle: members of a component with
+// more than one node, or nodes with an edge to themselves.
+template<typename Node>
+std::set<Node> CyclicNodes(const std::map<Node, std::set<Node>>& graph) {
+    std::set<Node> cyclic;
+    std::map<Node, int> index, low;
+    std::vector<Node> stack;
+    std::set<Node> onStack;
+    int counter = 0;
+    static const std::set<Node> none;
+
+    std::function<void(const Node&)> connect = [&](const Node& v) {
+        index[v] = low[v] = counter++;
+        stack.push_back(v);
+        onStack.insert(v);
+        auto edges = graph.find(v);
+        for (auto& w : edges != graph.end() ? edges->second : none) {
+            if (!index.count(w)) {
+                connect(w);
+                low[v] = std::min(low[v], low[w]);
+            } else if (onStack.count(w)) {
+                low[v] = std::min(low[v], index[w]);
+            }
+        }
+        if (low[v] != index[v]) return;
+
+        std::vector<Node> component;
+        Node w;
+        do {
+            w = stack.back();
+            stack.pop_back();
+            onStack.erase(w);
+            component.push_back(w);
+        } while (w != v);
+        if (component.size() > 1 || (edges != graph.end() && edges->second.count(v)))
+            cyclic.insert(component.begin(), component.end());
+    };
+
+    for (auto& entry : graph)
+        if (!index.count(entry.first)) connect(entry.first);
+    return cyclic;
+}
@@ -0,0 +1,59 @@
+#include "util/source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile() {
+    if (mapped) munmap(data, mapped);
+}
+
+bool SourceFile::Open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (S_ISREG(st.st_mode) ? Map(fd, (size_t)st.st_size) || Read(fd) : Read(fd));
+    close(fd);
+    return ok;
+}
+
+// Reserve zeroed anonymous pages for the file plus padding, then map the
+// file over the front of them. The rest of the file's last page reads as
+// zero, and any padding past it lands in the anonymous pages, so the
+// sentinel costs no copy.
+bool SourceFile::Map(int fd, size_t length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t total = (length + kPadding + page - 1) / page * page;
+
+    void* base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return false;
+    if (length && mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, total);
+        return false;
+    }
+    madvise(base, length, MADV_SEQUENTIAL);
+
+    data = (char*)base;
+    size = length;
+    mapped = total;
+    return true;
+}
+
+void SourceFile::Assign(const char* text, size_t length) {
+    copy.assign(text, text + length);
+    size = length;
+    copy.resize(size + kPadding, '\0');
+    data = copy.data();
+}
+
+bool SourceFile::Read(int fd) {
+    char chunk[65536];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof chunk)) > 0) copy.insert(copy.end(), chunk, chunk + n);
+    if (n < 0) return false;
+    size = copy.size();
+    copy.resize(size + kPadding, '\0');
+    data = copy.data();
+    return true;
+}
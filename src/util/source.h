@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A 1-based line and column in the source; line 0 means unknown.
+struct SourceLoc {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+// The contents of a source file followed by kPadding NUL bytes: flex's
+// yy_scan_buffer scans in place up to the first two, and the hand-written
+// Lexer's vector loads may read up to a vector past the end. Regular files
+// are memory-mapped rather than read; pipes and other special files are
+// read into memory.
+class SourceFile {
+public:
+    static constexpr size_t kPadding = 32;
+
+    SourceFile() = default;
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    // False, with errno set, when `path` cannot be read.
+    bool Open(const char* path);
+    // A copy of `size` bytes at `text`, for sources that are not files.
+    void Assign(const char* text, size_t size);
+
+    // Writable: the scanner NUL-terminates each token in place while it
+    // looks at it. The mapping is private, so the file itself never changes.
+    char* Data() { return data; }
+    size_t Size() const { return size; }   // excluding the padding
+
+private:
+    bool Map(int fd, size_t length);
+    bool Read(int fd);
+
+    char* data = nullptr;
+    size_t size = 0;
+    size_t mapped = 0;        // length of the mapping, or 0 when `data` is in `copy`
+    std::vector<char> copy;
+};
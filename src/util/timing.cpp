@@ -0,0 +1,58 @@
+#include "util/timing.h"
+
+#include "llvm/Support/TimeProfiler.h"
+
+namespace {
+
+thread_local TimeReport* report = nullptr;
+thread_local int depth = 0;
+
+} // anonymous namespace
+
+void SetTimeReport(TimeReport* r) { report = r; }
+
+size_t TimeReport::Row(std::string_view phase, int depth) {
+    for (size_t i = 0; i < phases.size(); ++i)
+        if (phases[i].name == phase && phases[i].depth == depth) return i;
+    phases.push_back({std::string(phase), depth, 0, 0});
+    return phases.size() - 1;
+}
+
+void TimeReport::Add(size_t row, double seconds) {
+    ++phases[row].count;
+    phases[row].seconds += seconds;
+}
+
+void TimeReport::Print(FILE* out, double total) const {
+    fprintf(out, "===== Compile time =====\n");
+    fprintf(out, "%-32s %8s %10s %7s\n", "phase", "count", "wall ms", "%");
+    for (auto& p : phases) {
+        std::string name = std::string(2 * p.depth, ' ') + p.name;
+        fprintf(out, "%-32s %8zu %10.2f %6.1f%%\n", name.c_str(), p.count, p.seconds * 1e3,
+                total > 0 ? 100 * p.seconds / total : 0.0);
+    }
+    fprintf(out, "%-32s %8s %10.2f %6.1f%%\n", "total", "", total * 1e3, 100.0);
+}
+
+TimeScope::TimeScope(std::string_view phase, std::string_view detail)
+    : report(::report), mem(depth == 0 ? GetMemReport() : nullptr), traced(llvm::timeTraceProfilerEnabled()) {
+    if (traced) llvm::timeTraceProfilerBegin(llvm::StringRef(phase.data(), phase.size()),
+                                             llvm::StringRef(detail.data(), detail.size()));
+    if (mem) {
+        memRow = mem->Row(phase);
+        memStart = MemUsage::Now();
+    }
+    if (report) row = report->Row(phase, depth);
+    ++depth;
+    if (report) start = std::chrono::steady_clock::now();
+}
+
+TimeScope::~TimeScope() {
+    if (report) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        report->Add(row, elapsed.count());
+    }
+    --depth;
+    if (mem) mem->Add(memRow, memStart, MemUsage::Now());
+    if (traced) llvm::timeTraceProfilerEnd();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/memreport.h"
+
+// Wall-clock accounting of the compile pipeline, for -ftime-report and
+// -ftime-trace. A TimeScope times the enclosing block as one phase, both
+// into the calling thread's TimeReport, if one is installed, and as an
+// event of LLVM's time-trace profiler, if that was initialized on this
+// thread; an outermost scope also samples memory for the thread's
+// MemReport. With none of them, a scope costs a few tests.
+class TimeReport {
+public:
+    // The row of `phase` at nesting `depth`, added on first use.
+    size_t Row(std::string_view phase, int depth);
+    void Add(size_t row, double seconds);
+    // One row per phase, in the order they first started, indented by
+    // nesting and with their share of `total` seconds.
+    void Print(FILE* out, double total) const;
+
+private:
+    struct Phase {
+        std::string name;
+        int depth;
+        size_t count;
+        double seconds;
+    };
+    std::vector<Phase> phases;
+};
+
+// Installs `report` (or null) for the calling thread.
+void SetTimeReport(TimeReport* report);
+
+class TimeScope {
+public:
+    // `detail` (a function's name, a command line) only goes into the trace.
+    explicit TimeScope(std::string_view phase, std::string_view detail = {});
+    ~TimeScope();
+    TimeScope(const TimeScope&) = delete;
+    TimeScope& operator=(const TimeScope&) = delete;
+
+private:
+    TimeReport* report;
+    size_t row = 0;
+    std::chrono::steady_clock::time_point start;
+    MemReport* mem;
+    size_t memRow = 0;
+    MemUsage memStart;
+    bool traced;
+};
@@ -0,0 +1,644 @@
+#include "x64/baseline.h"
+#include "x64/elfobject.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <map>
+#include <vector>
+
+namespace {
+
+enum Reg : int { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Condition codes, as in the low nibble of Jcc and SETcc.
+enum Cond : uint8_t { kA = 0x7, kE = 0x4, kNE = 0x5, kL = 0xC, kGE = 0xD, kLE = 0xE, kG = 0xF };
+
+const Reg kArgRegs[] = {RDI, RSI, RDX, RCX, R8, R9};
+
+// The memory block: [0, 16) is never an object, so the word at offset 8
+// holds the top of the local-array stack (0 until main has set it up).
+// The stack starts after the globals.
+constexpr int32_t kStackTop = 8;
+constexpr uint32_t kArrayStackBytes = 8u << 20;
+
+uint32_t Align16(uint32_t n) { return (n + 15) & ~15u; }
+
+// [base + index * scale + disp]; base -1 for none.
+struct Mem {
+    int base;
+    int index = -1;
+    int scale = 1;
+    int32_t disp = 0;
+};
+
+// Encodes the few instruction forms the lowering needs.
+class Assembler {
+public:
+    explicit Assembler(std::vector<uint8_t>& code) : code(code) {}
+
+    size_t Size() const { return code.size(); }
+    void Bytes(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+    void Imm32(int32_t v) {
+        for (int i = 0; i < 4; ++i) code.push_back((uint8_t)((uint32_t)v >> (8 * i)));
+    }
+    void Patch32(size_t at, int32_t v) {
+        for (int i = 0; i < 4; ++i) code[at + i] = (uint8_t)((uint32_t)v >> (8 * i));
+    }
+
+    // `opcode` with ModRM reg field `reg` and memory operand `m`.
+    void M(std::initializer_list<uint8_t> opcode, int reg, const Mem& m, bool wide = false) {
+        Rex(wide, reg, m.index < 0 ? 0 : m.index, m.base < 0 ? 0 : m.base);
+        Bytes(opcode);
+        int scale = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+        // A base takes an 8-bit displacement when it fits (most stack slots).
+        bool short8 = m.base >= 0 && m.disp >= -128 && m.disp <= 127;
+        uint8_t mod = m.base < 0 ? 0x00 : short8 ? 0x40 : 0x80;
+        if (m.index < 0 && m.base >= 0 && (m.base & 7) != RSP) {
+            code.push_back((uint8_t)(mod | ((reg & 7) << 3) | (m.base & 7)));
+        } else {
+            code.push_back((uint8_t)(mod | ((reg & 7) << 3) | 4));
+            int index = m.index < 0 ? RSP : m.index;
+            code.push_back((uint8_t)((scale << 6) | ((index & 7) << 3) | (m.base < 0 ? 5 : m.base & 7)));
+        }
+        if (short8) code.push_back((uint8_t)m.disp);
+        else Imm32(m.disp);
+    }
+
+    // `opcode` with ModRM reg field `reg` and register operand `rm`.
+    void R(std::initializer_list<uint8_t> opcode, int reg, int rm, bool wide = false) {
+        Rex(wide, reg, 0, rm);
+        Bytes(opcode);
+        code.push_back((uint8_t)(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+    }
+
+    // `opcode` with a RIP-relative operand; returns the displacement's offset.
+    size_t Rip(std::initializer_list<uint8_t> opcode, int reg, bool wide) {
+        Rex(wide, reg, 0, 0);
+        Bytes(opcode);
+        code.push_back((uint8_t)(((reg & 7) << 3) | 5));
+        Imm32(0);
+        return code.size() - 4;
+    }
+
+private:
+    void Rex(bool wide, int reg, int index, int base) {
+        uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+        if (rex != 0x40) code.push_back(rex);
+    }
+
+    std::vector<uint8_t>& code;
+};
+
+// Which arguments of a printf (or scanf) call are pointers, from its
+// format; anything past what the format names is an int.
+std::vector<bool> PointerArgs(const char* format, bool scan) {
+    std::vector<bool> pointers{true};
+    for (const char* p = format; *p; ++p) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+        bool suppress = scan && *p == '*';
+        if (suppress) ++p;
+        while (!scan && *p && strchr("-+ #0", *p)) ++p;
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1 && *p == '.') ++p;
+            if (!scan && *p == '*') {
+                pointers.push_back(false);
+                ++p;
+            }
+            while (*p >= '0' && *p <= '9') ++p;
+        }
+        while (*p && strchr("hlLqjzt", *p)) ++p;
+        if (!*p) break;
+        if (scan && *p == '[') {
+            p += p[1] == ']' ? 2 : p[1] == '^' && p[2] == ']' ? 3 : 1;
+            while (*p && *p != ']') ++p;
+            if (!*p) break;
+        }
+        if (!suppress) pointers.push_back(scan || *p == 's' || *p == 'n');
+    }
+    return pointers;
+}
+
+// Whether `insn` sets register `reg` (of its own window).
+bool Writes(const Insn& insn, int reg) {
+    switch (insn.op) {
+    case Op::Stw: case Op::Stb: case Op::StwO: case Op::StbO:
+    case Op::Stg: case Op::Stgb: case Op::StgX: case Op::StgbX:
+    case Op::Zero: case Op::AddM: case Op::AddGX: case Op::AddG: case Op::AddGI:
+    case Op::Jmp: case Op::Jz: case Op::Jnz:
+    case Op::JLt: case Op::JLe: case Op::JGt: case Op::JGe: case Op::JEq: case Op::JNe:
+    case Op::JLtI: case Op::JLeI: case Op::JGtI: case Op::JGeI: case Op::JEqI: case Op::JNeI:
+    case Op::Switch: case Op::Ret: case Op::Ret0:
+        return false;
+    case Op::Call:
+        return insn.b == reg;
+    default:
+        return insn.a == reg;
+    }
+}
+
+class Lowering {
+public:
+    Lowering(const Program& program, const uint8_t* image, ElfObject& obj, FILE* diagnostics)
+        : program(program), image(image), obj(obj), diagnostics(diagnostics), a(obj.text) {}
+
+    bool Run();
+
+private:
+    struct Fixup {
+        size_t at;
+        int32_t target;
+    };
+
+    void Function(int index);
+    void Lower(const ::Function& fn, size_t i);
+    void Prologue(const ::Function& fn);
+    void Epilogue(const ::Function& fn);
+    void Switch(const SwitchTable& table, size_t lo, size_t hi);
+    // A call; `base` is the first argument's register, and `pointers`
+    // marks the arguments that are offsets into memory. Returns the offset
+    // of the call's displacement, for the caller to patch or relocate.
+    size_t CallArgs(int base, int count, const std::vector<bool>& pointers);
+    void Builtin(const ::Function& fn, size_t i, const char* name);
+    bool FormatOf(const ::Function& fn, size_t i, const char*& format);
+    void FindJumpSources(const ::Function& fn);
+
+    Mem Slot(int reg) const { return {RBP, -1, 1, -16 - 4 * (reg + 1)}; }
+    Mem At(int reg, int32_t disp = 0) const { return {R15, reg, 1, disp}; }
+    void Load(int reg, int slot) { a.M({0x8B}, reg, Slot(slot)); }
+    void Store(int slot, int reg) { a.M({0x89}, reg, Slot(slot)); }
+    void CmpImm(const Mem& m, int32_t imm) {
+        a.M({0x81}, 7, m);
+        a.Imm32(imm);
+    }
+    void Set(Cond cond) {
+        a.Bytes({0x0F, (uint8_t)(0x90 | cond), 0xC0, 0x0F, 0xB6, 0xC0});   // setcc al; movzx eax, al
+    }
+    // ecx = R[base] + R[index] * scale
+    void Address(int base, int index, int scale) {
+        Load(RCX, base);
+        Load(RDX, index);
+        a.M({0x8D}, RCX, {RCX, RDX, scale});
+    }
+    // A jump to instruction `target`; kJmp for an unconditional one.
+    static constexpr uint8_t kJmp = 0xFF;
+    void Jump(uint8_t cond, int32_t target);
+    size_t JumpHere(uint8_t cond);
+    void Land(size_t at) { a.Patch32(at, (int32_t)(a.Size() - (at + 4))); }
+    int External(const std::string& name);
+
+    const Program& program;
+    const uint8_t* image;
+    ElfObject& obj;
+    FILE* diagnostics;
+    Assembler a;
+
+    std::vector<size_t> functionOffsets;
+    std::vector<Fixup> calls;
+    std::map<std::string, int> externals;
+    int errors = 0;
+
+    // Per function: where each instruction starts (then the epilogue and
+    // the trap), the jumps to patch, and which instructions jump where.
+    std::vector<size_t> offsets;
+    std::vector<Fixup> jumps;
+    std::vector<std::pair<int32_t, int32_t>> jumpSources;   // (target, source), sorted
+};
+
+bool Lowering::Run() {
+    uint32_t stackStart = Align16(program.globalBytes);
+    obj.rodata.assign(image, image + program.globalBytes);
+    obj.bssSize = (uint64_t)stackStart + kArrayStackBytes;
+
+    functionOffsets.resize(program.functions.size());
+    for (size_t i = 0; i < program.functions.size(); ++i) Function((int)i);
+    for (auto& call : calls)
+        a.Patch32(call.at, (int32_t)(functionOffsets[call.target] - (call.at + 4)));
+    for (size_t i = 0; i < program.functions.size(); ++i) {
+        size_t end = i + 1 < program.functions.size() ? functionOffsets[i + 1] : a.Size();
+        obj.AddGlobal(program.functions[i].name, ElfObject::Section::Text, functionOffsets[i], end - functionOffsets[i]);
+    }
+    return errors == 0;
+}
+
+int Lowering::External(const std::string& name) {
+    auto found = externals.find(name);
+    if (found != externals.end()) return found->second;
+    return externals[name] = obj.AddGlobal(name, ElfObject::Section::Undefined);
+}
+
+void Lowering::Jump(uint8_t cond, int32_t target) {
+    jumps.push_back({JumpHere(cond), target});
+}
+
+size_t Lowering::JumpHere(uint8_t cond) {
+    if (cond == kJmp) a.Bytes({0xE9});
+    else a.Bytes({0x0F, (uint8_t)(0x80 | cond)});
+    a.Imm32(0);
+    return a.Size() - 4;
+}
+
+void Lowering::Function(int index) {
+    const ::Function& fn = program.functions[index];
+    // 16-byte alignment keeps every function start a fetch-block boundary.
+    while (a.Size() % 16) a.Bytes({0xCC});
+    functionOffsets[index] = a.Size();
+    offsets.assign(fn.code.size() + 2, 0);
+    jumps.clear();
+    jumpSources.clear();
+
+    Prologue(fn);
+    for (size_t i = 0; i < fn.code.size(); ++i) {
+        offsets[i] = a.Size();
+        Lower(fn, i);
+    }
+    offsets[fn.code.size()] = a.Size();
+    Epilogue(fn);
+    offsets[fn.code.size() + 1] = a.Size();
+    a.Bytes({0x0F, 0x0B});   // ud2: the local-array stack is exhausted
+
+    for (auto& jump : jumps)
+        a.Patch32(jump.at, (int32_t)(offsets[jump.target] - (jump.at + 4)));
+}
+
+// The frame: saved rbp, r15 (the memory base) and r14 (this call's slice
+// of the local-array stack), then one 4-byte slot per register.
+void Lowering::Prologue(const ::Function& fn) {
+    a.Bytes({0x55, 0x48, 0x89, 0xE5, 0x41, 0x57, 0x41, 0x56});   // push rbp; mov rbp, rsp; push r15; push r14
+    a.Bytes({0x48, 0x81, 0xEC});                                 // sub rsp, imm32
+    a.Imm32((int32_t)Align16(4 * (uint32_t)fn.registers));
+    obj.AddPC32(a.Rip({0x8D}, R15, true), obj.SectionSymbol(ElfObject::Section::Bss), -4);
+
+    if (fn.name == "main") {
+        // Copy the globals in, on the first entry only.
+        CmpImm({R15, -1, 1, kStackTop}, 0);
+        size_t skip = JumpHere(kNE);
+        a.R({0x89}, R15, RDI, true);                             // mov rdi, r15
+        obj.AddPC32(a.Rip({0x8D}, RSI, true), obj.SectionSymbol(ElfObject::Section::Rodata), -4);
+        a.Bytes({0xB9});                                         // mov ecx, imm32
+        a.Imm32((int32_t)program.globalBytes);
+        a.Bytes({0xF3, 0xA4});                                   // rep movsb
+        a.M({0xC7}, 0, {R15, -1, 1, kStackTop});
+        a.Imm32((int32_t)Align16(program.globalBytes));
+        Land(skip);
+    }
+
+    for (int i = 0; i < fn.params; ++i) {
+        if (i < 6) {
+            Store(i, kArgRegs[i]);
+        } else {
+            a.M({0x8B}, RAX, {RBP, -1, 1, 16 + 8 * (i - 6)});
+            Store(i, RAX);
+        }
+    }
+
+    if (fn.frameBytes) {
+        a.M({0x8B}, R14, {R15, -1, 1, kStackTop});               // mov r14d, [stack top]
+        a.M({0x8D}, RAX, {R14, -1, 1, (int32_t)Align16(fn.frameBytes)});
+        a.Bytes({0x3D});                                         // cmp eax, imm32
+        a.Imm32((int32_t)obj.bssSize);
+        Jump(kA, (int32_t)fn.code.size() + 1);
+        a.M({0x89}, RAX, {R15, -1, 1, kStackTop});
+    }
+}
+
+void Lowering::Epilogue(const ::Function& fn) {
+    if (fn.frameBytes) a.M({0x89}, R14, {R15, -1, 1, kStackTop});
+    a.M({0x8D}, RSP, {RBP, -1, 1, -16}, true);                   // lea rsp, [rbp - 16]
+    a.Bytes({0x41, 0x5E, 0x41, 0x5F, 0x5D, 0xC3});               // pop r14; pop r15; pop rbp; ret
+}
+
+void Lowering::Lower(const ::Function& fn, size_t i) {
+    const Insn& in = fn.code[i];
+    auto binary = [&](std::initializer_list<uint8_t> opcode) {
+        Load(RAX, in.b);
+        a.M(opcode, RAX, Slot(in.c));
+        Store(in.a, RAX);
+    };
+    auto compare = [&](Cond cond) {
+        Load(RAX, in.b);
+        a.M({0x3B}, RAX, Slot(in.c));
+        Set(cond);
+        Store(in.a, RAX);
+    };
+    auto branch = [&](Cond cond) {
+        Load(RAX, in.a);
+        a.M({0x3B}, RAX, Slot(in.b));
+        Jump(cond, in.c);
+    };
+    auto branchImm = [&](Cond cond) {
+        CmpImm(Slot(in.a), in.b);
+        Jump(cond, in.c);
+    };
+
+    switch (in.op) {
+    case Op::Mov:
+        Load(RAX, in.b);
+        Store(in.a, RAX);
+        break;
+    case Op::Li:
+        a.M({0xC7}, 0, Slot(in.a));
+        a.Imm32(in.b);
+        break;
+    case Op::Lea:
+        a.M({0x8D}, RAX, {R14, -1, 1, in.b});
+        Store(in.a, RAX);
+        break;
+
+    case Op::Add: binary({0x03}); break;
+    case Op::Sub: binary({0x2B}); break;
+    case Op::Mul: binary({0x0F, 0xAF}); break;
+    case Op::And: binary({0x23}); break;
+    case Op::Or:  binary({0x0B}); break;
+    case Op::Xor: binary({0x33}); break;
+    case Op::Div:
+    case Op::Mod:
+        Load(RAX, in.b);
+        a.Bytes({0x99});                                         // cdq
+        a.M({0xF7}, 7, Slot(in.c));                              // idiv
+        Store(in.a, in.op == Op::Div ? RAX : RDX);
+        break;
+    case Op::Shl:
+    case Op::Shr:
+        Load(RAX, in.b);
+        Load(RCX, in.c);
+        a.R({0xD3}, in.op == Op::Shl ? 4 : 7, RAX);              // shl/sar eax, cl
+        Store(in.a, RAX);
+        break;
+    case Op::Lt: compare(kL); break;
+    case Op::Le: compare(kLE); break;
+    case Op::Gt: compare(kG); break;
+    case Op::Ge: compare(kGE); break;
+    case Op::Eq: compare(kE); break;
+    case Op::Ne: compare(kNE); break;
+    case Op::AddI:
+        Load(RAX, in.b);
+        a.R({0x81}, 0, RAX);
+        a.Imm32(in.c);
+        Store(in.a, RAX);
+        break;
+    case Op::MulI:
+        a.M({0x69}, RAX, Slot(in.b));
+        a.Imm32(in.c);
+        Store(in.a, RAX);
+        break;
+
+    case Op::Neg:
+    case Op::BitNot:
+        Load(RAX, in.b);
+        a.R({0xF7}, in.op == Op::Neg ? 3 : 2, RAX);
+        Store(in.a, RAX);
+        break;
+    case Op::Not:
+    case Op::Bool:
+        CmpImm(Slot(in.b), 0);
+        Set(in.op == Op::Not ? kE : kNE);
+        Store(in.a, RAX);
+        break;
+    case Op::Sext8:
+        Load(RAX, in.b);
+        a.R({0x0F, 0xBE}, RAX, RAX);                             // movsx eax, al
+        Store(in.a, RAX);
+        break;
+
+    case Op::Ldw:
+    case Op::Ldb:
+        Address(in.b, in.c, in.op == Op::Ldw ? 4 : 1);
+        if (in.op == Op::Ldw) a.M({0x8B}, RAX, At(RCX));
+        else a.M({0x0F, 0xBE}, RAX, At(RCX));
+        Store(in.a, RAX);
+        break;
+    case Op::Stw:
+    case Op::Stb:
+        Address(in.b, in.c, in.op == Op::Stw ? 4 : 1);
+        Load(RAX, in.a);
+        a.M({(uint8_t)(in.op == Op::Stw ? 0x89 : 0x88)}, RAX, At(RCX));
+        break;
+    case Op::LdwO:
+    case Op::LdbO:
+        Load(RCX, in.b);
+        a.M({0x8D}, RCX, {RCX, -1, 1, in.c});
+        if (in.op == Op::LdwO) a.M({0x8B}, RAX, At(RCX));
+        else a.M({0x0F, 0xBE}, RAX, At(RCX));
+        Store(in.a, RAX);
+        break;
+    case Op::StwO:
+    case Op::StbO:
+        Load(RCX, in.b);
+        a.M({0x8D}, RCX, {RCX, -1, 1, in.c});
+        Load(RAX, in.a);
+        a.M({(uint8_t)(in.op == Op::StwO ? 0x89 : 0x88)}, RAX, At(RCX));
+        break;
+    case Op::Ldg:
+        a.M({0x8B}, RAX, {R15, -1, 1, in.b});
+        Store(in.a, RAX);
+        break;
+    case Op::Ldgb:
+        a.M({0x0F, 0xBE}, RAX, {R15, -1, 1, in.b});
+        Store(in.a, RAX);
+        break;
+    case Op::Stg:
+    case Op::Stgb:
+        Load(RAX, in.a);
+        a.M({(uint8_t)(in.op == Op::Stg ? 0x89 : 0x88)}, RAX, {R15, -1, 1, in.b});
+        break;
+    case Op::LdgX:
+    case Op::LdgbX:
+        Load(RCX, in.b);
+        a.M({0x8D}, RCX, {-1, RCX, in.op == Op::LdgX ? 4 : 1, in.c});
+        if (in.op == Op::LdgX) a.M({0x8B}, RAX, At(RCX));
+        else a.M({0x0F, 0xBE}, RAX, At(RCX));
+        Store(in.a, RAX);
+        break;
+    case Op::StgX:
+    case Op::StgbX:
+        Load(RCX, in.b);
+        a.M({0x8D}, RCX, {-1, RCX, in.op == Op::StgX ? 4 : 1, in.c});
+        Load(RAX, in.a);
+        a.M({(uint8_t)(in.op == Op::StgX ? 0x89 : 0x88)}, RAX, At(RCX));
+        break;
+    case Op::Zero:
+        Load(RAX, in.a);
+        a.M({0x8D}, RDI, At(RAX), true);                         // lea rdi, [r15 + rax]
+        a.Bytes({0xB9});
+        a.Imm32(in.b);
+        a.Bytes({0x31, 0xC0, 0xF3, 0xAA});                       // xor eax, eax; rep stosb
+        break;
+
+    case Op::AddM:
+        Address(in.b, in.c, 4);
+        Load(RAX, in.a);
+        a.M({0x01}, RAX, At(RCX));
+        break;
+    case Op::AddGX:
+        Load(RCX, in.b);
+        a.M({0x8D}, RCX, {-1, RCX, 4, in.c});
+        Load(RAX, in.a);
+        a.M({0x01}, RAX, At(RCX));
+        break;
+    case Op::AddG:
+        Load(RAX, in.a);
+        a.M({0x01}, RAX, {R15, -1, 1, in.b});
+        break;
+    case Op::AddGI:
+        a.M({0x81}, 0, {R15, -1, 1, in.b});
+        a.Imm32(in.a);
+        break;
+
+    case Op::Jmp:
+        if (in.a != (int32_t)i + 1) Jump(kJmp, in.a);
+        break;
+    case Op::Jz:
+    case Op::Jnz:
+        CmpImm(Slot(in.a), 0);
+        Jump(in.op == Op::Jz ? kE : kNE, in.b);
+        break;
+    case Op::JLt: branch(kL); break;
+    case Op::JLe: branch(kLE); break;
+    case Op::JGt: branch(kG); break;
+    case Op::JGe: branch(kGE); break;
+    case Op::JEq: branch(kE); break;
+    case Op::JNe: branch(kNE); break;
+    case Op::JLtI: branchImm(kL); break;
+    case Op::JLeI: branchImm(kLE); break;
+    case Op::JGtI: branchImm(kG); break;
+    case Op::JGeI: branchImm(kGE); break;
+    case Op::JEqI: branchImm(kE); break;
+    case Op::JNeI: branchImm(kNE); break;
+    case Op::Switch: {
+        const SwitchTable& table = fn.switches[in.b];
+        Load(RAX, in.a);
+        Switch(table, 0, table.cases.size());
+        break;
+    }
+
+    case Op::Call:
+        calls.push_back({CallArgs(in.b, in.c, {}), in.a});
+        Store(in.b, RAX);
+        break;
+    case Op::Printf:
+        Builtin(fn, i, "printf");
+        break;
+    case Op::Scanf:
+        Builtin(fn, i, "scanf");
+        break;
+    case Op::Ret:
+    case Op::Ret0:
+        if (in.op == Op::Ret) Load(RAX, in.a);
+        else a.Bytes({0x31, 0xC0});                              // xor eax, eax
+        if (i + 1 < fn.code.size()) Jump(kJmp, (int32_t)fn.code.size());
+        break;
+    }
+}
+
+// Binary search over the sorted case values in eax.
+void Lowering::Switch(const SwitchTable& table, size_t lo, size_t hi) {
+    auto compare = [&](size_t k) {
+        a.Bytes({0x3D});                                         // cmp eax, imm32
+        a.Imm32(table.cases[k].first);
+        Jump(kE, table.cases[k].second);
+    };
+    if (hi - lo <= 4) {
+        for (size_t k = lo; k < hi; ++k) compare(k);
+        Jump(kJmp, table.defaultTarget);
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    compare(mid);
+    size_t below = JumpHere(kL);
+    Switch(table, mid + 1, hi);
+    Land(below);
+    Switch(table, lo, mid);
+}
+
+// Arguments past the sixth go on the stack, padded to keep it 16-byte
+// aligned at the call.
+size_t Lowering::CallArgs(int base, int count, const std::vector<bool>& pointers) {
+    auto load = [&](int reg, int k) {
+        Load(reg, base + k);
+        if (k < (int)pointers.size() && pointers[k]) a.M({0x8D}, reg, At(reg), true);   // lea reg, [r15 + reg]
+    };
+    int onStack = count > 6 ? count - 6 : 0;
+    if (onStack % 2) a.Bytes({0x48, 0x83, 0xEC, 0x08});         // sub rsp, 8
+    for (int k = count - 1; k >= 6; --k) {
+        load(RAX, k);
+        a.Bytes({0x50});                                         // push rax
+    }
+    for (int k = 0; k < count && k < 6; ++k) load(kArgRegs[k], k);
+    a.Bytes({0x31, 0xC0, 0xE8});                                 // xor eax, eax (no vector args); call
+    a.Imm32(0);
+    size_t call = a.Size() - 4;
+    if (onStack) {
+        a.Bytes({0x48, 0x81, 0xC4});                             // add rsp, imm32
+        a.Imm32(8 * (onStack + onStack % 2));
+    }
+    return call;
+}
+
+void Lowering::Builtin(const ::Function& fn, size_t i, const char* name) {
+    const Insn& in = fn.code[i];
+    const char* format;
+    if (!FormatOf(fn, i, format)) {
+        fprintf(diagnostics, "error: the format of a '%s' call in '%s' is not a string literal\n", name, fn.name.c_str());
+        ++errors;
+        return;
+    }
+    size_t call = CallArgs(in.a, in.b, PointerArgs(format, in.op == Op::Scanf));
+    obj.AddPLT32(call, External(name), -4);
+    Store(in.a, RAX);
+}
+
+// The format is the string literal whose address the last write to the
+// call's first register loads, provided nothing can jump past that write
+// to reach the call.
+bool Lowering::FormatOf(const ::Function& fn, size_t i, const char*& format) {
+    int reg = fn.code[i].a;
+    size_t w = i;
+    while (w-- > 0 && !Writes(fn.code[w], reg)) {}
+    if (w >= i || fn.code[w].op != Op::Li) return false;
+
+    if (jumpSources.empty()) FindJumpSources(fn);
+    auto it = std::lower_bound(jumpSources.begin(), jumpSources.end(), std::make_pair((int32_t)w + 1, INT32_MIN));
+    for (; it != jumpSources.end() && it->first <= (int32_t)i; ++it)
+        if (it->second <= (int32_t)w || it->second >= (int32_t)i) return false;
+
+    uint32_t addr = (uint32_t)fn.code[w].b;
+    if (addr >= program.globalBytes || !memchr(image + addr, 0, program.globalBytes - addr)) return false;
+    format = (const char*)image + addr;
+    return true;
+}
+
+void Lowering::FindJumpSources(const ::Function& fn) {
+    for (size_t s = 0; s < fn.code.size(); ++s) {
+        const Insn& in = fn.code[s];
+        auto add = [&](int32_t target) { jumpSources.push_back({target, (int32_t)s}); };
+        switch (in.op) {
+        case Op::Jmp: add(in.a); break;
+        case Op::Jz: case Op::Jnz: add(in.b); break;
+        case Op::JLt: case Op::JLe: case Op::JGt: case Op::JGe: case Op::JEq: case Op::JNe:
+        case Op::JLtI: case Op::JLeI: case Op::JGtI: case Op::JGeI: case Op::JEqI: case Op::JNeI:
+            add(in.c);
+            break;
+        case Op::Switch:
+            for (auto& c : fn.switches[in.b].cases) add(c.second);
+            add(fn.switches[in.b].defaultTarget);
+            break;
+        default:
+            break;
+        }
+    }
+    // Never empty once computed, so it is only built once per function.
+    jumpSources.push_back({INT32_MAX, INT32_MAX});
+    std::sort(jumpSources.begin(), jumpSources.end());
+}
+
+} // anonymous namespace
+
+bool EmitX64Object(const Program& program, const uint8_t* image, std::vector<uint8_t>& object, FILE* diagnostics) {
+    ElfObject obj;
+    if (!Lowering(program, image, obj, diagnostics).Run()) return false;
+    object = obj.Bytes();
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "interp/bytecode.h"
+
+// The baseline x86-64 backend (-backend=baseline): one pass over the
+// bytecode the interpreter compiles, straight to machine code in an ELF
+// object, without LLVM.
+//
+// Each bytecode register gets a stack slot. Pointers stay what they are in
+// the bytecode, 32-bit offsets into one block of memory in .bss (based in
+// r15); `image` supplies its first program.globalBytes bytes, the globals
+// and string literals, which main copies in on entry. Local arrays are
+// carved from the same block. Functions use the SysV calling convention,
+// and printf/scanf are the linked C library's, so a format must be a
+// string literal for its pointer arguments to be known.
+//
+// Sets `object` to the ELF object's bytes; on failure reports the errors
+// to `diagnostics` and returns false.
+bool EmitX64Object(const Program& program, const uint8_t* image, std::vector<uint8_t>& object,
+                   FILE* diagnostics = stderr);
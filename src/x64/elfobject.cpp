@@ -0,0 +1,134 @@
+#include "x64/elfobject.h"
+
+#include <elf.h>
+#include <cstring>
+
+namespace {
+
+// Section header indices, in file order.
+enum : uint16_t { kNull, kText, kRodata, kBss, kRela, kSymtab, kStrtab, kNote, kShstrtab, kSections };
+
+// The first global symbol; before it are the null symbol and one section
+// symbol per ElfObject::Section with contents.
+constexpr int kFirstGlobal = 4;
+
+void Append(std::vector<uint8_t>& out, const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void Align(std::vector<uint8_t>& out, size_t alignment) {
+    out.resize((out.size() + alignment - 1) / alignment * alignment);
+}
+
+uint32_t AddString(std::vector<uint8_t>& table, const std::string& str) {
+    uint32_t offset = (uint32_t)table.size();
+    Append(table, str.c_str(), str.size() + 1);
+    return offset;
+}
+
+} // anonymous namespace
+
+int ElfObject::AddGlobal(const std::string& name, Section section, uint64_t value, uint64_t size) {
+    globals.push_back({name, section, value, size});
+    return kFirstGlobal + (int)globals.size() - 1;
+}
+
+void ElfObject::AddPC32(uint64_t offset, int symbol, int64_t addend) {
+    relocations.push_back({offset, symbol, R_X86_64_PC32, addend});
+}
+
+void ElfObject::AddPLT32(uint64_t offset, int symbol, int64_t addend) {
+    relocations.push_back({offset, symbol, R_X86_64_PLT32, addend});
+}
+
+std::vector<uint8_t> ElfObject::Bytes() const {
+    auto sectionIndex = [](Section section) -> uint16_t {
+        switch (section) {
+        case Section::Text:   return kText;
+        case Section::Rodata: return kRodata;
+        case Section::Bss:    return kBss;
+        default:              return SHN_UNDEF;
+        }
+    };
+
+    std::vector<uint8_t> strtab{0};
+    std::vector<Elf64_Sym> symbols(kFirstGlobal);
+    memset(symbols.data(), 0, symbols.size() * sizeof(Elf64_Sym));
+    for (int i = 1; i < kFirstGlobal; ++i) {
+        symbols[i].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+        symbols[i].st_shndx = sectionIndex((Section)(i - 1));
+    }
+    for (auto& global : globals) {
+        Elf64_Sym sym{};
+        sym.st_name = AddString(strtab, global.name);
+        bool defined = global.section != Section::Undefined;
+        sym.st_info = ELF64_ST_INFO(STB_GLOBAL, defined && global.section == Section::Text ? STT_FUNC : STT_NOTYPE);
+        sym.st_shndx = sectionIndex(global.section);
+        sym.st_value = global.value;
+        sym.st_size = global.size;
+        symbols.push_back(sym);
+    }
+
+    std::vector<Elf64_Rela> relas;
+    for (auto& reloc : relocations) {
+        Elf64_Rela rela{};
+        rela.r_offset = reloc.offset;
+        rela.r_info = ELF64_R_INFO((uint64_t)reloc.symbol, reloc.type);
+        rela.r_addend = reloc.addend;
+        relas.push_back(rela);
+    }
+
+    std::vector<uint8_t> shstrtab{0};
+    const char* names[kSections] = {
+        "", ".text", ".rodata", ".bss", ".rela.text", ".symtab", ".strtab", ".note.GNU-stack", ".shstrtab",
+    };
+    Elf64_Shdr headers[kSections]{};
+    for (int i = 1; i < kSections; ++i) headers[i].sh_name = AddString(shstrtab, names[i]);
+
+    // The file: ELF header, section contents, then the section headers.
+    std::vector<uint8_t> file(sizeof(Elf64_Ehdr));
+    auto place = [&](uint16_t index, uint32_t type, uint64_t flags, const void* data, size_t size, size_t alignment) {
+        Align(file, alignment);
+        Elf64_Shdr& h = headers[index];
+        h.sh_type = type;
+        h.sh_flags = flags;
+        h.sh_offset = file.size();
+        h.sh_size = size;
+        h.sh_addralign = alignment;
+        if (type != SHT_NOBITS && size) Append(file, data, size);
+    };
+    place(kText, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text.data(), text.size(), 16);
+    place(kRodata, SHT_PROGBITS, SHF_ALLOC, rodata.data(), rodata.size(), 16);
+    place(kBss, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, nullptr, bssSize, 16);
+    place(kRela, SHT_RELA, SHF_INFO_LINK, relas.data(), relas.size() * sizeof(Elf64_Rela), 8);
+    headers[kRela].sh_link = kSymtab;
+    headers[kRela].sh_info = kText;
+    headers[kRela].sh_entsize = sizeof(Elf64_Rela);
+    place(kSymtab, SHT_SYMTAB, 0, symbols.data(), symbols.size() * sizeof(Elf64_Sym), 8);
+    headers[kSymtab].sh_link = kStrtab;
+    headers[kSymtab].sh_info = kFirstGlobal;
+    headers[kSymtab].sh_entsize = sizeof(Elf64_Sym);
+    place(kStrtab, SHT_STRTAB, 0, strtab.data(), strtab.size(), 1);
+    place(kNote, SHT_PROGBITS, 0, nullptr, 0, 1);
+    place(kShstrtab, SHT_STRTAB, 0, shstrtab.data(), shstrtab.size(), 1);
+
+    Align(file, 8);
+    Elf64_Ehdr ehdr{};
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    ehdr.e_type = ET_REL;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_shoff = file.size();
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_shentsize = sizeof(Elf64_Shdr);
+    ehdr.e_shnum = kSections;
+    ehdr.e_shstrndx = kShstrtab;
+    memcpy(file.data(), &ehdr, sizeof(ehdr));
+    Append(file, headers, sizeof(headers));
+    return file;
+}
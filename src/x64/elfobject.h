@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A minimal ELF64 relocatable object for x86-64: code in .text, read-only
+// data in .rodata, zero-initialized memory in .bss, and the symbols and
+// relocations that tie them together. Enough for `ld` or a C compiler
+// driver to link it like any other object.
+class ElfObject {
+public:
+    enum class Section { Text, Rodata, Bss, Undefined };
+
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> rodata;
+    uint64_t bssSize = 0;
+
+    // The symbol for a section's start, for section-relative relocations.
+    int SectionSymbol(Section section) const { return 1 + (int)section; }
+    // A global symbol: a function defined in .text, or an undefined one
+    // (Section::Undefined) that the linker resolves.
+    int AddGlobal(const std::string& name, Section section, uint64_t value = 0, uint64_t size = 0);
+    // R_X86_64_PC32 / R_X86_64_PLT32 relocations at `offset` in .text.
+    void AddPC32(uint64_t offset, int symbol, int64_t addend);
+    void AddPLT32(uint64_t offset, int symbol, int64_t addend);
+
+    // The object file's contents.
+    std::vector<uint8_t> Bytes() const;
+
+private:
+    struct Symbol {
+        std::string name;
+        Section section;
+        uint64_t value;
+        uint64_t size;
+    };
+    struct Relocation {
+        uint64_t offset;
+        int symbol;
+        uint32_t type;
+        int64_t addend;
+    };
+
+    std::vector<Symbol> globals;
+    std::vector<Relocation> relocations;
+};
@@ -0,0 +1,133 @@
+#include "zcc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "scanner/scanner.h"
+#include "ir/codegen.h"
+#include "ir/stackusage.h"
+#include "ir/irstats.h"
+#include "ir/profile.h"
+#include "interp/interp.h"
+#include "x64/baseline.h"
+#include "util/memreport.h"
+#include "util/timing.h"
+
+namespace zcc {
+
+namespace {
+
+// A FILE* the compiler's components report to, collecting into a string.
+class DiagnosticStream {
+public:
+    DiagnosticStream() : file(open_memstream(&buffer, &length)) {}
+    ~DiagnosticStream() {
+        if (file) fclose(file);
+        free(buffer);
+    }
+
+    FILE* File() const { return file ? file : stderr; }
+
+    std::string Take() {
+        if (!file) return {};
+        fclose(file);
+        file = nullptr;
+        return std::string(buffer, length);
+    }
+
+private:
+    char* buffer = nullptr;
+    size_t length = 0;
+    FILE* file;
+};
+
+bool CompileIR(Scanner& scanner, SourceFile& source, const Options& options, FILE* diagnostics, Result& result) {
+    CodeGen cg(options.filename);
+    cg.SetDiagnostics(diagnostics);
+    cg.SetStaticLocalLimit(options.staticLocalLimit);
+    cg.SetOptLevel(options.optLevel);
+    // Remarks are only as precise as the locations the IR carries.
+    bool remarks = !options.remarksPassed.empty() || !options.remarksMissed.empty() ||
+                   !options.remarksAnalysis.empty() || !options.optimizationRecord.empty();
+    if (options.debugInfo || remarks) cg.EnableDebugInfo();
+    if (!cg.SetRemarkFilters(options.remarksPassed, options.remarksMissed, options.remarksAnalysis)) return false;
+    if (!options.optimizationRecord.empty() && !cg.SaveOptimizationRecord(options.optimizationRecord)) return false;
+    cg.SetCycleProfile(options.cycleProfile);
+    ProfileData profile;
+    if (!options.profileGenerate.empty()) {
+        cg.SetProfileGenerate(options.profileGenerate);
+    } else if (!options.profileUse.empty()) {
+        std::string problem;
+        if (!profile.Parse(options.profileUse, problem)) {
+            cg.Error("invalid profile: " + problem);
+            return false;
+        }
+        if (profile.Empty()) cg.Warning("the profile has no functions");
+        cg.SetProfileUse(&profile);
+    }
+    if (!scanner.Parse(source, &cg) || cg.ErrorCount()) return false;
+    if (auto* report = GetMemReport()) {
+        // What codegen built, before the optimizer reshapes it.
+        IRFootprint footprint = MeasureIR(cg.GetModule());
+        report->AddObjects("LLVM constants", footprint.constants, footprint.constantBytes);
+        report->AddObjects("LLVM instructions", footprint.instructions, footprint.instructionBytes);
+    }
+
+    cg.Optimize();
+    if (options.stackUsage) {
+        TimeScope timer("Stack usage");
+        std::ostringstream out;
+        WriteStackUsage(AnalyzeStackUsage(cg.GetModule()), options.filename, out);
+        result.stackUsage = out.str();
+    }
+    if (options.stats) {
+        TimeScope timer("Statistics");
+        result.stats = CollectIRStats(cg.GetModule());
+    }
+    TimeScope timer("Emit");
+    result.output = cg.IR();
+    return true;
+}
+
+bool CompileObject(Scanner& scanner, SourceFile& source, FILE* diagnostics, Result& result) {
+    Interner names;
+    if (!scanner.Parse(source, names)) return false;
+    Interpreter interp(scanner.ast, names);
+    interp.SetDiagnostics(diagnostics);
+    {
+        TimeScope timer("Bytecode");
+        if (!interp.Compile()) return false;
+    }
+
+    TimeScope timer("Emit");
+    std::vector<uint8_t> object;
+    if (!EmitX64Object(interp.GetProgram(), interp.Image(), object, diagnostics)) return false;
+    result.output.assign(object.begin(), object.end());
+    return true;
+}
+
+} // anonymous namespace
+
+Result Compile(const char* text, size_t size, const Options& options) {
+    Result result;
+    DiagnosticStream diagnostics;
+
+    SourceFile source;
+    source.Assign(text, size);
+    Scanner scanner;
+    scanner.SetLexer(options.handLexer ? LexerKind::Hand : LexerKind::Flex);
+    scanner.SetDiagnostics(diagnostics.File());
+
+    if (options.output == Output::X64Object)
+        result.ok = CompileObject(scanner, source, diagnostics.File(), result);
+    else
+        result.ok = CompileIR(scanner, source, options, diagnostics.File(), result);
+
+    if (!result.ok) result.output.clear();
+    result.diagnostics = diagnostics.Take();
+    return result;
+}
+
+} // namespace zcc
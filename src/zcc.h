@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ir/irstats.h"
+
+// The compiler as a library (libzcc.a): one call takes a source buffer to
+// LLVM IR or an x86-64 object in memory, with its diagnostics captured
+// rather than printed.
+//
+// Compile() keeps all of its state in locals, so any number of threads may
+// call it at once; each gets its own Scanner (a reentrant flex instance),
+// arena, CodeGen and LLVMContext. Linking the object into an executable is
+// left to the caller, which needs the target's ld and runtime anyway.
+namespace zcc {
+
+enum class Output {
+    LLVMIR,      // textual LLVM IR, as -llvm writes it
+    X64Object,   // an ELF relocatable object from the baseline backend
+};
+
+struct Options {
+    Output output = Output::LLVMIR;
+    // The module name, and the file name in the stack usage report.
+    std::string filename = "input.c";
+    bool handLexer = false;              // -lexer=hand
+    uint64_t staticLocalLimit = 0;       // -fstatic-local-arrays=<bytes>; LLVM IR only
+    bool stackUsage = false;             // -fstack-usage; LLVM IR only
+    bool stats = false;                  // -stats-json; LLVM IR only
+    // The rest apply to LLVM IR only.
+    unsigned optLevel = 0;               // -O<level>
+    bool debugInfo = false;              // -g: line tables
+    std::string remarksPassed;           // -Rpass=<regex>
+    std::string remarksMissed;           // -Rpass-missed=<regex>
+    std::string remarksAnalysis;         // -Rpass-analysis=<regex>
+    std::string optimizationRecord;      // -fsave-optimization-record=<file>
+    // -fprofile-generate: where the instrumented program writes its profile.
+    std::string profileGenerate;
+    // -fprofile-use: the text of a profile it wrote.
+    std::string profileUse;
+    bool cycleProfile = false;           // -fcycle-profile
+};
+
+struct Result {
+    bool ok = false;
+    // The IR text or the object file's bytes; empty unless `ok`.
+    std::string output;
+    // The -fstack-usage report, when requested.
+    std::string stackUsage;
+    // Per-function statistics of the optimized IR, when requested; the
+    // caller that assembles the object can add its code sizes.
+    std::vector<IRStats> stats;
+    // Every error and warning, one per line, as the driver prints them.
+    std::string diagnostics;
+};
+
+Result Compile(const char* source, size_t size, const Options& options = {});
+
+} // namespace zcc
@@ -0,0 +1,62 @@
+// Sieve of Eratosthenes over a packed bitset, plus a small hash.
+const int LIMIT = 1 << 10;
+const int WORDS = (LIMIT + 31) >> 5;
+const int MASK = ~0 ^ 0xff;
+
+int bits[WORDS];
+
+int test(int n) { return (bits[n >> 5] >> (n & 31)) & 1; }
+
+void set(int n) { bits[n >> 5] = bits[n >> 5] | (1 << (n & 31)); }
+
+int popcount(int x) {
+    int count = 0;
+    while (x != 0) {
+        x = x & (x - 1);
+        count = count + 1;
+    }
+    return count;
+}
+
+int hash(int h, int c) { return ((h << 5) + h) ^ c; }
+
+// Shift counts are taken mod 32 in every context.
+int shl(int a, int b) { return a << b; }
+const int FOLDED = (1 << 33) + (-16 >> 34);
+const int CALLED = shl(1, 33) + shl(3, -1);
+
+int main() {
+    int i = 2;
+    while (i * i < LIMIT) {
+        if (!test(i)) {
+            int j = i * i;
+            while (j < LIMIT) {
+                set(j);
+                j = j + i;
+            }
+        }
+        i = i + 1;
+    }
+    int primes = 0;
+    i = 2;
+    while (i < LIMIT) {
+        primes = primes + !test(i);
+        i = i + 1;
+    }
+    printf("%d %d\n", primes, popcount(bits[0]));
+
+    printf("%d %d %d\n", MASK, -16 >> 2, 1 | 2 ^ 3 & 6);
+    printf("%d %d\n", 1 << 2 + 1, (5 & 3) == 1);
+
+    int h = 5381;
+    i = 0;
+    while (i < 4) {
+        h = hash(h, 'a' + i);
+        i = i + 1;
+    }
+    printf("%d %d\n", h, ~h);
+
+    int n = 33;
+    printf("%d %d %d\n", FOLDED, CALLED, (1 << n) + (-64 >> (n + 1)) + shl(1, n - 1));
+    return 0;
+}
@@ -0,0 +1,30 @@
+int errors;
+
+__attribute__((cold, noinline))
+int fail(int code) {
+    errors = errors + 1;
+    return -code;
+}
+
+__attribute__((hot))
+int checked_div(int a, int b) {
+    if (unlikely(b == 0)) return fail(1);
+    return a / b;
+}
+
+__attribute__((always_inline)) int square(int x) { return x * x; }
+
+const int K = likely(7) + unlikely(0);
+
+int main() {
+    int sum = 0;
+    int i = 0;
+    while (likely(i < 10)) {
+        sum = sum + checked_div(100, i);
+        i = i + 1;
+    }
+    int picked = unlikely(sum > 1000) ? 1 : 2;
+    if (!likely(errors)) printf("no errors\n");
+    printf("%d %d %d %d %d\n", sum, errors, picked, square(K), likely(5));
+    return 0;
+}
@@ -0,0 +1,58 @@
+int fact(int n) {
+    if (n <= 1) return 1;
+    return n * fact(n - 1);
+}
+int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+int popcount(int x) {
+    int c = 0;
+    while (x) {
+        c = c + x % 2;
+        x = x / 2;
+    }
+    return c;
+}
+int sum(int a[], int n) {
+    int s = 0;
+    for (int i = 0; i < n; i = i + 1) s = s + a[i];
+    return s;
+}
+int noisy() {
+    printf("evaluated\n");
+    return 1;
+}
+int squares(int n) {
+    int t[16];
+    for (int i = 0; i < n; i = i + 1) t[i] = i * i;
+    return sum(t, n);
+}
+const int N = fact(5);
+const int F = fib(25);
+int bits[8] = {popcount(0), popcount(1), popcount(3), popcount(7), popcount(255), popcount(N)};
+int buf[fact(3)];
+int g = squares(4) + 1;
+// The operand that does not decide `&&`/`||` is never evaluated.
+const int SKIP = 0 && noisy();
+const int TAKE = 1 || noisy();
+const int WRAP = 2147483647 + 1;
+const int NEG = -(-2147483647 - 1);
+int main() {
+    const int M = squares(N / 20);
+    int local[fact(4)];
+    printf("%d %d %d\n", N, F, M);
+    for (int i = 0; i < 8; i = i + 1) printf("%d ", bits[i]);
+    printf("\n");
+    local[23] = 7;
+    buf[5] = local[23];
+    printf("%d %d\n", buf[5], g);
+    printf("%d %d %d %d\n", SKIP, TAKE, WRAP, NEG);
+    return 0;
+}
+// A variable's initializer is not its value once it has been assigned.
+// REJECT: int g = 5; int main() { g = 9; int a[g]; const int c = g; return c; } => 'g' is not a constant expression
+// REJECT: int g = 5; int h = g + 1; int main() { return h; } => 'g' is not a constant expression
+// REJECT: const int x = 1 / 0; int main() { return x; } => division by zero in a constant expression
+// REJECT: int a[5 % 0]; int main() { return 0; } => division by zero in a constant expression
+// REJECT: const int m = -2147483647 - 1; const int q = m / -1; int main() { return q; } => signed division overflow in a constant expression
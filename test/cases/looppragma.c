@@ -0,0 +1,42 @@
+// Loop hints only steer the optimizer; the results must not change.
+// Pragmas this compiler does not know, and hints not on a loop, are only
+// warned about.
+#pragma once
+int a[100];
+
+int main() {
+    int i = 0;
+#pragma unroll(4)
+    while (i < 100) {
+        a[i] = i * i;
+        i = i + 1;
+    }
+
+#pragma GCC ivdep
+    int sum = 0;
+#pragma unrol(4)
+#pragma unroll(2)
+    sum = sum + 0;
+#pragma vectorize(4)
+#pragma interleave(2)
+    for (int j = 0; j < 100; j = j + 1)
+        sum = sum + a[j];
+
+    int odd = 0;
+#pragma nounroll
+    for (int j = 1; j < 100; j = j + 2) {
+        if (j > 50) continue;
+        odd = odd + j;
+    }
+
+#pragma vectorize(8)
+    parallel reduction(+: sum) for (int j = 0; j < 100; j = j + 1)
+        sum = sum + 1;
+
+    printf("%d %d\n", sum, odd);
+    return 0;
+#pragma unroll(2)
+}
+// REJECT: int main() {\n#pragma unroll(0)\nwhile (0) ; return 0; } => loop hint count must be positive
+// REJECT: int main() {\n#pragma vectorize\nwhile (0) ; return 0; } => loop hint needs a count in parentheses
+// REJECT: int main() {\n#pragma nounroll(2)\nwhile (0) ; return 0; } => nounroll takes no count
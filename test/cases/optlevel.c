@@ -0,0 +1,20 @@
+// FLAGS: -O2 -g
+int square(int x) { return x * x; }
+
+int gcd(int a, int b) {
+    if (b == 0) return a;
+    return gcd(b, a % b);
+}
+
+int main() {
+    int i = 0, sum = 0;
+    while (i < 10) {
+        sum = sum + square(i);
+        i = i + 1;
+    }
+    int odd = 0;
+    for (int j = 0; j < 100; j = j + 1)
+        if (j % 2) odd = odd + j;
+    printf("%d %d %d\n", sum, gcd(1071, 462), odd);
+    return 0;
+}
@@ -0,0 +1,39 @@
+int a[1000];
+int grid[40][40];
+
+int square(int x) { return x * x; }
+
+int main() {
+    int n = 1000;
+    parallel for (int i = 0; i < n; i = i + 1) {
+        a[i] = square(i % 100);
+    }
+
+    int sum = 0;
+    int odd = 0;
+    parallel reduction(+: sum, odd) for (int i = 0; i < n; i = i + 1) {
+        sum = sum + a[i];
+        if (i % 2 == 1) odd = odd + 1;
+    }
+    printf("%d %d\n", sum, odd);
+
+    int scale = 3;
+    int j;
+    parallel for (j = 1; j <= 38; j = j + 1) {
+        int k = 0;
+        while (k < 40) {
+            grid[j][k] = (j + k) * scale;
+            k = k + 1;
+        }
+    }
+    int checksum = 0;
+    parallel reduction(+: checksum) for (int r = 0; r < 40; r = r + 3) {
+        for (int c = 0; c < 40; c = c + 1) checksum = checksum + grid[r][c];
+    }
+    printf("%d %d\n", j, checksum);
+
+    int steps = 0;
+    parallel reduction(+: steps) for (int i = 10; i < 10; i = i + 1) steps = steps + 1;
+    printf("%d\n", steps);
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Shadowing in nested blocks, loops and switches; each inner binding must
+// be undone when its scope ends.
+int x = 1;
+const int N = 3;
+
+int f(int x) {
+    {
+        int x = 10;
+        x = x + 1;
+    }
+    return x;
+}
+
+int main() {
+    printf("%d ", x);
+    int x = 2;
+    printf("%d ", x);
+    {
+        const int x = 5;
+        int y[x];
+        y[4] = x;
+        printf("%d ", y[4]);
+        {
+            int x = 7;
+            printf("%d ", x);
+        }
+        printf("%d ", x);
+    }
+    for (int x = 0; x < N; x = x + 1) {
+        int N = 100;
+        printf("%d ", x + N);
+    }
+    switch (x) {
+    case 2: {
+        int x = 9;
+        printf("%d ", x);
+    }
+    }
+    printf("%d %d %d\n", x, f(40), N);
+    return 0;
+}
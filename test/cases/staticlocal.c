@@ -0,0 +1,55 @@
+// FLAGS: -fstatic-local-arrays=64
+// Large local arrays move to static storage; each call must still see
+// zeroed arrays where it reads before writing, and recursive functions
+// keep their arrays on the stack.
+
+int count(int n) {
+    int hist[32];
+    int i = 0;
+    while (i < n) {
+        hist[i % 32] = hist[i % 32] + 1;
+        i = i + 1;
+    }
+    return hist[0] * 100 + hist[31];
+}
+
+int squares(int n) {
+    int sq[64];
+    int i = 0;
+    while (i < 64) {
+        sq[i] = i * i;
+        i = i + 1;
+    }
+    return sq[n];
+}
+
+// A write that may not run does not make the array write-first.
+int sticky(int n) {
+    int buf[32];
+    if (n) buf[1] = n;
+    buf[0] = 1;
+    return buf[1];
+}
+
+// Filled by the loop right after it, so it needs no zeroing.
+int filled(int n) {
+    int t[8][8];
+    for (int i = 0; i < 8; i = i + 1)
+        for (int j = 0; j < 8; j = j + 1) t[i][j] = i * 8 + j + n;
+    return t[7][7];
+}
+
+int depth(int n) {
+    int frame[32];
+    frame[0] = n;
+    if (n > 0) depth(n - 1);
+    return frame[0];
+}
+
+int main() {
+    printf("%d %d\n", count(40), count(33));
+    printf("%d %d\n", squares(7), squares(63));
+    printf("%d %d %d\n", sticky(5), sticky(0), filled(1));
+    printf("%d\n", depth(5));
+    return 0;
+}
@@ -0,0 +1,74 @@
+int classify(int op) {
+    switch (op) {
+    case 0:
+        return 10;
+    case 1:
+    case 2:
+        return 20;
+    case 7:
+        op = op * 2;
+    case 8:
+        return op + 100;
+    default:
+        return -1;
+    }
+}
+
+const int SCALE = 3;
+
+int run(int program[], int n) {
+    int acc = 0;
+    int pc = 0;
+    while (pc < n) {
+        int steps = 0;
+        switch (program[pc]) {
+        case 1: acc = acc + 1; break;
+        case 2: acc = acc * SCALE; break;
+        case 2 + 1:
+            pc = pc + 1;
+            continue;
+        default:
+            acc = acc - 1;
+        case 9:
+            steps = steps + 1;
+        }
+        pc = pc + 1 + steps * 0;
+    }
+    return acc;
+}
+
+int folded(int x) {
+    switch (x) {
+    default: x = x + 1;
+    case 5: x = x * 2; break;
+    case 6: x = 0;
+    }
+    return x;
+}
+
+const int F = folded(1) + folded(5) + folded(6);
+
+int main() {
+    int i = -1;
+    while (i < 10) {
+        printf("%d ", classify(i));
+        i = i + 1;
+    }
+    printf("\n");
+
+    int program[8] = {1, 1, 2, 3, 1, 4, 9, 2};
+    printf("%d\n", run(program, 8));
+
+    int hits = 0;
+    for (int k = 0; k < 20; k = k + 1) {
+        switch (k % 4) {
+        case 0: break;
+        }
+        switch (k % 5) { }
+        switch (k) {
+        case 3: hits = hits + 1;
+        }
+    }
+    printf("%d %d\n", F, hits);
+    return 0;
+}
@@ -0,0 +1,40 @@
+int calls;
+
+int bump(int x) {
+    calls = calls + 1;
+    return x;
+}
+
+int max(int a, int b) { return a > b ? a : b; }
+
+int sign(int x) { return x < 0 ? -1 : x == 0 ? 0 : 1; }
+
+// Guards that must not be speculated: the division, the out-of-range
+// element and the call only happen on the taken side.
+int safe_div(int a, int b) { return b != 0 ? a / b : 0; }
+
+const int N = 4 > 3 ? 5 : 2;
+
+int main() {
+    int a[N] = {3, 1, 4, 1, 5};
+    int i = 0;
+    int best = 0;
+    while (i < N) {
+        best = max(best, a[i]);
+        i = i + 1;
+    }
+    printf("%d %d %d %d\n", best, sign(-7), sign(0), sign(9));
+
+    printf("%d %d\n", safe_div(12, 4), safe_div(12, 0));
+    i = 7;
+    printf("%d\n", i < N ? a[i] : -1);
+
+    int picked = calls > 0 ? bump(1) : bump(2);
+    printf("%d %d\n", picked, calls);
+    picked = 0 ? bump(3) : 4;
+    printf("%d %d\n", picked, calls);
+
+    int x = 1 ? 2 ? 3 : 4 : 5;
+    printf("%d %d\n", x, (i > 5 ? 10 : 20) + 1);
+    return 0;
+}
@@ -0,0 +1,28 @@
+int table[8];
+
+int unused_leaf(int x) { return x * 7; }
+int unused_caller(int x) { return unused_leaf(x) + unused_caller(x - 1); }
+
+int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+int fib_sum(int n) { return fib(n) + fib(n + 1); }
+
+int cube(int x) { return x * x * x; }
+int fill(int n) {
+    parallel for (int i = 0; i < n; i = i + 1) table[i] = cube(i);
+    return n;
+}
+
+// Called only from a constant expression, so no IR needs it.
+int twice(int x) { return x + x; }
+const int kSize = twice(4);
+
+__attribute__((used)) int exported(int x) { return unused_leaf(x); }
+
+int main() {
+    fill(kSize);
+    printf("%d %d %d\n", fib(10), fib_sum(5), table[kSize - 1]);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+#
+# -fcycle-profile over test/cases, on the hosted path.
+#
+# Each case is built with -fcycle-profile against the hosted runtime (libc
+# plus src/runtime/cycle.c and parallel.c) and run. It must print the
+# case's expected output followed by the profile, in which main is called
+# once, no function's total cycles are below its self cycles, and every
+# function's calls match the entry count that -fprofile-generate records
+# for the same case. Parallel loop bodies run on the thread pool, so this
+# also checks that concurrent calls are counted and timed per thread.
+#
+# Override the host compiler with CC=... (default: clang) and the pool size
+# with ZCC_NUM_THREADS=... (default: 4, so that even a single CPU runs the
+# loop bodies on several threads).
+
+set -u
+
+export ZCC_NUM_THREADS="${ZCC_NUM_THREADS:-4}"
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COMPILER="${COMPILER:-$ROOT/build/compiler}"
+CASES_DIR="$ROOT/test/cases"
+CC="${CC:-clang}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+if [ ! -x "$COMPILER" ]; then
+    echo "error: $COMPILER not found - run 'make' first" >&2
+    exit 1
+fi
+
+for rt in parallel profile cycle; do
+    if ! "$CC" -c "$ROOT/src/runtime/$rt.c" -o "$WORK/$rt.o"; then
+        echo "error: cannot build the $rt runtime with $CC" >&2
+        exit 1
+    fi
+done
+
+pass=0 fail=0
+
+for src in "$CASES_DIR"/*.c; do
+    [ -e "$src" ] || continue
+    name="$(basename "$src" .c)"
+    head -n 1 "$src" | grep -q "XFAIL" && continue
+    want="$(cat "$CASES_DIR/$name.expected")"
+    flags="$(sed -n 's|^// FLAGS: *||p' "$src" | head -n 1)"
+    profile="$WORK/$name.profile"
+    log="$WORK/$name.log"
+
+    problem=""
+    if ! "$COMPILER" -llvm "$src" -o "$WORK/$name.cyc.ll" $flags -fcycle-profile >/dev/null 2>"$log" ||
+       ! "$CC" "$WORK/$name.cyc.ll" "$WORK/cycle.o" "$WORK/parallel.o" -pthread -o "$WORK/$name.cyc" 2>>"$log"; then
+        problem="instrumented build failed"
+    elif ! "$WORK/$name.cyc" >"$WORK/$name.out" 2>/dev/null; then
+        problem="instrumented run failed"
+    elif [ "$(head -n "$(printf '%s\n' "$want" | wc -l)" "$WORK/$name.out")" != "$want" ]; then
+        problem="instrumented run printed the wrong output"
+    elif ! grep -q "^cycle profile: " "$WORK/$name.out"; then
+        problem="no cycle profile printed"
+    elif ! "$COMPILER" -llvm "$src" -o "$WORK/$name.gen.ll" $flags -fprofile-generate="$profile" >/dev/null 2>>"$log" ||
+         ! "$CC" "$WORK/$name.gen.ll" "$WORK/profile.o" "$WORK/parallel.o" -pthread -o "$WORK/$name.gen" 2>>"$log" ||
+         ! "$WORK/$name.gen" >/dev/null 2>&1; then
+        problem="reference profile build failed"
+    else
+        # "<function> <calls>" from both profiles, for functions that ran.
+        sed -n '/self%/,$p' "$WORK/$name.out" | awk 'NR > 1 { print $5, $4 }' | sort >"$WORK/$name.calls"
+        awk 'NR > 1 && $1 != "end" && $4 > 0 { print $1, $4 }' "$profile" | sort >"$WORK/$name.want"
+        if ! diff "$WORK/$name.want" "$WORK/$name.calls" >>"$log"; then
+            problem="calls differ from the -fprofile-generate entry counts"
+        elif ! grep -qx "main 1" "$WORK/$name.calls"; then
+            problem="main is not called exactly once"
+        elif sed -n '/self%/,$p' "$WORK/$name.out" | awk 'NR > 1 && $3 < $2 { bad = 1 } END { exit !bad }'; then
+            problem="a function's total cycles are below its self cycles"
+        fi
+    fi
+
+    if [ -z "$problem" ]; then
+        echo "PASS  $name"
+        pass=$((pass + 1))
+    else
+        echo "FAIL  $name: $problem"
+        sed 's/^/      /' "$log" | head -n 5
+        fail=$((fail + 1))
+    fi
+done
+
+echo "----"
+echo "pass=$pass fail=$fail"
+[ $fail -eq 0 ]
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+#
+# Lexer throughput benchmark.
+#
+# Generates a large source file in the style that makes the flex scanner
+# slow (deep indentation, block and line comments, long identifiers, string
+# literals), lexes it with -lexer=flex and -lexer=hand using -lex-only, and
+# reports the best of RUNS runs of each in MB/s.
+#
+# Override the input size in MB with MB=... (default: 32) and the number of
+# runs with RUNS=... (default: 5).
+
+set -u
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COMPILER="${COMPILER:-$ROOT/build/compiler}"
+MB="${MB:-32}"
+RUNS="${RUNS:-5}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+if [ ! -x "$COMPILER" ]; then
+    echo "error: $COMPILER not found - run 'make' first" >&2
+    exit 1
+fi
+
+awk -v bytes=$((MB * 1000000)) 'BEGIN {
+    for (n = 0; size < bytes; n++) {
+        s = sprintf("/*\n * accumulate_partial_results_%d: folds one block of samples into the\n" \
+                    " * running totals; see the notes above for the overflow behaviour.\n */\n" \
+                    "int accumulate_partial_results_%d(int sample_buffer_length, int scale_factor) {\n" \
+                    "        int running_total_for_block = 0;   // reset for every block\n" \
+                    "        int sample_index_in_block = 0;\n" \
+                    "        while (sample_index_in_block < sample_buffer_length) {\n" \
+                    "                running_total_for_block = running_total_for_block + sample_index_in_block * scale_factor;\n" \
+                    "                sample_index_in_block = sample_index_in_block + 1;\n" \
+                    "        }\n" \
+                    "        printf(\"block %%d total %%d\\n\", %d, running_total_for_block);\n" \
+                    "        return running_total_for_block & 0x7fffffff;\n" \
+                    "}\n\n", n, n, n)
+        printf "%s", s
+        size += length(s)
+    }
+}' > "$WORK/bench.c"
+
+# best <lexer>: the highest MB/s of RUNS runs.
+best() {
+    local top=0 rate
+    for _ in $(seq 1 "$RUNS"); do
+        rate="$("$COMPILER" -llvm "$WORK/bench.c" -o /dev/null -lex-only "-lexer=$1" 2>&1 \
+                | sed -n 's/.*: \([0-9.]*\) MB\/s$/\1/p')"
+        [ -z "$rate" ] && return 1
+        top="$(awk -v a="$top" -v b="$rate" 'BEGIN { print (b > a ? b : a) }')"
+    done
+    echo "$top"
+}
+
+flex="$(best flex)" || { echo "error: -lexer=flex failed" >&2; exit 1; }
+hand="$(best hand)" || { echo "error: -lexer=hand failed" >&2; exit 1; }
+printf "input  %d MB, best of %d runs\n" "$MB" "$RUNS"
+printf "flex   %8.1f MB/s\n" "$flex"
+printf "hand   %8.1f MB/s  (%.1fx)\n" "$hand" "$(awk -v a="$flex" -v b="$hand" 'BEGIN { print b / a }')"
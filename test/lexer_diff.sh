@@ -0,0 +1,102 @@
+#!/usr/bin/env bash
+#
+# Differential test of the hand-written lexer against the flex one.
+#
+# Dumps the token stream (-dump-tokens: kind, value and location of every
+# token) of each input with -lexer=flex and -lexer=hand and requires them
+# to be identical. The inputs are every test/*.c and test/cases/*.c, plus
+# generated files that splice together fragments chosen to hit the edges
+# of the rules in parser/sysy.l: unterminated comments and strings, bad
+# escapes, numbers that overflow or end early, near-miss keywords and
+# operators, stray bytes, and runs long enough to span several vectors.
+#
+# Override the number of generated files with FILES=... (default: 200).
+
+set -u
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COMPILER="${COMPILER:-$ROOT/build/compiler}"
+FILES="${FILES:-200}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+if [ ! -x "$COMPILER" ]; then
+    echo "error: $COMPILER not found - run 'make' first" >&2
+    exit 1
+fi
+
+# generate <seed>: print a random splice of lexer edge cases on stdout.
+# (\047 is a single quote.)
+generate() {
+    LC_ALL=C awk -v seed="$1" '
+    function add(s) { piece[++n] = s }
+    BEGIN {
+        srand(seed)
+        add("int"); add("intx"); add("in"); add("__attribute__"); add("__attribute_")
+        add("parallel"); add("default"); add("a1_b2"); add("_"); add("x"); add("ZZ9")
+        add(" "); add("  "); add("\t"); add("\r"); add("\n"); add("\n\n")
+        add("// line\n"); add("//"); add("*/"); add("/* c */"); add("/** x **/")
+        add("*"); add("/")
+        add("\047a\047"); add("\047\\n\047"); add("\047\\q\047"); add("\047")
+        add("\047\047"); add("\047\\\047\047"); add("\047\n\047")
+        add("\"s\""); add("\"a\\\"b\""); add("\"\\\n\""); add("\""); add("\"x\ny\""); add("\\")
+        add("0x1F"); add("0X"); add("0x"); add("0"); add("0777"); add("09"); add("123")
+        add("4294967296"); add("99999999999999999999"); add("0xFFFFFFFFFF")
+        add("#pragma unroll(4)"); add("#pragm"); add("#")
+        add("&&"); add("&"); add("&&&"); add("||"); add("|"); add("=="); add("=")
+        add("!="); add("!"); add("<="); add("<<"); add("<"); add("<<="); add(">=")
+        add(">>"); add(">"); add("{"); add("}"); add(";"); add("("); add(")")
+        add("["); add("]"); add(","); add("+"); add("-"); add("%"); add("^"); add("~")
+        add("?"); add(":"); add("@"); add("$"); add("`"); add("\f"); add("\v")
+        for (i = 0; i < 400; i++) {
+            r = rand()
+            if (r < 0.03) {
+                # a long run: blanks, identifier tail, comment or string body
+                len = int(rand() * 100)
+                kind = int(rand() * 4)
+                s = ""
+                for (j = 0; j < len; j++) s = s (kind == 0 ? " " : kind == 1 ? "a" : "*")
+                if (kind == 2) s = "/*" s "*/"
+                if (kind == 3) s = "\"" s "\""
+                printf "%s", s
+            } else if (r < 0.032) {
+                # rare, as either one ends the token stream
+                printf (rand() < 0.5 ? "%c" : "/*"), 128 + int(rand() * 128)
+            } else {
+                printf "%s", piece[1 + int(rand() * n)]
+            }
+        }
+    }'
+}
+
+# tokens <src> <lexer>: the token dump, or a marker if the compiler failed.
+tokens() {
+    "$COMPILER" -llvm "$1" -o /dev/null -dump-tokens "-lexer=$2" 2>&1 || echo "<<exit $?>>"
+}
+
+fail=0
+total=0
+check() {
+    local src="$1" name="$2"
+    total=$((total + 1))
+    tokens "$src" flex > "$WORK/flex.txt"
+    tokens "$src" hand > "$WORK/hand.txt"
+    if ! cmp -s "$WORK/flex.txt" "$WORK/hand.txt"; then
+        echo "FAIL  $name"
+        diff "$WORK/flex.txt" "$WORK/hand.txt" | head -n 6 | sed 's/^/      /'
+        fail=$((fail + 1))
+    fi
+}
+
+for src in "$ROOT"/test/*.c "$ROOT"/test/cases/*.c; do
+    check "$src" "${src#$ROOT/}"
+done
+for seed in $(seq 1 "$FILES"); do
+    generate "$seed" > "$WORK/gen.c"
+    check "$WORK/gen.c" "generated (seed $seed)"
+done
+
+echo "----"
+[ $fail -eq 0 ] && echo "lexer: $total inputs agree" || echo "lexer: $fail of $total inputs differ"
+[ $fail -eq 0 ]
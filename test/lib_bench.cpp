@@ -0,0 +1,113 @@
+// libzcc throughput benchmark.
+//
+// Compiles every input to LLVM IR and to a baseline x86-64 object, ROUNDS
+// times over, first on one thread and then on THREADS threads at once, and
+// reports compilations per second for each. Every concurrent result must
+// match a serial compilation of the same input byte for byte, diagnostics
+// included, so the benchmark doubles as a check that zcc::Compile shares no
+// state between threads.
+//
+// Usage: lib_bench <input.c>...
+// Override the thread count with THREADS=... (default: the hardware's) and
+// the number of rounds with ROUNDS=... (default: 10).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zcc.h"
+
+namespace {
+
+struct Job {
+    std::string path;
+    std::string source;
+    zcc::Options options;
+    zcc::Result expected;
+};
+
+bool Same(const zcc::Result& a, const zcc::Result& b) {
+    return a.ok == b.ok && a.output == b.output && a.diagnostics == b.diagnostics;
+}
+
+// Runs every job `rounds` times on each of `threads` threads; returns the
+// wall time in seconds, or a negative value if any result differed.
+double Run(const std::vector<Job>& jobs, int threads, int rounds) {
+    std::atomic<bool> mismatch{false};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int r = 0; r < rounds; ++r) {
+                // Each thread starts at a different job, so the same input
+                // is rarely compiled twice at the same moment.
+                for (size_t i = 0; i < jobs.size(); ++i) {
+                    const Job& job = jobs[(i + t) % jobs.size()];
+                    zcc::Result result = zcc::Compile(job.source.data(), job.source.size(), job.options);
+                    if (!Same(result, job.expected) && !mismatch.exchange(true))
+                        fprintf(stderr, "error: %s differs when compiled concurrently\n", job.path.c_str());
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return mismatch ? -1 : elapsed.count();
+}
+
+int EnvInt(const char* name, int fallback) {
+    const char* value = getenv(name);
+    return value && atoi(value) > 0 ? atoi(value) : fallback;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input.c>...\n", argv[0]);
+        return 1;
+    }
+    int threads = EnvInt("THREADS", std::max(1u, std::thread::hardware_concurrency()));
+    int rounds = EnvInt("ROUNDS", 10);
+
+    std::vector<Job> jobs;
+    size_t bytes = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "error: cannot read %s\n", argv[i]);
+            return 1;
+        }
+        std::ostringstream text;
+        text << in.rdbuf();
+        for (auto output : {zcc::Output::LLVMIR, zcc::Output::X64Object}) {
+            Job job{argv[i], text.str(), {}, {}};
+            job.options.output = output;
+            job.options.filename = argv[i];
+            job.expected = zcc::Compile(job.source.data(), job.source.size(), job.options);
+            bytes += job.source.size();
+            jobs.push_back(std::move(job));
+        }
+    }
+
+    double serial = Run(jobs, 1, rounds);
+    double parallel = Run(jobs, threads, rounds);
+    if (serial < 0 || parallel < 0) return 1;
+
+    double perRound = jobs.size();
+    double mb = bytes / 1e6;
+    printf("%zu compilations of %.2f MB per round, %d rounds\n", jobs.size(), mb, rounds);
+    printf("1 thread   %8.1f compilations/s  %7.1f MB/s\n",
+           perRound * rounds / serial, mb * rounds / serial);
+    printf("%-2d threads %8.1f compilations/s  %7.1f MB/s  (%.1fx)\n", threads,
+           perRound * rounds * threads / parallel, mb * rounds * threads / parallel,
+           serial * threads / parallel);
+    return 0;
+}
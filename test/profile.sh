@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+#
+# Round trip of profile-guided optimization over test/cases.
+#
+# Each case is built with -fprofile-generate against the hosted runtime
+# (libc plus src/runtime/profile.c and parallel.c), run to write its
+# profile, then rebuilt with -fprofile-use at OPT and run again. Both runs
+# must print the case's expected output, the profile must match the code
+# it was taken from (no "does not match" warning), and the optimized IR
+# must carry the entry counts.
+#
+# Override the host compiler with CC=... (default: clang) and the level of
+# the optimized build with OPT=... (default: -O2).
+
+set -u
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COMPILER="${COMPILER:-$ROOT/build/compiler}"
+CASES_DIR="$ROOT/test/cases"
+CC="${CC:-clang}"
+OPT="${OPT:--O2}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+if [ ! -x "$COMPILER" ]; then
+    echo "error: $COMPILER not found - run 'make' first" >&2
+    exit 1
+fi
+
+for rt in parallel profile; do
+    if ! "$CC" -c "$ROOT/src/runtime/$rt.c" -o "$WORK/$rt.o"; then
+        echo "error: cannot build the $rt runtime with $CC" >&2
+        exit 1
+    fi
+done
+
+pass=0 fail=0
+
+for src in "$CASES_DIR"/*.c; do
+    [ -e "$src" ] || continue
+    name="$(basename "$src" .c)"
+    head -n 1 "$src" | grep -q "XFAIL" && continue
+    want="$(cat "$CASES_DIR/$name.expected")"
+    flags="$(sed -n 's|^// FLAGS: *||p' "$src" | head -n 1)"
+    profile="$WORK/$name.profile"
+    log="$WORK/$name.log"
+
+    problem=""
+    if ! "$COMPILER" -llvm "$src" -o "$WORK/$name.gen.ll" $flags -fprofile-generate="$profile" >/dev/null 2>"$log" ||
+       ! "$CC" "$WORK/$name.gen.ll" "$WORK/profile.o" "$WORK/parallel.o" -pthread -o "$WORK/$name.gen" 2>>"$log"; then
+        problem="instrumented build failed"
+    elif [ "$("$WORK/$name.gen" 2>/dev/null)" != "$want" ]; then
+        problem="instrumented run printed the wrong output"
+    elif [ ! -s "$profile" ]; then
+        problem="no profile written"
+    elif ! "$COMPILER" -llvm "$src" -o "$WORK/$name.use.ll" $flags $OPT -fprofile-use="$profile" >/dev/null 2>"$log" ||
+         ! "$CC" "$WORK/$name.use.ll" "$WORK/parallel.o" -pthread -o "$WORK/$name.use" 2>>"$log"; then
+        problem="optimized build failed"
+    elif grep -q "does not match" "$log"; then
+        problem="$(grep -m 1 "does not match" "$log")"
+    elif ! grep -q "function_entry_count" "$WORK/$name.use.ll"; then
+        problem="no entry counts in the optimized IR"
+    elif [ "$("$WORK/$name.use" 2>/dev/null)" != "$want" ]; then
+        problem="optimized run printed the wrong output"
+    fi
+
+    if [ -z "$problem" ]; then
+        echo "PASS  $name"
+        pass=$((pass + 1))
+    else
+        echo "FAIL  $name: $problem"
+        sed 's/^/      /' "$log" | head -n 5
+        fail=$((fail + 1))
+    fi
+done
+
+echo "----"
+echo "pass=$pass fail=$fail"
+[ $fail -eq 0 ]
@@ -4,7 +4,8 @@
 #
 # For each test/cases/<name>.c:
 #   1. compile to LLVM IR with the zcc compiler (-llvm mode)
-#   2. build a native binary with the host clang (libc printf/scanf as the oracle)
+#   2. build a native binary with the host clang (libc printf/scanf as the oracle),
+#      linked with the hosted build of the parallel-loop runtime
 #   3. run it and compare stdout to test/cases/<name>.expected
 #
 # A case whose first line contains "XFAIL" documents a known-broken feature:
@@ -12,7 +13,17 @@
 # is reported as "XPASS" (a hint to drop the marker). The suite's exit status is
 # non-zero only when a non-XFAIL case fails.
 #
-# Override the host compiler with CC=... (default: clang).
+# A line "// FLAGS: <options>" anywhere in a case passes extra options to zcc.
+# A line "// REJECT: <source> => <diagnostic>" adds a negative test to the
+# case: <source>, compiled on its own the same way, must fail with an error
+# that contains <diagnostic>. A "\n" in <source> starts a new line, for a
+# "#pragma" that must end before the code after it.
+#
+# Override the host compiler with CC=... (default: clang). With ORACLE=interp,
+# each case is run directly by "zcc -interp" instead, which needs neither the
+# host compiler nor the runtime. With BACKEND=baseline, zcc writes an x86-64
+# object with its baseline backend (-backend=baseline) instead of LLVM IR, and
+# the host compiler only links it.
 
 set -u
 
@@ -20,6 +31,8 @@ ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
 COMPILER="$ROOT/build/compiler"
 CASES_DIR="$ROOT/test/cases"
 CC="${CC:-clang}"
+ORACLE="${ORACLE:-clang}"
+BACKEND="${BACKEND:-llvm}"
 
 WORK="$(mktemp -d)"
 trap 'rm -rf "$WORK"' EXIT
@@ -29,6 +42,33 @@ if [ ! -x "$COMPILER" ]; then
     exit 1
 fi
 
+if [ "$ORACLE" != interp ] && ! "$CC" -c "$ROOT/src/runtime/parallel.c" -o "$WORK/parallel.o"; then
+    echo "error: cannot build the parallel runtime with $CC" >&2
+    exit 1
+fi
+
+# Compiles each "// REJECT:" program of case $1; prints the first one that is
+# not rejected as it should be, and fails.
+check_rejects() {
+    local line code want
+    while IFS= read -r line; do
+        code="${line%% => *}"
+        want="${line#* => }"
+        printf '%b\n' "$code" >"$WORK/reject.c"
+        if [ "$ORACLE" = interp ]; then
+            "$COMPILER" -interp "$WORK/reject.c" </dev/null >/dev/null 2>"$WORK/reject.log"
+        elif [ "$BACKEND" = baseline ]; then
+            "$COMPILER" -x64 "$WORK/reject.c" -o "$WORK/reject.o" -backend=baseline -c >/dev/null 2>"$WORK/reject.log"
+        else
+            "$COMPILER" -llvm "$WORK/reject.c" -o "$WORK/reject.ll" >/dev/null 2>"$WORK/reject.log"
+        fi
+        if [ $? -eq 0 ] || ! grep -qF -- "$want" "$WORK/reject.log"; then
+            echo "$code"
+            return 1
+        fi
+    done < <(sed -n 's|^// REJECT: *||p' "$1")
+}
+
 pass=0 fail=0 xfail=0 xpass=0
 
 for src in "$CASES_DIR"/*.c; do
@@ -47,19 +87,30 @@ for src in "$CASES_DIR"/*.c; do
         is_xfail=1
     fi
 
+    flags="$(sed -n 's|^// FLAGS: *||p' "$src" | head -n 1)"
+
     ll="$WORK/$name.ll"
     bin="$WORK/$name.bin"
     ok=1
-    "$COMPILER" -llvm "$src" -o "$ll" >/dev/null 2>"$WORK/$name.cc.log" || ok=0
-    if [ $ok -eq 1 ]; then
-        "$CC" "$ll" -o "$bin" >/dev/null 2>"$WORK/$name.ld.log" || ok=0
-    fi
-
     got=""
-    if [ $ok -eq 1 ]; then
-        got="$("$bin" 2>/dev/null)"
+    if [ "$ORACLE" = interp ]; then
+        got="$("$COMPILER" -interp "$src" $flags </dev/null 2>"$WORK/$name.cc.log")"
+    else
+        if [ "$BACKEND" = baseline ]; then
+            ll="$WORK/$name.o"
+            "$COMPILER" -x64 "$src" -o "$ll" -backend=baseline -c $flags >/dev/null 2>"$WORK/$name.cc.log" || ok=0
+        else
+            "$COMPILER" -llvm "$src" -o "$ll" $flags >/dev/null 2>"$WORK/$name.cc.log" || ok=0
+        fi
+        if [ $ok -eq 1 ]; then
+            "$CC" "$ll" "$WORK/parallel.o" -pthread -o "$bin" >/dev/null 2>"$WORK/$name.ld.log" || ok=0
+        fi
+        if [ $ok -eq 1 ]; then
+            got="$("$bin" 2>/dev/null)"
+        fi
     fi
     want="$(cat "$exp")"
+    accepted="$(check_rejects "$src")" || ok=0
 
     if [ $ok -eq 1 ] && [ "$got" = "$want" ]; then
         if [ $is_xfail -eq 1 ]; then
@@ -77,6 +128,7 @@ for src in "$CASES_DIR"/*.c; do
             echo "FAIL  $name"
             echo "      expected: $(printf '%q' "$want")"
             echo "      got:      $(printf '%q' "$got")"
+            [ -n "$accepted" ] && echo "      accepted: $accepted"
             fail=$((fail + 1))
         fi
     fi
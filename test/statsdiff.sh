@@ -0,0 +1,135 @@
+#!/usr/bin/env bash
+#
+# -stats-json reports over test/cases, and tools/statsdiff on them.
+#
+# Each case is compiled twice with -stats-json. The report must have an
+# entry for main, and its module entry must count the function entries and
+# sum their counters (instructions, blocks, loops, loads, ...). statsdiff
+# must find no changes between the two builds (exit 0, "no changes").
+# Then a program that gains a function called from main must be reported
+# as changed (exit 1, "added function", main's calls and the module's
+# function count one higher), and the other way round as "removed
+# function"; a report that cannot be read is an error (exit 2).
+#
+# Override the statsdiff binary with STATSDIFF=... (default: build/statsdiff,
+# see 'make statsdiff').
+
+set -u
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COMPILER="${COMPILER:-$ROOT/build/compiler}"
+STATSDIFF="${STATSDIFF:-$ROOT/build/statsdiff}"
+CASES_DIR="$ROOT/test/cases"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+for tool in "$COMPILER" "$STATSDIFF"; do
+    if [ ! -x "$tool" ]; then
+        echo "error: $tool not found - run 'make' and 'make statsdiff' first" >&2
+        exit 1
+    fi
+done
+
+# "<entry> <counter> <value>" for each top-level counter of report $1, where
+# <entry> is "module" or a function name.
+counters() {
+    awk '
+        /^  "functions": / { section = "functions"; next }
+        /^  "module": / { section = "module"; next }
+        section == "functions" && /^    \{$/ { n = 0 }
+        section == "functions" && /^      "[a-z_]+": -?[0-9]+,?$/ {
+            gsub(/[",:]/, ""); keys[n] = $1; values[n++] = $2
+        }
+        section == "functions" && /^      "name": / { gsub(/[",]/, "", $2); name = $2 }
+        section == "functions" && /^    \},?$/ { for (i = 0; i < n; i++) print name, keys[i], values[i] }
+        section == "module" && /^    "[a-z_]+": -?[0-9]+,?$/ { gsub(/[",:]/, ""); print "module", $1, $2 }
+    ' "$1"
+}
+
+# Runs statsdiff on $1 and $2 into $3; prints its exit status.
+statsdiff() {
+    "$STATSDIFF" "$1" "$2" >"$3" 2>&1
+    echo $?
+}
+
+pass=0 fail=0
+
+for src in "$CASES_DIR"/*.c; do
+    [ -e "$src" ] || continue
+    name="$(basename "$src" .c)"
+    head -n 1 "$src" | grep -q "XFAIL" && continue
+    flags="$(sed -n 's|^// FLAGS: *||p' "$src" | head -n 1)"
+    log="$WORK/$name.log"
+
+    problem=""
+    for build in old new; do
+        if ! "$COMPILER" -llvm "$src" -o "$WORK/$name.$build.ll" $flags \
+                -stats-json="$WORK/$name.$build.json" >/dev/null 2>>"$log"; then
+            problem="$build build failed"
+            break
+        fi
+    done
+
+    if [ -z "$problem" ]; then
+        counters "$WORK/$name.old.json" >"$WORK/$name.counters"
+        # Counters the module entry would have if it summed its functions.
+        awk '$1 != "module" { sum[$2] += $3; if ($2 == "instructions") n++ }
+             END { print "module functions", n + 0
+                   for (k in sum) if (k != "code_bytes") print "module", k, sum[k] }' \
+            "$WORK/$name.counters" | sort >"$WORK/$name.sums"
+        if ! grep -q "^main instructions [1-9]" "$WORK/$name.counters"; then
+            problem="no entry for main"
+        elif ! grep "^module " "$WORK/$name.counters" | sort | comm -13 - "$WORK/$name.sums" | diff /dev/null - >>"$log"; then
+            problem="the module entry does not sum the functions"
+        elif [ "$(statsdiff "$WORK/$name.old.json" "$WORK/$name.new.json" "$WORK/$name.same")" != 0 ] ||
+             ! grep -qx "no changes" "$WORK/$name.same"; then
+            cat "$WORK/$name.same" >>"$log"
+            problem="statsdiff found changes between two identical builds"
+        fi
+    fi
+
+    if [ -z "$problem" ]; then
+        echo "PASS  $name"
+        pass=$((pass + 1))
+    else
+        echo "FAIL  $name: $problem"
+        sed 's/^/      /' "$log" | head -n 5
+        fail=$((fail + 1))
+    fi
+done
+
+# Reports of a program before and after it gains a function.
+printf 'int f(int x) { return x * 2; }\nint main() { return f(1); }\n' >"$WORK/before.c"
+printf 'int f(int x) { return x * 2; }\nint g(int x) { return x + 1; }\nint main() { return f(1) + g(2); }\n' >"$WORK/after.c"
+problem=""
+for build in before after; do
+    if ! "$COMPILER" -llvm "$WORK/$build.c" -o "$WORK/$build.ll" -stats-json="$WORK/$build.json" >/dev/null 2>&1; then
+        problem="$build build failed"
+    fi
+done
+if [ -n "$problem" ]; then
+    :
+elif [ "$(statsdiff "$WORK/before.json" "$WORK/after.json" "$WORK/added")" != 1 ] ||
+     ! grep -qx "added function g" "$WORK/added" ||
+     ! grep -Eq "^  functions +2 +3 +\+1 " "$WORK/added" ||
+     ! sed -n '/^function main$/,/^[a-z]/p' "$WORK/added" | grep -Eq "^  calls +1 +2 +\+1 "; then
+    problem="statsdiff did not report the added function"
+elif [ "$(statsdiff "$WORK/after.json" "$WORK/before.json" "$WORK/removed")" != 1 ] ||
+     ! grep -qx "removed function g" "$WORK/removed"; then
+    problem="statsdiff did not report the removed function"
+elif [ "$(statsdiff "$WORK/missing.json" "$WORK/before.json" "$WORK/missing")" != 2 ]; then
+    problem="statsdiff did not fail on a missing report"
+fi
+if [ -z "$problem" ]; then
+    echo "PASS  (statsdiff)"
+    pass=$((pass + 1))
+else
+    echo "FAIL  (statsdiff): $problem"
+    cat "$WORK/added" "$WORK/removed" 2>/dev/null | sed 's/^/      /' | head -n 10
+    fail=$((fail + 1))
+fi
+
+echo "----"
+echo "pass=$pass fail=$fail"
+[ $fail -eq 0 ]
@@ -0,0 +1,119 @@
+#!/usr/bin/env bash
+#
+# Stress test for very deep inputs.
+#
+# Generates machine-style sources whose expressions or statements nest
+# N levels deep, at sizes N, 2N and 4N, and compiles each with zcc (-llvm)
+# under a small C++ stack. Every shape must compile, and compile time and
+# peak memory (when /usr/bin/time is available) must stay roughly linear:
+# quadrupling N may cost at most MAX_GROWTH times as much.
+#
+# Shapes:
+#   sum      x + x + ... + x                   (left-deep operators)
+#   nested   x + (x + (... + x))               (right-deep, parenthesized)
+#   land     x && x && ... && x                (short-circuit chain)
+#   ternary  x == 0 ? 0 : x == 1 ? 1 : ...     (conditional chain)
+#   elseif   if (x == 0) ... else if ...       (else-if ladder)
+#
+# Override the base size with N=... (default: 25000), the stack limit in KB
+# with STACK_KB=... (default: 1024) and the bound with MAX_GROWTH=... (default: 8).
+
+set -u
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COMPILER="${COMPILER:-$ROOT/build/compiler}"
+N="${N:-25000}"
+STACK_KB="${STACK_KB:-1024}"
+MAX_GROWTH="${MAX_GROWTH:-8}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+if [ ! -x "$COMPILER" ]; then
+    echo "error: $COMPILER not found - run 'make' first" >&2
+    exit 1
+fi
+
+# generate <shape> <n>: print a test program on stdout.
+generate() {
+    awk -v shape="$1" -v n="$2" 'BEGIN {
+        print "int main() {"
+        print "    int x = 1;"
+        if (shape == "sum" || shape == "land") {
+            op = shape == "sum" ? " + " : " && "
+            printf "    int r = x"
+            for (i = 1; i < n; i++) printf "%s%s", op, (i % 16 ? "x" : "\n        x")
+            print ";"
+        } else if (shape == "nested") {
+            printf "    int r = "
+            for (i = 1; i < n; i++) printf "x + (%s", (i % 16 ? "" : "\n        ")
+            printf "x"
+            for (i = 1; i < n; i++) printf ")"
+            print ";"
+        } else if (shape == "ternary") {
+            printf "    int r = "
+            for (i = 0; i < n; i++) printf "x == %d ? %d :%s", i, i, (i % 8 ? " " : "\n        ")
+            print "-1;"
+        } else if (shape == "elseif") {
+            print "    int r = -1;"
+            printf "    "
+            for (i = 0; i < n; i++) printf "if (x == %d) r = %d;\n    else ", i, i
+            print "r = -2;"
+        }
+        print "    printf(\"%d\\n\", r);"
+        print "    return 0;"
+        print "}"
+    }'
+}
+
+# measure <src>: compile, and print "<milliseconds> <peak KB or ->".
+measure() {
+    local src="$1" start end kb="-"
+    start=$(date +%s%N)
+    if [ -x /usr/bin/time ]; then
+        ( ulimit -s "$STACK_KB"
+          /usr/bin/time -f "%M" -o "$WORK/rss" "$COMPILER" -llvm "$src" -o "$WORK/out.ll" ) \
+            >/dev/null 2>"$WORK/log" || return 1
+        kb="$(tail -n 1 "$WORK/rss")"
+    else
+        ( ulimit -s "$STACK_KB"
+          "$COMPILER" -llvm "$src" -o "$WORK/out.ll" ) >/dev/null 2>"$WORK/log" || return 1
+    fi
+    end=$(date +%s%N)
+    echo "$(( (end - start) / 1000000 )) $kb"
+}
+
+# within <small> <large>: true unless large exceeds MAX_GROWTH times small.
+within() {
+    [ "$1" = "-" ] || [ "$2" = "-" ] && return 0
+    local base=$(( $1 > 0 ? $1 : 1 ))
+    [ "$2" -le $(( base * MAX_GROWTH )) ]
+}
+
+fail=0
+printf "%-8s %8s %10s %10s\n" shape n ms peak-kb
+for shape in sum nested land ternary elseif; do
+    first=""
+    for n in "$N" $((N * 2)) $((N * 4)); do
+        src="$WORK/$shape-$n.c"
+        generate "$shape" "$n" > "$src"
+        if ! result="$(measure "$src")"; then
+            echo "FAIL  $shape n=$n: compiler failed"
+            sed 's/^/      /' "$WORK/log" | head -n 5
+            fail=$((fail + 1))
+            continue 2
+        fi
+        read -r ms kb <<< "$result"
+        printf "%-8s %8d %10d %10s\n" "$shape" "$n" "$ms" "$kb"
+        [ -z "$first" ] && first="$ms $kb"
+    done
+    read -r ms0 kb0 <<< "$first"
+    if ! within "$ms0" "$ms" || ! within "$kb0" "$kb"; then
+        echo "FAIL  $shape: growth from n=$N to n=$((N * 4)) is not linear"
+        fail=$((fail + 1))
+    fi
+done
+
+echo "----"
+[ $fail -eq 0 ] && echo "stress: ok" || echo "stress: $fail shape(s) failed"
+[ $fail -eq 0 ]
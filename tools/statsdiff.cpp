@@ -0,0 +1,118 @@
+// Compares two -stats-json reports.
+//
+// Usage: statsdiff <old.json> <new.json>
+//
+// Prints every counter that changed, for the module and then for each
+// function present in both reports, followed by the functions only one of
+// them has. Opcode counts show up as `opcodes.<name>`. Exits with 0 when
+// nothing changed, 1 when something did and 2 on error, like diff(1).
+
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace {
+
+using Counters = std::map<std::string, int64_t>;
+
+bool Load(const char* path, llvm::json::Value& report) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        fprintf(stderr, "statsdiff: cannot read %s: %s\n", path, buffer.getError().message().c_str());
+        return false;
+    }
+    auto parsed = llvm::json::parse((*buffer)->getBuffer());
+    if (!parsed) {
+        fprintf(stderr, "statsdiff: %s: %s\n", path, llvm::toString(parsed.takeError()).c_str());
+        return false;
+    }
+    report = std::move(*parsed);
+    return true;
+}
+
+// The integer counters of one module or function entry, opcodes flattened.
+Counters Flatten(const llvm::json::Object& entry) {
+    Counters counters;
+    for (auto& field : entry) {
+        if (auto value = field.second.getAsInteger()) counters[field.first.str()] = *value;
+        if (auto* opcodes = field.second.getAsObject())
+            for (auto& op : *opcodes)
+                if (auto count = op.second.getAsInteger()) counters["opcodes." + op.first.str()] = *count;
+    }
+    return counters;
+}
+
+std::map<std::string, Counters> Functions(const llvm::json::Value& report) {
+    std::map<std::string, Counters> functions;
+    if (auto* obj = report.getAsObject())
+        if (auto* list = obj->getArray("functions"))
+            for (auto& entry : *list)
+                if (auto* func = entry.getAsObject())
+                    if (auto name = func->getString("name")) functions[name->str()] = Flatten(*func);
+    return functions;
+}
+
+Counters Module(const llvm::json::Value& report) {
+    if (auto* obj = report.getAsObject())
+        if (auto* module = obj->getObject("module")) return Flatten(*module);
+    return {};
+}
+
+// Prints the counters of `a` and `b` that differ under `title`; returns
+// whether any did.
+bool Compare(const std::string& title, const Counters& a, const Counters& b) {
+    std::set<std::string> keys;
+    for (auto& c : a) keys.insert(c.first);
+    for (auto& c : b) keys.insert(c.first);
+
+    bool changed = false;
+    for (auto& key : keys) {
+        auto oldIt = a.find(key), newIt = b.find(key);
+        int64_t before = oldIt != a.end() ? oldIt->second : 0;
+        int64_t after = newIt != b.end() ? newIt->second : 0;
+        if (before == after) continue;
+        if (!changed) printf("%s\n", title.c_str());
+        changed = true;
+        printf("  %-28s %10lld %10lld %+10lld", key.c_str(), (long long)before, (long long)after,
+               (long long)(after - before));
+        if (before) printf(" (%+.1f%%)", 100.0 * (after - before) / before);
+        printf("\n");
+    }
+    return changed;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <old.json> <new.json>\n", argv[0]);
+        return 2;
+    }
+    llvm::json::Value before = nullptr, after = nullptr;
+    if (!Load(argv[1], before) || !Load(argv[2], after)) return 2;
+
+    printf("  %-28s %10s %10s %10s\n", "", "old", "new", "delta");
+    bool changed = Compare("module", Module(before), Module(after));
+
+    auto oldFuncs = Functions(before), newFuncs = Functions(after);
+    for (auto& func : oldFuncs) {
+        auto found = newFuncs.find(func.first);
+        if (found != newFuncs.end()) changed |= Compare("function " + func.first, func.second, found->second);
+    }
+    for (auto& func : oldFuncs) {
+        if (newFuncs.count(func.first)) continue;
+        printf("removed function %s\n", func.first.c_str());
+        changed = true;
+    }
+    for (auto& func : newFuncs) {
+        if (oldFuncs.count(func.first)) continue;
+        printf("added function %s\n", func.first.c_str());
+        changed = true;
+    }
+    if (!changed) printf("no changes\n");
+    return changed ? 1 : 0;
+}